@@ -95,6 +95,7 @@ static void print_iface_info(uct_worker_h worker, uct_md_h md,
     ucs_status_t status;
     uct_iface_h iface;
     char buf[200] = {0};
+    int i;
     uct_iface_params_t iface_params = {
         .tl_name     = resource->tl_name,
         .dev_name    = resource->dev_name,
@@ -192,6 +193,18 @@ static void print_iface_info(uct_worker_h worker, uct_md_h md,
 
         printf("#             priority: %d\n", iface_attr.priority);
 
+        if (iface_attr.numa_node_mask != 0) {
+            buf[0] = '\0';
+            for (i = 0; i < 64; ++i) {
+                if (iface_attr.numa_node_mask & UCS_BIT(i)) {
+                    snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
+                             " %d,", i);
+                }
+            }
+            buf[strlen(buf) - 1] = '\0';
+            printf("#            numa node:%s\n", buf);
+        }
+
         printf("#       device address: %zu bytes\n", iface_attr.device_addr_len);
         if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_IFACE) {
             printf("#        iface address: %zu bytes\n", iface_attr.iface_addr_len);
@@ -349,6 +362,9 @@ static void print_md_info(const char *md_name, int print_opts,
                 printf("+(%.3f*<SIZE>)", md_attr.reg_cost.growth * 1e9);
             }
             printf(" nsec\n");
+            if (md_attr.cap.flags & UCT_MD_FLAG_RCACHE) {
+                printf("#                       registration cache\n");
+            }
         }
         if (md_attr.cap.flags & UCT_MD_FLAG_NEED_RKEY) {
             printf("#           remote key: %zu bytes\n", md_attr.rkey_packed_size);
@@ -468,6 +468,22 @@ static ucs_status_t uct_perf_test_check_capabilities(ucx_perf_params_t *params,
         }
     }
 
+    if (params->uct.num_eps == 0) {
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("Number of endpoints must be at least 1");
+        }
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    if ((params->uct.num_eps > 1) &&
+        !(attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_IFACE)) {
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("Many-to-one test requires a transport which connects "
+                      "to interface");
+        }
+        return UCS_ERR_UNSUPPORTED;
+    }
+
     if (UCT_PERF_DATA_LAYOUT_ZCOPY == params->uct.data_layout) {
         if (params->msg_size_cnt > max_iov) {
             if ((params->flags & UCX_PERF_TEST_FLAG_VERBOSE) ||
@@ -494,11 +510,28 @@ static ucs_status_t uct_perf_test_check_capabilities(ucx_perf_params_t *params,
     return UCS_OK;
 }
 
+static void uct_perf_test_destroy_peer_eps(ucx_perf_context_t *perf,
+                                           uct_peer_t *peer)
+{
+    unsigned ep_index;
+
+    if (peer->eps == NULL) {
+        return;
+    }
+
+    for (ep_index = 0; ep_index < perf->params.uct.num_eps; ++ep_index) {
+        if (peer->eps[ep_index] != NULL) {
+            uct_ep_destroy(peer->eps[ep_index]);
+        }
+    }
+    free(peer->eps);
+}
+
 static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
 {
     const size_t buffer_size = 2048;
     ucx_perf_ep_info_t info, *remote_info;
-    unsigned group_size, i, group_index;
+    unsigned group_size, i, group_index, ep_index;
     uct_device_addr_t *dev_addr;
     uct_iface_addr_t *iface_addr;
     uct_ep_addr_t *ep_addr;
@@ -576,6 +609,15 @@ static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
         goto err_free;
     }
 
+    for (i = 0; i < group_size; ++i) {
+        perf->uct.peers[i].eps = calloc(perf->params.uct.num_eps,
+                                        sizeof(*perf->uct.peers[i].eps));
+        if (perf->uct.peers[i].eps == NULL) {
+            status = UCS_ERR_NO_MEMORY;
+            goto err_destroy_eps;
+        }
+    }
+
     if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_EP) {
         for (i = 0; i < group_size; ++i) {
             if (i == group_index) {
@@ -587,6 +629,7 @@ static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
                 ucs_error("Failed to uct_ep_create: %s", ucs_status_string(status));
                 goto err_destroy_eps;
             }
+            perf->uct.peers[i].eps[0] = perf->uct.peers[i].ep;
             status = uct_ep_get_address(perf->uct.peers[i].ep, ep_addr);
             if (status != UCS_OK) {
                 ucs_error("Failed to uct_ep_get_address: %s", ucs_status_string(status));
@@ -633,8 +676,17 @@ static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
         if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_EP) {
             status = uct_ep_connect_to_ep(perf->uct.peers[i].ep, dev_addr, ep_addr);
         } else if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_IFACE) {
-            status = uct_ep_create_connected(perf->uct.iface, dev_addr, iface_addr,
-                                             &perf->uct.peers[i].ep);
+            /* Every endpoint is a separate connection to the peer, so with
+             * num_eps > 1 the peer sees many senders */
+            for (ep_index = 0; ep_index < perf->params.uct.num_eps; ++ep_index) {
+                status = uct_ep_create_connected(perf->uct.iface, dev_addr,
+                                                 iface_addr,
+                                                 &perf->uct.peers[i].eps[ep_index]);
+                if (status != UCS_OK) {
+                    break;
+                }
+            }
+            perf->uct.peers[i].ep = perf->uct.peers[i].eps[0];
         } else {
             status = UCS_ERR_UNSUPPORTED;
         }
@@ -654,9 +706,7 @@ err_destroy_eps:
         if (perf->uct.peers[i].rkey.type != NULL) {
             uct_rkey_release(&perf->uct.peers[i].rkey);
         }
-        if (perf->uct.peers[i].ep != NULL) {
-            uct_ep_destroy(perf->uct.peers[i].ep);
-        }
+        uct_perf_test_destroy_peer_eps(perf, &perf->uct.peers[i]);
     }
     free(perf->uct.peers);
 err_free:
@@ -681,10 +731,8 @@ static void uct_perf_test_cleanup_endpoints(ucx_perf_context_t *perf)
             if (perf->uct.peers[i].rkey.rkey != UCT_INVALID_RKEY) {
                 uct_rkey_release(&perf->uct.peers[i].rkey);
             }
-            if (perf->uct.peers[i].ep) {
-                uct_ep_destroy(perf->uct.peers[i].ep);
-            }
         }
+        uct_perf_test_destroy_peer_eps(perf, &perf->uct.peers[i]);
     }
     free(perf->uct.peers);
 }
@@ -726,6 +774,28 @@ static ucs_status_t ucp_perf_test_check_params(ucx_perf_params_t *params,
         return UCS_ERR_INVALID_PARAM;
     }
 
+    switch (params->wait_mode) {
+    case UCX_PERF_WAIT_MODE_PROGRESS:
+    case UCX_PERF_WAIT_MODE_LAST:
+        break;
+    case UCX_PERF_WAIT_MODE_SLEEP:
+    case UCX_PERF_WAIT_MODE_ADAPTIVE:
+        /* Only tag requests complete by remote events */
+        if (params->command != UCX_PERF_CMD_TAG) {
+            if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+                ucs_error("Wait mode is supported only for tag tests");
+            }
+            return UCS_ERR_UNSUPPORTED;
+        }
+        *features |= UCP_FEATURE_WAKEUP;
+        break;
+    default:
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("Invalid wait mode");
+        }
+        return UCS_ERR_INVALID_PARAM;
+    }
+
     status = ucx_perf_test_check_params(params);
     if (status != UCS_OK) {
         return status;
@@ -1188,6 +1258,16 @@ static ucs_status_t ucp_perf_setup(ucx_perf_context_t *perf, ucx_perf_params_t *
         goto err;
     }
 
+    if (params->wait_mode == UCX_PERF_WAIT_MODE_SLEEP) {
+        status = ucp_config_modify(config, "WAIT_MODE", "sleep");
+    } else if (params->wait_mode == UCX_PERF_WAIT_MODE_ADAPTIVE) {
+        status = ucp_config_modify(config, "WAIT_MODE", "adaptive");
+    }
+    if (status != UCS_OK) {
+        ucp_config_release(config);
+        goto err;
+    }
+
     ucp_params.field_mask      = UCP_PARAM_FIELD_FEATURES;
     ucp_params.features        = features;
 
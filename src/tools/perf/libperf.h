@@ -66,6 +66,8 @@ typedef enum {
     UCX_PERF_WAIT_MODE_PROGRESS,     /* Repeatedly call progress */
     UCX_PERF_WAIT_MODE_SLEEP,        /* Go to sleep */
     UCX_PERF_WAIT_MODE_SPIN,         /* Spin without calling progress */
+    UCX_PERF_WAIT_MODE_ADAPTIVE,     /* Call progress for a self-tuned time, then
+                                        go to sleep */
     UCX_PERF_WAIT_MODE_LAST
 } ucx_perf_wait_mode_t;
 
@@ -173,6 +175,8 @@ typedef struct ucx_perf_params {
         char                   tl_name[UCT_TL_NAME_MAX];      /* Transport to use */
         uct_perf_data_layout_t data_layout; /* Data layout to use */
         unsigned               fc_window;   /* Window size for flow control <= UCX_PERF_TEST_MAX_FC_WINDOW */
+        unsigned               num_eps;     /* Number of endpoints the sender opens to
+                                               its peer, used for many-to-one tests */
     } uct;
 
     struct {
@@ -77,6 +77,8 @@ struct ucx_perf_context {
 
 struct uct_peer {
     uct_ep_h                     ep;
+    uct_ep_h                     *eps;        /* All endpoints to the peer, the
+                                                 first one is 'ep' */
     unsigned long                remote_addr;
     uct_rkey_bundle_t            rkey;
 };
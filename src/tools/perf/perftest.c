@@ -78,7 +78,7 @@ struct perftest_context {
     sock_rte_group_t             sock_rte_group;
 };
 
-#define TEST_PARAMS_ARGS   "t:n:s:W:O:w:D:i:H:oSCqM:T:d:x:A:B"
+#define TEST_PARAMS_ARGS   "t:n:s:W:O:w:D:i:H:oSCqM:T:d:x:A:BE:m:"
 
 
 test_type_t tests[] = {
@@ -345,6 +345,9 @@ static void usage(struct perftest_context *ctx, const char *program)
                                 ctx->params.max_outstanding);
     printf("     -i <count>     Distance between starting address of consecutive "
                                 "IOV entries. The same as UCT uct_iov_t stride.\n");
+    printf("     -E <count>     Number of endpoints the sender opens to the receiver, "
+                                "and sends over in round-robin (many-to-one test). (%u)\n",
+                                ctx->params.uct.num_eps);
     printf("     -N             Use numeric formatting - thousands separator.\n");
     printf("     -f             Print only final numbers.\n");
     printf("     -v             Print CSV-formatted output.\n");
@@ -363,6 +366,11 @@ static void usage(struct perftest_context *ctx, const char *program)
     printf("     -A <mode>      Async progress mode. (thread)\n");
     printf("                        thread     : Use separate progress thread.\n");
     printf("                        signal     : Use signal based timer.\n"); 
+    printf("     -m <mode>      How to wait for completion of UCP tag requests. (progress)\n");
+    printf("                        progress   : Call progress repeatedly.\n");
+    printf("                        sleep      : Call progress, then sleep in ucp_worker_wait().\n");
+    printf("                        adaptive   : Call progress, then wait in ucp_worker_wait(),\n");
+    printf("                                     which spins for a self-tuned time before sleeping.\n");
     printf("     -B             Register memory with NONBLOCK flag.\n");
     printf("     -C             Use wildcard for tag tests.\n");
     printf("     -S             Use synchronous mode for tag sends.\n");
@@ -457,6 +465,7 @@ static void init_test_params(ucx_perf_params_t *params)
     params->report_interval = 1.0;
     params->flags           = UCX_PERF_TEST_FLAG_VERBOSE;
     params->uct.fc_window   = UCT_PERF_TEST_MAX_FC_WINDOW;
+    params->uct.num_eps     = 1;
     params->uct.data_layout = UCT_PERF_DATA_LAYOUT_SHORT;
     params->msg_size_cnt    = 1;
     params->iov_stride      = 0;
@@ -536,6 +545,9 @@ static ucs_status_t parse_test_params(ucx_perf_params_t *params, char opt, const
     case 'O':
         params->max_outstanding = atoi(optarg);
         return UCS_OK;
+    case 'E':
+        params->uct.num_eps = atoi(optarg);
+        return UCS_OK;
     case 'w':
         params->warmup_iter = atol(optarg);
         return UCS_OK;
@@ -583,6 +595,20 @@ static ucs_status_t parse_test_params(ucx_perf_params_t *params, char opt, const
             ucs_error("Invalid option argument for -A");
             return UCS_ERR_INVALID_PARAM;
         }
+    case 'm':
+        if (0 == strcmp(optarg, "progress")) {
+            params->wait_mode = UCX_PERF_WAIT_MODE_PROGRESS;
+            return UCS_OK;
+        } else if (0 == strcmp(optarg, "sleep")) {
+            params->wait_mode = UCX_PERF_WAIT_MODE_SLEEP;
+            return UCS_OK;
+        } else if (0 == strcmp(optarg, "adaptive")) {
+            params->wait_mode = UCX_PERF_WAIT_MODE_ADAPTIVE;
+            return UCS_OK;
+        } else {
+            ucs_error("Invalid option argument for -m");
+            return UCS_ERR_INVALID_PARAM;
+        }
     default:
        return UCS_ERR_INVALID_PARAM;
     }
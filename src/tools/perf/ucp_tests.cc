@@ -27,8 +27,9 @@ public:
     ucp_perf_test_runner(ucx_perf_context_t &perf) :
         m_perf(perf),
         m_outstanding(0),
-        m_max_outstanding(m_perf.params.max_outstanding)
-
+        m_max_outstanding(m_perf.params.max_outstanding),
+        m_sleep((m_perf.params.wait_mode == UCX_PERF_WAIT_MODE_SLEEP) ||
+                (m_perf.params.wait_mode == UCX_PERF_WAIT_MODE_ADAPTIVE))
     {
         ucs_assert_always(m_max_outstanding > 0);
     }
@@ -103,6 +104,9 @@ public:
             } else {
                 progress_responder();
             }
+            if (m_sleep && !ucp_request_is_completed(request)) {
+                ucp_worker_wait(m_perf.ucp.worker);
+            }
         }
         ucp_request_release(request);
         return UCS_OK;
@@ -350,6 +354,7 @@ private:
     ucx_perf_context_t &m_perf;
     unsigned           m_outstanding;
     const unsigned     m_max_outstanding;
+    const bool         m_sleep;  /* Whether to call ucp_worker_wait() */
 };
 
 
@@ -39,7 +39,9 @@ public:
         ucs_assert_always(status == UCS_OK);
         if (attr.cap.flags & (UCT_IFACE_FLAG_AM_SHORT|UCT_IFACE_FLAG_AM_BCOPY|UCT_IFACE_FLAG_AM_ZCOPY)) {
             status = uct_iface_set_am_handler(m_perf.uct.iface, UCT_PERF_TEST_AM_ID,
-                                              am_hander, m_perf.recv_buffer, UCT_AM_CB_FLAG_SYNC);
+                                              (m_perf.params.uct.num_eps > 1) ?
+                                              am_hander_many2one : am_hander,
+                                              m_perf.recv_buffer, UCT_AM_CB_FLAG_SYNC);
             ucs_assert_always(status == UCS_OK);
         }
     }
@@ -140,6 +142,17 @@ public:
         return UCS_OK;
     }
 
+    static ucs_status_t am_hander_many2one(void *arg, void *data, size_t length,
+                                           unsigned flags)
+    {
+        /* In many-to-one mode messages arrive over several connections and
+         * may be reordered, so keep the highest sequence number seen */
+        if (UCS_CIRCULAR_COMPARE8(*(psn_t*)arg, <, *(psn_t*)data)) {
+            *(psn_t*)arg = *(psn_t*)data;
+        }
+        return UCS_OK;
+    }
+
     static size_t pack_cb(void *dest, void *arg)
     {
         uct_perf_test_runner *self = (uct_perf_test_runner *)arg;
@@ -360,6 +373,8 @@ public:
         unsigned fc_window;
         unsigned my_index;
         unsigned length;
+        unsigned ep_index;
+        uct_ep_h *eps;
         uct_ep_h ep;
 
         length = ucx_perf_get_message_size(&m_perf.params);
@@ -384,6 +399,8 @@ public:
         remote_addr = m_perf.uct.peers[1 - my_index].remote_addr + m_perf.offset;
         rkey        = m_perf.uct.peers[1 - my_index].rkey.rkey;
         fc_window   = m_perf.params.uct.fc_window;
+        eps         = m_perf.uct.peers[1 - my_index].eps;
+        ep_index    = 0;
 
         if (my_index == 1) {
             /* send_sn is the next SN to send */
@@ -408,6 +425,12 @@ public:
                  * the next completion handle in the window. */
                 wait_for_window(send_window);
 
+                /* Spread the messages over all endpoints to the responder */
+                ep = eps[ep_index];
+                if (++ep_index == m_perf.params.uct.num_eps) {
+                    ep_index = 0;
+                }
+
                 if (flow_control) {
                     send_b(ep, send_sn, send_sn - 1, buffer, length, remote_addr,
                            rkey, &m_completion);
@@ -49,12 +49,24 @@ typedef struct options {
 } options_t;
 
 
+typedef struct {
+    uint32_t                     tid;
+    uint64_t                     start_time;
+    uint64_t                     num_records;
+    unsigned                     num_segments;
+    const ucs_profile_record_t   *records;
+    ucs_profile_record_t         *merged;   /* Records of all segments, if
+                                               there is more than one */
+} profile_thread_data_t;
+
+
 typedef struct {
     void                         *mem;
     size_t                       length;
     const ucs_profile_header_t   *header;
     const ucs_profile_location_t *locations;
-    const ucs_profile_record_t   *records;
+    profile_thread_data_t        *threads;
+    unsigned                     num_threads;
 } profile_data_t;
 
 
@@ -71,6 +83,104 @@ static const char* time_units_str[] = {
 };
 
 
+static profile_thread_data_t *find_thread(profile_data_t *data, uint32_t tid)
+{
+    profile_thread_data_t *thread;
+
+    for (thread = data->threads; thread < data->threads + data->num_threads;
+         ++thread) {
+        if (thread->tid == tid) {
+            return thread;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Collect the segments of each thread. A thread may have several segments
+ * (e.g in streaming mode), which are merged to a single timeline.
+ */
+static int read_profile_segments(const char *file_name, profile_data_t *data)
+{
+    const ucs_profile_thread_header_t *seg_hdr;
+    const ucs_profile_record_t *records;
+    profile_thread_data_t *thread;
+    const void *ptr, *end;
+    unsigned seg_idx;
+    int pass;
+
+    data->threads = calloc(data->header->num_segments, sizeof(*data->threads));
+    if (data->threads == NULL) {
+        fprintf(stderr, "Failed to allocate threads array\n");
+        return -1;
+    }
+
+    /* First pass counts the records of each thread, second pass copies the
+     * records of threads which have more than one segment */
+    for (pass = 0; pass < 2; ++pass) {
+        ptr = data->mem + data->header->segments_offset;
+        end = data->mem + data->length;
+        for (seg_idx = 0; seg_idx < data->header->num_segments; ++seg_idx) {
+            seg_hdr = ptr;
+            records = (const void*)(seg_hdr + 1);
+            ptr     = records + seg_hdr->num_records;
+            if (ptr > end) {
+                fprintf(stderr, "%s: segment %u is truncated\n", file_name,
+                        seg_idx);
+                return -1;
+            }
+
+            thread = find_thread(data, seg_hdr->tid);
+            if (pass == 0) {
+                if (thread == NULL) {
+                    thread             = &data->threads[data->num_threads++];
+                    thread->tid        = seg_hdr->tid;
+                    thread->start_time = seg_hdr->start_time;
+                    thread->records    = records;
+                }
+                thread->num_records += seg_hdr->num_records;
+                ++thread->num_segments;
+            } else if (thread->num_segments > 1) {
+                memcpy(thread->merged + thread->num_records, records,
+                       sizeof(*records) * seg_hdr->num_records);
+                thread->num_records += seg_hdr->num_records;
+            }
+        }
+
+        if (pass > 0) {
+            break;
+        }
+
+        for (thread = data->threads; thread < data->threads + data->num_threads;
+             ++thread) {
+            if (thread->num_segments > 1) {
+                thread->merged = malloc(sizeof(*thread->merged) *
+                                        thread->num_records);
+                if (thread->merged == NULL) {
+                    fprintf(stderr, "Failed to allocate thread records\n");
+                    return -1;
+                }
+                thread->records     = thread->merged;
+                thread->num_records = 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void release_profile_segments(profile_data_t *data)
+{
+    profile_thread_data_t *thread;
+
+    for (thread = data->threads; thread < data->threads + data->num_threads;
+         ++thread) {
+        free(thread->merged);
+    }
+    free(data->threads);
+}
+
 static int read_profile_data(const char *file_name, profile_data_t *data)
 {
     struct stat stat;
@@ -99,10 +209,13 @@ static int read_profile_data(const char *file_name, profile_data_t *data)
     }
 
     data->header    = data->mem;
-    data->locations = (const void*)(data->header + 1);
-    data->records   = (const void*)(data->locations + data->header->num_locations);
+    data->locations = data->mem + data->header->locations_offset;
 
-    ret = 0;
+    ret = read_profile_segments(file_name, data);
+    if (ret < 0) {
+        release_profile_segments(data);
+        munmap(data->mem, data->length);
+    }
 
 out_close:
     close(fd);
@@ -112,6 +225,7 @@ out:
 
 static void release_profile_data(profile_data_t *data)
 {
+    release_profile_segments(data);
     munmap(data->mem, data->length);
 }
 
@@ -190,9 +304,11 @@ static void show_profile_data_accum(profile_data_t *data, options_t *opts)
 
 KHASH_MAP_INIT_INT64(request_ids, int)
 
-static void show_profile_data_log(profile_data_t *data, options_t *opts)
+static void show_profile_data_log(profile_data_t *data, options_t *opts,
+                                  const profile_thread_data_t *thread)
 {
-    size_t num_recods               = data->header->num_records;
+    size_t num_recods                   = thread->num_records;
+    const ucs_profile_record_t *records = thread->records;
     const ucs_profile_record_t **stack[UCS_PROFILE_STACK_MAX * 2];
     const ucs_profile_record_t **scope_ends;
     const ucs_profile_location_t *loc;
@@ -234,11 +350,11 @@ static void show_profile_data_log(profile_data_t *data, options_t *opts)
     /* Find the first record with minimal nesting level, which is the base of call stack */
     nesting         = 0;
     min_nesting     = 0;
-    for (rec = data->records; rec < data->records + num_recods; ++rec) {
+    for (rec = records; rec < records + num_recods; ++rec) {
         loc = &data->locations[rec->location];
         switch (loc->type) {
         case UCS_PROFILE_TYPE_SCOPE_BEGIN:
-            stack[nesting + UCS_PROFILE_STACK_MAX] = &scope_ends[rec - data->records];
+            stack[nesting + UCS_PROFILE_STACK_MAX] = &scope_ends[rec - records];
             ++nesting;
             break;
         case UCS_PROFILE_TYPE_SCOPE_END:
@@ -257,7 +373,7 @@ static void show_profile_data_log(profile_data_t *data, options_t *opts)
     }
 
     if (num_recods > 0) {
-        prev_time = data->records[0].timestamp;
+        prev_time = records[0].timestamp;
     } else {
         prev_time = 0;
     }
@@ -266,11 +382,11 @@ static void show_profile_data_log(profile_data_t *data, options_t *opts)
 
     /* Display records */
     nesting = -min_nesting;
-    for (rec = data->records; rec < data->records + num_recods; ++rec) {
+    for (rec = records; rec < records + num_recods; ++rec) {
         loc = &data->locations[rec->location];
         switch (loc->type) {
         case UCS_PROFILE_TYPE_SCOPE_BEGIN:
-            se = scope_ends[rec - data->records];
+            se = scope_ends[rec - records];
             if (se != NULL) {
                 snprintf(buf, sizeof(buf), RECORD_FMT"  %s%s%s %s%.3f%s {",
                          RECORD_ARG(rec->timestamp - prev_time),
@@ -368,11 +484,11 @@ static int redirect_output(const ucs_profile_header_t *hdr)
         return ret;
     }
 
-    num_lines = 6 + /* header */
+    num_lines = 7 + /* header */
                 ((hdr->mode & UCS_BIT(UCS_PROFILE_MODE_ACCUM)) ?
                                 (hdr->num_locations + 2) : 0) +
                 ((hdr->mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) ?
-                                (hdr->num_records    + 1) : 0) +
+                                (hdr->num_records + 3 * hdr->num_segments) : 0) +
                 1; /* footer */
 
     if (num_lines <= wsz.ws_row) {
@@ -426,11 +542,27 @@ static void show_header(profile_data_t *data, options_t *opts)
     printf("   host    : %s\n", data->header->hostname);
     printf("   pid     : %d\n", data->header->pid);
     printf("   units   : %s\n", time_units_str[opts->time_units]);
+    printf("   overhead: %.3f (%.3f per record), %lu records dropped\n",
+           time_to_usec(data, opts, data->header->overhead),
+           time_to_usec(data, opts, data->header->record_cost),
+           (unsigned long)data->header->num_dropped);
     printf("\n");
 }
 
+static void show_thread_header(profile_data_t *data, options_t *opts,
+                               const profile_thread_data_t *thread)
+{
+    printf("%sthread %d%s, %lu records in %u segment(s), started at %.3f\n\n",
+           opts->raw ? "" : TERM_COLOR_GREEN, thread->tid,
+           opts->raw ? "" : TERM_COLOR_CLEAR,
+           (unsigned long)thread->num_records, thread->num_segments,
+           time_to_usec(data, opts, thread->start_time -
+                                    data->threads[0].start_time));
+}
+
 static int show_profile_data(profile_data_t *data, options_t *opts)
 {
+    unsigned thread_idx;
     int ret;
 
     if (!opts->raw) {
@@ -448,8 +580,11 @@ static int show_profile_data(profile_data_t *data, options_t *opts)
     }
 
     if (data->header->mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
-        show_profile_data_log(data, opts);
-        printf("\n");
+        for (thread_idx = 0; thread_idx < data->num_threads; ++thread_idx) {
+            show_thread_header(data, opts, &data->threads[thread_idx]);
+            show_profile_data_log(data, opts, &data->threads[thread_idx]);
+            printf("\n");
+        }
     }
 
     return 0;
@@ -16,7 +16,9 @@
 #include <ucm/util/ucm_config.h>
 #include <ucm/util/log.h>
 #include <ucm/util/sys.h>
-#include <ucs/arch/cpu.h>
+#include <ucs/arch/bitops.h>
+#include <ucs/type/component.h>
+#include <ucs/type/epoch.h>
 
 #include <sys/mman.h>
 #include <pthread.h>
@@ -25,12 +27,58 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 
 
-static pthread_rwlock_t ucm_event_lock = PTHREAD_RWLOCK_INITIALIZER;
+/* Event types are the flags below UCM_EVENT_FLAG_NO_INSTALL */
+#define UCM_EVENT_TYPES_COUNT  24
+
+
+typedef struct ucm_event_entry {
+    ucm_event_callback_t  cb;
+    void                  *arg;
+} ucm_event_entry_t;
+
+
+/*
+ * Immutable snapshot of the handlers list, with a separate array for every
+ * event type, in the order of priority. Entries of event type with index i are
+ * entries[offsets[i]] .. entries[offsets[i + 1] - 1].
+ */
+typedef struct ucm_event_table {
+    size_t                size;     /* Size of the mapping */
+    unsigned              offsets[UCM_EVENT_TYPES_COUNT + 1];
+    ucm_event_entry_t     entries[0];
+} ucm_event_table_t;
+
+
+/* Dispatch state of a thread */
+typedef struct ucm_event_thread {
+    ucs_epoch_thread_t    reader;   /* Reader state */
+    ucs_epoch_reader_t    *record;  /* Record the section was entered with */
+    int                   section;  /* Section returned by ucs_epoch_enter() */
+    unsigned              nesting;  /* Depth of nested dispatch sections */
+} ucm_event_thread_t;
+
+
+/*
+ * Dispatching events does not take locks or write shared memory: a thread
+ * reads the handlers table in an epoch section, and whoever replaces the table
+ * waits for the sections which could see the old one. Threads without a reader
+ * record - while it is being registered, or after the thread has exited - are
+ * counted as unregistered readers.
+ */
+static pthread_mutex_t ucm_event_writer_lock = PTHREAD_MUTEX_INITIALIZER;
 static ucs_list_link_t ucm_event_handlers;
+static ucm_event_table_t * volatile ucm_event_table = NULL;
+static ucs_epoch_t ucm_event_epoch = UCS_EPOCH_INITIALIZER(ucm_sys_alloc_pages);
 static int ucm_external_events = 0;
 
+/* Using initial-exec TLS model, since a dynamic TLS access could call malloc()
+ * and recurse into the hooks */
+static __thread ucm_event_thread_t ucm_event_thread
+                __attribute__((tls_model("initial-exec")));
+
 static size_t ucm_shm_size(int shmid)
 {
     struct shmid_ds ds;
@@ -113,39 +161,120 @@ static ucs_list_link_t ucm_event_handlers =
 
 static void ucm_event_dispatch(ucm_event_type_t event_type, ucm_event_t *event)
 {
-    ucm_event_handler_t *handler;
-
-    ucs_list_for_each(handler, &ucm_event_handlers, list) {
-        if (handler->events & event_type) {
-            handler->cb(event_type, event, handler->arg);
+    ucm_event_table_t *table = ucm_event_table;
+    ucm_event_entry_t *entry, *end;
+    unsigned index;
+
+    if (table == NULL) {
+        /* No handlers were added yet */
+        if (ucm_event_orig_handler.events & event_type) {
+            ucm_event_call_orig(event_type, event, NULL);
         }
+        return;
+    }
+
+    index = ucs_ilog2(event_type);
+    end   = &table->entries[table->offsets[index + 1]];
+    for (entry = &table->entries[table->offsets[index]]; entry < end; ++entry) {
+        entry->cb(event_type, event, entry->arg);
     }
 }
 
-#define ucm_event_lock(_lock_func) \
-    { \
-        int ret; \
-        do { \
-            ret = _lock_func(&ucm_event_lock); \
-        } while (ret == EAGAIN); \
-        if (ret != 0) { \
-            ucm_fatal("%s() failed: %s", #_lock_func, strerror(ret)); \
-        } \
+static int ucm_event_has_handlers(ucm_event_type_t event_type)
+{
+    ucm_event_table_t *table = ucm_event_table;
+    unsigned index;
+
+    if (table == NULL) {
+        return 0;
     }
 
+    index = ucs_ilog2(event_type);
+    return table->offsets[index + 1] > table->offsets[index];
+}
+
 static void ucm_event_enter()
 {
-    ucm_event_lock(pthread_rwlock_rdlock);
+    ucm_event_thread_t *thread = &ucm_event_thread;
+
+    if (thread->nesting > 0) {
+        ++thread->nesting;
+        return;
+    }
+
+    ucs_epoch_thread_register(&ucm_event_epoch, &thread->reader);
+    thread->record  = ucs_epoch_thread_reader(&thread->reader);
+    thread->section = ucs_epoch_enter(&ucm_event_epoch, thread->record);
+    thread->nesting = 1;
+}
+
+static void ucm_event_leave()
+{
+    ucm_event_thread_t *thread = &ucm_event_thread;
+
+    if (--thread->nesting > 0) {
+        return;
+    }
+
+    ucs_epoch_leave(&ucm_event_epoch, thread->record, thread->section);
 }
 
 static void ucm_event_enter_exclusive()
 {
-    ucm_event_lock(pthread_rwlock_wrlock);
+    if (ucm_event_thread.nesting > 0) {
+        ucm_fatal("cannot modify event handlers from an event callback");
+    }
+    pthread_mutex_lock(&ucm_event_writer_lock);
 }
 
-static void ucm_event_leave()
+static void ucm_event_leave_exclusive()
 {
-    pthread_rwlock_unlock(&ucm_event_lock);
+    pthread_mutex_unlock(&ucm_event_writer_lock);
+}
+
+/* Has to be called with the writer lock held */
+static void ucm_event_table_update()
+{
+    ucm_event_table_t *old_table = ucm_event_table;
+    ucm_event_table_t *table;
+    ucm_event_handler_t *handler;
+    unsigned index, count;
+    size_t size;
+
+    count = 0;
+    ucs_list_for_each(handler, &ucm_event_handlers, list) {
+        count += ucs_count_one_bits(handler->events & UCS_MASK(UCM_EVENT_TYPES_COUNT));
+    }
+
+    size  = sizeof(*table) + (count * sizeof(*table->entries));
+    table = ucm_orig_mmap(NULL, size, PROT_READ|PROT_WRITE,
+                          MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED) {
+        ucm_fatal("failed to allocate events table: %m");
+    }
+
+    table->size = size;
+    count       = 0;
+    for (index = 0; index < UCM_EVENT_TYPES_COUNT; ++index) {
+        table->offsets[index] = count;
+        ucs_list_for_each(handler, &ucm_event_handlers, list) {
+            if (handler->events & UCS_BIT(index)) {
+                table->entries[count].cb  = handler->cb;
+                table->entries[count].arg = handler->arg;
+                ++count;
+            }
+        }
+    }
+    table->offsets[index] = count;
+
+    ucs_memory_cpu_store_fence();
+    ucm_event_table = table;
+
+    /* Wait until all sections which could read the previous table are done */
+    ucs_epoch_synchronize(&ucm_event_epoch);
+    if (old_table != NULL) {
+        ucm_orig_munmap(old_table, old_table->size);
+    }
 }
 
 static UCS_F_ALWAYS_INLINE void
@@ -274,7 +403,8 @@ void *ucm_shmat(int shmid, const void *shmaddr, int shmflg)
     ucm_trace("ucm_shmat(shmid=%d shmaddr=%p shmflg=0x%x)",
               shmid, shmaddr, shmflg);
 
-    size = ucm_shm_size(shmid);
+    /* Finding the size is not cheap, so only do it when it's needed */
+    size = ucm_event_has_handlers(UCM_EVENT_VM_MAPPED) ? ucm_shm_size(shmid) : 0;
     event.shmat.result  = MAP_FAILED;
     event.shmat.shmid   = shmid;
     event.shmat.shmaddr = shmaddr;
@@ -298,7 +428,9 @@ int ucm_shmdt(const void *shmaddr)
 
     ucm_debug("ucm_shmdt(shmaddr=%p)", shmaddr);
 
-    ucm_dispatch_vm_munmap((void*)shmaddr, ucm_get_shm_seg_size(shmaddr));
+    if (ucm_event_has_handlers(UCM_EVENT_VM_UNMAPPED)) {
+        ucm_dispatch_vm_munmap((void*)shmaddr, ucm_get_shm_seg_size(shmaddr));
+    }
 
     event.shmdt.result  = -1;
     event.shmdt.shmaddr = shmaddr;
@@ -342,20 +474,22 @@ void ucm_event_handler_add(ucm_event_handler_t *handler)
     ucs_list_for_each(elem, &ucm_event_handlers, list) {
         if (handler->priority < elem->priority) {
             ucs_list_insert_before(&elem->list, &handler->list);
-            ucm_event_leave();
-            return;
+            goto out;
         }
     }
 
     ucs_list_add_tail(&ucm_event_handlers, &handler->list);
-    ucm_event_leave();
+out:
+    ucm_event_table_update();
+    ucm_event_leave_exclusive();
 }
 
 void ucm_event_handler_remove(ucm_event_handler_t *handler)
 {
     ucm_event_enter_exclusive();
     ucs_list_del(&handler->list);
-    ucm_event_leave();
+    ucm_event_table_update();
+    ucm_event_leave_exclusive();
 }
 
 static ucs_status_t ucm_event_install(int events)
@@ -435,14 +569,14 @@ void ucm_set_external_event(int events)
 {
     ucm_event_enter_exclusive();
     ucm_external_events |= events;
-    ucm_event_leave();
+    ucm_event_leave_exclusive();
 }
 
 void ucm_unset_external_event(int events)
 {
     ucm_event_enter_exclusive();
     ucm_external_events &= ~events;
-    ucm_event_leave();
+    ucm_event_leave_exclusive();
 }
 
 void ucm_unset_event_handler(int events, ucm_event_callback_t cb, void *arg)
@@ -460,7 +594,8 @@ void ucm_unset_event_handler(int events, ucm_event_callback_t cb, void *arg)
             }
         }
     }
-    ucm_event_leave();
+    ucm_event_table_update();
+    ucm_event_leave_exclusive();
 
     /* Do not release memory while we hold event lock - may deadlock */
     while (!ucs_list_is_empty(&gc_list)) {
@@ -469,3 +604,28 @@ void ucm_unset_event_handler(int events, ucm_event_callback_t cb, void *arg)
     }
 }
 
+static void ucm_event_fork_prepare()
+{
+    pthread_mutex_lock(&ucm_event_writer_lock);
+    ucs_epoch_fork_prepare(&ucm_event_epoch);
+}
+
+static void ucm_event_fork_parent()
+{
+    ucs_epoch_fork_parent(&ucm_event_epoch);
+    pthread_mutex_unlock(&ucm_event_writer_lock);
+}
+
+static void ucm_event_fork_child()
+{
+    /* Only the forking thread exists in the child process */
+    ucs_epoch_fork_child(&ucm_event_epoch, &ucm_event_thread.reader);
+    pthread_mutex_unlock(&ucm_event_writer_lock);
+}
+
+UCS_STATIC_INIT {
+    UCS_STATIC_ASSERT(UCM_EVENT_FLAG_NO_INSTALL == UCS_BIT(UCM_EVENT_TYPES_COUNT));
+
+    pthread_atfork(ucm_event_fork_prepare, ucm_event_fork_parent,
+                   ucm_event_fork_child);
+}
@@ -20,15 +20,20 @@
 #include <ucm/mmap/mmap.h>
 #include <ucm/util/log.h>
 #include <ucm/util/reloc.h>
+#include <ucm/util/sys.h>
 #include <ucm/util/ucm_config.h>
+#include <ucs/arch/bitops.h>
+#include <ucs/arch/cpu.h>
 #include <ucs/datastruct/queue.h>
 #include <ucs/type/component.h>
+#include <ucs/type/epoch.h>
 #include <ucs/type/spinlock.h>
 #include <ucs/sys/compiler.h>
 #include <ucs/sys/math.h>
 #include <ucs/sys/checker.h>
 #include <ucs/sys/sys.h>
 
+#include <sys/syscall.h>
 #include <string.h>
 #include <netdb.h>
 
@@ -47,10 +52,45 @@
 #define UCM_OPERATOR_VEC_DELETE_SYMBOL "_ZdaPv"
 
 
+/* Thread arenas */
+#define UCM_MALLOC_MAX_ARENAS          64  /* Upper limit on arenas number */
+#define UCM_MALLOC_ARENA_GLOBAL        -1  /* Thread uses the global heap */
+
+
+/* Map of pages which belong to mmap'ed heap segments: a table of bitmaps, each
+ * one covering a block of the address space */
+#define UCM_MALLOC_SEGMAP_PAGE_SHIFT   12
+#define UCM_MALLOC_SEGMAP_BLOCK_SHIFT  30
+#define UCM_MALLOC_SEGMAP_ADDR_BITS    48
+#define UCM_MALLOC_SEGMAP_NUM_BLOCKS   UCS_BIT(UCM_MALLOC_SEGMAP_ADDR_BITS - \
+                                               UCM_MALLOC_SEGMAP_BLOCK_SHIFT)
+#define UCM_MALLOC_SEGMAP_BLOCK_PAGES  UCS_BIT(UCM_MALLOC_SEGMAP_BLOCK_SHIFT - \
+                                               UCM_MALLOC_SEGMAP_PAGE_SHIFT)
+
+
+/* Set of mmap'ed pointers */
+#define UCM_MALLOC_PTR_SET_MIN_SLOTS   512
+#define UCM_MALLOC_PTR_REMOVED         ((void*)1) /* Slot of a removed pointer */
+
+
 /* Pointer to memory release function */
 typedef void (*ucm_release_func_t)(void *ptr);
 
 
+/*
+ * Open-addressing hash set of pointers, with linear probing. Slots are only
+ * changed from empty to used, and from used to removed and back, so a lookup
+ * never misses a pointer which was present during the whole lookup, and does
+ * not need the lock. When the set is full, it is replaced by a new one.
+ */
+typedef struct ucm_malloc_ptr_set {
+    size_t                size;      /* Number of slots, power of 2 */
+    size_t                count;     /* Number of pointers in the set */
+    size_t                used;      /* Number of non-empty slots */
+    void * volatile       slots[0];
+} ucm_malloc_ptr_set_t;
+
+
 typedef struct ucm_malloc_hook_state {
     /*
      * State of hook installment
@@ -70,16 +110,32 @@ typedef struct ucm_malloc_hook_state {
                                          Note: Cannot modify events when this lock
                                          is held - may deadlock */
     /* Our heap address range. Used to identify whether a released pointer is ours,
-     * or was allocated by the previous heap manager. */
-    void                  *heap_start;
-    void                  *heap_end;
+     * or was allocated by the previous heap manager. Read without the lock. */
+    void * volatile       heap_start;
+    void * volatile       heap_end;
+
+    /* Pages of the heap segments which were mapped with mmap(), either by the
+     * global heap or by the thread arenas. Modified with the lock held, and read
+     * without it. */
+    uint64_t * volatile   *segmap;
+
+    /*
+     * Thread arenas. The main thread allocates from the global heap, and other
+     * threads are spread round-robin between a bounded set of dlmalloc mspaces,
+     * so they would not serialize on a single heap lock. Arenas take memory
+     * from the system with mmap(), so their segments are found in segmap.
+     */
+    pthread_mutex_t       arenas_lock;    /* Protect arenas creation */
+    unsigned              arenas_counter; /* Next arena to assign to a thread */
+    mspace                arenas[UCM_MALLOC_MAX_ARENAS];
 
     /* Save the pointers that we have allocated with mmap, so when they are
      * released we would know they are ours, despite the fact they are not in the
-     * heap address range. */
-    void                 **ptrs;
-    unsigned             num_ptrs;
-    unsigned             max_ptrs;
+     * heap address range. Modified with the lock held, and looked up without
+     * it in an epoch section, so a replaced set can be released once the
+     * lookups which could see it are done. */
+    ucm_malloc_ptr_set_t * volatile ptrs;
+    ucs_epoch_t           ptrs_epoch;
 
     /**
      * Save the environment strings we've allocated
@@ -99,78 +155,334 @@ static ucm_malloc_hook_state_t ucm_malloc_hook_state = {
     .free             = free,
     .heap_start       = (void*)-1,
     .heap_end         = (void*)-1,
+    .segmap           = NULL,
+    .arenas_lock      = PTHREAD_MUTEX_INITIALIZER,
+    .arenas_counter   = 0,
     .ptrs             = NULL,
-    .num_ptrs         = 0,
-    .max_ptrs         = 0,
+    .ptrs_epoch       = UCS_EPOCH_INITIALIZER(ucm_sys_alloc_pages),
     .env_lock         = PTHREAD_MUTEX_INITIALIZER,
     .env_strs         = NULL,
     .num_env_strs     = 0
 };
 
 
+/* Arena of the current thread: 0 - not selected yet, UCM_MALLOC_ARENA_GLOBAL -
+ * the global heap, otherwise arena index + 1. Using initial-exec TLS model,
+ * since a dynamic TLS access could call malloc() and recurse into the hooks. */
+static __thread int ucm_malloc_thread_arena
+                __attribute__((tls_model("initial-exec"))) = 0;
+
+/* Reader state of the current thread, for looking up mmap'ed pointers */
+static __thread ucs_epoch_thread_t ucm_malloc_thread_reader
+                __attribute__((tls_model("initial-exec")));
+
+
+static inline size_t ucm_malloc_ptr_set_hash(ucm_malloc_ptr_set_t *set,
+                                             void *ptr)
+{
+    /* Fibonacci hashing, low bits of the pointer are always 0 */
+    return (((uintptr_t)ptr >> 4) * 0x9e3779b97f4a7c15ul) >>
+           (64 - ucs_ilog2(set->size));
+}
+
+static void * volatile *ucm_malloc_ptr_set_find(ucm_malloc_ptr_set_t *set,
+                                                void *ptr)
+{
+    size_t mask = set->size - 1;
+    size_t i;
+    void *slot;
+
+    /* There is always an empty slot, so the loop ends */
+    for (i = ucm_malloc_ptr_set_hash(set, ptr); ; i = (i + 1) & mask) {
+        slot = set->slots[i];
+        if (slot == ptr) {
+            return &set->slots[i];
+        } else if (slot == NULL) {
+            return NULL;
+        }
+    }
+}
+
+/* Has to be called with the lock held */
+static void ucm_malloc_ptr_set_insert(ucm_malloc_ptr_set_t *set, void *ptr)
+{
+    size_t mask = set->size - 1;
+    size_t i;
+    void *slot;
+
+    for (i = ucm_malloc_ptr_set_hash(set, ptr); ; i = (i + 1) & mask) {
+        slot = set->slots[i];
+        if ((slot == NULL) || (slot == UCM_MALLOC_PTR_REMOVED)) {
+            break;
+        }
+    }
+
+    set->used += (slot == NULL);
+    ++set->count;
+    set->slots[i] = ptr;
+}
+
+/* Has to be called with the lock held */
+static ucs_status_t ucm_malloc_ptr_set_grow(void)
+{
+    ucm_malloc_ptr_set_t *old_set = ucm_malloc_hook_state.ptrs;
+    ucm_malloc_ptr_set_t *new_set;
+    size_t i, size, count;
+    void *ptr;
+
+    /* Keep the new set at most half-full */
+    count = (old_set == NULL) ? 0 : old_set->count;
+    size  = UCM_MALLOC_PTR_SET_MIN_SLOTS;
+    while (size < (count + 1) * 2) {
+        size *= 2;
+    }
+
+    new_set = ucm_orig_mmap(NULL, sizeof(*new_set) + size * sizeof(void*),
+                            PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+                            -1, 0);
+    if (new_set == MAP_FAILED) {
+        ucm_error("failed to allocate memory for mmap pointers: %m");
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    new_set->size  = size;
+    new_set->count = 0;
+    new_set->used  = 0;
+    if (old_set != NULL) {
+        for (i = 0; i < old_set->size; ++i) {
+            ptr = old_set->slots[i];
+            if ((ptr != NULL) && (ptr != UCM_MALLOC_PTR_REMOVED)) {
+                ucm_malloc_ptr_set_insert(new_set, ptr);
+            }
+        }
+    }
+
+    ucs_memory_cpu_store_fence();
+    ucm_malloc_hook_state.ptrs = new_set;
+
+    if (old_set != NULL) {
+        ucs_epoch_synchronize(&ucm_malloc_hook_state.ptrs_epoch);
+        ucm_orig_munmap(old_set, sizeof(*old_set) + old_set->size * sizeof(void*));
+    }
+
+    return UCS_OK;
+}
+
 static void ucm_malloc_mmaped_ptr_add(void *ptr)
 {
-    unsigned new_max_ptrs;
-    void **buf;
+    ucm_malloc_ptr_set_t *set;
+
+    if (ptr == NULL) {
+        return;
+    }
 
     ucs_spin_lock(&ucm_malloc_hook_state.lock);
 
-    if (ucm_malloc_hook_state.num_ptrs == ucm_malloc_hook_state.max_ptrs) {
-        /* Enlarge the array if needed */
-        if (ucm_malloc_hook_state.max_ptrs == 0) {
-            new_max_ptrs = sysconf(_SC_PAGESIZE) / sizeof(void*);
-            /* coverity[suspicious_sizeof] */
-            buf = ucm_orig_mmap(NULL, new_max_ptrs * sizeof(void*),
-                                PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
-                                -1, 0);
-        } else {
-            new_max_ptrs = ucm_malloc_hook_state.max_ptrs * 2;
-            buf = ucm_orig_mremap(ucm_malloc_hook_state.ptrs,
-                                  ucm_malloc_hook_state.max_ptrs * sizeof(void*),
-                                  new_max_ptrs * sizeof(void*), MREMAP_MAYMOVE);
-        }
-        if (buf == MAP_FAILED) {
-            ucm_error("failed to allocated memory for mmap pointers: %m")
+    set = ucm_malloc_hook_state.ptrs;
+    if ((set == NULL) || ((set->used + 1) * 4 > set->size * 3)) {
+        /* Also drops the removed slots */
+        if (ucm_malloc_ptr_set_grow() != UCS_OK) {
             goto out_unlock;
         }
-
-        ucm_malloc_hook_state.ptrs     = buf;
-        ucm_malloc_hook_state.max_ptrs = new_max_ptrs;
+        set = ucm_malloc_hook_state.ptrs;
     }
 
-    ucm_malloc_hook_state.ptrs[ucm_malloc_hook_state.num_ptrs] = ptr;
-    ++ucm_malloc_hook_state.num_ptrs;
+    ucm_malloc_ptr_set_insert(set, ptr);
 out_unlock:
     ucs_spin_unlock(&ucm_malloc_hook_state.lock);
 }
 
+static int ucm_malloc_mmaped_ptr_exists(void *ptr)
+{
+    ucs_epoch_reader_t *reader;
+    ucm_malloc_ptr_set_t *set;
+    int exists, section;
+
+    ucs_epoch_thread_register(&ucm_malloc_hook_state.ptrs_epoch,
+                              &ucm_malloc_thread_reader);
+    reader  = ucs_epoch_thread_reader(&ucm_malloc_thread_reader);
+    section = ucs_epoch_enter(&ucm_malloc_hook_state.ptrs_epoch, reader);
+    set     = ucm_malloc_hook_state.ptrs;
+    exists  = (set != NULL) && (ucm_malloc_ptr_set_find(set, ptr) != NULL);
+    ucs_epoch_leave(&ucm_malloc_hook_state.ptrs_epoch, reader, section);
+    return exists;
+}
+
 static int ucm_malloc_mmaped_ptr_remove_if_exists(void *ptr)
 {
-    unsigned i;
+    void * volatile *slot;
+
+    /* Foreign pointers are filtered out without the lock. A pointer of ours can
+     * be removed only by the thread which releases it. */
+    if (!ucm_malloc_mmaped_ptr_exists(ptr)) {
+        return 0;
+    }
 
     ucs_spin_lock(&ucm_malloc_hook_state.lock);
-    for (i = 0; i < ucm_malloc_hook_state.num_ptrs; ++i) {
-        if (ucm_malloc_hook_state.ptrs[i] == ptr) {
-            --ucm_malloc_hook_state.num_ptrs;
-            ucm_malloc_hook_state.ptrs[i] =
-                            ucm_malloc_hook_state.ptrs[ucm_malloc_hook_state.num_ptrs];
-            ucs_spin_unlock(&ucm_malloc_hook_state.lock);
-            return 1;
-        }
+    slot = ucm_malloc_ptr_set_find(ucm_malloc_hook_state.ptrs, ptr);
+    if (slot != NULL) {
+        *slot = UCM_MALLOC_PTR_REMOVED;
+        --ucm_malloc_hook_state.ptrs->count;
     }
     ucs_spin_unlock(&ucm_malloc_hook_state.lock);
-    return 0;
+    return slot != NULL;
 }
 
 static int ucm_malloc_is_address_in_heap(void *ptr)
 {
-    int in_heap;
+    /* The sbrk handler updates the range so it never covers foreign memory
+     * in the middle of the update */
+    return (ptr >= ucm_malloc_hook_state.heap_start) &&
+           (ptr < ucm_malloc_hook_state.heap_end);
+}
+
+static int ucm_malloc_is_address_in_segments(void *ptr)
+{
+    uint64_t * volatile *segmap = ucm_malloc_hook_state.segmap;
+    uintptr_t page              = (uintptr_t)ptr >> UCM_MALLOC_SEGMAP_PAGE_SHIFT;
+    uint64_t *bitmap;
+    unsigned bit;
+
+    if ((segmap == NULL) ||
+        ((uintptr_t)ptr >> UCM_MALLOC_SEGMAP_ADDR_BITS)) {
+        return 0;
+    }
+
+    bitmap = segmap[page / UCM_MALLOC_SEGMAP_BLOCK_PAGES];
+    if (bitmap == NULL) {
+        return 0;
+    }
+
+    bit = page % UCM_MALLOC_SEGMAP_BLOCK_PAGES;
+    return !!(bitmap[bit / 64] & UCS_BIT(bit % 64));
+}
+
+/* Has to be called with the lock held */
+static void ucm_malloc_segmap_update(void *addr, size_t size, int is_segment)
+{
+    uintptr_t page, end_page;
+    uint64_t *bitmap;
+    unsigned bit;
+    void *segmap;
+
+    if (ucm_malloc_hook_state.segmap == NULL) {
+        if (!is_segment) {
+            return;
+        }
+
+        /* The table is only address space, untouched entries cost nothing */
+        segmap = ucm_orig_mmap(NULL, UCM_MALLOC_SEGMAP_NUM_BLOCKS *
+                                     sizeof(*ucm_malloc_hook_state.segmap),
+                               PROT_READ|PROT_WRITE,
+                               MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (segmap == MAP_FAILED) {
+            goto err;
+        }
+
+        ucm_malloc_hook_state.segmap = segmap;
+    }
+
+    /* If a segment is missing from the map, its blocks are tracked in the
+     * mmap'ed pointers set instead, so a failure here is not fatal */
+    end_page = ((uintptr_t)addr + size - 1) >> UCM_MALLOC_SEGMAP_PAGE_SHIFT;
+    for (page = (uintptr_t)addr >> UCM_MALLOC_SEGMAP_PAGE_SHIFT;
+         page <= end_page; ++page)
+    {
+        if ((page / UCM_MALLOC_SEGMAP_BLOCK_PAGES) >= UCM_MALLOC_SEGMAP_NUM_BLOCKS) {
+            break;
+        }
+
+        bitmap = ucm_malloc_hook_state.segmap[page / UCM_MALLOC_SEGMAP_BLOCK_PAGES];
+        if (bitmap == NULL) {
+            if (!is_segment) {
+                continue;
+            }
+
+            bitmap = ucm_orig_mmap(NULL, UCM_MALLOC_SEGMAP_BLOCK_PAGES / 8,
+                                   PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+                                   -1, 0);
+            if (bitmap == MAP_FAILED) {
+                goto err;
+            }
+
+            ucs_memory_cpu_store_fence();
+            ucm_malloc_hook_state.segmap[page / UCM_MALLOC_SEGMAP_BLOCK_PAGES] =
+                            bitmap;
+        }
 
+        bit = page % UCM_MALLOC_SEGMAP_BLOCK_PAGES;
+        if (is_segment) {
+            bitmap[bit / 64] |= UCS_BIT(bit % 64);
+        } else {
+            bitmap[bit / 64] &= ~UCS_BIT(bit % 64);
+        }
+    }
+    return;
+
+err:
+    ucm_error("failed to allocate memory for heap segments map: %m");
+}
+
+static void ucm_malloc_segmap_lock_update(void *addr, size_t size, int is_segment)
+{
     ucs_spin_lock(&ucm_malloc_hook_state.lock);
-    in_heap = (ptr >= ucm_malloc_hook_state.heap_start) &&
-              (ptr < ucm_malloc_hook_state.heap_end);
+    ucm_malloc_segmap_update(addr, size, is_segment);
     ucs_spin_unlock(&ucm_malloc_hook_state.lock);
-    return in_heap;
+}
+
+void *ucm_malloc_segment_mmap(size_t size)
+{
+    void *ptr;
+
+    ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (ptr != MAP_FAILED) {
+        ucm_malloc_segmap_lock_update(ptr, size, 1);
+    }
+    return ptr;
+}
+
+int ucm_malloc_segment_munmap(void *addr, size_t size)
+{
+    int is_segment;
+    int ret;
+
+    /* Forget the pages before releasing them, so they would not be mistaken
+     * for ours when somebody else maps them again. Blocks mapped directly are
+     * released here as well, and they are not in the map. */
+    is_segment = ucm_malloc_is_address_in_segments(addr);
+    if (is_segment) {
+        ucm_malloc_segmap_lock_update(addr, size, 0);
+    }
+
+    ret = munmap(addr, size);
+    if ((ret != 0) && is_segment) {
+        ucm_malloc_segmap_lock_update(addr, size, 1);
+    }
+    return ret;
+}
+
+void *ucm_malloc_segment_mremap(void *old_address, size_t old_size,
+                                size_t new_size, int flags)
+{
+    int is_segment;
+    void *ptr;
+
+    /* Also used to resize blocks mapped directly, which are not segments */
+    is_segment = ucm_malloc_is_address_in_segments(old_address);
+    if (is_segment) {
+        ucm_malloc_segmap_lock_update(old_address, old_size, 0);
+    }
+
+    ptr = mremap(old_address, old_size, new_size, flags);
+
+    if (is_segment) {
+        if (ptr == MAP_FAILED) {
+            ucm_malloc_segmap_lock_update(old_address, old_size, 1);
+        } else {
+            ucm_malloc_segmap_lock_update(ptr, new_size, 1);
+        }
+    }
+    return ptr;
 }
 
 static int ucm_malloc_address_remove_if_managed(void *ptr, const char *debug_name)
@@ -178,6 +490,10 @@ static int ucm_malloc_address_remove_if_managed(void *ptr, const char *debug_nam
     int is_managed;
 
     if (ucm_malloc_is_address_in_heap(ptr)) {
+        /* The original heap manager may extend the same sbrk area, so check the
+         * chunk footer before releasing the block to our heap */
+        is_managed = ucm_dlmalloc_owns(ptr);
+    } else if (ucm_malloc_is_address_in_segments(ptr)) {
         is_managed = 1;
     } else {
         is_managed = ucm_malloc_mmaped_ptr_remove_if_exists(ptr);
@@ -195,6 +511,8 @@ static void ucm_malloc_allocated(void *ptr, size_t size, const char *debug_name)
     if (ucm_malloc_is_address_in_heap(ptr)) {
         ucm_trace("%s(size=%zu)=%p, in heap [%p..%p]", debug_name, size, ptr,
                   ucm_malloc_hook_state.heap_start, ucm_malloc_hook_state.heap_end);
+    } else if (ucm_malloc_is_address_in_segments(ptr)) {
+        ucm_trace("%s(size=%zu)=%p, in mmap'ed segment", debug_name, size, ptr);
     } else {
         ucm_trace("%s(size=%zu)=%p, mmap'ed", debug_name, size, ptr);
         ucm_malloc_mmaped_ptr_add(ptr);
@@ -217,15 +535,104 @@ static void ucm_release_foreign_block(void *ptr, ucm_release_func_t orig_free,
     }
 }
 
+static inline void ucm_malloc_set_hook_called()
+{
+    /* Avoid writing to a shared cache line on every call */
+    if (ucs_unlikely(!ucm_malloc_hook_state.hook_called)) {
+        ucm_malloc_hook_state.hook_called = 1;
+    }
+}
+
+static int ucm_malloc_arena_select()
+{
+    unsigned num_arenas;
+    int index;
+
+    /* Allocations made while selecting (e.g by memory event handlers) use the
+     * global heap */
+    ucm_malloc_thread_arena = UCM_MALLOC_ARENA_GLOBAL;
+
+    /* Like glibc, keep the main thread on the sbrk-based global heap */
+    num_arenas = ucs_min(ucm_global_config.malloc_arenas, UCM_MALLOC_MAX_ARENAS);
+    if ((num_arenas == 0) || (syscall(SYS_gettid) == getpid())) {
+        return UCM_MALLOC_ARENA_GLOBAL;
+    }
+
+    pthread_mutex_lock(&ucm_malloc_hook_state.arenas_lock);
+
+    index = ucm_malloc_hook_state.arenas_counter++ % num_arenas;
+    if (ucm_malloc_hook_state.arenas[index] == NULL) {
+        ucm_malloc_hook_state.arenas[index] = create_mspace(0, 1);
+        if (ucm_malloc_hook_state.arenas[index] == NULL) {
+            ucm_warn("failed to create malloc arena %d", index);
+            index = UCM_MALLOC_ARENA_GLOBAL;
+            goto out_unlock;
+        }
+
+        ucm_debug("created malloc arena %d", index);
+    }
+
+    index += 1;
+
+out_unlock:
+    pthread_mutex_unlock(&ucm_malloc_hook_state.arenas_lock);
+    return index;
+}
+
+/* Return the arena of the current thread, or NULL to use the global heap */
+static inline mspace ucm_malloc_thread_mspace()
+{
+    int index = ucm_malloc_thread_arena;
+
+    if (ucs_unlikely(index == 0)) {
+        index = ucm_malloc_arena_select();
+        ucm_malloc_thread_arena = index;
+    }
+
+    return (index == UCM_MALLOC_ARENA_GLOBAL) ? NULL :
+           ucm_malloc_hook_state.arenas[index - 1];
+}
+
+static void *ucm_arena_malloc(size_t size)
+{
+    mspace msp = ucm_malloc_thread_mspace();
+    return (msp == NULL) ? ucm_dlmalloc(size) : mspace_malloc(msp, size);
+}
+
+static void *ucm_arena_memalign(size_t alignment, size_t size)
+{
+    mspace msp = ucm_malloc_thread_mspace();
+    return (msp == NULL) ? ucm_dlmemalign(alignment, size) :
+                           mspace_memalign(msp, alignment, size);
+}
+
+static int ucm_malloc_trim(size_t pad)
+{
+    int released;
+    int i;
+
+    released = ucm_dlmalloc_trim(pad);
+
+    pthread_mutex_lock(&ucm_malloc_hook_state.arenas_lock);
+    for (i = 0; i < UCM_MALLOC_MAX_ARENAS; ++i) {
+        if (ucm_malloc_hook_state.arenas[i] != NULL) {
+            released |= mspace_trim(ucm_malloc_hook_state.arenas[i], pad);
+        }
+    }
+    pthread_mutex_unlock(&ucm_malloc_hook_state.arenas_lock);
+
+    return released;
+}
+
 static void *ucm_malloc_impl(size_t size, const char *debug_name)
 {
     void *ptr;
 
-    ucm_malloc_hook_state.hook_called = 1;
+    ucm_malloc_set_hook_called();
     if (ucm_global_config.alloc_alignment > 1) {
-        ptr = ucm_dlmemalign(ucm_global_config.alloc_alignment, size);
+        ptr = ucm_arena_memalign(ucm_global_config.alloc_alignment, size);
     } else {
-        ptr = ucm_dlmalloc(size);
+        ptr = ucm_arena_malloc(size);
     }
     ucm_malloc_allocated(ptr, size, debug_name);
     return ptr;
@@ -241,7 +648,7 @@ static inline void ucm_mem_free(void *ptr, size_t size)
 static void ucm_free_impl(void *ptr, ucm_release_func_t orig_free,
                           const char *debug_name)
 {
-    ucm_malloc_hook_state.hook_called = 1;
+    ucm_malloc_set_hook_called();
 
     if (ptr == NULL) {
         /* Ignore */
@@ -256,8 +663,9 @@ static void *ucm_memalign_impl(size_t alignment, size_t size, const char *debug_
 {
     void *ptr;
 
-    ucm_malloc_hook_state.hook_called = 1;
-    ptr = ucm_dlmemalign(ucs_max(alignment, ucm_global_config.alloc_alignment), size);
+    ucm_malloc_set_hook_called();
+    ptr = ucm_arena_memalign(ucs_max(alignment, ucm_global_config.alloc_alignment),
+                             size);
     ucm_malloc_allocated(ptr, size, debug_name);
     return ptr;
 }
@@ -273,7 +681,7 @@ static void *ucm_realloc(void *oldptr, size_t size, const void *caller)
     size_t oldsz;
     int foreign;
 
-    ucm_malloc_hook_state.hook_called = 1;
+    ucm_malloc_set_hook_called();
     if (oldptr != NULL) {
         foreign = !ucm_malloc_address_remove_if_managed(oldptr, "realloc");
         if (RUNNING_ON_VALGRIND || foreign) {
@@ -282,7 +690,7 @@ static void *ucm_realloc(void *oldptr, size_t size, const void *caller)
              *  We do the same if we are running with valgrind, so we could use client
              * requests properly.
              */
-            newptr = ucm_dlmalloc(size);
+            newptr = ucm_arena_malloc(size);
             ucm_malloc_allocated(newptr, size, "realloc");
 
             oldsz = ucm_malloc_hook_state.usable_size(oldptr);
@@ -297,6 +705,7 @@ static void *ucm_realloc(void *oldptr, size_t size, const void *caller)
         }
     }
 
+    /* Chunk footers let dlrealloc() find the arena which owns the block */
     newptr = ucm_dlrealloc(oldptr, size);
     ucm_malloc_allocated(newptr, size, "realloc");
     return newptr;
@@ -465,9 +874,14 @@ static void ucm_malloc_sbrk(ucm_event_type_t event_type,
 {
     ucs_spin_lock(&ucm_malloc_hook_state.lock);
 
-    /* Copy return value from call. We assume the event handler uses a lock. */
+    /* Copy return value from call. We assume the event handler uses a lock.
+     * The range is read without the lock, so it has to be empty until both
+     * ends are valid. */
     if (ucm_malloc_hook_state.heap_start == (void*)-1) {
+        ucm_malloc_hook_state.heap_end   = event->sbrk.result;
+        ucs_memory_cpu_store_fence();
         ucm_malloc_hook_state.heap_start = event->sbrk.result; /* sbrk() returns the previous break */
+        ucs_memory_cpu_store_fence();
     }
     ucm_malloc_hook_state.heap_end = ucm_orig_sbrk(0);
 
@@ -534,7 +948,7 @@ static void ucm_malloc_test(int events)
     free(p[0]);
 
     if (ucm_malloc_hook_state.hook_called) {
-        ucm_dlmalloc_trim(0);
+        ucm_malloc_trim(0);
     }
 
     ucm_event_handler_remove(&handler);
@@ -587,7 +1001,7 @@ static ucm_reloc_patch_t ucm_malloc_optional_symbol_patches[] = {
     { "mallopt", ucm_dlmallopt },
     { "mallinfo", ucm_dlmallinfo },
     { "malloc_stats", ucm_dlmalloc_stats },
-    { "malloc_trim", ucm_dlmalloc_trim },
+    { "malloc_trim", ucm_malloc_trim },
     { "malloc_usable_size", ucm_dlmalloc_usable_size },
     { NULL, NULL }
 };
@@ -688,8 +1102,26 @@ out_unlock:
     return status;
 }
 
+static void ucm_malloc_fork_prepare()
+{
+    ucs_epoch_fork_prepare(&ucm_malloc_hook_state.ptrs_epoch);
+}
+
+static void ucm_malloc_fork_parent()
+{
+    ucs_epoch_fork_parent(&ucm_malloc_hook_state.ptrs_epoch);
+}
+
+static void ucm_malloc_fork_child()
+{
+    ucs_epoch_fork_child(&ucm_malloc_hook_state.ptrs_epoch,
+                         &ucm_malloc_thread_reader);
+}
+
 UCS_STATIC_INIT {
     ucs_spinlock_init(&ucm_malloc_hook_state.lock);
+    pthread_atfork(ucm_malloc_fork_prepare, ucm_malloc_fork_parent,
+                   ucm_malloc_fork_child);
 }
 
 static void UCS_F_DTOR ucm_clear_env()
@@ -9,6 +9,19 @@
 
 #include <ucs/type/status.h>
 
+#include <stddef.h>
+
 ucs_status_t ucm_malloc_install(int events);
 
+/*
+ * Used by the allocator to map and unmap its heap segments, so we would know
+ * which blocks belong to them.
+ */
+void *ucm_malloc_segment_mmap(size_t size);
+
+int ucm_malloc_segment_munmap(void *addr, size_t size);
+
+void *ucm_malloc_segment_mremap(void *old_address, size_t old_size,
+                                size_t new_size, int flags);
+
 #endif
@@ -749,6 +749,7 @@ extern "C" {
 #define dlmalloc_trim          UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_trim)
 #define dlmalloc_stats         UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_stats)
 #define dlmalloc_usable_size   UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_usable_size)
+#define dlmalloc_owns          UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_owns)
 #define dlmalloc_footprint     UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_footprint)
 #define dlindependent_calloc   UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, independent_calloc)
 #define dlindependent_comalloc UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, independent_comalloc)
@@ -1065,6 +1066,15 @@ int  dlmalloc_trim(size_t);
 */
 size_t dlmalloc_usable_size(void*);
 
+/*
+  malloc_owns(void* p);
+  Returns nonzero if the chunk in use at p was allocated from the global
+  heap, according to its footer. Memory of other allocators which happens to
+  lie in the same sbrk area is told apart this way. Without FOOTERS, every
+  chunk is assumed to be ours.
+*/
+int dlmalloc_owns(void*);
+
 /*
   malloc_stats();
   Prints on stderr the amount of space obtained from the system (both
@@ -1090,6 +1100,26 @@ void  dlmalloc_stats(void);
 
 #if MSPACES
 
+#ifdef UCM_MALLOC_PREFIX
+#define create_mspace               UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, create_mspace)
+#define create_mspace_with_base     UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, create_mspace_with_base)
+#define destroy_mspace              UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, destroy_mspace)
+#define mspace_malloc               UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_malloc)
+#define mspace_free                 UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_free)
+#define mspace_calloc               UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_calloc)
+#define mspace_realloc              UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_realloc)
+#define mspace_memalign             UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_memalign)
+#define mspace_independent_calloc   UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_independent_calloc)
+#define mspace_independent_comalloc UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_independent_comalloc)
+#define mspace_usable_size          UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_usable_size)
+#define mspace_malloc_stats         UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_malloc_stats)
+#define mspace_trim                 UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_trim)
+#define mspace_footprint            UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_footprint)
+#define mspace_max_footprint        UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_max_footprint)
+#define mspace_mallinfo             UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_mallinfo)
+#define mspace_mallopt              UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_mallopt)
+#endif /* UCM_MALLOC_PREFIX */
+
 /*
   mspace is an opaque type representing an independent
   region of space that supports mspace_malloc, etc.
@@ -1502,6 +1532,30 @@ static FORCEINLINE int win32munmap(void* ptr, size_t size) {
                                          (void)(nsz), (void)(mv),MFAIL)
 #endif /* HAVE_MMAP && HAVE_MREMAP */
 
+/*
+  Let ucm track the heap segments mapped with mmap(), so it would know which
+  blocks are ours. Chunks mapped directly still use the default mmap().
+*/
+#if defined(UCM_MALLOC_PREFIX) && HAVE_MMAP && !defined(WIN32)
+void* ucm_malloc_segment_mmap(size_t size);
+int   ucm_malloc_segment_munmap(void* addr, size_t size);
+void* ucm_malloc_segment_mremap(void* old_address, size_t old_size,
+                                size_t new_size, int flags);
+#undef DIRECT_MMAP
+#undef CALL_MMAP
+#undef CALL_MUNMAP
+#undef CALL_MREMAP
+#define DIRECT_MMAP(s)       mmap(0, (s), MMAP_PROT, MMAP_FLAGS, -1, 0)
+#define CALL_MMAP(s)         ucm_malloc_segment_mmap(s)
+#define CALL_MUNMAP(a, s)    ucm_malloc_segment_munmap((a), (s))
+#if HAVE_MREMAP
+#define CALL_MREMAP(addr, osz, nsz, mv) ucm_malloc_segment_mremap((addr), (osz), (nsz), (mv))
+#else  /* HAVE_MREMAP */
+#define CALL_MREMAP(addr, osz, nsz, mv) ((void)(addr),(void)(osz), \
+                                         (void)(nsz), (void)(mv),MFAIL)
+#endif /* HAVE_MREMAP */
+#endif /* UCM_MALLOC_PREFIX && HAVE_MMAP && !WIN32 */
+
 #if HAVE_MORECORE
 #define CALL_MORECORE(S)     MORECORE(S)
 #else  /* HAVE_MORECORE */
@@ -3494,7 +3548,7 @@ static void internal_malloc_stats(mstate m) {
 #else /* ONLY_MSPACES */
 #if MSPACES
 #define internal_malloc(m, b)\
-   (m == gm)? dlmalloc(b) : mspace_malloc(m, b)
+   ((m == gm)? dlmalloc(b) : mspace_malloc(m, b))
 #define internal_free(m, mem)\
    if (m == gm) dlfree(mem); else mspace_free(m,mem);
 #else /* MSPACES */
@@ -4779,6 +4833,14 @@ size_t dlmalloc_usable_size(void* mem) {
   return 0;
 }
 
+int dlmalloc_owns(void* mem) {
+#if FOOTERS
+  return get_mstate_for(mem2chunk(mem)) == gm;
+#else /* FOOTERS */
+  return 1;
+#endif /* FOOTERS */
+}
+
 int dlmallopt(int param_number, int value) {
   return change_mparam(param_number, value);
 }
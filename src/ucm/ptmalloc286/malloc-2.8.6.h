@@ -64,6 +64,7 @@ extern "C" {
 #define dlmalloc_trim                UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_trim)
 #define dlmalloc_stats               UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_stats)
 #define dlmalloc_usable_size         UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_usable_size)
+#define dlmalloc_owns                UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_owns)
 #define dlmalloc_footprint           UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_footprint)
 #define dlmalloc_max_footprint       UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_max_footprint)
 #define dlmalloc_footprint_limit     UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, malloc_footprint_limit)
@@ -522,8 +523,43 @@ void  dlmalloc_stats(void);
 */
 size_t dlmalloc_usable_size(const void*);
 
+/*
+  malloc_owns(void* p);
+  Returns nonzero if the chunk in use at p was allocated from the global
+  heap, according to its footer. Memory of other allocators which happens to
+  lie in the same sbrk area is told apart this way. Without FOOTERS, every
+  chunk is assumed to be ours.
+*/
+int dlmalloc_owns(void*);
+
 #if MSPACES
 
+#ifdef UCM_MALLOC_PREFIX
+#define create_mspace               UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, create_mspace)
+#define create_mspace_with_base     UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, create_mspace_with_base)
+#define destroy_mspace              UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, destroy_mspace)
+#define mspace_track_large_chunks   UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_track_large_chunks)
+#define mspace_malloc               UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_malloc)
+#define mspace_free                 UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_free)
+#define mspace_calloc               UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_calloc)
+#define mspace_realloc              UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_realloc)
+#define mspace_realloc_in_place     UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_realloc_in_place)
+#define mspace_memalign             UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_memalign)
+#define mspace_independent_calloc   UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_independent_calloc)
+#define mspace_independent_comalloc UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_independent_comalloc)
+#define mspace_bulk_free            UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_bulk_free)
+#define mspace_usable_size          UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_usable_size)
+#define mspace_malloc_stats         UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_malloc_stats)
+#define mspace_trim                 UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_trim)
+#define mspace_footprint            UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_footprint)
+#define mspace_max_footprint        UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_max_footprint)
+#define mspace_footprint_limit      UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_footprint_limit)
+#define mspace_set_footprint_limit  UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_set_footprint_limit)
+#define mspace_inspect_all          UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_inspect_all)
+#define mspace_mallinfo             UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_mallinfo)
+#define mspace_mallopt              UCS_PP_TOKENPASTE(UCM_MALLOC_PREFIX, mspace_mallopt)
+#endif /* UCM_MALLOC_PREFIX */
+
 /*
   mspace is an opaque type representing an independent
   region of space that supports mspace_malloc, etc.
@@ -139,3 +139,12 @@ size_t ucm_get_shm_seg_size(const void *shmaddr)
     ucm_parse_proc_self_maps(ucm_get_shm_seg_size_cb, &ctx);
     return ctx.seg_size;
 }
+
+void *ucm_sys_alloc_pages(size_t size)
+{
+    void *ptr;
+
+    ptr = ucm_orig_mmap(NULL, size, PROT_READ|PROT_WRITE,
+                        MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+}
@@ -43,4 +43,13 @@ void ucm_parse_proc_self_maps(ucm_proc_maps_cb_t cb, void *arg);
 size_t ucm_get_shm_seg_size(const void *shmaddr);
 
 
+/**
+ * @brief Allocate memory without calling the memory hooks
+ *
+ * @param [in]  size     Size to allocate.
+ * @return Page-aligned memory, or NULL if failed.
+ */
+void *ucm_sys_alloc_pages(size_t size);
+
+
 #endif
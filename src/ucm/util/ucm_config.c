@@ -20,6 +20,7 @@
 #define UCM_EN_MMAP_RELOC_VAR    "MMAP_RELOC"
 #define UCM_EN_MALLOC_HOOKS_VAR  "MALLOC_HOOKS"
 #define UCM_EN_MALLOC_RELOC_VAR  "MALLOC_RELOC"
+#define UCM_MALLOC_ARENAS_VAR    "MALLOC_ARENAS"
 
 
 ucm_config_t ucm_global_config = {
@@ -28,7 +29,8 @@ ucm_config_t ucm_global_config = {
     .enable_events        = 1,
     .enable_mmap_reloc    = 1,
     .enable_malloc_hooks  = 1,
-    .enable_malloc_reloc  = 0
+    .enable_malloc_reloc  = 0,
+    .malloc_arenas        = 8
 };
 
 static const char *ucm_config_bool_to_string(int value)
@@ -107,6 +109,14 @@ void ucm_config_print(FILE *stream, ucs_config_print_flags_t print_flags)
                               print_flags);
     fprintf(stream, "%s%s=%s\n", UCM_ENV_PREFIX, UCM_EN_MALLOC_RELOC_VAR,
             ucm_config_bool_to_string(ucm_global_config.enable_malloc_reloc));
+
+    ucm_config_print_doc(stream,
+                         "Number of heaps shared by secondary threads when malloc is replaced.\n"
+                         "The main thread always uses the global heap. 0 means all threads use\n"
+                         "the global heap.",
+                         "long integer", print_flags);
+    fprintf(stream, "%s%s=%zu\n", UCM_ENV_PREFIX, UCM_MALLOC_ARENAS_VAR,
+            ucm_global_config.malloc_arenas);
 }
 
 static void ucm_config_set_value_table(const char *str_value, const char **table,
@@ -157,6 +167,8 @@ ucs_status_t ucm_config_modify(const char *name, const char *value)
         ucm_config_set_value_bool(value, &ucm_global_config.enable_malloc_hooks);
     } else if (!strcmp(name, UCM_EN_MALLOC_RELOC_VAR)) {
         ucm_config_set_value_bool(value, &ucm_global_config.enable_malloc_reloc);
+    } else if (!strcmp(name, UCM_MALLOC_ARENAS_VAR)) {
+        ucm_config_set_value_size(value, &ucm_global_config.malloc_arenas);
     } else {
         return UCS_ERR_INVALID_PARAM;
     }
@@ -183,4 +195,5 @@ UCS_STATIC_INIT {
     ucm_config_set(UCM_EN_MMAP_RELOC_VAR);
     ucm_config_set(UCM_EN_MALLOC_HOOKS_VAR);
     ucm_config_set(UCM_EN_MALLOC_RELOC_VAR);
+    ucm_config_set(UCM_MALLOC_ARENAS_VAR);
 }
@@ -19,6 +19,7 @@ typedef struct ucm_config {
     int             enable_malloc_hooks;
     int             enable_malloc_reloc;
     size_t          alloc_alignment;
+    size_t          malloc_arenas;
 } ucm_config_t;
 
 
@@ -133,7 +133,7 @@ ucs_status_t ucp_amo_check_send_status(ucp_request_t *req, ucs_status_t status)
     }
     /* Complete for UCS_OK and unexpected errors */
     if (status != UCS_ERR_NO_RESOURCE) {
-        ucp_request_complete_send(req, status);
+        ucp_request_complete_send(req->send.ep->worker, req, status);
     }
     return status;
 }
@@ -143,7 +143,7 @@ static void ucp_amo_completed_single(uct_completion_t *self,
 {
     ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.uct_comp);
     ucs_trace("Invoking completion on AMO request %p", req);
-    ucp_request_complete_send(req, status);
+    ucp_request_complete_send(req->send.ep->worker, req, status);
 }
 
 static inline ucs_status_t ucp_rma_check_atomic(uint64_t remote_addr, size_t size)
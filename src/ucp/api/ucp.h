@@ -1141,6 +1141,12 @@ ucs_status_t ucp_worker_get_efd(ucp_worker_h worker, int *fd);
  * notification and may not progress some of the requests as it would when
  * calling @ref ucp_worker_progress (which is not invoked in that duration).
  *
+ * @note Depending on the UCX_WAIT_MODE configuration, this routine may call
+ * @ref ucp_worker_progress for some time before blocking, and return as soon
+ * as a request is completed or a message is received during that time. In the
+ * poll mode it does not block, and returns after that time also if no event
+ * was seen.
+ *
  * @note UCP @ref ucp_feature "features" have to be triggered
  *   with @ref UCP_FEATURE_WAKEUP to select proper transport
  *
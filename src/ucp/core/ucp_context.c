@@ -7,6 +7,7 @@
 
 #include "ucp_context.h"
 #include "ucp_request.h"
+#include "ucp_mm.h"
 
 #include <ucs/config/parser.h>
 #include <ucs/algorithm/crc.h>
@@ -28,6 +29,14 @@ static const char *ucp_atomic_modes[] = {
     [UCP_ATOMIC_MODE_LAST]   = NULL,
 };
 
+static const char *ucp_wait_modes[] = {
+    [UCP_WAIT_MODE_SLEEP]    = "sleep",
+    [UCP_WAIT_MODE_POLL]     = "poll",
+    [UCP_WAIT_MODE_SPIN]     = "spin",
+    [UCP_WAIT_MODE_ADAPTIVE] = "adaptive",
+    [UCP_WAIT_MODE_LAST]     = NULL,
+};
+
 static const char * ucp_device_type_names[] = {
     [UCT_DEVICE_TYPE_NET]  = "network",
     [UCT_DEVICE_TYPE_SHM]  = "intra-node",
@@ -97,6 +106,18 @@ static ucs_config_field_t ucp_config_table[] = {
    "the eager_zcopy protocol",
    ucs_offsetof(ucp_config_t, ctx.rndv_perf_diff), UCS_CONFIG_TYPE_DOUBLE},
 
+  {"MAX_RNDV_LANES", "1",
+   "Maximal number of lanes to split rendezvous data between. Additional lanes\n"
+   "are selected only on other devices of comparable bandwidth, and each lane\n"
+   "fetches a part of the message proportional to its bandwidth.\n"
+   "The maximum is " UCS_PP_MAKE_STRING(UCP_MAX_RNDV_LANES) ".",
+   ucs_offsetof(ucp_config_t, ctx.max_rndv_lanes), UCS_CONFIG_TYPE_UINT},
+
+  {"RNDV_MIN_BW_RATIO", "0.5",
+   "Minimal bandwidth of an additional rendezvous lane, relative to the\n"
+   "bandwidth of the best one.",
+   ucs_offsetof(ucp_config_t, ctx.rndv_min_bw_ratio), UCS_CONFIG_TYPE_DOUBLE},
+
   {"ZCOPY_THRESH", "auto",
    "Threshold for switching from buffer copy to zero copy protocol",
    ucs_offsetof(ucp_config_t, ctx.zcopy_thresh), UCS_CONFIG_TYPE_MEMUNITS},
@@ -105,6 +126,28 @@ static ucs_config_field_t ucp_config_table[] = {
    "Estimation of buffer copy bandwidth",
    ucs_offsetof(ucp_config_t, ctx.bcopy_bw), UCS_CONFIG_TYPE_MEMUNITS},
 
+  {"RCACHE", "try",
+   "Use a registration cache for zero-copy send and rendezvous buffers on every\n"
+   "memory domain which requires memory registration and does not cache the\n"
+   "registrations by itself. Cached regions are released when the memory is\n"
+   "unmapped.",
+   ucs_offsetof(ucp_config_t, ctx.rcache_enable), UCS_CONFIG_TYPE_TERNARY},
+
+  {"RCACHE_MEM_PRIO", "1000",
+   "Priority of the registration cache memory event handler",
+   ucs_offsetof(ucp_config_t, ctx.rcache_event_prio), UCS_CONFIG_TYPE_UINT},
+
+  {"RCACHE_MAX_REGIONS", "inf",
+   "Maximal number of regions in the registration cache of each memory domain.\n"
+   "Unused regions are released in least recently used order to stay below the\n"
+   "limit.",
+   ucs_offsetof(ucp_config_t, ctx.rcache_max_regions), UCS_CONFIG_TYPE_ULUNITS},
+
+  {"RCACHE_MAX_SIZE", "inf",
+   "Maximal total size of the regions in the registration cache of each memory\n"
+   "domain, which bounds the amount of memory kept registered.",
+   ucs_offsetof(ucp_config_t, ctx.rcache_max_size), UCS_CONFIG_TYPE_MEMUNITS},
+
   {"ATOMIC_MODE", "guess",
    "Atomic operations synchronization mode.\n"
    " cpu    - atomic operations are consistent with respect to the CPU.\n"
@@ -125,6 +168,21 @@ static ucs_config_field_t ucp_config_table[] = {
    "y      - Use mutex for multithreading support in UCP.\n",
    ucs_offsetof(ucp_config_t, ctx.use_mt_mutex), UCS_CONFIG_TYPE_BOOL},
 
+  {"WAIT_MODE", "sleep",
+   "How ucp_worker_wait() waits for events.\n"
+   " sleep    - arm the interfaces and block until an event arrives.\n"
+   " poll     - call progress until an event arrives, or for WAIT_SPIN_TIME,\n"
+   "            never block.\n"
+   " spin     - call progress for WAIT_SPIN_TIME, then arm and block.\n"
+   " adaptive - call progress for a time derived from the recent inter-arrival\n"
+   "            times of events, up to WAIT_SPIN_TIME, then arm and block.",
+   ucs_offsetof(ucp_config_t, ctx.wait_mode), UCS_CONFIG_TYPE_ENUM(ucp_wait_modes)},
+
+  {"WAIT_SPIN_TIME", "50us",
+   "Maximal time to call progress in ucp_worker_wait() before blocking, in the\n"
+   "spin and adaptive wait modes, or before returning, in the poll mode.",
+   ucs_offsetof(ucp_config_t, ctx.wait_spin_time), UCS_CONFIG_TYPE_TIME},
+
   {NULL}
 };
 
@@ -411,6 +469,7 @@ static void ucp_free_resources(ucp_context_t *context)
     ucp_rsc_index_t i;
 
     ucs_free(context->tl_rscs);
+    ucp_mem_rcache_cleanup(context);
     for (i = 0; i < context->num_mds; ++i) {
         uct_md_close(context->tl_mds[i].md);
     }
@@ -449,7 +508,8 @@ static ucs_status_t ucp_fill_tl_md(const uct_md_resource_desc_t *md_rsc,
     ucs_status_t status;
 
     /* Save MD resource */
-    tl_md->rsc = *md_rsc;
+    tl_md->rsc    = *md_rsc;
+    tl_md->rcache = NULL;
 
     /* Read MD configuration */
     status = uct_md_config_read(md_rsc->md_name, NULL, NULL, &md_config);
@@ -627,6 +687,12 @@ static ucs_status_t ucp_fill_resources(ucp_context_h context,
         goto err_free_context_resources;
     }
 
+    /* Create registration caches for the memory domains which need them */
+    status = ucp_mem_rcache_init(context);
+    if (status != UCS_OK) {
+        goto err_free_context_resources;
+    }
+
     uct_release_md_resource_list(md_rscs);
 
     /* Notify the user if there are devices from the command line that are not available */
@@ -710,6 +776,14 @@ static ucs_status_t ucp_fill_config(ucp_context_h context,
      * routines */
     UCP_THREAD_LOCK_INIT(&context->mt_lock);
 
+    if ((config->ctx.max_rndv_lanes == 0) ||
+        (config->ctx.max_rndv_lanes > UCP_MAX_RNDV_LANES)) {
+        ucs_error("MAX_RNDV_LANES must be between 1 and %d (got %u)",
+                  UCP_MAX_RNDV_LANES, config->ctx.max_rndv_lanes);
+        status = UCS_ERR_INVALID_PARAM;
+        goto err;
+    }
+
     /* Get allocation alignment from configuration, make sure it's valid */
     if (config->alloc_prio.count == 0) {
         ucs_error("No allocation methods specified - aborting");
@@ -814,7 +888,8 @@ ucs_status_t ucp_init_version(unsigned api_major_version, unsigned api_minor_ver
     }
 
     /* initialize tag matching */
-    status = ucp_tag_match_init(&context->tm);
+    status = ucp_tag_match_init(&context->tm
+                                UCS_STATS_ARG(ucs_stats_get_root()));
     if (status != UCS_OK) {
         goto err_free_resources;
     }
@@ -16,6 +16,7 @@
 #include <ucp/tag/tag_match.h>
 #include <uct/api/uct.h>
 #include <ucs/datastruct/queue_types.h>
+#include <ucs/sys/rcache.h>
 #include <ucs/type/component.h>
 #include <ucs/type/spinlock.h>
 
@@ -31,16 +32,33 @@ typedef struct ucp_context_config {
     /** The percentage allowed for performance difference between rendezvous
      *  and the eager_zcopy protocol */
     double                                 rndv_perf_diff;
+    /** Maximal number of lanes to stripe rendezvous data over */
+    unsigned                               max_rndv_lanes;
+    /** Minimal bandwidth of an additional rendezvous lane, relative to the
+     *  best one */
+    double                                 rndv_min_bw_ratio;
     /** Threshold for switching UCP to zero copy protocol */
     size_t                                 zcopy_thresh;
     /** Estimation of bcopy bandwidth */
     size_t                                 bcopy_bw;
     /** Maximal size of worker name for debugging */
     unsigned                               max_worker_name;
+    /** Whether to cache the registration of send buffers */
+    ucs_ternary_value_t                    rcache_enable;
+    /** Priority of the registration cache memory event handler */
+    unsigned                               rcache_event_prio;
+    /** Maximal number of regions in each registration cache */
+    unsigned long                          rcache_max_regions;
+    /** Maximal total size of the regions in each registration cache */
+    size_t                                 rcache_max_size;
     /** Atomic mode */
     ucp_atomic_mode_t                      atomic_mode;
     /** If use mutex for MT support or not */
     int                                    use_mt_mutex;
+    /** How ucp_worker_wait() waits for events */
+    ucp_wait_mode_t                        wait_mode;
+    /** Maximal time to call progress before blocking in ucp_worker_wait() */
+    double                                 wait_spin_time;
 } ucp_context_config_t;
 
 
@@ -84,6 +102,7 @@ typedef struct ucp_tl_md {
     uct_md_h                      md;       /* Memory domain handle */
     uct_md_resource_desc_t        rsc;      /* Memory domain resource */
     uct_md_attr_t                 attr;     /* Memory domain attributes */
+    ucs_rcache_t                  *rcache;  /* Registration cache, or NULL */
 } ucp_tl_md_t;
 
 
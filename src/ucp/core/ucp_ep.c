@@ -36,9 +36,9 @@ void ucp_ep_config_key_reset(ucp_ep_config_key_t *key)
     memset(key, 0, sizeof(*key));
     key->num_lanes        = 0;
     key->am_lane          = UCP_NULL_LANE;
-    key->rndv_lane        = UCP_NULL_LANE;
     key->wireup_lane      = UCP_NULL_LANE;
     key->reachable_md_map = 0;
+    memset(key->rndv_lanes, UCP_NULL_LANE, sizeof(key->rndv_lanes));
     memset(key->rma_lanes, UCP_NULL_LANE, sizeof(key->rma_lanes));
     memset(key->amo_lanes, UCP_NULL_LANE, sizeof(key->amo_lanes));
 }
@@ -137,7 +137,7 @@ ucs_status_t ucp_ep_create_stub(ucp_worker_h worker, uint64_t dest_uuid,
     key.lanes[0].rsc_index    = UCP_NULL_RESOURCE;
     key.lanes[0].dst_md_index = UCP_NULL_RESOURCE;
     key.am_lane               = 0;
-    key.rndv_lane             = 0;
+    key.rndv_lanes[0]         = 0;
     key.wireup_lane           = 0;
 
     ep->cfg_index        = ucp_worker_get_ep_config(worker, &key);
@@ -319,17 +319,19 @@ static void ucp_ep_flushed_slow_path_callback(ucs_callbackq_slow_elem_t *self)
 {
     ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.flush.cbq_elem);
     ucp_ep_h ep = req->send.ep;
+    ucp_worker_h worker = ep->worker;
 
     ucs_assert(!(req->flags & UCP_REQUEST_FLAG_COMPLETED));
 
     ucs_trace("flush req %p ep %p remove from uct_worker %p", req, ep,
-              ep->worker->uct);
+              worker->uct);
     ucp_ep_flush_slow_path_remove(req);
     req->send.flush.flushed_cb(req);
 
     /* Complete send request from here, to avoid releasing the request while
-     * slow-path element is still pending */
-    ucp_request_complete_send(req, req->status);
+     * slow-path element is still pending. The endpoint may be destroyed by
+     * flushed_cb, so the request is completed without accessing it. */
+    ucp_request_complete_send(worker, req, req->status);
 }
 
 static int ucp_flush_check_completion(ucp_request_t *req)
@@ -564,9 +566,9 @@ int ucp_ep_config_is_equal(const ucp_ep_config_key_t *key1,
     if ((key1->num_lanes        != key2->num_lanes) ||
         memcmp(key1->rma_lanes, key2->rma_lanes, sizeof(key1->rma_lanes)) ||
         memcmp(key1->amo_lanes, key2->amo_lanes, sizeof(key1->amo_lanes)) ||
+        memcmp(key1->rndv_lanes, key2->rndv_lanes, sizeof(key1->rndv_lanes)) ||
         (key1->reachable_md_map != key2->reachable_md_map) ||
         (key1->am_lane          != key2->am_lane) ||
-        (key1->rndv_lane        != key2->rndv_lane) ||
         (key1->wireup_lane      != key2->wireup_lane))
     {
         return 0;
@@ -674,7 +676,6 @@ void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config)
     config->am.zcopy_auto_thresh  = 0;
     config->bcopy_thresh          = context->config.ext.bcopy_thresh;
     config->rndv.rma_thresh       = SIZE_MAX;
-    config->rndv.max_get_zcopy    = SIZE_MAX;
     config->rndv.am_thresh        = SIZE_MAX;
     config->p2p_lanes             = 0;
 
@@ -791,9 +792,10 @@ void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config)
         }
     }
 
-    /* Configuration for Rendezvous data */
-    if (config->key.rndv_lane != UCP_NULL_LANE) {
-        lane        = config->key.rndv_lane;
+    /* Configuration for Rendezvous data, the thresholds are defined by the
+     * primary lane */
+    if (config->key.rndv_lanes[0] != UCP_NULL_LANE) {
+        lane        = config->key.rndv_lanes[0];
         rsc_index   = config->key.lanes[lane].rsc_index;
         if (rsc_index != UCP_NULL_RESOURCE) {
             iface_attr = &worker->iface_attrs[rsc_index];
@@ -817,7 +819,6 @@ void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config)
             rndv_thresh                = ucs_max(rndv_thresh,
                                                  iface_attr->cap.get.min_zcopy);
 
-            config->rndv.max_get_zcopy = iface_attr->cap.get.max_zcopy;
             config->rndv.rma_thresh    = rndv_thresh;
         } else {
             ucs_debug("rendezvous (get_zcopy) protocol is not supported ");
@@ -939,9 +940,11 @@ void ucp_ep_config_lane_info_str(ucp_context_h context,
         p += strlen(p);
     }
 
-    if (lane == key->rndv_lane) {
-        snprintf(p, endp - p, " zcopy_rndv");
-        p += strlen(p);
+    for (prio = 0; prio < UCP_MAX_RNDV_LANES; ++prio) {
+        if (lane == key->rndv_lanes[prio]) {
+            snprintf(p, endp - p, " zcopy_rndv#%d", prio);
+            p += strlen(p);
+        }
     }
 
     if (key->wireup_lane == lane) {
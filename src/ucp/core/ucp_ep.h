@@ -62,9 +62,13 @@ typedef struct ucp_ep_config_key {
     } lanes[UCP_MAX_LANES];
 
     ucp_lane_index_t       am_lane;      /* Lane for AM (can be NULL) */
-    ucp_lane_index_t       rndv_lane;    /* Lane for zcopy Rendezvous (can be NULL) */
     ucp_lane_index_t       wireup_lane;  /* Lane for wireup messages (can be NULL) */
 
+    /* Lanes for zcopy Rendezvous, sorted by priority, highest first. The data
+     * is striped over all of them according to their bandwidth.
+     */
+    ucp_lane_index_t       rndv_lanes[UCP_MAX_RNDV_LANES];
+
     /* Lanes for remote memory access, sorted by priority, highest first */
     ucp_lane_index_t       rma_lanes[UCP_MAX_LANES];
 
@@ -125,8 +129,6 @@ typedef struct ucp_ep_config {
     size_t                     bcopy_thresh;
 
     struct {
-        /* Maximal total size of rndv_get_zcopy */
-        size_t                 max_get_zcopy;
         /* Threshold for switching from eager to RMA based rendezvous */
         size_t                 rma_thresh;
         /* Threshold for switching from eager to AM based rendezvous */
@@ -34,13 +34,13 @@ static inline ucp_lane_index_t ucp_ep_get_wireup_msg_lane(ucp_ep_h ep)
 
 static inline ucp_lane_index_t ucp_ep_get_rndv_get_lane(ucp_ep_h ep)
 {
-    ucs_assert(ucp_ep_config(ep)->key.rndv_lane != UCP_NULL_RESOURCE);
-    return ucp_ep_config(ep)->key.rndv_lane;
+    ucs_assert(ucp_ep_config(ep)->key.rndv_lanes[0] != UCP_NULL_RESOURCE);
+    return ucp_ep_config(ep)->key.rndv_lanes[0];
 }
 
 static inline int ucp_ep_is_rndv_lane_present(ucp_ep_h ep)
 {
-    return ucp_ep_config(ep)->key.rndv_lane != UCP_NULL_RESOURCE;
+    return ucp_ep_config(ep)->key.rndv_lanes[0] != UCP_NULL_RESOURCE;
 }
 
 static inline uct_ep_h ucp_ep_get_am_uct_ep(ucp_ep_h ep)
@@ -48,11 +48,6 @@ static inline uct_ep_h ucp_ep_get_am_uct_ep(ucp_ep_h ep)
     return ep->uct_eps[ucp_ep_get_am_lane(ep)];
 }
 
-static inline uct_ep_h ucp_ep_get_rndv_data_uct_ep(ucp_ep_h ep)
-{
-    return ep->uct_eps[ucp_ep_get_rndv_get_lane(ep)];
-}
-
 static inline ucp_rsc_index_t ucp_ep_get_rsc_index(ucp_ep_h ep, ucp_lane_index_t lane)
 {
     return ucp_ep_config(ep)->key.lanes[lane].rsc_index;
@@ -92,11 +87,6 @@ static inline const uct_md_attr_t* ucp_ep_md_attr(ucp_ep_h ep, ucp_lane_index_t
     return &context->tl_mds[ucp_ep_md_index(ep, lane)].attr;
 }
 
-static inline uint64_t ucp_ep_rndv_md_flags(ucp_ep_h ep)
-{
-    return ucp_ep_md_attr(ep, ucp_ep_get_rndv_get_lane(ep))->cap.flags;
-}
-
 static inline const char* ucp_ep_peer_name(ucp_ep_h ep)
 {
 #if ENABLE_DEBUG_DATA
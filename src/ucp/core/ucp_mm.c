@@ -444,3 +444,142 @@ ucp_mem_advise(ucp_context_h context, ucp_mem_h memh,
     UCP_THREAD_CS_EXIT(&context->mt_lock);
     return status;
 }
+
+static ucs_status_t ucp_mem_rcache_mem_reg_cb(void *context, ucs_rcache_t *rcache,
+                                              void *arg, ucs_rcache_region_t *rregion)
+{
+    ucp_mem_rcache_region_t *region = ucs_derived_of(rregion,
+                                                     ucp_mem_rcache_region_t);
+    ucp_tl_md_t *tl_md              = context;
+
+    return uct_md_mem_reg(tl_md->md, (void*)region->super.super.start,
+                          region->super.super.end - region->super.super.start,
+                          0, &region->memh);
+}
+
+static void ucp_mem_rcache_mem_dereg_cb(void *context, ucs_rcache_t *rcache,
+                                        ucs_rcache_region_t *rregion)
+{
+    ucp_mem_rcache_region_t *region = ucs_derived_of(rregion,
+                                                     ucp_mem_rcache_region_t);
+    ucp_tl_md_t *tl_md              = context;
+
+    uct_md_mem_dereg(tl_md->md, region->memh);
+}
+
+static void ucp_mem_rcache_dump_region_cb(void *context, ucs_rcache_t *rcache,
+                                          ucs_rcache_region_t *rregion, char *buf,
+                                          size_t max)
+{
+    ucp_mem_rcache_region_t *region = ucs_derived_of(rregion,
+                                                     ucp_mem_rcache_region_t);
+
+    snprintf(buf, max, "memh %p", region->memh);
+}
+
+static ucs_rcache_ops_t ucp_mem_rcache_ops = {
+    .mem_reg     = ucp_mem_rcache_mem_reg_cb,
+    .mem_dereg   = ucp_mem_rcache_mem_dereg_cb,
+    .dump_region = ucp_mem_rcache_dump_region_cb
+};
+
+ucs_status_t ucp_mem_rcache_init(ucp_context_h context)
+{
+    ucp_context_config_t *config = &context->config.ext;
+    ucs_rcache_params_t rcache_params;
+    ucp_rsc_index_t md_index;
+    ucp_tl_md_t *tl_md;
+    char name[64];
+    ucs_status_t status;
+
+    if (config->rcache_enable == UCS_NO) {
+        return UCS_OK;
+    }
+
+    for (md_index = 0; md_index < context->num_mds; ++md_index) {
+        tl_md = &context->tl_mds[md_index];
+        if (!(tl_md->attr.cap.flags & UCT_MD_FLAG_REG) ||
+            (tl_md->attr.cap.flags & UCT_MD_FLAG_RCACHE)) {
+            /* no registration, or the md caches registrations by itself */
+            continue;
+        }
+
+        rcache_params.region_struct_size = sizeof(ucp_mem_rcache_region_t);
+        rcache_params.alignment          = UCS_PGT_ADDR_ALIGN;
+        rcache_params.ucm_event_priority = config->rcache_event_prio;
+        rcache_params.context            = tl_md;
+        rcache_params.ops                = &ucp_mem_rcache_ops;
+        rcache_params.max_regions        = config->rcache_max_regions;
+        rcache_params.max_size           = config->rcache_max_size;
+        snprintf(name, sizeof(name), "ucp_%s", tl_md->rsc.md_name);
+        status = ucs_rcache_create(&rcache_params, name
+                                   UCS_STATS_ARG(ucs_stats_get_root()),
+                                   &tl_md->rcache);
+        if (status == UCS_OK) {
+            continue;
+        }
+
+        tl_md->rcache = NULL;
+        if (config->rcache_enable == UCS_YES) {
+            ucs_error("Failed to create registration cache for md %s: %s",
+                      tl_md->rsc.md_name, ucs_status_string(status));
+            return status;
+        }
+
+        ucs_debug("Could not create registration cache for md %s: %s",
+                  tl_md->rsc.md_name, ucs_status_string(status));
+    }
+
+    return UCS_OK;
+}
+
+void ucp_mem_rcache_cleanup(ucp_context_h context)
+{
+    ucp_rsc_index_t md_index;
+    ucp_tl_md_t *tl_md;
+
+    for (md_index = 0; md_index < context->num_mds; ++md_index) {
+        tl_md = &context->tl_mds[md_index];
+        if (tl_md->rcache != NULL) {
+            ucs_rcache_destroy(tl_md->rcache);
+            tl_md->rcache = NULL;
+        }
+    }
+}
+
+ucs_status_t ucp_mem_buffer_reg(ucp_context_h context, ucp_rsc_index_t md_index,
+                                void *address, size_t length, int prot,
+                                uct_mem_h *memh_p,
+                                ucp_mem_rcache_region_t **rregion_p)
+{
+    ucp_tl_md_t *tl_md = &context->tl_mds[md_index];
+    ucs_rcache_region_t *rregion;
+    ucs_status_t status;
+
+    if ((tl_md->rcache == NULL) || (length == 0)) {
+        *rregion_p = NULL;
+        return uct_md_mem_reg(tl_md->md, address, length, 0, memh_p);
+    }
+
+    status = ucs_rcache_get(tl_md->rcache, address, length, prot, NULL,
+                            &rregion);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    *rregion_p = ucs_derived_of(rregion, ucp_mem_rcache_region_t);
+    *memh_p    = (*rregion_p)->memh;
+    return UCS_OK;
+}
+
+void ucp_mem_buffer_dereg(ucp_context_h context, ucp_rsc_index_t md_index,
+                          uct_mem_h memh, ucp_mem_rcache_region_t *rregion)
+{
+    ucp_tl_md_t *tl_md = &context->tl_mds[md_index];
+
+    if (rregion == NULL) {
+        uct_md_mem_dereg(tl_md->md, memh);
+    } else {
+        ucs_rcache_region_put(tl_md->rcache, &rregion->super);
+    }
+}
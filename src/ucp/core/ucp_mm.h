@@ -13,6 +13,7 @@
 #include <uct/api/uct.h>
 #include <ucs/arch/bitops.h>
 #include <ucs/debug/log.h>
+#include <ucs/sys/rcache.h>
 
 #include <inttypes.h>
 
@@ -54,9 +55,63 @@ typedef struct ucp_mem {
 } ucp_mem_t;
 
 
+/**
+ * Registration cache region of a memory domain, holds the UCT memory handle
+ * of the whole (aligned, possibly merged) region.
+ */
+struct ucp_mem_rcache_region {
+    ucs_rcache_region_t           super;
+    uct_mem_h                     memh;         /* UCT handle of the region */
+};
+
+
+/**
+ * Create a registration cache for every memory domain of the context which
+ * requires memory registration and does not have a cache of its own.
+ */
+ucs_status_t ucp_mem_rcache_init(ucp_context_h context);
+
+
+void ucp_mem_rcache_cleanup(ucp_context_h context);
+
+
+/**
+ * Register a buffer on a memory domain, through its registration cache if it
+ * has one.
+ *
+ * @param [in]  context    UCP context.
+ * @param [in]  md_index   Memory domain to register on.
+ * @param [in]  address    Buffer address.
+ * @param [in]  length     Buffer length.
+ * @param [in]  prot       Access the buffer is registered for, PROT_xx.
+ * @param [out] memh_p     Filled with the UCT memory handle.
+ * @param [out] rregion_p  Filled with the cache region which holds the memory
+ *                         handle, or NULL if the buffer was registered directly.
+ */
+ucs_status_t ucp_mem_buffer_reg(ucp_context_h context, ucp_rsc_index_t md_index,
+                                void *address, size_t length, int prot,
+                                uct_mem_h *memh_p,
+                                ucp_mem_rcache_region_t **rregion_p);
+
+
+/**
+ * Release a buffer registration obtained by @ref ucp_mem_buffer_reg.
+ */
+void ucp_mem_buffer_dereg(ucp_context_h context, ucp_rsc_index_t md_index,
+                          uct_mem_h memh, ucp_mem_rcache_region_t *rregion);
+
+
 void ucp_rkey_resolve_inner(ucp_rkey_h rkey, ucp_ep_h ep);
 
 
+/**
+ * Unpack a remote key buffer, keeping only the keys of the remote MDs which are
+ * present in reachable_md_map.
+ */
+ucs_status_t ucp_rkey_unpack_mds(void *rkey_buffer, ucp_md_map_t reachable_md_map,
+                                 ucp_rkey_h *rkey_p);
+
+
 #define UCP_RKEY_RESOLVE(_rkey, _ep, _op_type) \
     ({ \
         ucs_status_t status = UCS_OK; \
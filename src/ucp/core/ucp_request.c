@@ -6,6 +6,7 @@
 
 #include "ucp_context.h"
 #include "ucp_worker.h"
+#include "ucp_mm.h"
 #include "ucp_request.inl"
 
 #include <ucp/tag/tag_match.h>
@@ -86,7 +87,7 @@ UCS_PROFILE_FUNC_VOID(ucp_request_cancel, (worker, request),
         UCP_THREAD_CS_ENTER_CONDITIONAL(&worker->context->mt_lock);
 
         ucp_tag_exp_remove(&worker->context->tm, req);
-        ucp_request_complete_recv(req, UCS_ERR_CANCELED);
+        ucp_request_complete_recv(worker, req, UCS_ERR_CANCELED);
 
         UCP_THREAD_CS_EXIT_CONDITIONAL(&worker->context->mt_lock);
         UCP_THREAD_CS_EXIT_CONDITIONAL(&worker->mt_lock);
@@ -125,7 +126,7 @@ ucs_mpool_ops_t ucp_request_mpool_ops = {
 void ucp_request_release_pending_send(uct_pending_req_t *self, void *arg)
 {
     ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.uct);
-    ucp_request_complete_send(req, UCS_ERR_CANCELED);
+    ucp_request_complete_send(req->send.ep->worker, req, UCS_ERR_CANCELED);
 }
 
 int ucp_request_pending_add(ucp_request_t *req, ucs_status_t *req_status)
@@ -154,23 +155,26 @@ int ucp_request_pending_add(ucp_request_t *req, ucs_status_t *req_status)
 }
 
 static UCS_F_ALWAYS_INLINE
-void ucp_iov_buffer_memh_dereg(uct_md_h uct_md, uct_mem_h *memh,
+void ucp_iov_buffer_memh_dereg(ucp_context_h context, ucp_rsc_index_t md_index,
+                               uct_mem_h *memh, ucp_mem_rcache_region_t **rregion,
                                size_t count)
 {
     size_t it;
 
     for (it = 0; it < count; ++it) {
         if (memh[it] != UCT_MEM_HANDLE_NULL) {
-            uct_md_mem_dereg(uct_md, memh[it]);
+            ucp_mem_buffer_dereg(context, md_index, memh[it], rregion[it]);
         }
     }
 }
 
-UCS_PROFILE_FUNC(ucs_status_t, ucp_request_send_buffer_reg, (req, lane),
-                 ucp_request_t *req, ucp_lane_index_t lane)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_request_send_buffer_reg, (req, lane, prot),
+                 ucp_request_t *req, ucp_lane_index_t lane, int prot)
 {
-    uct_md_h uct_md       = ucp_ep_md(req->send.ep, lane);
-    ucp_dt_state_t *state = &req->send.state;
+    ucp_context_h context    = req->send.ep->worker->context;
+    ucp_rsc_index_t md_index = ucp_ep_md_index(req->send.ep, lane);
+    ucp_dt_state_t *state    = &req->send.state;
+    ucp_mem_rcache_region_t **rregion;
     size_t iov_it, iovcnt;
     const ucp_dt_iov_t *iov;
     uct_mem_h *memh;
@@ -179,24 +183,30 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_request_send_buffer_reg, (req, lane),
     status = UCS_OK;
     switch (req->send.datatype & UCP_DATATYPE_CLASS_MASK) {
     case UCP_DATATYPE_CONTIG:
-        status = uct_md_mem_reg(uct_md, (void *)req->send.buffer, req->send.length,
-                                0, &state->dt.contig.memh);
+        status = ucp_mem_buffer_reg(context, md_index, (void *)req->send.buffer,
+                                    req->send.length, prot,
+                                    &state->dt.contig.memh,
+                                    &state->dt.contig.rregion);
         break;
     case UCP_DATATYPE_IOV:
-        iovcnt = state->dt.iov.iovcnt;
-        iov    = req->send.buffer;
-        memh   = ucs_malloc(sizeof(*memh) * iovcnt, "IOV memh");
+        iovcnt  = state->dt.iov.iovcnt;
+        iov     = req->send.buffer;
+        memh    = ucs_malloc((sizeof(*memh) + sizeof(*rregion)) * iovcnt,
+                             "IOV memh");
         if (NULL == memh) {
             status = UCS_ERR_NO_MEMORY;
             goto err;
         }
+        rregion = (ucp_mem_rcache_region_t**)(memh + iovcnt);
         for (iov_it = 0; iov_it < iovcnt; ++iov_it) {
             if (iov[iov_it].length) {
-                status = uct_md_mem_reg(uct_md, iov[iov_it].buffer,
-                                        iov[iov_it].length, 0, &memh[iov_it]);
+                status = ucp_mem_buffer_reg(context, md_index, iov[iov_it].buffer,
+                                            iov[iov_it].length, prot,
+                                            &memh[iov_it], &rregion[iov_it]);
                 if (status != UCS_OK) {
                     /* unregister previously registered memory */
-                    ucp_iov_buffer_memh_dereg(uct_md, memh, iov_it);
+                    ucp_iov_buffer_memh_dereg(context, md_index, memh, rregion,
+                                              iov_it);
                     ucs_free(memh);
                     goto err;
                 }
@@ -225,24 +235,24 @@ err:
 UCS_PROFILE_FUNC_VOID(ucp_request_send_buffer_dereg, (req, lane),
                       ucp_request_t *req, ucp_lane_index_t lane)
 {
-    uct_md_h uct_md       = ucp_ep_md(req->send.ep, lane);
-    ucp_dt_state_t *state = &req->send.state;
+    ucp_context_h context    = req->send.ep->worker->context;
+    ucp_rsc_index_t md_index = ucp_ep_md_index(req->send.ep, lane);
+    ucp_dt_state_t *state    = &req->send.state;
     uct_mem_h *memh;
-    size_t iov_it;
 
     switch (req->send.datatype & UCP_DATATYPE_CLASS_MASK) {
     case UCP_DATATYPE_CONTIG:
-        if (req->send.state.dt.contig.memh != UCT_MEM_HANDLE_NULL) {
-            uct_md_mem_dereg(uct_md, state->dt.contig.memh);
+        if (state->dt.contig.memh != UCT_MEM_HANDLE_NULL) {
+            ucp_mem_buffer_dereg(context, md_index, state->dt.contig.memh,
+                                 state->dt.contig.rregion);
         }
         break;
     case UCP_DATATYPE_IOV:
         memh = state->dt.iov.memh;
-        for (iov_it = 0; iov_it < state->dt.iov.iovcnt; ++iov_it) {
-            if (memh[iov_it] != UCT_MEM_HANDLE_NULL) { /* skip zero memh */
-                uct_md_mem_dereg(uct_md, memh[iov_it]);
-            }
-        }
+        ucp_iov_buffer_memh_dereg(context, md_index, memh,
+                                  (ucp_mem_rcache_region_t**)
+                                  (memh + state->dt.iov.iovcnt),
+                                  state->dt.iov.iovcnt);
         ucs_free(state->dt.iov.memh);
         break;
     default:
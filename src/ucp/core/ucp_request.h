@@ -107,7 +107,7 @@ struct ucp_request {
                 struct {
                     uint64_t      remote_address; /* address of the sender's data buffer */
                     uintptr_t     remote_request; /* pointer to the sender's send request */
-                    uct_rkey_bundle_t rkey_bundle;
+                    ucp_rkey_h    rkey;     /* keys of the sender's buffer, or NULL */
                     ucp_request_t *rreq;    /* receive request on the recv side */
                 } rndv_get;
 
@@ -166,7 +166,8 @@ int ucp_request_pending_add(ucp_request_t *req, ucs_status_t *req_status);
 
 void ucp_request_release_pending_send(uct_pending_req_t *self, void *arg);
 
-ucs_status_t ucp_request_send_buffer_reg(ucp_request_t *req, ucp_lane_index_t lane);
+ucs_status_t ucp_request_send_buffer_reg(ucp_request_t *req, ucp_lane_index_t lane,
+                                         int prot);
 
 void ucp_request_send_buffer_dereg(ucp_request_t *req, ucp_lane_index_t lane);
 
@@ -117,17 +117,20 @@ ucp_request_put(ucp_request_t *req)
 }
 
 static UCS_F_ALWAYS_INLINE void
-ucp_request_complete_send(ucp_request_t *req, ucs_status_t status)
+ucp_request_complete_send(ucp_worker_h worker, ucp_request_t *req,
+                          ucs_status_t status)
 {
     ucs_trace_req("completing send request %p (%p) "UCP_REQUEST_FLAGS_FMT" %s",
                   req, req + 1, UCP_REQUEST_FLAGS_ARG(req->flags),
                   ucs_status_string(status));
     UCS_PROFILE_REQUEST_EVENT(req, "complete_send", status);
+    UCP_WORKER_WAIT_EVENT(worker);
     ucp_request_complete(req, send.cb, status);
 }
 
 static UCS_F_ALWAYS_INLINE void
-ucp_request_complete_recv(ucp_request_t *req, ucs_status_t status)
+ucp_request_complete_recv(ucp_worker_h worker, ucp_request_t *req,
+                          ucs_status_t status)
 {
     ucs_trace_req("completing receive request %p (%p) "UCP_REQUEST_FLAGS_FMT
                   " stag 0x%"PRIx64" len %zu, %s",
@@ -135,6 +138,7 @@ ucp_request_complete_recv(ucp_request_t *req, ucs_status_t status)
                   req->recv.info.sender_tag, req->recv.info.length,
                   ucs_status_string(status));
     UCS_PROFILE_REQUEST_EVENT(req, "complete_recv", status);
+    UCP_WORKER_WAIT_EVENT(worker);
     ucp_request_complete(req, recv.cb, status, &req->recv.info);
 }
 
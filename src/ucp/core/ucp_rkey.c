@@ -110,7 +110,8 @@ void ucp_rkey_buffer_release(void *rkey_buffer)
     ucs_free(rkey_buffer);
 }
 
-ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey_p)
+ucs_status_t ucp_rkey_unpack_mds(void *rkey_buffer, ucp_md_map_t reachable_md_map,
+                                 ucp_rkey_h *rkey_p)
 {
     unsigned remote_md_index, remote_md_gap;
     unsigned rkey_index;
@@ -168,7 +169,7 @@ ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey
         ucs_assert_always(remote_md_index <= UCP_MD_INDEX_BITS);
 
         /* Unpack only reachable rkeys */
-        if (UCS_BIT(remote_md_index) & ucp_ep_config(ep)->key.reachable_md_map) {
+        if (UCS_BIT(remote_md_index) & reachable_md_map) {
             ucs_assert(rkey_index < md_count);
 
             status = uct_rkey_unpack(p, &rkey->uct[rkey_index]);
@@ -195,7 +196,7 @@ ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey
         goto err_destroy;
     }
 
-    ucp_rkey_resolve_inner(rkey, ep);
+    rkey->cache.ep_cfg_index = (ucp_ep_cfg_index_t)-1;
     *rkey_p = rkey;
     return UCS_OK;
 
@@ -205,6 +206,19 @@ err:
     return status;
 }
 
+ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey_p)
+{
+    ucs_status_t status;
+
+    status = ucp_rkey_unpack_mds(rkey_buffer,
+                                 ucp_ep_config(ep)->key.reachable_md_map,
+                                 rkey_p);
+    if ((status == UCS_OK) && (*rkey_p != &ucp_mem_dummy_rkey)) {
+        ucp_rkey_resolve_inner(*rkey_p, ep);
+    }
+    return status;
+}
+
 void ucp_rkey_destroy(ucp_rkey_h rkey)
 {
     unsigned num_rkeys;
@@ -33,6 +33,7 @@ UCP_UINT_TYPE(UCP_MD_INDEX_BITS)     ucp_md_map_t;
 #define UCP_NULL_LANE                ((ucp_lane_index_t)-1)
 typedef uint8_t                      ucp_lane_index_t;
 UCP_UINT_TYPE(UCP_MAX_LANES)         ucp_lane_map_t;
+#define UCP_MAX_RNDV_LANES           4   /* Lanes a rendezvous can be striped on */
 
 
 /* Forward declarations */
@@ -40,6 +41,7 @@ typedef struct ucp_request              ucp_request_t;
 typedef struct ucp_address_iface_attr   ucp_address_iface_attr_t;
 typedef struct ucp_address_entry        ucp_address_entry_t;
 typedef struct ucp_stub_ep              ucp_stub_ep_t;
+typedef struct ucp_mem_rcache_region    ucp_mem_rcache_region_t;
 
 
 /**
@@ -81,6 +83,19 @@ typedef enum {
 } ucp_atomic_mode_t;
 
 
+/**
+ * Worker wait mode, used by ucp_worker_wait().
+ */
+typedef enum {
+    UCP_WAIT_MODE_SLEEP,     /* Arm the interfaces and block until an event */
+    UCP_WAIT_MODE_POLL,      /* Call progress until an event, never block */
+    UCP_WAIT_MODE_SPIN,      /* Call progress for a fixed time, then block */
+    UCP_WAIT_MODE_ADAPTIVE,  /* Call progress for a time derived from the recent
+                              * inter-arrival times of events, then block */
+    UCP_WAIT_MODE_LAST
+} ucp_wait_mode_t;
+
+
 /**
  * Active message tracer.
  */
@@ -11,11 +11,23 @@
 #include <ucp/wireup/address.h>
 #include <ucp/wireup/stub_ep.h>
 #include <ucp/tag/eager.h>
+#include <ucs/arch/atomic.h>
 #include <ucs/datastruct/mpool.inl>
 #include <ucs/type/cpu_set.h>
 #include <ucs/sys/string.h>
 
 
+/* Weight of the history in the moving average of the wait time */
+#define UCP_WORKER_WAIT_AVG_WEIGHT    8
+
+/* Maximal wait time accounted in the moving average, in units of the spin
+ * time */
+#define UCP_WORKER_WAIT_MAX_TIME      4
+
+/* Maximal number of waits without spinning after a spin which failed */
+#define UCP_WORKER_WAIT_MAX_BACKOFF   64
+
+
 #if ENABLE_STATS
 static ucs_stats_class_t ucp_worker_stats_class = {
     .name           = "ucp_worker",
@@ -26,7 +38,9 @@ static ucs_stats_class_t ucp_worker_stats_class = {
         [UCP_WORKER_STAT_TAG_RX_EAGER_CHUNK_EXP]   = "rx_eager_chunk_exp",
         [UCP_WORKER_STAT_TAG_RX_EAGER_CHUNK_UNEXP] = "rx_eager_chunk_unexp",
         [UCP_WORKER_STAT_TAG_RX_RNDV_EXP]          = "rx_rndv_rts_exp",
-        [UCP_WORKER_STAT_TAG_RX_RNDV_UNEXP]        = "rx_rndv_rts_unexp"
+        [UCP_WORKER_STAT_TAG_RX_RNDV_UNEXP]        = "rx_rndv_rts_unexp",
+        [UCP_WORKER_STAT_WAIT_SPIN]                = "wait_spin",
+        [UCP_WORKER_STAT_WAIT_SLEEP]               = "wait_sleep"
     }
 };
 #endif
@@ -130,7 +144,8 @@ static void ucp_worker_am_tracer(void *arg, uct_am_trace_type_t type,
 }
 
 static ucs_status_t ucp_worker_wakeup_context_init(ucp_worker_wakeup_t *wakeup,
-                                                   ucp_rsc_index_t num_tls)
+                                                   ucp_rsc_index_t num_tls,
+                                                   double spin_time)
 {
     ucs_status_t status;
 
@@ -140,10 +155,18 @@ static ucs_status_t ucp_worker_wakeup_context_init(ucp_worker_wakeup_t *wakeup,
         return UCS_ERR_NO_MEMORY;
     }
 
+    /* One event for each interface, and one for the signal pipe */
+    wakeup->events = ucs_malloc((num_tls + 1) * sizeof(*wakeup->events),
+                                "ucp wakeup events");
+    if (wakeup->events == NULL) {
+        status = UCS_ERR_NO_MEMORY;
+        goto free_handles;
+    }
+
     if (pipe(wakeup->wakeup_pipe) != 0) {
         ucs_error("Failed to create pipe: %m");
         status = UCS_ERR_IO_ERROR;
-        goto free_handles;
+        goto free_events;
     }
 
     status = ucs_sys_fcntl_modfl(wakeup->wakeup_pipe[0], O_NONBLOCK, 0);
@@ -158,12 +181,21 @@ static ucs_status_t ucp_worker_wakeup_context_init(ucp_worker_wakeup_t *wakeup,
         return status;
     }
 
-    wakeup->wakeup_efd = -1;
+    wakeup->wakeup_efd   = -1;
+    wakeup->num_events   = 0;
+    wakeup->num_signals  = 0;
+    wakeup->spin_time    = ucs_time_from_sec(spin_time);
+    /* Start with the longest wait which is still worth spinning for */
+    wakeup->avg_wait     = wakeup->spin_time;
+    wakeup->spin_backoff = 0;
+    wakeup->spin_skip    = 0;
     return UCS_OK;
 
 pipe_cleanup:
     close(wakeup->wakeup_pipe[0]);
     close(wakeup->wakeup_pipe[1]);
+free_events:
+    ucs_free(wakeup->events);
 free_handles:
     ucs_free(wakeup->iface_wakeups);
     return status;
@@ -191,6 +223,7 @@ static void ucp_worker_wakeup_context_cleanup(ucp_worker_wakeup_t *wakeup)
     if (wakeup->wakeup_efd != -1) {
         close(wakeup->wakeup_efd);
     }
+    ucs_free(wakeup->events);
     ucs_free(wakeup->iface_wakeups);
     close(wakeup->wakeup_pipe[0]);
     close(wakeup->wakeup_pipe[1]);
@@ -588,7 +621,8 @@ ucs_status_t ucp_worker_create(ucp_context_h context,
         goto err_free_attrs;
     }
 
-    status = ucp_worker_wakeup_context_init(&worker->wakeup, context->num_tls);
+    status = ucp_worker_wakeup_context_init(&worker->wakeup, context->num_tls,
+                                            context->config.ext.wait_spin_time);
     if (status != UCS_OK) {
         goto err_free_stats;
     }
@@ -817,16 +851,109 @@ void ucp_worker_wait_mem(ucp_worker_h worker, void *address)
    ucs_arch_wait_mem(address);
 }
 
+/* How long ucp_worker_wait() calls progress before blocking */
+static ucs_time_t ucp_worker_wait_spin_time(ucp_worker_h worker)
+{
+    ucp_worker_wakeup_t *wakeup = &worker->wakeup;
+
+    switch (worker->context->config.ext.wait_mode) {
+    case UCP_WAIT_MODE_POLL:
+    case UCP_WAIT_MODE_SPIN:
+        return wakeup->spin_time;
+    case UCP_WAIT_MODE_ADAPTIVE:
+        /* Spin only if the events used to arrive within the spin time, and
+         * allow twice the average to absorb the jitter */
+        if ((wakeup->spin_skip > 0) || (wakeup->avg_wait > wakeup->spin_time)) {
+            return 0;
+        }
+        return ucs_min(2 * wakeup->avg_wait, wakeup->spin_time);
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Update the moving average of the time until an event arrives, and back off
+ * from spinning after spins which ended without an event. Such spins may have
+ * delayed the event by themselves, e.g when the sender runs on the same CPU,
+ * so the number of waits without spinning doubles after each of them.
+ */
+static void ucp_worker_wait_update(ucp_worker_wakeup_t *wakeup,
+                                   ucs_time_t spin_time, int spin_failed,
+                                   ucs_time_t wait_time)
+{
+    if (spin_failed) {
+        wakeup->spin_backoff = ucs_min(ucs_max(2 * wakeup->spin_backoff, 1),
+                                       UCP_WORKER_WAIT_MAX_BACKOFF);
+        wakeup->spin_skip    = wakeup->spin_backoff;
+    } else if (spin_time > 0) {
+        wakeup->spin_backoff = 0;
+    } else if (wakeup->spin_skip > 0) {
+        --wakeup->spin_skip;
+    }
+
+    /* Limit a single long idle period, so a burst of events which follows it
+     * would bring the spinning back quickly */
+    wait_time        = ucs_min(wait_time,
+                               UCP_WORKER_WAIT_MAX_TIME * wakeup->spin_time);
+    wakeup->avg_wait = ((wakeup->avg_wait * (UCP_WORKER_WAIT_AVG_WEIGHT - 1)) +
+                        wait_time) / UCP_WORKER_WAIT_AVG_WEIGHT;
+}
+
+/*
+ * Call progress until it completes a request or receives a message, the worker
+ * is signaled, or the spin time expires.
+ *
+ * @return Whether an event was seen.
+ */
+static int ucp_worker_wait_spin(ucp_worker_h worker, ucs_time_t start_time,
+                                ucs_time_t spin_time)
+{
+    ucp_worker_wakeup_t *wakeup = &worker->wakeup;
+    unsigned num_events         = wakeup->num_events;
+    uint32_t num_signals        = wakeup->num_signals;
+
+    do {
+        ucp_worker_progress(worker);
+        if ((wakeup->num_events != num_events) ||
+            (wakeup->num_signals != num_signals)) {
+            return 1;
+        }
+    } while ((ucs_get_time() - start_time) < spin_time);
+
+    return 0;
+}
+
 ucs_status_t ucp_worker_wait(ucp_worker_h worker)
 {
     int res;
     int epoll_fd;
     ucs_status_t status;
-    struct epoll_event *events;
+    ucs_time_t start_time, spin_time;
     ucp_context_h context = worker->context;
 
     UCP_THREAD_CS_ENTER_CONDITIONAL(&worker->mt_lock);
 
+    start_time = ucs_get_time();
+    spin_time  = ucp_worker_wait_spin_time(worker);
+
+    if ((context->config.ext.wait_mode != UCP_WAIT_MODE_SLEEP) &&
+        ucp_worker_wait_spin(worker, start_time, spin_time)) {
+        UCS_STATS_UPDATE_COUNTER(worker->stats, UCP_WORKER_STAT_WAIT_SPIN, 1);
+        ucp_worker_wait_update(&worker->wakeup, spin_time, 0,
+                               ucs_get_time() - start_time);
+        status = UCS_OK;
+        goto out;
+    }
+
+    /* Not all events are counted, e.g wireup messages and remote memory
+     * accesses, so a poll returns after the spin time to let the caller check
+     * for them */
+    if (context->config.ext.wait_mode == UCP_WAIT_MODE_POLL) {
+        status = UCS_OK;
+        goto out;
+    }
+
     status = ucp_worker_get_efd(worker, &epoll_fd);
     if (status != UCS_OK) {
         goto out;
@@ -835,25 +962,20 @@ ucs_status_t ucp_worker_wait(ucp_worker_h worker)
     status = ucp_worker_arm(worker);
     if (UCS_ERR_BUSY == status) { /* if UCS_ERR_BUSY returned - no poll() must called */
         status = UCS_OK;
-        goto out;
+        goto out_blocked;
     } else if (status != UCS_OK) {
         goto out;
     }
 
-    events = ucs_malloc(context->num_tls * sizeof(*events), "wakeup events");
-    if (events == NULL) {
-        status = UCS_ERR_NO_MEMORY;
-        goto out;
-    }
+    UCS_STATS_UPDATE_COUNTER(worker->stats, UCP_WORKER_STAT_WAIT_SLEEP, 1);
 
     do {
         ucs_debug("epoll_wait loop with epfd %d maxevents %d timeout %d",
-                   epoll_fd, context->num_tls, -1);
-        res = epoll_wait(epoll_fd, events, context->num_tls, -1);
+                   epoll_fd, context->num_tls + 1, -1);
+        res = epoll_wait(epoll_fd, worker->wakeup.events, context->num_tls + 1,
+                         -1);
     } while ((res == -1) && (errno == EINTR));
 
-    free(events);
-
     if (res == -1) {
         ucs_error("Polling internally for events failed: %m");
         status = UCS_ERR_IO_ERROR;
@@ -861,6 +983,9 @@ ucs_status_t ucp_worker_wait(ucp_worker_h worker)
     }
 
     status = UCS_OK;
+out_blocked:
+    ucp_worker_wait_update(&worker->wakeup, spin_time, spin_time > 0,
+                           ucs_get_time() - start_time);
 out:
     UCP_THREAD_CS_EXIT_CONDITIONAL(&worker->mt_lock);
     return status;
@@ -872,6 +997,9 @@ ucs_status_t ucp_worker_signal(ucp_worker_h worker)
     int res;
     ucs_status_t status = UCS_OK;
 
+    /* Counted before taking the lock, to stop a waiter which spins with it */
+    ucs_atomic_add32(&worker->wakeup.num_signals, 1);
+
     UCP_THREAD_CS_ENTER_CONDITIONAL(&worker->mt_lock);
 
     res = write(worker->wakeup.wakeup_pipe[1], &buf, 1);
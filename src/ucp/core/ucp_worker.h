@@ -49,6 +49,10 @@ enum {
 
     UCP_WORKER_STAT_TAG_RX_RNDV_EXP,
     UCP_WORKER_STAT_TAG_RX_RNDV_UNEXP,
+
+    /* Wait */
+    UCP_WORKER_STAT_WAIT_SPIN,
+    UCP_WORKER_STAT_WAIT_SLEEP,
     UCP_WORKER_STAT_LAST
 };
 
@@ -67,6 +71,12 @@ enum {
     UCS_STATS_UPDATE_COUNTER((_worker)->stats, \
                              UCP_WORKER_STAT_TAG_RX_RNDV_##_is_exp, 1);
 
+/* Count an event which ends the spinning in ucp_worker_wait() */
+#define UCP_WORKER_WAIT_EVENT(_worker) \
+    do { \
+        ++(_worker)->wakeup.num_events; \
+    } while (0)
+
 
 /**
  * UCP worker wake-up context.
@@ -75,6 +85,14 @@ typedef struct ucp_worker_wakeup {
     int                           wakeup_efd;     /* Allocated (on-demand) epoll fd for wakeup */
     int                           wakeup_pipe[2]; /* Pipe to support signal() calls */
     uct_wakeup_h                  *iface_wakeups; /* Array of interface wake-up handles */
+    struct epoll_event            *events;        /* Array of events returned by epoll_wait() */
+    unsigned                      num_events;     /* Number of completions and arrivals */
+    volatile uint32_t             num_signals;    /* Number of signal() calls */
+    ucs_time_t                    spin_time;      /* Maximal time to spin before blocking */
+    ucs_time_t                    avg_wait;       /* Moving average of the time wait()
+                                                     takes until an event arrives */
+    unsigned                      spin_backoff;   /* Waits without spinning after a failed spin */
+    unsigned                      spin_skip;      /* Remaining waits without spinning */
 } ucp_worker_wakeup_t;
 
 
@@ -12,11 +12,21 @@
 #include "dt_iov.h"
 #include "dt_generic.h"
 
+#include <ucp/core/ucp_types.h>
 #include <uct/api/uct.h>
 #include <ucs/debug/profile.h>
 #include <string.h>
 
 
+/**
+ * Memory registration of a contiguous buffer on a single memory domain.
+ */
+typedef struct ucp_dt_reg {
+    uct_mem_h                     memh;
+    ucp_mem_rcache_region_t       *rregion; /* Cache region holding memh, or NULL */
+} ucp_dt_reg_t;
+
+
 /**
  * State of progressing sent/receive operation on a datatype.
  */
@@ -25,12 +35,18 @@ typedef struct ucp_dt_state {
     union {
         struct {
             uct_mem_h             memh;
+            ucp_mem_rcache_region_t *rregion; /* Cache region holding memh, or NULL */
+            ucp_dt_reg_t          *rndv_regs; /* Registrations for rendezvous
+                                                 lanes 1..UCP_MAX_RNDV_LANES-1,
+                                                 allocated when striping */
         } contig;
         struct {
             size_t                iov_offset;     /* Offset in the IOV item */
             size_t                iovcnt_offset;  /* The IOV item to start copy */
             size_t                iovcnt;         /* Number of IOV buffers */
-            uct_mem_h             *memh;          /* Pointer to IOV memh[iovcnt] */
+            uct_mem_h             *memh;          /* Pointer to IOV memh[iovcnt],
+                                                     followed by their registration
+                                                     cache regions rregion[iovcnt] */
         } iov;
         struct {
             void                  *state;
@@ -53,7 +53,7 @@ ucp_rma_request_advance(ucp_request_t *req, ssize_t frag_length,
                                  UCT_MEM_HANDLE_NULL)) {
                     ucp_request_send_buffer_dereg(req, req->send.lane);
                 }
-                ucp_request_complete_send(req, UCS_OK);
+                ucp_request_complete_send(req->send.ep->worker, req, UCS_OK);
             }
             return UCS_OK;
         } 
@@ -71,7 +71,7 @@ static void ucp_rma_request_bcopy_completion(uct_completion_t *self,
     ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.uct_comp);
 
     if (ucs_likely(req->send.length == 0)) {
-        ucp_request_complete_send(req, UCS_OK);
+        ucp_request_complete_send(req->send.ep->worker, req, UCS_OK);
     }
 }
 
@@ -82,14 +82,15 @@ static void ucp_rma_request_zcopy_completion(uct_completion_t *self,
 
     if (ucs_likely(req->send.length == 0)) {
         ucp_request_send_buffer_dereg(req, req->send.lane);
-        ucp_request_complete_send(req, UCS_OK);
+        ucp_request_complete_send(req->send.ep->worker, req, UCS_OK);
     }
 }
 
 static UCS_F_ALWAYS_INLINE ucs_status_t
 ucp_rma_request_init(ucp_request_t *req, ucp_ep_h ep, const void *buffer, 
                      size_t length, uint64_t remote_addr, ucp_rkey_h rkey,
-                     uct_pending_callback_t cb, size_t zcopy_thresh, int flags)
+                     uct_pending_callback_t cb, size_t zcopy_thresh, int prot,
+                     int flags)
 {
     req->flags                = flags; /* Implicit release */
     req->send.ep              = ep;
@@ -110,7 +111,7 @@ ucp_rma_request_init(ucp_request_t *req, ucp_ep_h ep, const void *buffer,
         return UCS_OK;
     } else {
         req->send.uct_comp.func        = ucp_rma_request_zcopy_completion;
-        return ucp_request_send_buffer_reg(req, req->send.lane);
+        return ucp_request_send_buffer_reg(req, req->send.lane, prot);
     }
 }
 
@@ -220,13 +221,14 @@ static ucs_status_t ucp_progress_get(uct_pending_req_t *self)
 static UCS_F_ALWAYS_INLINE ucs_status_t
 ucp_rma_blocking(ucp_ep_h ep, const void *buffer, size_t length,
                  uint64_t remote_addr, ucp_rkey_h rkey,
-                 uct_pending_callback_t progress_cb, size_t zcopy_thresh)
+                 uct_pending_callback_t progress_cb, size_t zcopy_thresh,
+                 int prot)
 {
     ucs_status_t status;
     ucp_request_t req;
 
     status = ucp_rma_request_init(&req, ep, buffer, length, remote_addr, rkey,
-                                  NULL, zcopy_thresh, 0);
+                                  NULL, zcopy_thresh, prot, 0);
     if (ucs_unlikely(status != UCS_OK)) {
         return status;
     }
@@ -256,7 +258,8 @@ ucp_rma_blocking(ucp_ep_h ep, const void *buffer, size_t length,
 static UCS_F_ALWAYS_INLINE ucs_status_t
 ucp_rma_nonblocking(ucp_ep_h ep, const void *buffer, size_t length,
                     uint64_t remote_addr, ucp_rkey_h rkey,
-                    uct_pending_callback_t progress_cb, size_t zcopy_thresh)
+                    uct_pending_callback_t progress_cb, size_t zcopy_thresh,
+                    int prot)
 {
     ucs_status_t status;
     ucp_request_t *req;
@@ -267,7 +270,7 @@ ucp_rma_nonblocking(ucp_ep_h ep, const void *buffer, size_t length,
     }
 
     status = ucp_rma_request_init(req, ep, buffer, length, remote_addr, rkey,
-                                  progress_cb, zcopy_thresh,
+                                  progress_cb, zcopy_thresh, prot,
                                   UCP_REQUEST_FLAG_RELEASED);
     if (ucs_unlikely(status != UCS_OK)) {
         return status;
@@ -314,7 +317,8 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_put, (ep, buffer, length, remote_addr, rkey),
 
     rma_config = &ucp_ep_config(ep)->rma[rkey->cache.rma_lane];
     status = ucp_rma_blocking(ep, buffer, length, remote_addr, rkey,
-                              ucp_progress_put, rma_config->put_zcopy_thresh);
+                              ucp_progress_put, rma_config->put_zcopy_thresh,
+                              PROT_READ);
 out_unlock:
     UCP_THREAD_CS_EXIT_CONDITIONAL(&ep->worker->mt_lock);
     return status;
@@ -336,8 +340,9 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_get, (ep, buffer, length, remote_addr, rkey),
     }
 
     rma_config = &ucp_ep_config(ep)->rma[rkey->cache.rma_lane];
-    status = ucp_rma_blocking(ep, buffer, length, remote_addr, rkey, 
-                              ucp_progress_get, rma_config->get_zcopy_thresh);
+    status = ucp_rma_blocking(ep, buffer, length, remote_addr, rkey,
+                              ucp_progress_get, rma_config->get_zcopy_thresh,
+                              PROT_READ|PROT_WRITE);
 out_unlock:
     UCP_THREAD_CS_EXIT_CONDITIONAL(&ep->worker->mt_lock);
     return status;
@@ -368,7 +373,8 @@ ucs_status_t ucp_put_nbi(ucp_ep_h ep, const void *buffer, size_t length,
 
     rma_config = &ucp_ep_config(ep)->rma[rkey->cache.rma_lane];
     status = ucp_rma_nonblocking(ep, buffer, length, remote_addr, rkey,
-                                 ucp_progress_put, rma_config->put_zcopy_thresh);
+                                 ucp_progress_put, rma_config->put_zcopy_thresh,
+                                 PROT_READ);
 out_unlock:
     UCP_THREAD_CS_EXIT_CONDITIONAL(&ep->worker->mt_lock);
     return status;
@@ -390,7 +396,8 @@ ucs_status_t ucp_get_nbi(ucp_ep_h ep, void *buffer, size_t length,
 
     rma_config = &ucp_ep_config(ep)->rma[rkey->cache.rma_lane];
     status = ucp_rma_nonblocking(ep, buffer, length, remote_addr, rkey,
-                         ucp_progress_get, rma_config->get_zcopy_thresh);
+                         ucp_progress_get, rma_config->get_zcopy_thresh,
+                         PROT_READ|PROT_WRITE);
 out_unlock:
     UCP_THREAD_CS_EXIT_CONDITIONAL(&ep->worker->mt_lock);
     return status;
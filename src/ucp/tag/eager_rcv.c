@@ -78,7 +78,7 @@ ucp_eager_handler(void *arg, void *data, size_t length, unsigned am_flags,
 
         /* Last fragment completes the request */
         if (flags & UCP_RECV_DESC_FLAG_LAST) {
-            ucp_request_complete_recv(req, status);
+            ucp_request_complete_recv(worker, req, status);
         } else {
             req->recv.state.offset += recv_len;
         }
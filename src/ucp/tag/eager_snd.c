@@ -132,7 +132,7 @@ static ucs_status_t ucp_tag_eager_contig_short(uct_pending_req_t *self)
         return status;
     }
 
-    ucp_request_complete_send(req, UCS_OK);
+    ucp_request_complete_send(ep->worker, req, UCS_OK);
     return UCS_OK;
 }
 
@@ -143,7 +143,7 @@ static ucs_status_t ucp_tag_eager_bcopy_single(uct_pending_req_t *self)
     if (status == UCS_OK) {
         ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.uct);
         ucp_request_send_generic_dt_finish(req);
-        ucp_request_complete_send(req, UCS_OK);
+        ucp_request_complete_send(req->send.ep->worker, req, UCS_OK);
     }
     return status;
 }
@@ -161,7 +161,7 @@ static ucs_status_t ucp_tag_eager_bcopy_multi(uct_pending_req_t *self)
     if (status == UCS_OK) {
         ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.uct);
         ucp_request_send_generic_dt_finish(req);
-        ucp_request_complete_send(req, UCS_OK);
+        ucp_request_complete_send(req->send.ep->worker, req, UCS_OK);
     }
     return status;
 }
@@ -169,7 +169,7 @@ static ucs_status_t ucp_tag_eager_bcopy_multi(uct_pending_req_t *self)
 static void ucp_tag_eager_zcopy_req_complete(ucp_request_t *req)
 {
     ucp_request_send_buffer_dereg(req, req->send.lane); /* TODO register+lane change */
-    ucp_request_complete_send(req, UCS_OK);
+    ucp_request_complete_send(req->send.ep->worker, req, UCS_OK);
 }
 
 static ucs_status_t ucp_tag_eager_zcopy_single(uct_pending_req_t *self)
@@ -229,7 +229,7 @@ void ucp_tag_eager_sync_completion(ucp_request_t *req, uint16_t flag)
     ucs_assertv(!(req->flags & flag), "req->flags=%d flag=%d", req->flags, flag);
     req->flags |= flag;
     if (ucs_test_all_flags(req->flags, all_completed)) {
-        ucp_request_complete_send(req, UCS_OK);
+        ucp_request_complete_send(req->send.ep->worker, req, UCS_OK);
     }
 }
 
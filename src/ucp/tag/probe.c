@@ -43,7 +43,7 @@ ucp_tag_probe_search(ucp_context_h context, ucp_tag_t tag, uint64_t tag_mask,
             }
 
             if (remove) {
-                ucp_tag_unexp_remove(rdesc);
+                ucp_tag_unexp_remove(&context->tm, rdesc);
             }
             return rdesc;
         }
@@ -7,57 +7,239 @@
 #include "rndv.h"
 #include "tag_match.inl"
 
+#include <ucp/core/ucp_mm.h>
 #include <ucp/proto/proto_am.inl>
 #include <ucp/core/ucp_request.inl>
 #include <ucs/datastruct/queue.h>
 
 
-static int ucp_tag_rndv_is_get_op_possible(ucp_ep_h ep, uct_rkey_t rkey)
+/*
+ * Find the key of the sender's buffer to be used on a rendezvous lane.
+ * Returns 0 if the lane cannot access the sender's buffer.
+ */
+static int ucp_rndv_get_lane_rkey(ucp_ep_h ep, ucp_rkey_h rkey,
+                                  ucp_lane_index_t lane, uct_rkey_t *uct_rkey_p)
 {
-    uint64_t md_flags;
+    uint64_t md_flags = ucp_ep_md_attr(ep, lane)->cap.flags;
+    ucp_md_map_t dst_md_mask;
 
     ucs_assert(!ucp_ep_is_stub(ep));
-    if (ucp_ep_is_rndv_lane_present(ep)) {
-        md_flags = ucp_ep_rndv_md_flags(ep);
-        return (((rkey != UCT_INVALID_RKEY) && (md_flags & UCT_MD_FLAG_REG)) ||
-                !(md_flags & UCT_MD_FLAG_NEED_RKEY));
+
+    dst_md_mask = UCS_BIT(ucp_ep_config(ep)->key.lanes[lane].dst_md_index);
+    if ((rkey != NULL) && (rkey->md_map & dst_md_mask) &&
+        (md_flags & UCT_MD_FLAG_REG)) {
+        *uct_rkey_p = rkey->uct[ucs_count_one_bits(rkey->md_map &
+                                                   (dst_md_mask - 1))].rkey;
+        return 1;
+    }
+
+    *uct_rkey_p = UCT_INVALID_RKEY;
+    return !(md_flags & UCT_MD_FLAG_NEED_RKEY);
+}
+
+static int ucp_tag_rndv_is_get_op_possible(ucp_ep_h ep, ucp_rkey_h rkey)
+{
+    uct_rkey_t uct_rkey;
+
+    return ucp_ep_is_rndv_lane_present(ep) &&
+           ucp_rndv_get_lane_rkey(ep, rkey, ucp_ep_get_rndv_get_lane(ep),
+                                  &uct_rkey);
+}
+
+static void ucp_rndv_rkey_release(ucp_request_t *rndv_req)
+{
+    if (rndv_req->send.rndv_get.rkey != NULL) {
+        ucp_rkey_destroy(rndv_req->send.rndv_get.rkey);
+        rndv_req->send.rndv_get.rkey = NULL;
+    }
+}
+
+/*
+ * Memory handle of a contiguous rendezvous request on the memory domain of a
+ * rendezvous lane. The primary lane uses the common contig state, and the
+ * others are kept out of line since only striped requests need them.
+ */
+static uct_mem_h ucp_rndv_buffer_memh(ucp_request_t *req, unsigned lane_idx)
+{
+    ucp_dt_reg_t *rndv_regs = req->send.state.dt.contig.rndv_regs;
+
+    if (lane_idx == 0) {
+        return req->send.state.dt.contig.memh;
+    } else if (rndv_regs == NULL) {
+        return UCT_MEM_HANDLE_NULL;
     } else {
-        return 0;
+        return rndv_regs[lane_idx - 1].memh;
     }
 }
 
-static void ucp_rndv_rma_request_send_buffer_dereg(ucp_request_t *sreq)
+/*
+ * Register the buffer of a contiguous rendezvous request on the memory domain
+ * of a rendezvous lane.
+ */
+static ucs_status_t ucp_rndv_buffer_reg(ucp_request_t *req, unsigned lane_idx,
+                                        int prot)
 {
-    if ((UCP_DT_IS_CONTIG(sreq->send.datatype)) &&
-        (ucp_ep_is_rndv_lane_present(sreq->send.ep))) {
-        ucp_request_send_buffer_dereg(sreq, ucp_ep_get_rndv_get_lane(sreq->send.ep));
+    ucp_ep_h ep           = req->send.ep;
+    ucp_lane_index_t lane = ucp_ep_config(ep)->key.rndv_lanes[lane_idx];
+    ucp_dt_reg_t *rndv_regs;
+    ucp_mem_rcache_region_t **rregion_p;
+    uct_mem_h *memh_p;
+    ucs_status_t status;
+    unsigned i;
+
+    ucs_assert(UCP_DT_IS_CONTIG(req->send.datatype));
+    ucs_assert(ucp_rndv_buffer_memh(req, lane_idx) == UCT_MEM_HANDLE_NULL);
+
+    if (lane_idx == 0) {
+        memh_p    = &req->send.state.dt.contig.memh;
+        rregion_p = &req->send.state.dt.contig.rregion;
+    } else {
+        rndv_regs = req->send.state.dt.contig.rndv_regs;
+        if (rndv_regs == NULL) {
+            rndv_regs = ucs_malloc(sizeof(*rndv_regs) *
+                                   (UCP_MAX_RNDV_LANES - 1), "rndv_regs");
+            if (rndv_regs == NULL) {
+                ucs_error("failed to allocate rendezvous lanes registration");
+                return UCS_ERR_NO_MEMORY;
+            }
+
+            for (i = 0; i < UCP_MAX_RNDV_LANES - 1; ++i) {
+                rndv_regs[i].memh    = UCT_MEM_HANDLE_NULL;
+                rndv_regs[i].rregion = NULL;
+            }
+            req->send.state.dt.contig.rndv_regs = rndv_regs;
+        }
+        memh_p    = &rndv_regs[lane_idx - 1].memh;
+        rregion_p = &rndv_regs[lane_idx - 1].rregion;
+    }
+
+    status = ucp_mem_buffer_reg(ep->worker->context, ucp_ep_md_index(ep, lane),
+                                (void*)req->send.buffer, req->send.length, prot,
+                                memh_p, rregion_p);
+    if (status != UCS_OK) {
+        ucs_error("failed to register rendezvous buffer [address=%p len=%zu "
+                  "md=\"%s\"]: %s", req->send.buffer, req->send.length,
+                  ucp_ep_md_attr(ep, lane)->component_name,
+                  ucs_status_string(status));
+    }
+    return status;
+}
+
+static void ucp_rndv_buffer_lane_dereg(ucp_request_t *req, unsigned lane_idx,
+                                       uct_mem_h *memh_p,
+                                       ucp_mem_rcache_region_t *rregion)
+{
+    ucp_ep_h ep = req->send.ep;
+    ucp_lane_index_t lane;
+
+    if (*memh_p == UCT_MEM_HANDLE_NULL) {
+        return;
     }
+
+    lane = ucp_ep_config(ep)->key.rndv_lanes[lane_idx];
+    ucs_assert(lane != UCP_NULL_LANE);
+    ucp_mem_buffer_dereg(ep->worker->context, ucp_ep_md_index(ep, lane),
+                         *memh_p, rregion);
+    *memh_p = UCT_MEM_HANDLE_NULL;
 }
 
+static void ucp_rndv_buffer_dereg(ucp_request_t *req)
+{
+    ucp_dt_reg_t *rndv_regs;
+    unsigned lane_idx;
+
+    if (!UCP_DT_IS_CONTIG(req->send.datatype)) {
+        return;
+    }
+
+    ucp_rndv_buffer_lane_dereg(req, 0, &req->send.state.dt.contig.memh,
+                               req->send.state.dt.contig.rregion);
+
+    rndv_regs = req->send.state.dt.contig.rndv_regs;
+    if (rndv_regs == NULL) {
+        return;
+    }
+
+    for (lane_idx = 1; lane_idx < UCP_MAX_RNDV_LANES; ++lane_idx) {
+        ucp_rndv_buffer_lane_dereg(req, lane_idx, &rndv_regs[lane_idx - 1].memh,
+                                   rndv_regs[lane_idx - 1].rregion);
+    }
+    ucs_free(rndv_regs);
+    req->send.state.dt.contig.rndv_regs = NULL;
+}
+
+static void ucp_rndv_buffer_reset(ucp_request_t *req)
+{
+    req->send.state.dt.contig.memh      = UCT_MEM_HANDLE_NULL;
+    req->send.state.dt.contig.rregion   = NULL;
+    req->send.state.dt.contig.rndv_regs = NULL;
+}
+
+/*
+ * Pack the keys of the send buffer for every memory domain of the rendezvous
+ * lanes which requires them, in the format of ucp_rkey_pack().
+ */
 static size_t ucp_tag_rndv_pack_rkey(ucp_request_t *sreq,
                                      ucp_rndv_rts_hdr_t *rndv_rts_hdr)
 {
-    ucp_ep_h ep = sreq->send.ep;
-    size_t packed_rkey = 0;
+    ucp_ep_h ep             = sreq->send.ep;
+    ucp_ep_config_t *config = ucp_ep_config(ep);
+    ucp_md_map_t md_map     = 0;
+    const uct_md_attr_t *md_attr;
+    ucp_md_index_t md_index;
+    ucp_lane_index_t lane;
+    unsigned lane_idx;
     ucs_status_t status;
+    void *p;
 
     ucs_assert(UCP_DT_IS_CONTIG(sreq->send.datatype));
 
     /* Check if the sender needs to register the send buffer -
      * is its datatype contiguous and does the receive side need it */
-    if ((ucp_ep_is_rndv_lane_present(ep)) &&
-        (ucp_ep_rndv_md_flags(ep) & UCT_MD_FLAG_NEED_RKEY)) {
-        status = ucp_request_send_buffer_reg(sreq, ucp_ep_get_rndv_get_lane(ep));
+    for (lane_idx = 0; lane_idx < UCP_MAX_RNDV_LANES; ++lane_idx) {
+        lane = config->key.rndv_lanes[lane_idx];
+        if (lane == UCP_NULL_LANE) {
+            break;
+        }
+        if (ucp_ep_md_attr(ep, lane)->cap.flags & UCT_MD_FLAG_NEED_RKEY) {
+            md_map |= UCS_BIT(ucp_ep_md_index(ep, lane));
+        }
+    }
+
+    if (md_map == 0) {
+        return 0;
+    }
+
+    *(ucp_md_map_t*)(rndv_rts_hdr + 1) = md_map;
+    p = (ucp_md_map_t*)(rndv_rts_hdr + 1) + 1;
+
+    /* the rkeys are packed by ascending md index, each one from the buffer
+     * registration on the first lane which uses this md */
+    for (md_index = 0; md_index < ep->worker->context->num_mds; ++md_index) {
+        if (!(md_map & UCS_BIT(md_index))) {
+            continue;
+        }
+
+        lane_idx = 0;
+        while (ucp_ep_md_index(ep, config->key.rndv_lanes[lane_idx]) != md_index) {
+            ++lane_idx;
+        }
+
+        status = ucp_rndv_buffer_reg(sreq, lane_idx, PROT_READ);
         ucs_assert_always(status == UCS_OK);
 
         /* if the send buffer was registered, send the rkey */
-        UCS_PROFILE_CALL(uct_md_mkey_pack, ucp_ep_md(ep, ucp_ep_get_rndv_get_lane(ep)),
-                         sreq->send.state.dt.contig.memh, rndv_rts_hdr + 1);
-        rndv_rts_hdr->flags |= UCP_RNDV_RTS_FLAG_PACKED_RKEY;
-        packed_rkey = ucp_ep_md_attr(ep, ucp_ep_get_rndv_get_lane(ep))->rkey_packed_size;
+        lane    = config->key.rndv_lanes[lane_idx];
+        md_attr = ucp_ep_md_attr(ep, lane);
+        ucs_assert_always(md_attr->rkey_packed_size < UINT8_MAX);
+        *(uint8_t*)p++ = md_attr->rkey_packed_size;
+        UCS_PROFILE_CALL(uct_md_mkey_pack, ucp_ep_md(ep, lane),
+                         ucp_rndv_buffer_memh(sreq, lane_idx), p);
+        p += md_attr->rkey_packed_size;
     }
 
-    return packed_rkey;
+    rndv_rts_hdr->flags |= UCP_RNDV_RTS_FLAG_PACKED_RKEY;
+    return p - (void*)(rndv_rts_hdr + 1);
 }
 
 static size_t ucp_tag_rndv_rts_pack(void *dest, void *arg)
@@ -129,7 +311,7 @@ void ucp_tag_send_start_rndv(ucp_request_t *sreq)
     ucp_ep_connect_remote(sreq->send.ep);
 
     if (UCP_DT_IS_CONTIG(sreq->send.datatype)) {
-        sreq->send.state.dt.contig.memh = UCT_MEM_HANDLE_NULL;
+        ucp_rndv_buffer_reset(sreq);
     }
 
     sreq->send.uct.func = ucp_proto_progress_rndv_rts;
@@ -162,13 +344,10 @@ static void ucp_rndv_complete_rndv_get(ucp_request_t *rndv_req)
     ucs_trace_data("ep: %p rndv get completed", rndv_req->send.ep);
 
     UCS_PROFILE_REQUEST_EVENT(rreq, "complete_rndv_get", 0); // TODO
-    ucp_request_complete_recv(rreq, UCS_OK);
-
-    if (rndv_req->send.rndv_get.rkey_bundle.rkey != UCT_INVALID_RKEY) {
-        uct_rkey_release(&rndv_req->send.rndv_get.rkey_bundle);
-    }
+    ucp_request_complete_recv(rndv_req->send.ep->worker, rreq, UCS_OK);
 
-    ucp_rndv_rma_request_send_buffer_dereg(rndv_req);
+    ucp_rndv_rkey_release(rndv_req);
+    ucp_rndv_buffer_dereg(rndv_req);
 
     ucp_rndv_send_ats(rndv_req, rndv_req->send.rndv_get.remote_request);
 }
@@ -181,7 +360,8 @@ static ucs_status_t ucp_rndv_truncated(uct_pending_req_t *self)
     /* if the recv request has a generic datatype, need to finish it */
     ucp_request_recv_generic_dt_finish(rreq);
 
-    ucp_request_complete_recv(rreq, UCS_ERR_MESSAGE_TRUNCATED);
+    ucp_request_complete_recv(rndv_req->send.ep->worker, rreq,
+                              UCS_ERR_MESSAGE_TRUNCATED);
     ucp_rndv_send_ats(rndv_req, rndv_req->send.proto.remote_request);
 
     return UCS_OK;
@@ -209,97 +389,178 @@ static void ucp_rndv_recv_am(ucp_request_t *rndv_req, ucp_request_t *rreq,
     }
 }
 
+/*
+ * The message is fetched in contiguous stripes, one for every rendezvous lane
+ * which can access the sender's buffer, with sizes proportional to the lanes'
+ * bandwidth. Find the stripe which contains the given offset.
+ *
+ * @return Index of the stripe's lane in the rendezvous lanes array.
+ */
+static unsigned ucp_rndv_get_stripe(ucp_request_t *rndv_req, size_t offset,
+                                    size_t *start_p, size_t *end_p,
+                                    uct_rkey_t *uct_rkey_p)
+{
+    ucp_ep_h ep             = rndv_req->send.ep;
+    ucp_ep_config_t *config = ucp_ep_config(ep);
+    size_t length           = rndv_req->send.length;
+    uct_rkey_t uct_rkeys[UCP_MAX_RNDV_LANES];
+    double bandwidth[UCP_MAX_RNDV_LANES];
+    double total_bandwidth, prefix_bandwidth;
+    unsigned lane_idx, last_idx;
+    ucp_lane_index_t lane;
+    size_t start, end;
+
+    total_bandwidth = 0;
+    last_idx        = 0;
+    for (lane_idx = 0; lane_idx < UCP_MAX_RNDV_LANES; ++lane_idx) {
+        lane = config->key.rndv_lanes[lane_idx];
+        if (lane == UCP_NULL_LANE) {
+            break;
+        }
+
+        if (ucp_rndv_get_lane_rkey(ep, rndv_req->send.rndv_get.rkey, lane,
+                                   &uct_rkeys[lane_idx])) {
+            bandwidth[lane_idx] = ucs_max(ucp_ep_get_iface_attr(ep, lane)->bandwidth,
+                                          1.0);
+            total_bandwidth    += bandwidth[lane_idx];
+            last_idx            = lane_idx;
+        } else {
+            bandwidth[lane_idx] = 0;
+        }
+    }
+
+    /* the last usable lane takes the remainder of the message */
+    start            = 0;
+    end              = length;
+    prefix_bandwidth = 0;
+    for (lane_idx = 0; lane_idx < last_idx; ++lane_idx) {
+        if (bandwidth[lane_idx] == 0) {
+            continue;
+        }
+
+        prefix_bandwidth += bandwidth[lane_idx];
+        end               = length * (prefix_bandwidth / total_bandwidth);
+        if (offset < end) {
+            break;
+        }
+        start             = end;
+    }
+
+    *start_p    = start;
+    *end_p      = (lane_idx == last_idx) ? length : end;
+    *uct_rkey_p = uct_rkeys[lane_idx];
+    return lane_idx;
+}
+
 UCS_PROFILE_FUNC(ucs_status_t, ucp_proto_progress_rndv_get_zcopy, (self),
                  uct_pending_req_t *self)
 {
     ucp_request_t *rndv_req = ucs_container_of(self, ucp_request_t, send.uct);
+    ucp_ep_h ep             = rndv_req->send.ep;
+    size_t offset, length, stripe_start, stripe_end, ucp_mtu, align;
+    uct_iface_attr_t *iface_attr;
+    uct_rkey_t uct_rkey;
+    unsigned lane_idx;
     ucs_status_t status;
-    size_t offset, length, ucp_mtu, align;
     uct_iov_t iov[1];
-    ucp_rsc_index_t rsc_index;
 
-    if (ucp_ep_is_stub(rndv_req->send.ep)) {
+    if (ucp_ep_is_stub(ep)) {
         return UCS_ERR_NO_RESOURCE;
     }
 
-    if (!(ucp_tag_rndv_is_get_op_possible(rndv_req->send.ep,
-                                          rndv_req->send.rndv_get.rkey_bundle.rkey))) {
-        /* can't perform get_zcopy - switch to AM rndv */
+    if (!(ucp_tag_rndv_is_get_op_possible(ep, rndv_req->send.rndv_get.rkey))) {
+        /* can't perform get_zcopy - switch to AM rndv. the rkey is released
+         * first, since the AM rndv state overwrites it */
+        ucp_rndv_rkey_release(rndv_req);
         ucp_rndv_recv_am(rndv_req, rndv_req->send.rndv_get.rreq,
                          rndv_req->send.rndv_get.remote_request,
                          rndv_req->send.length);
-
-        if (rndv_req->send.rndv_get.rkey_bundle.rkey != UCT_INVALID_RKEY) {
-            uct_rkey_release(&rndv_req->send.rndv_get.rkey_bundle);
-        }
         return UCS_INPROGRESS;
     }
 
-    /* reset the lane to rndv since it might have been set to 0 since it was stub on RTS receive */
-    rndv_req->send.lane = ucp_ep_get_rndv_get_lane(rndv_req->send.ep);
-    rsc_index = ucp_ep_get_rsc_index(rndv_req->send.ep, rndv_req->send.lane);
-    align     = rndv_req->send.ep->worker->iface_attrs[rsc_index].cap.get.opt_zcopy_align;
-    ucp_mtu   = rndv_req->send.ep->worker->iface_attrs[rsc_index].cap.get.align_mtu;
+    /* select the lane of the next fragment. this also resets the lane to rndv
+     * since it might have been set to 0 since it was stub on RTS receive */
+    offset              = rndv_req->send.state.offset;
+    lane_idx            = ucp_rndv_get_stripe(rndv_req, offset, &stripe_start,
+                                              &stripe_end, &uct_rkey);
+    rndv_req->send.lane = ucp_ep_config(ep)->key.rndv_lanes[lane_idx];
+    iface_attr          = ucp_ep_get_iface_attr(ep, rndv_req->send.lane);
+    align               = iface_attr->cap.get.opt_zcopy_align;
+    ucp_mtu             = iface_attr->cap.get.align_mtu;
 
-    ucs_trace_data("ep: %p try to progress get_zcopy for rndv get. rndv_req: %p. lane: %d",
-                   rndv_req->send.ep, rndv_req, rndv_req->send.lane);
+    ucs_trace_data("ep: %p try to progress get_zcopy for rndv get. rndv_req: %p. "
+                   "lane: %d stripe: [%zu..%zu)", ep, rndv_req,
+                   rndv_req->send.lane, stripe_start, stripe_end);
 
     /* rndv_req is the internal request to perform the get operation */
-    if (rndv_req->send.state.dt.contig.memh == UCT_MEM_HANDLE_NULL) {
+    if (ucp_rndv_buffer_memh(rndv_req, lane_idx) == UCT_MEM_HANDLE_NULL) {
         /* TODO Not all UCTs need registration on the recv side */
         UCS_PROFILE_REQUEST_EVENT(rndv_req->send.rndv_get.rreq, "rndv_recv_reg", 0);
-        status = ucp_request_send_buffer_reg(rndv_req, rndv_req->send.lane);
+        status = ucp_rndv_buffer_reg(rndv_req, lane_idx, PROT_READ|PROT_WRITE);
         ucs_assert_always(status == UCS_OK);
     }
 
-    offset = rndv_req->send.state.offset;
-
-    if ((offset == 0) && ((uintptr_t)rndv_req->send.buffer % align) &&
-        (rndv_req->send.length > ucp_mtu )) {
-        length = ucp_mtu - ((uintptr_t)rndv_req->send.buffer % align);
+    if ((offset == stripe_start) &&
+        ((uintptr_t)(rndv_req->send.buffer + offset) % align) &&
+        (stripe_end - offset > ucp_mtu)) {
+        length = ucp_mtu - ((uintptr_t)(rndv_req->send.buffer + offset) % align);
     } else {
-        length = ucs_min(rndv_req->send.length - offset,
-                         ucp_ep_config(rndv_req->send.ep)->rndv.max_get_zcopy);
+        length = ucs_min(stripe_end - offset, iface_attr->cap.get.max_zcopy);
     }
 
     ucs_trace_data("offset %zu remainder %zu. read to %p len %zu",
-                   offset, (uintptr_t)rndv_req->send.buffer % align,
+                   offset, (uintptr_t)(rndv_req->send.buffer + offset) % align,
                    (void*)rndv_req->send.buffer + offset, length);
 
     iov[0].buffer = (void*)rndv_req->send.buffer + offset;
     iov[0].length = length;
-    iov[0].memh   = rndv_req->send.state.dt.contig.memh;
+    iov[0].memh   = ucp_rndv_buffer_memh(rndv_req, lane_idx);
     iov[0].count  = 1;
     iov[0].stride = 0;
     rndv_req->send.uct_comp.count++;
-    status = uct_ep_get_zcopy(ucp_ep_get_rndv_data_uct_ep(rndv_req->send.ep),
-                              iov, 1,
+    status = uct_ep_get_zcopy(ep->uct_eps[rndv_req->send.lane], iov, 1,
                               rndv_req->send.rndv_get.remote_address + offset,
-                              rndv_req->send.rndv_get.rkey_bundle.rkey,
-                              &rndv_req->send.uct_comp);
+                              uct_rkey, &rndv_req->send.uct_comp);
 
     if ((status == UCS_OK) || (status == UCS_INPROGRESS)) {
         UCS_PROFILE_REQUEST_EVENT(rndv_req->send.rndv_get.rreq, "rndv_get_zcopy",
                                   iov[0].length);
+        if (status == UCS_OK) {
+            /* if the zcopy operation was locally-completed, the uct_comp callback
+             * won't be called, so do the completion procedure here */
+            rndv_req->send.uct_comp.count--;
+        }
         rndv_req->send.state.offset += length;
         if (rndv_req->send.state.offset == rndv_req->send.length) {
-            rndv_req->send.uct_comp.count--; /* sent all fragments */
-            if (status == UCS_OK) {
-                /* if the zcopy operation was locally-completed, the uct_comp callback
-                 * won't be called, so do the completion procedure here */
-                rndv_req->send.uct_comp.count--;
-            }
-            if (rndv_req->send.uct_comp.count == 0) {
+            /* sent all fragments, the stripes on other lanes may still be
+             * in progress */
+            if (--rndv_req->send.uct_comp.count == 0) {
                 ucp_rndv_complete_rndv_get(rndv_req);
             }
             return UCS_OK;
         } else {
             return UCS_INPROGRESS;
         }
-    } else {
-       rndv_req->send.uct_comp.count--;
-       return status;
     }
+
+    rndv_req->send.uct_comp.count--;
+    if ((status != UCS_ERR_NO_RESOURCE) &&
+        (rndv_req->send.state.offset == 0)) {
+        /* the transport can't read the sender's memory, for example CMA which
+         * is not allowed to access the peer process. nothing was fetched yet,
+         * so switch to AM rndv */
+        ucs_debug("ep %p: rndv get_zcopy on lane %d failed: %s, switching "
+                  "to AM rndv", ep, rndv_req->send.lane,
+                  ucs_status_string(status));
+        ucp_rndv_buffer_dereg(rndv_req);
+        ucp_rndv_rkey_release(rndv_req);
+        ucp_rndv_recv_am(rndv_req, rndv_req->send.rndv_get.rreq,
+                         rndv_req->send.rndv_get.remote_request,
+                         rndv_req->send.length);
+        return UCS_INPROGRESS;
+    }
+
+    return status;
 }
 
 UCS_PROFILE_FUNC_VOID(ucp_rndv_get_completion, (self, status),
@@ -314,6 +575,8 @@ UCS_PROFILE_FUNC_VOID(ucp_rndv_get_completion, (self, status),
 static void ucp_rndv_handle_recv_contig(ucp_request_t *rndv_req, ucp_request_t *rreq,
                                         ucp_rndv_rts_hdr_t *rndv_rts_hdr)
 {
+    ucs_status_t status;
+
     ucs_trace_req("ucp_rndv_handle_recv_contig rndv_req %p rreq %p", rndv_req,
                   rreq);
 
@@ -335,8 +598,14 @@ static void ucp_rndv_handle_recv_contig(ucp_request_t *rndv_req, ucp_request_t *
         rndv_req->send.proto.rreq_ptr       = (uintptr_t) rreq;
     } else {
         if (rndv_rts_hdr->flags & UCP_RNDV_RTS_FLAG_PACKED_RKEY) {
-            UCS_PROFILE_CALL(uct_rkey_unpack, rndv_rts_hdr + 1,
-                             &rndv_req->send.rndv_get.rkey_bundle);
+            /* the ep may still be a stub, so unpack the keys for all remote
+             * mds and match them to the lanes when the data is fetched */
+            status = UCS_PROFILE_CALL(ucp_rkey_unpack_mds, rndv_rts_hdr + 1,
+                                      (ucp_md_map_t)-1,
+                                      &rndv_req->send.rndv_get.rkey);
+            if (status != UCS_OK) {
+                rndv_req->send.rndv_get.rkey = NULL;
+            }
         }
         rndv_req->send.length         = rndv_rts_hdr->size;
         rndv_req->send.uct_comp.func  = ucp_rndv_get_completion;
@@ -344,7 +613,7 @@ static void ucp_rndv_handle_recv_contig(ucp_request_t *rndv_req, ucp_request_t *
                                               until all fragments are sent */
         rndv_req->send.state.offset   = 0;
         rndv_req->send.lane           = ucp_ep_get_rndv_get_lane(rndv_req->send.ep);
-        rndv_req->send.state.dt.contig.memh = UCT_MEM_HANDLE_NULL;
+        ucp_rndv_buffer_reset(rndv_req);
     }
     ucp_request_start_send(rndv_req);
 }
@@ -381,7 +650,7 @@ UCS_PROFILE_FUNC_VOID(ucp_rndv_matched, (worker, rreq, rndv_rts_hdr),
      * operation, send "ATS" and "RTR") */
     rndv_req = ucp_worker_allocate_reply(worker, rndv_rts_hdr->sreq.sender_uuid);
     ep = rndv_req->send.ep;
-    rndv_req->send.rndv_get.rkey_bundle.rkey = UCT_INVALID_RKEY;
+    rndv_req->send.rndv_get.rkey = NULL;
     rndv_req->send.datatype = rreq->recv.datatype;
 
     ucs_trace_req("ucp_rndv_matched remote_address 0x%"PRIx64" remote_req 0x%lx "
@@ -452,14 +721,15 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_ats_handler,
                  (arg, data, length, flags),
                  void *arg, void *data, size_t length, unsigned flags)
 {
+    ucp_worker_h worker = arg;
     ucp_reply_hdr_t *rep_hdr = data;
     ucp_request_t *sreq = (ucp_request_t*) rep_hdr->reqptr;
 
     /* dereg the original send request and set it to complete */
     UCS_PROFILE_REQUEST_EVENT(sreq, "rndv_ats_recv", 0);
-    ucp_rndv_rma_request_send_buffer_dereg(sreq);
+    ucp_rndv_buffer_dereg(sreq);
     ucp_request_send_generic_dt_finish(sreq);
-    ucp_request_complete_send(sreq, UCS_OK);
+    ucp_request_complete_send(worker, sreq, UCS_OK);
     return UCS_OK;
 }
 
@@ -538,7 +808,7 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_progress_bcopy_send, (self),
     }
     if (status == UCS_OK) {
         ucp_request_send_generic_dt_finish(sreq);
-        ucp_request_complete_send(sreq, UCS_OK);
+        ucp_request_complete_send(ep->worker, sreq, UCS_OK);
     }
 
     return status;
@@ -547,7 +817,7 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_progress_bcopy_send, (self),
 static void ucp_rndv_zcopy_req_complete(ucp_request_t *req)
 {
     ucp_request_send_buffer_dereg(req, ucp_ep_get_am_lane(req->send.ep));
-    ucp_request_complete_send(req, UCS_OK);
+    ucp_request_complete_send(req->send.ep->worker, req, UCS_OK);
 }
 
 static void ucp_rndv_contig_zcopy_completion(uct_completion_t *self,
@@ -586,17 +856,27 @@ static ucs_status_t ucp_rndv_zcopy_multi(uct_pending_req_t *self)
 
 static void ucp_rndv_prepare_zcopy_send_buffer(ucp_request_t *sreq, ucp_ep_h ep)
 {
+    uct_mem_h am_memh                   = UCT_MEM_HANDLE_NULL;
+    ucp_mem_rcache_region_t *am_rregion = NULL;
     ucs_status_t status;
 
+    /* keep the registration of the primary rendezvous lane if it's also the
+     * AM lane, and dereg all others since we are going to send on the AM lane
+     * next */
     if ((ucp_ep_is_rndv_lane_present(ep)) &&
-        (ucp_ep_get_am_lane(ep) != ucp_ep_get_rndv_get_lane(ep))) {
-        /* dereg the original send request since we are going to send on the AM lane next */
-        ucp_rndv_rma_request_send_buffer_dereg(sreq);
+        (ucp_ep_get_am_lane(ep) == ucp_ep_get_rndv_get_lane(ep))) {
+        am_memh    = sreq->send.state.dt.contig.memh;
+        am_rregion = sreq->send.state.dt.contig.rregion;
         sreq->send.state.dt.contig.memh = UCT_MEM_HANDLE_NULL;
     }
+    ucp_rndv_buffer_dereg(sreq);
+    sreq->send.state.dt.contig.memh    = am_memh;
+    sreq->send.state.dt.contig.rregion = am_rregion;
+
     if (sreq->send.state.dt.contig.memh == UCT_MEM_HANDLE_NULL) {
         /* register the send buffer for the zcopy operation */
-        status = ucp_request_send_buffer_reg(sreq, ucp_ep_get_am_lane(ep));
+        status = ucp_request_send_buffer_reg(sreq, ucp_ep_get_am_lane(ep),
+                                             PROT_READ);
         ucs_assert_always(status == UCS_OK);
     }
 }
@@ -640,7 +920,7 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_rtr_handler,
     } else {
         /* send with bcopy */
         /* deregister the sender's buffer if it was registered */
-        ucp_rndv_rma_request_send_buffer_dereg(sreq);
+        ucp_rndv_buffer_dereg(sreq);
 
         sreq->send.uct.func = ucp_rndv_progress_bcopy_send;
     }
@@ -703,7 +983,7 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_data_last_handler,
                            rreq->recv.length, &rreq->recv.state,
                            data + hdr_len, recv_len, 1);
 
-    ucp_request_complete_recv(rreq, status);
+    ucp_request_complete_recv((ucp_worker_h)arg, rreq, status);
 
     return UCS_OK;
 }
@@ -26,7 +26,8 @@ typedef struct {
     uint64_t                  address;  /* holds the address of the data buffer on the sender's side */
     size_t                    size;     /* size of the data for sending */
     uint16_t                  flags;
-    /* packed rkeys follow */
+    /* packed rkeys follow, in the format of ucp_rkey_pack(): a map of the
+     * sender's memory domains, and [size][rkey] for each of them */
 } UCS_S_PACKED ucp_rndv_rts_hdr_t;
 
 /*
@@ -7,41 +7,220 @@
 #include "tag_match.inl"
 
 
-ucs_status_t ucp_tag_match_init(ucp_tag_match_t *tm)
+#if ENABLE_STATS
+static ucs_stats_class_t ucp_tag_match_stats_class = {
+    .name           = "ucp_tag_match",
+    .num_counters   = UCP_TAG_MATCH_STAT_LAST,
+    .counter_names  = {
+        [UCP_TAG_MATCH_STAT_EXP_BUCKETS]     = "exp_buckets",
+        [UCP_TAG_MATCH_STAT_EXP_ENTRIES]     = "exp_entries",
+        [UCP_TAG_MATCH_STAT_UNEXP_BUCKETS]   = "unexp_buckets",
+        [UCP_TAG_MATCH_STAT_UNEXP_ENTRIES]   = "unexp_entries",
+        [UCP_TAG_MATCH_STAT_EXP_SEARCH]      = "exp_search",
+        [UCP_TAG_MATCH_STAT_EXP_COMPARE]     = "exp_compare",
+        [UCP_TAG_MATCH_STAT_UNEXP_SEARCH]    = "unexp_search",
+        [UCP_TAG_MATCH_STAT_UNEXP_COMPARE]   = "unexp_compare",
+        [UCP_TAG_MATCH_STAT_EXP_GROW]        = "exp_grow",
+        [UCP_TAG_MATCH_STAT_UNEXP_GROW]      = "unexp_grow"
+    }
+};
+#endif
+
+/* Initial size of the wildcard masks array */
+#define UCP_TAG_MATCH_INIT_MASKS    4
+
+
+static ucs_queue_head_t* ucp_tag_exp_hash_alloc(size_t hash_size,
+                                                const char *name)
 {
-    size_t hash_size, bucket;
+    ucs_queue_head_t *hash;
+    size_t bucket;
 
-    hash_size = ucs_roundup_pow2(UCP_TAG_MATCH_HASH_SIZE);
+    hash = ucs_malloc(sizeof(*hash) * hash_size, name);
+    if (hash == NULL) {
+        return NULL;
+    }
 
-    tm->expected.sn   = 0;
-    ucs_queue_head_init(&tm->expected.wildcard);
+    for (bucket = 0; bucket < hash_size; ++bucket) {
+        ucs_queue_head_init(&hash[bucket]);
+    }
+    return hash;
+}
+
+static ucs_list_link_t* ucp_tag_unexp_hash_alloc(size_t hash_size)
+{
+    ucs_list_link_t *hash;
+    size_t bucket;
+
+    hash = ucs_malloc(sizeof(*hash) * hash_size, "ucp_tm_unexp_hash");
+    if (hash == NULL) {
+        return NULL;
+    }
+
+    for (bucket = 0; bucket < hash_size; ++bucket) {
+        ucs_list_head_init(&hash[bucket]);
+    }
+    return hash;
+}
+
+ucs_status_t ucp_tag_match_init(ucp_tag_match_t *tm
+                                UCS_STATS_ARG(ucs_stats_node_t *stats_parent))
+{
+    ucs_status_t status;
+
+    UCS_STATIC_ASSERT(ucs_is_pow2_or_zero(UCP_TAG_MATCH_HASH_SIZE));
+
+    tm->expected.sn          = 0;
+    tm->expected.count       = 0;
+    tm->expected.hash_mask   = UCP_TAG_MATCH_HASH_SIZE - 1;
+    tm->unexpected.count     = 0;
+    tm->unexpected.hash_mask = UCP_TAG_MATCH_HASH_SIZE - 1;
+    tm->expected.num_masks   = 0;
+    tm->expected.max_masks = UCP_TAG_MATCH_INIT_MASKS;
     ucs_list_head_init(&tm->unexpected.all);
 
-    tm->expected.hash = ucs_malloc(sizeof(*tm->expected.hash) * hash_size,
-                                   "ucp_tm_exp_hash");
+    status = UCS_STATS_NODE_ALLOC(&tm->stats, &ucp_tag_match_stats_class,
+                                  stats_parent, "-%p", tm);
+    if (status != UCS_OK) {
+        goto err;
+    }
+
+    status = UCS_ERR_NO_MEMORY;
+
+    tm->expected.hash = ucp_tag_exp_hash_alloc(UCP_TAG_MATCH_HASH_SIZE,
+                                               "ucp_tm_exp_hash");
     if (tm->expected.hash == NULL) {
-        return UCS_ERR_NO_MEMORY;
+        goto err_free_stats;
     }
 
-    tm->unexpected.hash = ucs_malloc(sizeof(*tm->unexpected.hash) * hash_size,
-                                     "ucp_tm_unexp_hash");
-    if (tm->unexpected.hash == NULL) {
-        ucs_free(tm->expected.hash);
-        return UCS_ERR_NO_MEMORY;
+    tm->expected.wildcard = ucp_tag_exp_hash_alloc(UCP_TAG_MATCH_HASH_SIZE,
+                                                   "ucp_tm_exp_wildcard");
+    if (tm->expected.wildcard == NULL) {
+        goto err_free_exp_hash;
     }
 
-    for (bucket = 0; bucket < hash_size; ++bucket) {
-        ucs_queue_head_init(&tm->expected.hash[bucket]);
-        ucs_list_head_init(&tm->unexpected.hash[bucket]);
+    tm->expected.masks = ucs_malloc(sizeof(*tm->expected.masks) *
+                                    tm->expected.max_masks, "ucp_tm_exp_masks");
+    if (tm->expected.masks == NULL) {
+        goto err_free_exp_wildcard;
+    }
+
+    tm->unexpected.hash = ucp_tag_unexp_hash_alloc(UCP_TAG_MATCH_HASH_SIZE);
+    if (tm->unexpected.hash == NULL) {
+        goto err_free_exp_masks;
     }
 
+    UCS_STATS_SET_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_BUCKETS,
+                          UCP_TAG_MATCH_HASH_SIZE);
+    UCS_STATS_SET_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_UNEXP_BUCKETS,
+                          UCP_TAG_MATCH_HASH_SIZE);
     return UCS_OK;
+
+err_free_exp_masks:
+    ucs_free(tm->expected.masks);
+err_free_exp_wildcard:
+    ucs_free(tm->expected.wildcard);
+err_free_exp_hash:
+    ucs_free(tm->expected.hash);
+err_free_stats:
+    UCS_STATS_NODE_FREE(tm->stats);
+err:
+    return status;
 }
 
 void ucp_tag_match_cleanup(ucp_tag_match_t *tm)
 {
     ucs_free(tm->unexpected.hash);
+    ucs_free(tm->expected.masks);
+    ucs_free(tm->expected.wildcard);
     ucs_free(tm->expected.hash);
+    UCS_STATS_NODE_FREE(tm->stats);
+}
+
+/**
+ * Move the requests of every bucket of an expected hash table to a table with
+ * twice the buckets. Every old bucket is split to two new ones, and the
+ * requests keep their relative order, which is the order of matching.
+ */
+static void ucp_tag_exp_rehash(ucp_tag_match_t *tm, ucs_queue_head_t *old_hash,
+                               ucs_queue_head_t *new_hash, size_t old_size)
+{
+    ucs_queue_head_t *queue;
+    ucp_request_t *req;
+    size_t bucket;
+
+    for (bucket = 0; bucket < old_size; ++bucket) {
+        ucs_queue_for_each_extract(req, &old_hash[bucket], recv.queue, 1) {
+            queue = ucp_tag_exp_get_req_queue(tm, req);
+            ucs_assert((queue == &new_hash[bucket]) ||
+                       (queue == &new_hash[bucket + old_size]));
+            ucs_queue_push(queue, &req->recv.queue);
+        }
+    }
+}
+
+void ucp_tag_exp_grow(ucp_tag_match_t *tm)
+{
+    size_t old_size = tm->expected.hash_mask + 1;
+    ucs_queue_head_t *old_hash, *old_wildcard;
+
+    old_hash              = tm->expected.hash;
+    old_wildcard          = tm->expected.wildcard;
+    tm->expected.hash     = ucp_tag_exp_hash_alloc(old_size * 2, "ucp_tm_exp_hash");
+    tm->expected.wildcard = ucp_tag_exp_hash_alloc(old_size * 2,
+                                                   "ucp_tm_exp_wildcard");
+    if ((tm->expected.hash == NULL) || (tm->expected.wildcard == NULL)) {
+        /* not fatal, keep matching with the current tables */
+        ucs_debug("failed to grow expected hash to %zu buckets", old_size * 2);
+        ucs_free(tm->expected.hash);
+        ucs_free(tm->expected.wildcard);
+        tm->expected.hash     = old_hash;
+        tm->expected.wildcard = old_wildcard;
+        return;
+    }
+
+    tm->expected.hash_mask = (old_size * 2) - 1;
+    ucp_tag_exp_rehash(tm, old_hash, tm->expected.hash, old_size);
+    ucp_tag_exp_rehash(tm, old_wildcard, tm->expected.wildcard, old_size);
+    ucs_free(old_wildcard);
+    ucs_free(old_hash);
+
+    ucs_debug("grew expected hash to %zu buckets with %zu requests",
+              old_size * 2, tm->expected.count);
+    UCS_STATS_SET_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_BUCKETS, old_size * 2);
+    UCS_STATS_UPDATE_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_GROW, 1);
+}
+
+void ucp_tag_unexp_grow(ucp_tag_match_t *tm)
+{
+    size_t old_size = tm->unexpected.hash_mask + 1;
+    ucs_list_link_t *old_hash, *list;
+    ucp_recv_desc_t *rdesc, *tmp;
+    size_t bucket;
+
+    old_hash            = tm->unexpected.hash;
+    tm->unexpected.hash = ucp_tag_unexp_hash_alloc(old_size * 2);
+    if (tm->unexpected.hash == NULL) {
+        ucs_debug("failed to grow unexpected hash to %zu buckets", old_size * 2);
+        tm->unexpected.hash = old_hash;
+        return;
+    }
+
+    tm->unexpected.hash_mask = (old_size * 2) - 1;
+    for (bucket = 0; bucket < old_size; ++bucket) {
+        ucs_list_for_each_safe(rdesc, tmp, &old_hash[bucket],
+                               list[UCP_RDESC_HASH_LIST]) {
+            list = ucp_tag_unexp_get_list_for_tag(tm, ucp_rdesc_get_tag(rdesc));
+            ucs_list_add_tail(list, &rdesc->list[UCP_RDESC_HASH_LIST]);
+        }
+    }
+    ucs_free(old_hash);
+
+    ucs_debug("grew unexpected hash to %zu buckets with %zu descriptors",
+              old_size * 2, tm->unexpected.count);
+    UCS_STATS_SET_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_UNEXP_BUCKETS,
+                          old_size * 2);
+    UCS_STATS_UPDATE_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_UNEXP_GROW, 1);
 }
 
 int ucp_tag_unexp_is_empty(ucp_tag_match_t *tm)
@@ -49,6 +228,58 @@ int ucp_tag_unexp_is_empty(ucp_tag_match_t *tm)
     return ucs_list_is_empty(&tm->unexpected.all);
 }
 
+ucs_status_t ucp_tag_exp_mask_add(ucp_tag_match_t *tm, ucp_tag_t tag_mask)
+{
+    ucp_tag_exp_mask_t *masks;
+    unsigned i;
+
+    for (i = 0; i < tm->expected.num_masks; ++i) {
+        if (tm->expected.masks[i].tag_mask == tag_mask) {
+            ++tm->expected.masks[i].count;
+            return UCS_OK;
+        }
+    }
+
+    if (tm->expected.num_masks == tm->expected.max_masks) {
+        masks = ucs_realloc(tm->expected.masks,
+                            sizeof(*masks) * tm->expected.max_masks * 2,
+                            "ucp_tm_exp_masks");
+        if (masks == NULL) {
+            ucs_error("failed to grow expected tag masks array to %u entries",
+                      tm->expected.max_masks * 2);
+            return UCS_ERR_NO_MEMORY;
+        }
+
+        tm->expected.masks      = masks;
+        tm->expected.max_masks *= 2;
+    }
+
+    ucs_trace_req("added expected tag mask %"PRIx64, tag_mask);
+    tm->expected.masks[tm->expected.num_masks].tag_mask = tag_mask;
+    tm->expected.masks[tm->expected.num_masks].count    = 1;
+    ++tm->expected.num_masks;
+    return UCS_OK;
+}
+
+static void ucp_tag_exp_mask_remove(ucp_tag_match_t *tm, ucp_tag_t tag_mask)
+{
+    unsigned i;
+
+    for (i = 0; i < tm->expected.num_masks; ++i) {
+        if (tm->expected.masks[i].tag_mask != tag_mask) {
+            continue;
+        }
+
+        if (--tm->expected.masks[i].count == 0) {
+            /* order of masks does not matter, move the last one instead */
+            tm->expected.masks[i] = tm->expected.masks[--tm->expected.num_masks];
+        }
+        return;
+    }
+
+    ucs_bug("expected tag mask %"PRIx64" not found", tag_mask);
+}
+
 void ucp_tag_exp_remove(ucp_tag_match_t *tm, ucp_request_t *req)
 {
     ucs_queue_head_t *queue = ucp_tag_exp_get_req_queue(tm, req);
@@ -57,7 +288,10 @@ void ucp_tag_exp_remove(ucp_tag_match_t *tm, ucp_request_t *req)
 
     ucs_queue_for_each_safe(qreq, iter, queue, recv.queue) {
         if (qreq == req) {
-            ucs_queue_del_iter(queue, iter);
+            ucp_tag_exp_del_iter(tm, queue, iter);
+            if (req->recv.tag_mask != UCP_TAG_MASK_FULL) {
+                ucp_tag_exp_mask_remove(tm, req->recv.tag_mask);
+            }
             return;
         }
     }
@@ -65,61 +299,82 @@ void ucp_tag_exp_remove(ucp_tag_match_t *tm, ucp_request_t *req)
     ucs_bug("expected request not found");
 }
 
-static inline uint64_t ucp_tag_exp_req_seq(ucs_queue_iter_t iter)
-{
-    return (*iter == NULL) ? ULONG_MAX :
-                    ucs_container_of(*iter, ucp_request_t, recv.queue)->recv.sn;
-}
-
-ucp_request_t*
-ucp_tag_exp_search_all(ucp_tag_match_t *tm, ucs_queue_head_t *hash_queue,
-                       ucp_tag_t recv_tag, size_t recv_len, unsigned recv_flags)
+/**
+ * Find the first request in the queue which matches the incoming tag and was
+ * posted before max_sn.
+ */
+static UCS_F_ALWAYS_INLINE ucp_request_t*
+ucp_tag_exp_search_queue(ucp_tag_match_t *tm, ucs_queue_head_t *queue,
+                         ucp_tag_t recv_tag, unsigned recv_flags,
+                         uint64_t max_sn, ucs_queue_iter_t *iter_p)
 {
-    ucs_queue_head_t *queue;
-    ucs_queue_iter_t hash_iter, wild_iter, *iter;
-    uint64_t hash_sn, wild_sn, *sn_p;
+    ucs_queue_iter_t iter;
     ucp_request_t *req;
 
-    *hash_queue->ptail           = NULL;
-    *tm->expected.wildcard.ptail = NULL;
-
-    hash_iter = ucs_queue_iter_begin(hash_queue);
-    wild_iter = ucs_queue_iter_begin(&tm->expected.wildcard);
-
-    hash_sn = ucp_tag_exp_req_seq(hash_iter);
-    wild_sn = ucp_tag_exp_req_seq(wild_iter);
-
-    while (hash_sn != wild_sn) {
-        if (hash_sn < wild_sn) {
-            iter  = &hash_iter;
-            sn_p  = &hash_sn;
-            queue = hash_queue;
-        } else {
-            iter  = &wild_iter;
-            sn_p  = &wild_sn;
-            queue = &tm->expected.wildcard;
+    ucs_queue_for_each_safe(req, iter, queue, recv.queue) {
+        if (req->recv.sn >= max_sn) {
+            /* the queue is ordered by sequence number */
+            break;
         }
 
-        req = ucs_container_of(**iter, ucp_request_t, recv.queue);
+        UCS_STATS_UPDATE_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_COMPARE, 1);
+
         if (ucp_tag_recv_is_match(recv_tag, recv_flags, req->recv.tag,
                                   req->recv.tag_mask, req->recv.state.offset,
                                   req->recv.info.sender_tag))
         {
-            ucp_tag_log_match(recv_tag, recv_len, req, req->recv.tag,
-                              req->recv.tag_mask, req->recv.state.offset, "expected");
-            if (recv_flags & UCP_RECV_DESC_FLAG_LAST) {
-                ucs_queue_del_iter(queue, *iter);
-            }
+            *iter_p = iter;
             return req;
         }
-
-        *iter = ucs_queue_iter_next(*iter);
-        *sn_p = ucp_tag_exp_req_seq(*iter);
     }
 
-    ucs_assertv((hash_sn == ULONG_MAX) && (wild_sn == ULONG_MAX),
-                "hash_seq=%lu wild_seq=%lu", hash_sn, wild_sn);
-    ucs_assert(ucs_queue_iter_end(hash_queue, hash_iter));
-    ucs_assert(ucs_queue_iter_end(&tm->expected.wildcard, wild_iter));
     return NULL;
 }
+
+ucp_request_t*
+ucp_tag_exp_search_all(ucp_tag_match_t *tm, ucs_queue_head_t *hash_queue,
+                       ucp_tag_t recv_tag, size_t recv_len, unsigned recv_flags)
+{
+    ucs_queue_head_t *queue, *match_queue;
+    ucs_queue_iter_t iter, match_iter;
+    ucp_request_t *req, *match_req;
+    ucp_tag_t tag_mask;
+    unsigned i;
+
+    UCS_STATS_UPDATE_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_SEARCH, 1);
+
+    match_queue = hash_queue;
+    match_req   = ucp_tag_exp_search_queue(tm, hash_queue, recv_tag, recv_flags,
+                                           ULONG_MAX, &match_iter);
+
+    /* Look up the incoming tag once for every distinct wildcard mask, and take
+     * the request which was posted first.
+     */
+    for (i = 0; i < tm->expected.num_masks; ++i) {
+        tag_mask = tm->expected.masks[i].tag_mask;
+        queue    = ucp_tag_exp_get_wildcard_queue(tm, recv_tag, tag_mask);
+        req      = ucp_tag_exp_search_queue(tm, queue, recv_tag, recv_flags,
+                                            (match_req == NULL) ? ULONG_MAX :
+                                            match_req->recv.sn, &iter);
+        if (req != NULL) {
+            match_req   = req;
+            match_queue = queue;
+            match_iter  = iter;
+        }
+    }
+
+    if (match_req == NULL) {
+        return NULL;
+    }
+
+    ucp_tag_log_match(recv_tag, recv_len, match_req, match_req->recv.tag,
+                      match_req->recv.tag_mask, match_req->recv.state.offset,
+                      "expected");
+    if (recv_flags & UCP_RECV_DESC_FLAG_LAST) {
+        ucp_tag_exp_del_iter(tm, match_queue, match_iter);
+        if (match_req->recv.tag_mask != UCP_TAG_MASK_FULL) {
+            ucp_tag_exp_mask_remove(tm, match_req->recv.tag_mask);
+        }
+    }
+    return match_req;
+}
@@ -10,11 +10,43 @@
 #include <ucp/api/ucp_def.h>
 #include <ucp/core/ucp_types.h>
 #include <ucs/datastruct/queue_types.h>
+#include <ucs/stats/stats.h>
 #include <ucs/sys/compiler_def.h>
 
 
 #define UCP_TAG_MASK_FULL     0xffffffffffffffffUL  /* All 1-s */
 
+/* Initial number of hash buckets, small enough to fit L1 cache */
+#define UCP_TAG_MATCH_HASH_SIZE     1024
+
+/* Hash tables are grown when they hold more than this many entries per bucket */
+#define UCP_TAG_MATCH_HASH_LOAD     2
+
+
+/**
+ * Tag-matching statistics counters
+ */
+enum {
+    /* Number of hash buckets, and of requests/descriptors stored in them.
+     * Their ratio is the average bucket occupancy. */
+    UCP_TAG_MATCH_STAT_EXP_BUCKETS,
+    UCP_TAG_MATCH_STAT_EXP_ENTRIES,
+    UCP_TAG_MATCH_STAT_UNEXP_BUCKETS,
+    UCP_TAG_MATCH_STAT_UNEXP_ENTRIES,
+
+    /* Number of searches, and of entries compared during them. Their ratio
+     * is the average number of entries visited by a search. */
+    UCP_TAG_MATCH_STAT_EXP_SEARCH,
+    UCP_TAG_MATCH_STAT_EXP_COMPARE,
+    UCP_TAG_MATCH_STAT_UNEXP_SEARCH,
+    UCP_TAG_MATCH_STAT_UNEXP_COMPARE,
+
+    /* Number of times the hash tables were grown */
+    UCP_TAG_MATCH_STAT_EXP_GROW,
+    UCP_TAG_MATCH_STAT_UNEXP_GROW,
+    UCP_TAG_MATCH_STAT_LAST
+};
+
 
 /**
  * Tag-match header
@@ -24,28 +56,59 @@ typedef struct {
 } UCS_S_PACKED ucp_tag_hdr_t;
 
 
+/**
+ * Tag mask which is used by outstanding expected wildcard requests
+ */
+typedef struct ucp_tag_exp_mask {
+    ucp_tag_t                 tag_mask;
+    unsigned                  count;      /* How many requests use this mask */
+} ucp_tag_exp_mask_t;
+
+
 /**
  * Tag-matching context
+ *
+ * Wildcard requests are hashed by their masked tag and mask. An incoming tag
+ * is looked up once for every distinct mask in use, and the matching request
+ * with the lowest sequence number wins, to keep the posting order.
+ *
+ * Hash tables have a power-of-2 number of buckets, and are doubled when the
+ * number of entries exceeds UCP_TAG_MATCH_HASH_LOAD per bucket.
  */
 typedef struct ucp_tag_match {
     struct {
-        ucs_queue_head_t      wildcard;   /* Expected wildcard requests */
         ucs_queue_head_t      *hash;      /* Hash table of expected non-wild tags */
+        ucs_queue_head_t      *wildcard;  /* Hash table of expected wildcard tags */
+        size_t                hash_mask;  /* Number of buckets in both, minus 1 */
+        size_t                count;      /* Number of expected requests */
+        ucp_tag_exp_mask_t    *masks;     /* Masks of expected wildcard tags */
+        unsigned              num_masks;
+        unsigned              max_masks;
         uint64_t              sn;
     } expected;
     struct {
         ucs_list_link_t       all;        /* Linked list of all tags */
         ucs_list_link_t       *hash;      /* Hash table of unexpected tags */
+        size_t                hash_mask;  /* Number of buckets, minus 1 */
+        size_t                count;      /* Number of unexpected descriptors */
     } unexpected;
+    UCS_STATS_NODE_DECLARE(stats);
 } ucp_tag_match_t;
 
 
-ucs_status_t ucp_tag_match_init(ucp_tag_match_t *tm);
+ucs_status_t ucp_tag_match_init(ucp_tag_match_t *tm
+                                UCS_STATS_ARG(ucs_stats_node_t *stats_parent));
 
 void ucp_tag_match_cleanup(ucp_tag_match_t *tm);
 
 void ucp_tag_exp_remove(ucp_tag_match_t *tm, ucp_request_t *req);
 
+ucs_status_t ucp_tag_exp_mask_add(ucp_tag_match_t *tm, ucp_tag_t tag_mask);
+
+void ucp_tag_exp_grow(ucp_tag_match_t *tm);
+
+void ucp_tag_unexp_grow(ucp_tag_match_t *tm);
+
 int ucp_tag_unexp_is_empty(ucp_tag_match_t *tm);
 
 ucp_request_t*
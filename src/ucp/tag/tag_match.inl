@@ -17,12 +17,6 @@
 #include <inttypes.h>
 
 
-/* Hash size is a prime number just below 1024. Prime number for even distribution,
- * and small enough to fit L1 cache. */
-#define UCP_TAG_MATCH_HASH_SIZE     1021
-
-
-
 #define ucp_tag_log_match(_recv_tag, _recv_len,_req, _exp_tag, _exp_tag_mask, \
                           _offset, _title) \
     ucs_trace_req("matched tag %"PRIx64" len %zu to %s request %p offset %zu " \
@@ -56,17 +50,33 @@ int ucp_tag_recv_is_match(ucp_tag_t recv_tag, unsigned recv_flags,
 }
 
 static UCS_F_ALWAYS_INLINE size_t
-ucp_tag_match_calc_hash(ucp_tag_t tag)
+ucp_tag_match_calc_hash(ucp_tag_t tag, size_t hash_mask)
 {
-    /* Compute two 32-bit modulo and combine their result */
-    return ((uint32_t)tag % UCP_TAG_MATCH_HASH_SIZE) ^
-           ((uint32_t)(tag >> 32) % UCP_TAG_MATCH_HASH_SIZE);
+    /* MurmurHash3 64-bit finalizer - every bit of the tag affects the bucket,
+     * so tags which differ only in their high bits are spread as well */
+    tag ^= tag >> 33;
+    tag *= 0xff51afd7ed558ccdUL;
+    tag ^= tag >> 33;
+    tag *= 0xc4ceb9fe1a85ec53UL;
+    tag ^= tag >> 33;
+    return tag & hash_mask;
 }
 
 static UCS_F_ALWAYS_INLINE ucs_queue_head_t*
 ucp_tag_exp_get_queue_for_tag(ucp_tag_match_t *tm, ucp_tag_t tag)
 {
-    return &tm->expected.hash[ucp_tag_match_calc_hash(tag)];
+    return &tm->expected.hash[ucp_tag_match_calc_hash(tag,
+                                                      tm->expected.hash_mask)];
+}
+
+static UCS_F_ALWAYS_INLINE ucs_queue_head_t*
+ucp_tag_exp_get_wildcard_queue(ucp_tag_match_t *tm, ucp_tag_t tag,
+                               ucp_tag_t tag_mask)
+{
+    /* Requests with different masks are likely to land in different buckets */
+    return &tm->expected.wildcard[ucp_tag_match_calc_hash((tag & tag_mask) ^
+                                                          tag_mask,
+                                                          tm->expected.hash_mask)];
 }
 
 static UCS_F_ALWAYS_INLINE ucs_queue_head_t*
@@ -75,7 +85,7 @@ ucp_tag_exp_get_queue(ucp_tag_match_t *tm, ucp_tag_t tag, ucp_tag_t tag_mask)
     if (tag_mask == UCP_TAG_MASK_FULL) {
         return ucp_tag_exp_get_queue_for_tag(tm, tag);
     } else {
-        return &tm->expected.wildcard;
+        return ucp_tag_exp_get_wildcard_queue(tm, tag, tag_mask);
     }
 }
 
@@ -85,17 +95,45 @@ ucp_tag_exp_get_req_queue(ucp_tag_match_t *tm, ucp_request_t *req)
     return ucp_tag_exp_get_queue(tm, req->recv.tag, req->recv.tag_mask);
 }
 
-static UCS_F_ALWAYS_INLINE void
+static UCS_F_ALWAYS_INLINE ucs_status_t
 ucp_tag_exp_push(ucp_tag_match_t *tm, ucs_queue_head_t *queue, ucp_request_t *req)
 {
+    ucs_status_t status;
+
+    if (ucs_unlikely(req->recv.tag_mask != UCP_TAG_MASK_FULL)) {
+        status = ucp_tag_exp_mask_add(tm, req->recv.tag_mask);
+        if (status != UCS_OK) {
+            return status;
+        }
+    }
+
     req->recv.sn = tm->expected.sn++;
     ucs_queue_push(queue, &req->recv.queue);
+    ++tm->expected.count;
+    UCS_STATS_SET_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_ENTRIES,
+                          tm->expected.count);
+    return UCS_OK;
 }
 
-static UCS_F_ALWAYS_INLINE void
+static UCS_F_ALWAYS_INLINE ucs_status_t
 ucp_tag_exp_add(ucp_tag_match_t *tm, ucp_request_t *req)
 {
-    ucp_tag_exp_push(tm, ucp_tag_exp_get_req_queue(tm, req), req);
+    if (ucs_unlikely(tm->expected.count >=
+                     (tm->expected.hash_mask + 1) * UCP_TAG_MATCH_HASH_LOAD)) {
+        ucp_tag_exp_grow(tm);
+    }
+
+    return ucp_tag_exp_push(tm, ucp_tag_exp_get_req_queue(tm, req), req);
+}
+
+static UCS_F_ALWAYS_INLINE void
+ucp_tag_exp_del_iter(ucp_tag_match_t *tm, ucs_queue_head_t *queue,
+                     ucs_queue_iter_t iter)
+{
+    ucs_queue_del_iter(queue, iter);
+    --tm->expected.count;
+    UCS_STATS_SET_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_ENTRIES,
+                          tm->expected.count);
 }
 
 static UCS_F_ALWAYS_INLINE ucp_request_t *
@@ -106,15 +144,17 @@ ucp_tag_exp_search(ucp_tag_match_t *tm, ucp_tag_t recv_tag, size_t recv_len,
     ucs_queue_iter_t iter;
     ucp_request_t *req;
 
-    if (ucs_unlikely(!ucs_queue_is_empty(&tm->expected.wildcard))) {
+    if (ucs_unlikely(tm->expected.num_masks > 0)) {
         queue = ucp_tag_exp_get_queue_for_tag(tm, recv_tag);
         return ucp_tag_exp_search_all(tm, queue, recv_tag, recv_len, recv_flags);
     }
 
-    /* fast path - wildcard queue is empty, search only the specific queue */
+    /* fast path - no wildcard requests, search only the specific queue */
+    UCS_STATS_UPDATE_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_SEARCH, 1);
     queue = ucp_tag_exp_get_queue_for_tag(tm, recv_tag);
     ucs_queue_for_each_safe(req, iter, queue, recv.queue) {
         req = ucs_container_of(*iter, ucp_request_t, recv.queue);
+        UCS_STATS_UPDATE_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_EXP_COMPARE, 1);
         ucs_trace_data("checking req %p tag %"PRIx64"/%"PRIx64" with recv_tag %"PRIx64,
                        req, req->recv.tag, req->recv.tag_mask, recv_tag);
         if (ucp_tag_recv_is_match(recv_tag, recv_flags, req->recv.tag,
@@ -124,7 +164,7 @@ ucp_tag_exp_search(ucp_tag_match_t *tm, ucp_tag_t recv_tag, size_t recv_len,
             ucp_tag_log_match(recv_tag, recv_len, req, req->recv.tag,
                               req->recv.tag_mask, req->recv.state.offset, "expected");
             if (recv_flags & UCP_RECV_DESC_FLAG_LAST) {
-                ucs_queue_del_iter(queue, iter);
+                ucp_tag_exp_del_iter(tm, queue, iter);
             }
             return req;
         }
@@ -140,14 +180,18 @@ static UCS_F_ALWAYS_INLINE ucp_tag_t ucp_rdesc_get_tag(ucp_recv_desc_t *rdesc)
 static UCS_F_ALWAYS_INLINE ucs_list_link_t*
 ucp_tag_unexp_get_list_for_tag(ucp_tag_match_t *tm, ucp_tag_t tag)
 {
-    return &tm->unexpected.hash[ucp_tag_match_calc_hash(tag)];
+    return &tm->unexpected.hash[ucp_tag_match_calc_hash(tag,
+                                                        tm->unexpected.hash_mask)];
 }
 
 static UCS_F_ALWAYS_INLINE void
-ucp_tag_unexp_remove(ucp_recv_desc_t *rdesc)
+ucp_tag_unexp_remove(ucp_tag_match_t *tm, ucp_recv_desc_t *rdesc)
 {
     ucs_list_del(&rdesc->list[UCP_RDESC_HASH_LIST]);
     ucs_list_del(&rdesc->list[UCP_RDESC_ALL_LIST] );
+    --tm->unexpected.count;
+    UCS_STATS_SET_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_UNEXP_ENTRIES,
+                          tm->unexpected.count);
 }
 
 static UCS_F_ALWAYS_INLINE ucs_status_t
@@ -183,11 +227,20 @@ ucp_tag_unexp_recv(ucp_tag_match_t *tm, ucp_worker_h worker, void *data,
                   (flags & UCP_RECV_DESC_FLAG_RNDV)  ? 'r' : '-',
                   ucp_rdesc_get_tag(rdesc), length - hdr_len, rdesc);
 
+    if (ucs_unlikely(tm->unexpected.count >=
+                     (tm->unexpected.hash_mask + 1) * UCP_TAG_MATCH_HASH_LOAD)) {
+        ucp_tag_unexp_grow(tm);
+    }
+
     rdesc->length  = length;
     rdesc->hdr_len = hdr_len;
     hash_list = ucp_tag_unexp_get_list_for_tag(tm, ucp_rdesc_get_tag(rdesc));
     ucs_list_add_tail(hash_list,           &rdesc->list[UCP_RDESC_HASH_LIST]);
     ucs_list_add_tail(&tm->unexpected.all, &rdesc->list[UCP_RDESC_ALL_LIST]);
+    ++tm->unexpected.count;
+    UCS_STATS_SET_COUNTER(tm->stats, UCP_TAG_MATCH_STAT_UNEXP_ENTRIES,
+                          tm->unexpected.count);
+    UCP_WORKER_WAIT_EVENT(worker);
     return status;
 }
 
@@ -51,8 +51,11 @@ ucp_tag_search_unexp(ucp_worker_h worker, void *buffer, size_t buffer_size,
         i_list = UCP_RDESC_ALL_LIST;
     }
 
+    UCS_STATS_UPDATE_COUNTER(context->tm.stats, UCP_TAG_MATCH_STAT_UNEXP_SEARCH, 1);
     rdesc = ucs_list_head(list, ucp_recv_desc_t, list[i_list]);
     do {
+        UCS_STATS_UPDATE_COUNTER(context->tm.stats,
+                                 UCP_TAG_MATCH_STAT_UNEXP_COMPARE, 1);
         recv_tag = ucp_rdesc_get_tag(rdesc);
         flags    = rdesc->flags;
         ucs_trace_req("searching for %"PRIx64"/%"PRIx64"/%"PRIx64" offset %zu, "
@@ -69,7 +72,7 @@ ucp_tag_search_unexp(ucp_worker_h worker, void *buffer, size_t buffer_size,
         {
             ucp_tag_log_match(recv_tag, rdesc->length - rdesc->hdr_len, req, tag,
                               tag_mask, req->recv.state.offset, "unexpected");
-            ucp_tag_unexp_remove(rdesc);
+            ucp_tag_unexp_remove(&context->tm, rdesc);
             if (rdesc->flags & UCP_RECV_DESC_FLAG_EAGER) {
                 UCS_PROFILE_REQUEST_EVENT(req, "eager_match", 0);
                 status = ucp_eager_unexp_match(worker, rdesc, recv_tag, flags,
@@ -178,7 +181,6 @@ ucp_tag_recv_common(ucp_worker_h worker, void *buffer, size_t buffer_size,
                     const char *debug_name)
 {
     unsigned save_rreq = 1;
-    ucs_queue_head_t *queue;
     ucp_context_h context;
     ucs_status_t status;
 
@@ -194,19 +196,22 @@ ucp_tag_recv_common(ucp_worker_h worker, void *buffer, size_t buffer_size,
         /* If not found on unexpected, wait until it arrives.
          * If was found but need this receive request for later completion, save it */
         context            = worker->context;
-        queue              = ucp_tag_exp_get_queue(&context->tm, tag, tag_mask);
         req->recv.buffer   = buffer;
         req->recv.length   = buffer_size;
         req->recv.datatype = datatype;
         req->recv.tag      = tag;
         req->recv.tag_mask = tag_mask;
         req->recv.cb       = cb;
-        ucp_tag_exp_push(&context->tm, queue, req);
+        status = ucp_tag_exp_add(&context->tm, req);
+        if (status != UCS_OK) {
+            return status;
+        }
+
         ucs_trace_req("%s returning expected request %p (%p)", debug_name, req,
                       req + 1);
     }
 
-    return status;
+    return UCS_INPROGRESS;
 }
 
 UCS_PROFILE_FUNC(ucs_status_t, ucp_tag_recv_nbr,
@@ -41,7 +41,7 @@ static ucs_status_t ucp_tag_req_start(ucp_request_t *req, size_t count,
         req->send.state.dt.iov.iov_offset    = 0;
         req->send.state.dt.iov.iovcnt        = count;
         flag_iov_single                      = (count <= config->am.max_iovcnt);
-        if (0 == count) {
+        if ((0 == count) || (0 == length)) {
             /* disable zcopy */
             zcopy_thresh = SIZE_MAX;
         } else if (!config->am.zcopy_auto_thresh) {
@@ -74,7 +74,7 @@ static ucs_status_t ucp_tag_req_start(ucp_request_t *req, size_t count,
         /* short */
         req->send.uct.func = proto->contig_short;
         UCS_PROFILE_REQUEST_EVENT(req, "start_contig_short", req->send.length);
-    } else if ((((config->key.rndv_lane != UCP_NULL_RESOURCE) &&
+    } else if ((((config->key.rndv_lanes[0] != UCP_NULL_RESOURCE) &&
                (length >= rndv_rma_thresh)) ||
                (length >= rndv_am_thresh)) && !is_iov) {
         /* RMA/AM rendezvous */
@@ -91,7 +91,7 @@ static ucs_status_t ucp_tag_req_start(ucp_request_t *req, size_t count,
         }
     } else {
         /* eager zcopy */
-        status = ucp_request_send_buffer_reg(req, lane);
+        status = ucp_request_send_buffer_reg(req, lane, PROT_READ);
         if (status != UCS_OK) {
             return status;
         }
@@ -29,6 +29,7 @@ typedef struct {
     uint32_t          usage;
     double            rma_score;
     double            amo_score;
+    double            rndv_score;
 } ucp_wireup_lane_desc_t;
 
 
@@ -324,6 +325,7 @@ ucp_wireup_add_lane_desc(ucp_wireup_lane_desc_t *lane_descs,
     lane_desc->usage        = usage;
     lane_desc->rma_score    = 0.0;
     lane_desc->amo_score    = 0.0;
+    lane_desc->rndv_score   = 0.0;
 
 out_update_score:
     if (usage & UCP_WIREUP_LANE_USAGE_RMA) {
@@ -332,6 +334,9 @@ out_update_score:
     if (usage & UCP_WIREUP_LANE_USAGE_AMO) {
         lane_desc->amo_score = score;
     }
+    if (usage & UCP_WIREUP_LANE_USAGE_RNDV) {
+        lane_desc->rndv_score = score;
+    }
 }
 
 #define UCP_WIREUP_COMPARE_SCORE(_elem1, _elem2, _arg, _token) \
@@ -359,6 +364,12 @@ static int ucp_wireup_compare_lane_amo_score(const void *elem1, const void *elem
     return UCP_WIREUP_COMPARE_SCORE(elem1, elem2, arg, amo);
 }
 
+static int ucp_wireup_compare_lane_rndv_score(const void *elem1, const void *elem2,
+                                              void *arg)
+{
+    return UCP_WIREUP_COMPARE_SCORE(elem1, elem2, arg, rndv);
+}
+
 static UCS_F_NOINLINE ucs_status_t
 ucp_wireup_add_memaccess_lanes(ucp_ep_h ep, unsigned address_count,
                                const ucp_address_entry_t *address_list,
@@ -606,25 +617,48 @@ static ucs_status_t ucp_wireup_add_am_lane(ucp_ep_h ep, unsigned address_count,
     return UCS_OK;
 }
 
-static ucs_status_t ucp_wireup_add_rndv_lane(ucp_ep_h ep, unsigned address_count,
-                                             const ucp_address_entry_t *address_list,
-                                             ucp_wireup_lane_desc_t *lane_descs,
-                                             ucp_lane_index_t *num_lanes_p)
+/* Bitmap of all resources on the same device as rsc_index */
+static uint64_t ucp_wireup_dev_tl_bitmap(ucp_context_h context,
+                                         ucp_rsc_index_t rsc_index)
+{
+    const char *dev_name = context->tl_rscs[rsc_index].tl_rsc.dev_name;
+    uint64_t tl_bitmap   = 0;
+    ucp_rsc_index_t i;
+
+    for (i = 0; i < context->num_tls; ++i) {
+        if (!strcmp(context->tl_rscs[i].tl_rsc.dev_name, dev_name)) {
+            tl_bitmap |= UCS_BIT(i);
+        }
+    }
+    return tl_bitmap;
+}
+
+static ucs_status_t ucp_wireup_add_rndv_lanes(ucp_ep_h ep, unsigned address_count,
+                                              const ucp_address_entry_t *address_list,
+                                              ucp_wireup_lane_desc_t *lane_descs,
+                                              ucp_lane_index_t *num_lanes_p)
 {
+    ucp_worker_h worker   = ep->worker;
+    ucp_context_h context = worker->context;
     ucp_wireup_criteria_t criteria;
     ucp_rsc_index_t rsc_index;
+    unsigned num_rndv_lanes;
     ucs_status_t status;
     unsigned addr_index;
-    double score;
+    uint64_t tl_bitmap;
+    double score, min_bw;
 
     if (!(ucp_ep_get_context_features(ep) & UCP_FEATURE_TAG)) {
         return UCS_OK;
     }
 
-    /* Select one lane for the Rendezvous protocol (for the actual data. not for rts/rtr) */
+    /* Select lanes for the Rendezvous protocol (for the actual data. not for rts/rtr).
+     * The receiver fetches the data from the sender's user buffer, so the remote
+     * md must be able to register any memory. For example, mm over posix or sysv
+     * exports only the segments it allocates, and is not used for rendezvous. */
     criteria.title              = "rendezvous";
     criteria.local_md_flags     = UCT_MD_FLAG_REG;
-    criteria.remote_md_flags    = UCT_MD_FLAG_REG;  /* TODO not all ucts need reg on remote side */
+    criteria.remote_md_flags    = UCT_MD_FLAG_REG;
     criteria.remote_iface_flags = UCT_IFACE_FLAG_GET_ZCOPY |
                                   UCT_IFACE_FLAG_PENDING;
     criteria.local_iface_flags  = UCT_IFACE_FLAG_GET_ZCOPY;
@@ -634,14 +668,36 @@ static ucs_status_t ucp_wireup_add_rndv_lane(ucp_ep_h ep, unsigned address_count
         criteria.remote_iface_flags |= UCT_IFACE_FLAG_WAKEUP;
     }
 
-    status = ucp_wireup_select_transport(ep, address_list, address_count, &criteria,
-                                         -1, -1, 0, &rsc_index, &addr_index, &score);
-    if ((status == UCS_OK) &&
-        /* a temporary workaround to prevent the ugni uct from using rndv */
-        (strstr(ep->worker->context->tl_rscs[rsc_index].tl_rsc.tl_name, "ugni") == NULL)) {
-         ucp_wireup_add_lane_desc(lane_descs, num_lanes_p, rsc_index, addr_index,
+    /* The best lane is selected first, and then additional lanes on other local
+     * devices, as long as their bandwidth is comparable to the best one. Other
+     * transports on the device of a selected lane are excluded, since they would
+     * share its bandwidth. The rendezvous data is split between the lanes
+     * according to bandwidth. */
+    tl_bitmap = -1;
+    min_bw    = 0;
+    for (num_rndv_lanes = 0;
+         (num_rndv_lanes < context->config.ext.max_rndv_lanes) &&
+         ((num_rndv_lanes == 0) || (*num_lanes_p < UCP_MAX_LANES));
+         ++num_rndv_lanes) {
+        status = ucp_wireup_select_transport(ep, address_list, address_count,
+                                             &criteria, tl_bitmap, -1, 0,
+                                             &rsc_index, &addr_index, &score);
+        if ((status != UCS_OK) ||
+            /* a temporary workaround to prevent the ugni uct from using rndv */
+            (strstr(context->tl_rscs[rsc_index].tl_rsc.tl_name, "ugni") != NULL) ||
+            (worker->iface_attrs[rsc_index].bandwidth < min_bw)) {
+            break;
+        }
+
+        ucp_wireup_add_lane_desc(lane_descs, num_lanes_p, rsc_index, addr_index,
                                  address_list[addr_index].md_index, score,
                                  UCP_WIREUP_LANE_USAGE_RNDV);
+
+        if (num_rndv_lanes == 0) {
+            min_bw = worker->iface_attrs[rsc_index].bandwidth *
+                     context->config.ext.rndv_min_bw_ratio;
+        }
+        tl_bitmap &= ~ucp_wireup_dev_tl_bitmap(context, rsc_index);
     }
 
     return UCS_OK;
@@ -714,6 +770,7 @@ ucs_status_t ucp_wireup_select_lanes(ucp_ep_h ep, unsigned address_count,
 {
     ucp_worker_h worker            = ep->worker;
     ucp_wireup_lane_desc_t lane_descs[UCP_MAX_LANES];
+    unsigned num_rndv_lanes;
     ucp_lane_index_t lane;
     ucs_status_t status;
 
@@ -738,8 +795,8 @@ ucs_status_t ucp_wireup_select_lanes(ucp_ep_h ep, unsigned address_count,
         return status;
     }
 
-    status = ucp_wireup_add_rndv_lane(ep, address_count, address_list,
-                                      lane_descs, &key->num_lanes);
+    status = ucp_wireup_add_rndv_lanes(ep, address_count, address_list,
+                                       lane_descs, &key->num_lanes);
     if (status != UCS_OK) {
         return status;
     }
@@ -751,6 +808,8 @@ ucs_status_t ucp_wireup_select_lanes(ucp_ep_h ep, unsigned address_count,
         return UCS_ERR_UNREACHABLE;
     }
 
+    num_rndv_lanes = 0;
+
     /* Construct the endpoint configuration key:
      * - arrange lane description in the EP configuration
      * - create remote MD bitmap
@@ -767,8 +826,8 @@ ucs_status_t ucp_wireup_select_lanes(ucp_ep_h ep, unsigned address_count,
             key->am_lane = lane;
         }
         if (lane_descs[lane].usage & UCP_WIREUP_LANE_USAGE_RNDV) {
-            ucs_assert(key->rndv_lane == UCP_NULL_LANE);
-            key->rndv_lane = lane;
+            ucs_assert(num_rndv_lanes < UCP_MAX_RNDV_LANES);
+            key->rndv_lanes[num_rndv_lanes++] = lane;
         }
         if (lane_descs[lane].usage & UCP_WIREUP_LANE_USAGE_RMA) {
             key->rma_lanes[lane] = lane;
@@ -783,6 +842,8 @@ ucs_status_t ucp_wireup_select_lanes(ucp_ep_h ep, unsigned address_count,
                 ucp_wireup_compare_lane_rma_score, lane_descs);
     ucs_qsort_r(key->amo_lanes, UCP_MAX_LANES, sizeof(ucp_lane_index_t),
                 ucp_wireup_compare_lane_amo_score, lane_descs);
+    ucs_qsort_r(key->rndv_lanes, UCP_MAX_RNDV_LANES, sizeof(ucp_lane_index_t),
+                ucp_wireup_compare_lane_rndv_score, lane_descs);
 
     /* Get all reachable MDs from full remote address list */
     key->reachable_md_map = ucp_wireup_get_reachable_mds(worker, address_count,
@@ -8,32 +8,62 @@
 
 #include <ucs/arch/atomic.h>
 #include <ucs/debug/debug.h>
-#include <ucs/datastruct/khash.h>
 #include <ucs/sys/sys.h>
+#include <ucs/type/epoch.h>
 
 
 #define UCS_ASYNC_TIMER_ID_MIN      1000000u
 #define UCS_ASYNC_TIMER_ID_MAX      2000000u
+#define UCS_ASYNC_TIMERS_BATCH      64
 
 #define UCS_ASYNC_HANDLER_FMT       "%p [id=%d] %s()"
 #define UCS_ASYNC_HANDLER_ARG(_h)   (_h), (_h)->id, ucs_debug_get_symbol_name((_h)->cb)
 
-/* Hash table for all event and timer handlers */
-KHASH_MAP_INIT_INT(ucs_async_handler, ucs_async_handler_t *);
+#define UCS_ASYNC_HANDLERS_MIN_SIZE 64
 
 
+/*
+ * Table of handlers: event handlers are indexed by the file descriptor, and
+ * timer handlers by the timer ID modulo the table size. Timer IDs are chosen so
+ * that they don't collide, which is kept when the table is extended.
+ */
+typedef struct ucs_async_handler_table {
+    unsigned                       size;     /* Power of 2 */
+    unsigned                       count;    /* Number of handlers */
+    ucs_async_handler_t * volatile slots[0];
+} ucs_async_handler_table_t;
+
+
+/*
+ * Handlers are looked up without a lock: the tables are modified with the lock
+ * held, and looked up in an epoch section. A removed handler, or a replaced
+ * table, is released after the lookups which could see it are done.
+ */
 typedef struct ucs_async_global_context {
-    khash_t(ucs_async_handler)     handlers;
-    pthread_rwlock_t               handlers_lock;
+    ucs_async_handler_table_t * volatile fd_handlers;
+    ucs_async_handler_table_t * volatile timer_handlers;
+    pthread_mutex_t                handlers_lock;
+    ucs_epoch_t                    epoch;
     volatile uint32_t              timer_id;
 } ucs_async_global_context_t;
 
 
+static void *ucs_async_readers_alloc(size_t size);
+
 static ucs_async_global_context_t ucs_async_global_context = {
-    .handlers_lock   = PTHREAD_RWLOCK_INITIALIZER,
-    .timer_id        = UCS_ASYNC_TIMER_ID_MIN
+    .fd_handlers     = NULL,
+    .timer_handlers  = NULL,
+    .handlers_lock   = PTHREAD_MUTEX_INITIALIZER,
+    .epoch           = UCS_EPOCH_INITIALIZER(ucs_async_readers_alloc),
+    .timer_id        = 0
 };
 
+/* Reader state of the current thread. Using initial-exec TLS model, since
+ * lookups are done from signal handlers, where a dynamic TLS access is not
+ * safe. */
+static __thread ucs_epoch_thread_t ucs_async_thread_reader
+                __attribute__((tls_model("initial-exec")));
+
 
 #define ucs_async_method_call(_mode, _func, ...) \
     ((_mode) == UCS_ASYNC_MODE_SIGNAL) ? ucs_async_signal_ops._func(__VA_ARGS__) : \
@@ -69,18 +99,106 @@ static ucs_async_ops_t ucs_async_poll_ops = {
     .context_unblock    = ucs_empty_function,
     .add_event_fd       = ucs_empty_function_return_success,
     .remove_event_fd    = ucs_empty_function_return_success,
+    .modify_event_fd    = ucs_empty_function_return_success,
     .add_timer          = ucs_empty_function_return_success,
     .remove_timer       = ucs_empty_function_return_success,
 };
 
-static inline khiter_t ucs_async_handler_kh_get(int id)
+static inline int ucs_async_handler_is_timer(int id)
+{
+    return id >= UCS_ASYNC_TIMER_ID_MIN;
+}
+
+static inline ucs_async_handler_table_t * volatile *
+ucs_async_handler_table_ptr(int id)
+{
+    return ucs_async_handler_is_timer(id) ?
+           &ucs_async_global_context.timer_handlers :
+           &ucs_async_global_context.fd_handlers;
+}
+
+static inline unsigned ucs_async_handler_table_index(unsigned size, int id)
+{
+    return ucs_async_handler_is_timer(id) ?
+           ((id - UCS_ASYNC_TIMER_ID_MIN) & (size - 1)) : id;
+}
+
+/* return the table slot of the handler, or NULL if the table is too small */
+static inline ucs_async_handler_t * volatile *
+ucs_async_handler_table_slot(ucs_async_handler_table_t *table, int id)
+{
+    unsigned index;
+
+    if (table == NULL) {
+        return NULL;
+    }
+
+    index = ucs_async_handler_table_index(table->size, id);
+    return (index < table->size) ? &table->slots[index] : NULL;
+}
+
+/* number of handlers, which may change unless the lock is held */
+static unsigned ucs_async_handlers_count()
+{
+    ucs_async_handler_table_t *fd_table    = ucs_async_global_context.fd_handlers;
+    ucs_async_handler_table_t *timer_table = ucs_async_global_context.timer_handlers;
+
+    return ((fd_table    == NULL) ? 0 : fd_table->count) +
+           ((timer_table == NULL) ? 0 : timer_table->count);
+}
+
+/* iterate over all handlers, within a lookup or with the lock held */
+#define ucs_async_handlers_for_each(_handler, _code) \
+    { \
+        ucs_async_handler_table_t *_tables[] = { \
+            ucs_async_global_context.fd_handlers, \
+            ucs_async_global_context.timer_handlers \
+        }; \
+        unsigned _t, _i; \
+        \
+        for (_t = 0; _t < ucs_static_array_size(_tables); ++_t) { \
+            for (_i = 0; (_tables[_t] != NULL) && (_i < _tables[_t]->size); ++_i) { \
+                (_handler) = _tables[_t]->slots[_i]; \
+                if ((_handler) != NULL) { \
+                    _code; \
+                } \
+            } \
+        } \
+    }
+
+/* Records are never released, so they are not tracked */
+static void *ucs_async_readers_alloc(size_t size)
+{
+    void *ptr;
+
+    return posix_memalign(&ptr, UCS_SYS_CACHE_LINE_SIZE, size) ? NULL : ptr;
+}
+
+void ucs_async_register_reader()
+{
+    ucs_epoch_thread_register(&ucs_async_global_context.epoch,
+                              &ucs_async_thread_reader);
+}
+
+static inline int ucs_async_handlers_read_begin()
 {
-    return kh_get(ucs_async_handler, &ucs_async_global_context.handlers, id);
+    return ucs_epoch_enter(&ucs_async_global_context.epoch,
+                           ucs_epoch_thread_reader(&ucs_async_thread_reader));
 }
 
-static inline int ucs_async_handler_kh_is_end(khiter_t hash_it)
+static inline void ucs_async_handlers_read_end(int section)
 {
-    return hash_it == kh_end(&ucs_async_global_context.handlers);
+    ucs_epoch_leave(&ucs_async_global_context.epoch,
+                    ucs_epoch_thread_reader(&ucs_async_thread_reader), section);
+}
+
+/*
+ * Wait until the lookups which could see a removed handler or table are done.
+ * Has to be called with the lock held.
+ */
+static void ucs_async_handlers_synchronize()
+{
+    ucs_epoch_synchronize(&ucs_async_global_context.epoch);
 }
 
 static void ucs_async_handler_hold(ucs_async_handler_t *handler)
@@ -91,44 +209,45 @@ static void ucs_async_handler_hold(ucs_async_handler_t *handler)
 /* incremented reference count and return the handler */
 static ucs_async_handler_t *ucs_async_handler_get(int id)
 {
+    ucs_async_handler_t * volatile *slot;
     ucs_async_handler_t *handler;
-    khiter_t hash_it;
+    int section;
 
-    pthread_rwlock_rdlock(&ucs_async_global_context.handlers_lock);
-    hash_it = ucs_async_handler_kh_get(id);
-    if (ucs_async_handler_kh_is_end(hash_it)) {
+    section = ucs_async_handlers_read_begin();
+    slot    = ucs_async_handler_table_slot(*ucs_async_handler_table_ptr(id), id);
+    handler = (slot == NULL) ? NULL : *slot;
+    if ((handler != NULL) && (handler->id == id)) {
+        ucs_async_handler_hold(handler);
+    } else {
         handler = NULL;
-        goto out_unlock;
     }
+    ucs_async_handlers_read_end(section);
 
-    handler = kh_value(&ucs_async_global_context.handlers, hash_it);
-    ucs_assert_always(handler->id == id);
-    ucs_async_handler_hold(handler);
-
-out_unlock:
-    pthread_rwlock_unlock(&ucs_async_global_context.handlers_lock);
     return handler;
 }
 
-/* remove from hash and return the handler */
+/* remove from the table and return the handler */
 static ucs_async_handler_t *ucs_async_handler_extract(int id)
 {
+    ucs_async_handler_table_t *table;
+    ucs_async_handler_t * volatile *slot;
     ucs_async_handler_t *handler;
-    khiter_t hash_it;
 
-    pthread_rwlock_wrlock(&ucs_async_global_context.handlers_lock);
-    hash_it = ucs_async_handler_kh_get(id);
-    if (ucs_async_handler_kh_is_end(hash_it)) {
-        ucs_debug("async handler [id=%d] not found in hash table", id);
+    pthread_mutex_lock(&ucs_async_global_context.handlers_lock);
+    table = *ucs_async_handler_table_ptr(id);
+    slot  = ucs_async_handler_table_slot(table, id);
+    if ((slot == NULL) || (*slot == NULL) || ((*slot)->id != id)) {
+        ucs_debug("async handler [id=%d] not found in the table", id);
         handler = NULL;
     } else {
-        handler = kh_value(&ucs_async_global_context.handlers, hash_it);
-        ucs_assert_always(handler->id == id);
-        kh_del(ucs_async_handler, &ucs_async_global_context.handlers, hash_it);
-        ucs_debug("removed async handler " UCS_ASYNC_HANDLER_FMT " from hash",
+        handler = *slot;
+        *slot   = NULL;
+        --table->count;
+        ucs_async_handlers_synchronize();
+        ucs_debug("removed async handler " UCS_ASYNC_HANDLER_FMT " from the table",
                   UCS_ASYNC_HANDLER_ARG(handler));
     }
-    pthread_rwlock_unlock(&ucs_async_global_context.handlers_lock);
+    pthread_mutex_unlock(&ucs_async_global_context.handlers_lock);
 
     return handler;
 }
@@ -145,39 +264,101 @@ static void ucs_async_handler_put(ucs_async_handler_t *handler)
     ucs_free(handler);
 }
 
+/* replace the table by a larger one, has to be called with the lock held */
+static ucs_status_t ucs_async_handler_table_grow(ucs_async_handler_table_t * volatile *table_p,
+                                                 unsigned size)
+{
+    ucs_async_handler_table_t *old_table = *table_p;
+    ucs_async_handler_table_t *new_table;
+    ucs_async_handler_t *handler;
+    unsigned i;
+
+    new_table = ucs_calloc(1, sizeof(*new_table) + size * sizeof(handler),
+                           "async handlers");
+    if (new_table == NULL) {
+        ucs_error("failed to allocate async handlers table of size %u", size);
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    new_table->size  = size;
+    new_table->count = 0;
+    if (old_table != NULL) {
+        for (i = 0; i < old_table->size; ++i) {
+            handler = old_table->slots[i];
+            if (handler != NULL) {
+                new_table->slots[ucs_async_handler_table_index(size, handler->id)] =
+                                handler;
+            }
+        }
+        new_table->count = old_table->count;
+    }
+
+    ucs_memory_cpu_store_fence();
+    *table_p = new_table;
+
+    if (old_table != NULL) {
+        ucs_async_handlers_synchronize();
+        ucs_free(old_table);
+    }
+    return UCS_OK;
+}
+
 /* add new handler to the table */
 static ucs_status_t ucs_async_handler_add(ucs_async_handler_t *handler)
 {
-    int hash_extra_status;
+    ucs_async_handler_table_t * volatile *table_p;
+    ucs_async_handler_t * volatile *slot;
     ucs_status_t status;
-    khiter_t hash_it;
+    unsigned size;
 
-    pthread_rwlock_wrlock(&ucs_async_global_context.handlers_lock);
+    pthread_mutex_lock(&ucs_async_global_context.handlers_lock);
 
     ucs_assert_always(handler->refcount == 1);
-    hash_it = kh_put(ucs_async_handler, &ucs_async_global_context.handlers,
-                     handler->id, &hash_extra_status);
-    if (hash_extra_status == -1) {
-        ucs_error("Failed to add async handler " UCS_ASYNC_HANDLER_FMT " to hash",
-                  UCS_ASYNC_HANDLER_ARG(handler));
-        status = UCS_ERR_NO_MEMORY;
-        goto out_unlock;
-    } else if (hash_extra_status == 0) {
-        ucs_error("Async handler " UCS_ASYNC_HANDLER_FMT " exists - cannot add %s()",
-                  UCS_ASYNC_HANDLER_ARG(kh_value(&ucs_async_global_context.handlers, hash_it)),
-                  ucs_debug_get_symbol_name(handler->cb));
+
+    /* Keep the timers table at most half full, so there are always free IDs */
+    table_p = ucs_async_handler_table_ptr(handler->id);
+    size    = (*table_p == NULL) ? UCS_ASYNC_HANDLERS_MIN_SIZE : (*table_p)->size;
+    if (ucs_async_handler_is_timer(handler->id)) {
+        while ((*table_p != NULL) && (((*table_p)->count + 1) * 2 > size)) {
+            size *= 2;
+        }
+    } else {
+        while (handler->id >= size) {
+            size *= 2;
+        }
+    }
+
+    if ((*table_p == NULL) || (size > (*table_p)->size)) {
+        status = ucs_async_handler_table_grow(table_p, size);
+        if (status != UCS_OK) {
+            goto out_unlock;
+        }
+    }
+
+    slot = ucs_async_handler_table_slot(*table_p, handler->id);
+    if (*slot != NULL) {
+        if (ucs_async_handler_is_timer(handler->id)) {
+            /* The caller would try another timer ID */
+            ucs_trace_async("timer id %d is in use by " UCS_ASYNC_HANDLER_FMT,
+                            handler->id, UCS_ASYNC_HANDLER_ARG(*slot));
+        } else {
+            ucs_error("Async handler " UCS_ASYNC_HANDLER_FMT " exists - cannot add %s()",
+                      UCS_ASYNC_HANDLER_ARG(*slot),
+                      ucs_debug_get_symbol_name(handler->cb));
+        }
         status = UCS_ERR_ALREADY_EXISTS;
         goto out_unlock;
     }
 
-    ucs_assert_always(!ucs_async_handler_kh_is_end(hash_it));
-    kh_value(&ucs_async_global_context.handlers, hash_it) = handler;
-    ucs_debug("added async handler " UCS_ASYNC_HANDLER_FMT " to hash",
+    ucs_memory_cpu_store_fence();
+    *slot = handler;
+    ++(*table_p)->count;
+    ucs_debug("added async handler " UCS_ASYNC_HANDLER_FMT " to the table",
               UCS_ASYNC_HANDLER_ARG(handler));
     status = UCS_OK;
 
 out_unlock:
-    pthread_rwlock_unlock(&ucs_async_global_context.handlers_lock);
+    pthread_mutex_unlock(&ucs_async_global_context.handlers_lock);
     return status;
 }
 
@@ -241,21 +422,28 @@ ucs_status_t ucs_async_dispatch_handlers(int *events, size_t count)
 ucs_status_t ucs_async_dispatch_timerq(ucs_timer_queue_t *timerq,
                                        ucs_time_t current_time)
 {
-    size_t max_timers, num_timers = 0;
-    int *expired_timers;
+    int expired_timers[UCS_ASYNC_TIMERS_BATCH];
+    ucs_status_t status = UCS_OK, tmp_status;
+    size_t num_timers;
     ucs_timer_t *timer;
 
-    max_timers     = ucs_max(1, ucs_timerq_size(timerq));
-    expired_timers = ucs_alloca(max_timers * sizeof(*expired_timers));
+    /* Dispatch the expired timers in batches, outside of the timer queue lock */
+    do {
+        num_timers = 0;
+        ucs_timerq_for_each_expired(timer, timerq, current_time, {
+            expired_timers[num_timers++] = timer->id;
+            if (num_timers >= UCS_ASYNC_TIMERS_BATCH) {
+                break; /* Keep timers which we don't have room for in the queue */
+            }
+        })
 
-    ucs_timerq_for_each_expired(timer, timerq, current_time, {
-        expired_timers[num_timers++] = timer->id;
-        if (num_timers >= max_timers) {
-            break; /* Keep timers which we don't have room for in the queue */
+        tmp_status = ucs_async_dispatch_handlers(expired_timers, num_timers);
+        if (tmp_status != UCS_OK) {
+            status = tmp_status;
         }
-    })
+    } while (num_timers == UCS_ASYNC_TIMERS_BATCH);
 
-    return ucs_async_dispatch_handlers(expired_timers, num_timers);
+    return status;
 }
 
 ucs_status_t ucs_async_context_init(ucs_async_context_t *async, ucs_async_mode_t mode)
@@ -264,6 +452,9 @@ ucs_status_t ucs_async_context_init(ucs_async_context_t *async, ucs_async_mode_t
 
     ucs_trace_func("async=%p", async);
 
+    /* Signals are delivered to the thread which creates the context */
+    ucs_async_register_reader();
+
     status = ucs_mpmc_queue_init(&async->missed, ucs_global_opts.async_max_events);
     if (status != UCS_OK) {
         goto err;
@@ -318,8 +509,8 @@ void ucs_async_context_cleanup(ucs_async_context_t *async)
     ucs_trace_func("async=%p", async);
 
     if (async->num_handlers > 0) {
-        pthread_rwlock_rdlock(&ucs_async_global_context.handlers_lock);
-        kh_foreach_value(&ucs_async_global_context.handlers, handler, {
+        pthread_mutex_lock(&ucs_async_global_context.handlers_lock);
+        ucs_async_handlers_for_each(handler, {
             if (async == handler->async) {
                 ucs_warn("async %p handler "UCS_ASYNC_HANDLER_FMT" %s() not released",
                          async, UCS_ASYNC_HANDLER_ARG(handler),
@@ -327,7 +518,7 @@ void ucs_async_context_cleanup(ucs_async_context_t *async)
             }
         });
         ucs_warn("releasing async context with %d handlers", async->num_handlers);
-        pthread_rwlock_unlock(&ucs_async_global_context.handlers_lock);
+        pthread_mutex_unlock(&ucs_async_global_context.handlers_lock);
     }
     ucs_mpmc_queue_cleanup(&async->missed);
 }
@@ -399,7 +590,10 @@ ucs_status_t ucs_async_set_event_handler(ucs_async_mode_t mode, int event_fd,
 {
     ucs_status_t status;
 
-    if (event_fd >= UCS_ASYNC_TIMER_ID_MIN) {
+    if (event_fd < 0) {
+        status = UCS_ERR_INVALID_PARAM;
+        goto err;
+    } else if (event_fd >= UCS_ASYNC_TIMER_ID_MIN) {
         /* File descriptor too large */
         status = UCS_ERR_EXCEEDS_LIMIT;
         goto err;
@@ -434,10 +628,9 @@ ucs_status_t ucs_async_add_timer(ucs_async_mode_t mode, ucs_time_t interval,
 
     /* Search for unused timer ID */
     do {
-        timer_id = ucs_atomic_fadd32(&ucs_async_global_context.timer_id, 1);
-        if (timer_id >= UCS_ASYNC_TIMER_ID_MAX) {
-            timer_id = UCS_ASYNC_TIMER_ID_MIN;
-        }
+        timer_id = UCS_ASYNC_TIMER_ID_MIN +
+                   (ucs_atomic_fadd32(&ucs_async_global_context.timer_id, 1) %
+                    (UCS_ASYNC_TIMER_ID_MAX - UCS_ASYNC_TIMER_ID_MIN));
 
         status = ucs_async_alloc_handler(mode, timer_id, cb, arg, async);
     } while (status == UCS_ERR_ALREADY_EXISTS);
@@ -505,6 +698,26 @@ ucs_status_t ucs_async_remove_handler(int id, int sync)
     return UCS_OK;
 }
 
+ucs_status_t ucs_async_modify_handler(int fd, int events)
+{
+    ucs_async_handler_t *handler;
+    ucs_status_t status;
+
+    if (fd >= UCS_ASYNC_TIMER_ID_MIN) {
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    handler = ucs_async_handler_get(fd);
+    if (handler == NULL) {
+        return UCS_ERR_NO_ELEM;
+    }
+
+    status = ucs_async_method_call(handler->mode, modify_event_fd,
+                                   handler->async, fd, events);
+    ucs_async_handler_put(handler);
+    return status;
+}
+
 void __ucs_async_poll_missed(ucs_async_context_t *async)
 {
     ucs_async_handler_t *handler;
@@ -513,6 +726,7 @@ void __ucs_async_poll_missed(ucs_async_context_t *async)
 
     ucs_trace_async("miss handler");
 
+    ucs_async_register_reader();
     while (!ucs_mpmc_queue_is_empty(&async->missed)) {
 
         status = ucs_mpmc_queue_pull(&async->missed, &value);
@@ -544,22 +758,26 @@ void __ucs_async_poll_missed(ucs_async_context_t *async)
 void ucs_async_poll(ucs_async_context_t *async)
 {
     ucs_async_handler_t **handlers, *handler;
-    size_t i, n;
+    size_t i, n, max;
+    int section;
 
     ucs_trace_poll("async=%p", async);
 
-    pthread_rwlock_rdlock(&ucs_async_global_context.handlers_lock);
-    handlers = ucs_alloca(kh_size(&ucs_async_global_context.handlers) * sizeof(*handlers));
+    ucs_async_register_reader();
+    section  = ucs_async_handlers_read_begin();
+    max      = ucs_async_handlers_count();
+    handlers = ucs_alloca(max * sizeof(*handlers));
     n = 0;
-    kh_foreach_value(&ucs_async_global_context.handlers, handler, {
-        if (((async == NULL) || (async == handler->async)) &&  /* Async context match */
+    ucs_async_handlers_for_each(handler, {
+        if ((n < max) && /* Skip handlers added concurrently */
+            ((async == NULL) || (async == handler->async)) &&  /* Async context match */
             ((handler->async == NULL) || (handler->async->poll_block == 0))) /* Not blocked */
         {
             ucs_async_handler_hold(handler);
             handlers[n++] = handler;
         }
     });
-    pthread_rwlock_unlock(&ucs_async_global_context.handlers_lock);
+    ucs_async_handlers_read_end(section);
 
     for (i = 0; i < n; ++i) {
         ucs_async_handler_dispatch(handlers[i]);
@@ -569,19 +787,20 @@ void ucs_async_poll(ucs_async_context_t *async)
 
 void ucs_async_global_init()
 {
-    pthread_rwlock_init(&ucs_async_global_context.handlers_lock, NULL);
-    kh_init_inplace(ucs_async_handler, &ucs_async_global_context.handlers);
     ucs_async_method_call_all(init);
 }
 
 void ucs_async_global_cleanup()
 {
-    int num_elems = kh_size(&ucs_async_global_context.handlers);
+    unsigned num_elems = ucs_async_handlers_count();
     if (num_elems != 0) {
-        ucs_info("async handler table is not empty during exit (contains %d elems)",
+        ucs_info("async handler table is not empty during exit (contains %u elems)",
                  num_elems);
     }
     ucs_async_method_call_all(cleanup);
-    kh_destroy_inplace(ucs_async_handler, &ucs_async_global_context.handlers);
-    pthread_rwlock_destroy(&ucs_async_global_context.handlers_lock);
+    ucs_free(ucs_async_global_context.fd_handlers);
+    ucs_free(ucs_async_global_context.timer_handlers);
+    ucs_async_global_context.fd_handlers    = NULL;
+    ucs_async_global_context.timer_handlers = NULL;
+    ucs_epoch_cleanup(&ucs_async_global_context.epoch);
 }
@@ -46,6 +46,19 @@ ucs_status_t ucs_async_set_event_handler(ucs_async_mode_t mode, int event_fd,
                                          void *arg, ucs_async_context_t *async);
 
 
+/**
+ * @ingroup UCS_RESOURCE
+ *
+ * Change the events which an event handler waits on.
+ *
+ * @param fd              File descriptor whose handler to modify.
+ * @param events          New events to wait on (POLLxx/EPOLLxx bits).
+ *
+ * @return Error code as defined by @ref ucs_status_t.
+ */
+ucs_status_t ucs_async_modify_handler(int fd, int events);
+
+
 /**
  * @ingroup UCS_RESOURCE
  *
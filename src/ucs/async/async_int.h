@@ -26,6 +26,13 @@ struct ucs_async_handler {
 };
 
 
+/**
+ * Get a record for looking up handlers from the calling thread, so the lookups
+ * would not write shared memory. Must not be called from a signal handler.
+ */
+void ucs_async_register_reader();
+
+
 /**
  * Dispatch event coming from async context.
  *
@@ -62,6 +69,8 @@ typedef struct ucs_async_ops {
     ucs_status_t (*add_event_fd)(ucs_async_context_t *async, int event_fd,
                                  int events);
     ucs_status_t (*remove_event_fd)(ucs_async_context_t *async, int event_fd);
+    ucs_status_t (*modify_event_fd)(ucs_async_context_t *async, int event_fd,
+                                    int events);
 
     ucs_status_t (*add_timer)(ucs_async_context_t *async, int timer_id,
                               ucs_time_t interval);
@@ -374,9 +374,12 @@ ucs_async_signal_timerq_add_timer(ucs_async_signal_timer_t *timer, int tid,
     int uid;
 
     if (timer->tid == 0) {
-        timer->tid = tid;
-        ucs_timerq_init(&timer->timerq);
+        status = ucs_timerq_init(&timer->timerq);
+        if (status != UCS_OK) {
+            return status;
+        }
 
+        timer->tid = tid;
         uid = (timer - ucs_async_signal_global_context.timers);
         status = ucs_async_signal_sys_timer_create(uid, timer->tid,
                                                    &timer->sys_timer_id);
@@ -541,6 +544,7 @@ ucs_async_ops_t ucs_async_signal_ops = {
     .context_unblock    = ucs_async_signal_unblock,
     .add_event_fd       = ucs_async_signal_add_event_fd,
     .remove_event_fd    = ucs_async_signal_remove_event_fd,
+    .modify_event_fd    = ucs_empty_function_return_success,
     .add_timer          = ucs_async_signal_add_timer,
     .remove_timer       = ucs_async_signal_remove_timer,
 };
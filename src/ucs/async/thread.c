@@ -13,12 +13,15 @@
 #include "pipe.h"
 
 #include <ucs/arch/atomic.h>
+#include <ucs/config/global_opts.h>
+#include <ucs/config/parser.h>
 #include <ucs/sys/checker.h>
 #include <ucs/sys/sys.h>
 
 
 #define UCS_ASYNC_EPOLL_MAX_EVENTS      16
 #define UCS_ASYNC_EPOLL_MIN_TIMEOUT_MS  2.0
+#define UCS_ASYNC_THREADS_MAX           64
 
 
 typedef struct ucs_async_thread {
@@ -31,17 +34,33 @@ typedef struct ucs_async_thread {
 } ucs_async_thread_t;
 
 
+typedef struct ucs_async_thread_slot {
+    ucs_async_thread_t *thread;       /* Running thread, or NULL */
+    unsigned           use_count;     /* Number of users of the thread */
+    ucs_cpu_set_t      cpus;          /* CPUs the thread is near to */
+} ucs_async_thread_slot_t;
+
+
+/*
+ * Pool of progress threads. Every async context is assigned to a thread near
+ * the CPU it was created on, and the thread is started when the context adds
+ * the first event or timer. Handlers without a context use the first thread.
+ */
 typedef struct ucs_async_thread_global_context {
-    ucs_async_thread_t *thread;
-    unsigned           use_count;
+    ucs_async_thread_slot_t slots[UCS_ASYNC_THREADS_MAX];
+    unsigned           num_threads;     /* Size of the pool, 0 - not set up */
+    int                bind;            /* Bind the threads to their CPUs */
+    unsigned           next_thread;     /* Spread contexts between threads */
+    unsigned           config_threads;  /* Configuration of the pool */
+    ucs_cpu_set_t      config_affinity;
     pthread_mutex_t    lock;
 } ucs_async_thread_global_context_t;
 
 
 static ucs_async_thread_global_context_t ucs_async_thread_global_context = {
-    .thread    = NULL,
-    .use_count = 0,
-    .lock      = PTHREAD_MUTEX_INITIALIZER
+    .num_threads = 0,
+    .next_thread = 0,
+    .lock        = PTHREAD_MUTEX_INITIALIZER
 };
 
 
@@ -72,6 +91,7 @@ static void *ucs_async_thread_func(void *arg)
     is_missed  = 0;
     curr_time  = ucs_get_time();
     last_time  = ucs_get_time();
+    ucs_async_register_reader();
 
     while (!thread->stop) {
 
@@ -133,24 +153,187 @@ static void *ucs_async_thread_func(void *arg)
     return NULL;
 }
 
-static ucs_status_t ucs_async_thread_start(ucs_async_thread_t **thread_p)
+static int ucs_async_thread_cpu_set_is_empty(const ucs_cpu_set_t *cpu_set)
+{
+    int i;
+
+    for (i = 0; i < UCS_CPU_SETSIZE / UCS_NCPUBITS; ++i) {
+        if (cpu_set->ucs_bits[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void ucs_async_thread_pool_log(ucs_async_thread_global_context_t *ctx)
+{
+    char buf[256];
+    unsigned i;
+
+    for (i = 0; i < ctx->num_threads; ++i) {
+        ucs_config_sprintf_cpu_set(buf, sizeof(buf), &ctx->slots[i].cpus, NULL);
+        ucs_debug("async thread %u: cpus %s%s", i, buf,
+                  ctx->bind ? "" : " (not bound)");
+    }
+}
+
+/* Has to be called with the lock held */
+static void ucs_async_thread_pool_setup()
+{
+    ucs_async_thread_global_context_t *ctx = &ucs_async_thread_global_context;
+    const ucs_cpu_set_t *affinity = &ucs_global_opts.async_thread_affinity;
+    int has_affinity              = !ucs_async_thread_cpu_set_is_empty(affinity);
+    unsigned num_cpus, index, i;
+    ucs_cpu_set_t cpus;
+    int cpu;
+
+    if ((ctx->num_threads > 0) &&
+        (ctx->config_threads == ucs_global_opts.async_threads) &&
+        !memcmp(&ctx->config_affinity, affinity, sizeof(*affinity)))
+    {
+        return;
+    }
+
+    ctx->config_threads  = ucs_global_opts.async_threads;
+    ctx->config_affinity = *affinity;
+    for (i = 0; i < UCS_ASYNC_THREADS_MAX; ++i) {
+        UCS_CPU_ZERO(&ctx->slots[i].cpus);
+    }
+
+    if (ucs_global_opts.async_threads == 0) {
+        /* A thread per NUMA node, bound to the node */
+        for (index = 0; index < UCS_ASYNC_THREADS_MAX; ++index) {
+            if (ucs_get_numa_node_cpus(index, &ctx->slots[index].cpus) != UCS_OK) {
+                break;
+            }
+            if (has_affinity) {
+                for (i = 0; i < UCS_CPU_SETSIZE / UCS_NCPUBITS; ++i) {
+                    ctx->slots[index].cpus.ucs_bits[i] &= affinity->ucs_bits[i];
+                }
+            }
+        }
+        ctx->num_threads = ucs_max(index, 1);
+        ctx->bind        = (index > 0);
+    } else {
+        /* Split the CPUs in order between the threads */
+        ctx->num_threads = ucs_min(ucs_global_opts.async_threads,
+                                   UCS_ASYNC_THREADS_MAX);
+        ctx->bind        = has_affinity;
+        if (has_affinity) {
+            cpus = *affinity;
+        } else {
+            UCS_CPU_ZERO(&cpus);
+            for (cpu = 0; cpu < sysconf(_SC_NPROCESSORS_CONF); ++cpu) {
+                UCS_CPU_SET(cpu, &cpus);
+            }
+        }
+
+        num_cpus = 0;
+        for (cpu = 0; cpu < UCS_CPU_SETSIZE; ++cpu) {
+            num_cpus += ucs_cpu_is_set(cpu, &cpus);
+        }
+
+        /* If there are less CPUs than threads, the threads share them */
+        i = 0;
+        for (cpu = 0; cpu < UCS_CPU_SETSIZE; ++cpu) {
+            if (!ucs_cpu_is_set(cpu, &cpus)) {
+                continue;
+            }
+            if (num_cpus >= ctx->num_threads) {
+                UCS_CPU_SET(cpu, &ctx->slots[i * ctx->num_threads / num_cpus].cpus);
+            } else {
+                for (index = i; index < ctx->num_threads; index += num_cpus) {
+                    UCS_CPU_SET(cpu, &ctx->slots[index].cpus);
+                }
+            }
+            ++i;
+        }
+    }
+
+    ucs_async_thread_pool_log(ctx);
+}
+
+static unsigned ucs_async_thread_select()
 {
+    ucs_async_thread_global_context_t *ctx = &ucs_async_thread_global_context;
+    int cpu = sched_getcpu();
+    unsigned num_near, nth, index, i;
+
+    pthread_mutex_lock(&ctx->lock);
+    ucs_async_thread_pool_setup();
+
+    /* Count the threads near the current CPU */
+    num_near = 0;
+    if (cpu >= 0) {
+        for (i = 0; i < ctx->num_threads; ++i) {
+            num_near += ucs_cpu_is_set(cpu, &ctx->slots[i].cpus);
+        }
+    }
+
+    /* Take the next one of the near threads, or just the next thread */
+    if (num_near == 0) {
+        index = ctx->next_thread++ % ctx->num_threads;
+    } else {
+        nth = ctx->next_thread++ % num_near;
+        for (index = 0; index < ctx->num_threads; ++index) {
+            if (ucs_cpu_is_set(cpu, &ctx->slots[index].cpus) && (nth-- == 0)) {
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->lock);
+    return index;
+}
+
+static unsigned ucs_async_thread_index(ucs_async_context_t *async)
+{
+    return (async == NULL) ? 0 : async->thread.thread_index;
+}
+
+static void ucs_async_thread_bind(ucs_async_thread_t *thread,
+                                  const ucs_cpu_set_t *cpus)
+{
+    cpu_set_t cpu_set;
+    int cpu, ret;
+
+    if (ucs_async_thread_cpu_set_is_empty(cpus)) {
+        return;
+    }
+
+    CPU_ZERO(&cpu_set);
+    for (cpu = 0; (cpu < UCS_CPU_SETSIZE) && (cpu < CPU_SETSIZE); ++cpu) {
+        if (ucs_cpu_is_set(cpu, cpus)) {
+            CPU_SET(cpu, &cpu_set);
+        }
+    }
+
+    ret = pthread_setaffinity_np(thread->thread_id, sizeof(cpu_set), &cpu_set);
+    if (ret != 0) {
+        ucs_warn("failed to set async thread affinity: %s", strerror(ret));
+    }
+}
+
+static ucs_status_t ucs_async_thread_start(unsigned index,
+                                           ucs_async_thread_t **thread_p)
+{
+    ucs_async_thread_slot_t *slot = &ucs_async_thread_global_context.slots[index];
     ucs_async_thread_t *thread;
     struct epoll_event event;
     ucs_status_t status;
     int wakeup_rfd;
     int ret;
 
-    ucs_trace_func("");
+    ucs_trace_func("index=%u", index);
 
     pthread_mutex_lock(&ucs_async_thread_global_context.lock);
-    if (ucs_async_thread_global_context.use_count++ > 0) {
+    if (slot->use_count++ > 0) {
         /* Thread already started */
         status = UCS_OK;
         goto out_unlock;
     }
 
-    ucs_assert_always(ucs_async_thread_global_context.thread == NULL);
+    ucs_assert_always(slot->thread == NULL);
 
     thread = ucs_malloc(sizeof(*thread), "async_thread_context");
     if (thread == NULL) {
@@ -199,7 +382,11 @@ static ucs_status_t ucs_async_thread_start(ucs_async_thread_t **thread_p)
         goto err_close_epfd;
     }
 
-    ucs_async_thread_global_context.thread = thread;
+    if (ucs_async_thread_global_context.bind) {
+        ucs_async_thread_bind(thread, &slot->cpus);
+    }
+
+    slot->thread = thread;
     status = UCS_OK;
     goto out_unlock;
 
@@ -212,27 +399,31 @@ err_timerq_cleanup:
 err_free:
     ucs_free(thread);
 err:
-    --ucs_async_thread_global_context.use_count;
+    --slot->use_count;
+    pthread_mutex_unlock(&ucs_async_thread_global_context.lock);
+    return status;
+
 out_unlock:
-    ucs_assert_always(ucs_async_thread_global_context.thread != NULL);
-    *thread_p = ucs_async_thread_global_context.thread;
+    ucs_assert_always(slot->thread != NULL);
+    *thread_p = slot->thread;
     pthread_mutex_unlock(&ucs_async_thread_global_context.lock);
     return status;
 }
 
-static void ucs_async_thread_stop()
+static void ucs_async_thread_stop(unsigned index)
 {
+    ucs_async_thread_slot_t *slot = &ucs_async_thread_global_context.slots[index];
     ucs_async_thread_t *thread = NULL;
 
-    ucs_trace_func("");
+    ucs_trace_func("index=%u", index);
 
     pthread_mutex_lock(&ucs_async_thread_global_context.lock);
-    if (--ucs_async_thread_global_context.use_count == 0) {
-        thread = ucs_async_thread_global_context.thread;
+    if (--slot->use_count == 0) {
+        thread = slot->thread;
         ucs_async_thread_hold(thread);
         thread->stop = 1;
         ucs_async_pipe_push(&thread->wakeup);
-        ucs_async_thread_global_context.thread = NULL;
+        slot->thread = NULL;
     }
     pthread_mutex_unlock(&ucs_async_thread_global_context.lock);
 
@@ -248,6 +439,8 @@ static void ucs_async_thread_stop()
 
 static ucs_status_t ucs_async_thread_init(ucs_async_context_t *async)
 {
+    async->thread.thread_index = ucs_async_thread_select();
+
 #if !(NVALGRIND)
     pthread_mutexattr_t attr;
     int ret;
@@ -270,12 +463,13 @@ static ucs_status_t ucs_async_thread_init(ucs_async_context_t *async)
 static ucs_status_t ucs_async_thread_add_event_fd(ucs_async_context_t *async,
                                                   int event_fd, int events)
 {
+    unsigned index = ucs_async_thread_index(async);
     ucs_async_thread_t *thread;
     struct epoll_event event;
     ucs_status_t status;
     int ret;
 
-    status = ucs_async_thread_start(&thread);
+    status = ucs_async_thread_start(index, &thread);
     if (status != UCS_OK) {
         goto err;
     }
@@ -295,7 +489,7 @@ static ucs_status_t ucs_async_thread_add_event_fd(ucs_async_context_t *async,
     return UCS_OK;
 
 err_removed:
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(index);
 err:
     return status;
 }
@@ -303,7 +497,8 @@ err:
 static ucs_status_t ucs_async_thread_remove_event_fd(ucs_async_context_t *async,
                                                      int event_fd)
 {
-    ucs_async_thread_t *thread = ucs_async_thread_global_context.thread;
+    unsigned index = ucs_async_thread_index(async);
+    ucs_async_thread_t *thread = ucs_async_thread_global_context.slots[index].thread;
     int ret;
 
     ret = epoll_ctl(thread->epfd, EPOLL_CTL_DEL, event_fd, NULL);
@@ -313,7 +508,28 @@ static ucs_status_t ucs_async_thread_remove_event_fd(ucs_async_context_t *async,
         return UCS_ERR_INVALID_PARAM;
     }
 
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(index);
+    return UCS_OK;
+}
+
+static ucs_status_t ucs_async_thread_modify_event_fd(ucs_async_context_t *async,
+                                                     int event_fd, int events)
+{
+    unsigned index = ucs_async_thread_index(async);
+    ucs_async_thread_t *thread = ucs_async_thread_global_context.slots[index].thread;
+    struct epoll_event event;
+    int ret;
+
+    memset(&event, 0, sizeof(event));
+    event.events  = events;
+    event.data.fd = event_fd;
+    ret = epoll_ctl(thread->epfd, EPOLL_CTL_MOD, event_fd, &event);
+    if (ret < 0) {
+        ucs_error("epoll_ctl(epfd=%d, MOD, fd=%d) failed: %m", thread->epfd,
+                  event_fd);
+        return UCS_ERR_IO_ERROR;
+    }
+
     return UCS_OK;
 }
 
@@ -335,6 +551,7 @@ static void ucs_async_thread_unblock(ucs_async_context_t *async)
 static ucs_status_t ucs_async_thread_add_timer(ucs_async_context_t *async,
                                                int timer_id, ucs_time_t interval)
 {
+    unsigned index = ucs_async_thread_index(async);
     ucs_async_thread_t *thread;
     ucs_status_t status;
 
@@ -344,7 +561,7 @@ static ucs_status_t ucs_async_thread_add_timer(ucs_async_context_t *async,
         goto err;
     }
 
-    status = ucs_async_thread_start(&thread);
+    status = ucs_async_thread_start(index, &thread);
     if (status != UCS_OK) {
         goto err;
     }
@@ -358,7 +575,7 @@ static ucs_status_t ucs_async_thread_add_timer(ucs_async_context_t *async,
     return UCS_OK;
 
 err_stop:
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(index);
 err:
     return status;
 }
@@ -366,18 +583,26 @@ err:
 static ucs_status_t ucs_async_thread_remove_timer(ucs_async_context_t *async,
                                                   int timer_id)
 {
-    ucs_async_thread_t *thread = ucs_async_thread_global_context.thread;
+    unsigned index = ucs_async_thread_index(async);
+    ucs_async_thread_t *thread = ucs_async_thread_global_context.slots[index].thread;
+
     ucs_timerq_remove(&thread->timerq, timer_id);
     ucs_async_pipe_push(&thread->wakeup);
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(index);
     return UCS_OK;
 }
 
 static void ucs_async_signal_global_cleanup()
 {
-    if (ucs_async_thread_global_context.thread != NULL) {
-        ucs_info("async thread still running (use count %d)",
-                 ucs_async_thread_global_context.use_count);
+    ucs_async_thread_slot_t *slot;
+    unsigned index;
+
+    for (index = 0; index < UCS_ASYNC_THREADS_MAX; ++index) {
+        slot = &ucs_async_thread_global_context.slots[index];
+        if (slot->thread != NULL) {
+            ucs_info("async thread %u still running (use count %u)", index,
+                     slot->use_count);
+        }
     }
 }
 
@@ -391,6 +616,7 @@ ucs_async_ops_t ucs_async_thread_ops = {
     .context_unblock    = ucs_async_thread_unblock,
     .add_event_fd       = ucs_async_thread_add_event_fd,
     .remove_event_fd    = ucs_async_thread_remove_event_fd,
+    .modify_event_fd    = ucs_async_thread_modify_event_fd,
     .add_timer          = ucs_async_thread_add_timer,
     .remove_timer       = ucs_async_thread_remove_timer,
 };
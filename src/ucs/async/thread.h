@@ -18,6 +18,7 @@ typedef struct ucs_async_thread_context {
 #endif
         ucs_spinlock_t  spinlock;
     };
+    unsigned            thread_index; /* Progress thread serving the context */
 } ucs_async_thread_context_t;
 
 
@@ -26,6 +26,7 @@ ucs_global_opts_t ucs_global_opts = {
     .debug_signo           = SIGHUP,
     .async_max_events      = 64,
     .async_signo           = SIGALRM,
+    .async_threads         = 1,
     .stats_dest            = "",
     .tuning_path           = "",
     .memtrack_dest         = "",
@@ -118,6 +119,18 @@ static ucs_config_field_t ucs_global_opts_table[] = {
   "Signal number used for async signaling.",
   ucs_offsetof(ucs_global_opts_t, async_signo), UCS_CONFIG_TYPE_SIGNO},
 
+ {"ASYNC_THREADS", "1",
+  "Number of progress threads for thread-mode async events. 0 means one thread\n"
+  "per NUMA node, bound to the CPUs of the node. An async context is served by\n"
+  "a thread near the CPU the context was created on.",
+  ucs_offsetof(ucs_global_opts_t, async_threads), UCS_CONFIG_TYPE_UINT},
+
+ {"ASYNC_THREAD_AFFINITY", "",
+  "CPUs to bind the async progress threads to. They are split between the\n"
+  "threads in order. If empty, the threads are not bound, except for the\n"
+  "per-NUMA-node threads.",
+  ucs_offsetof(ucs_global_opts_t, async_thread_affinity), UCS_CONFIG_TYPE_CPU_SET},
+
 #if ENABLE_STATS
  {"STATS_DEST", "",
   "Destination to send statistics to. If the value is empty, statistics are\n"
@@ -180,8 +193,16 @@ static ucs_config_field_t ucs_global_opts_table[] = {
    ucs_offsetof(ucs_global_opts_t, profile_file), UCS_CONFIG_TYPE_STRING},
 
   {"PROFILE_LOG_SIZE", "4m",
-   "Maximal size of profiling log. New records will replace old records.",
+   "Maximal size of the profiling log of each thread. New records will replace\n"
+   "old records.",
    ucs_offsetof(ucs_global_opts_t, profile_log_size), UCS_CONFIG_TYPE_MEMUNITS},
+
+  {"PROFILE_STREAM", "n",
+   "Write the profiling log continuously instead of keeping only its last part.\n"
+   "Every thread passes full parts of its log to a background thread, which\n"
+   "appends them to the profiling file. If the background thread falls behind,\n"
+   "records are dropped and their number is reported in the file.",
+   ucs_offsetof(ucs_global_opts_t, profile_stream), UCS_CONFIG_TYPE_BOOL},
 #endif
 
  {NULL}
@@ -10,6 +10,7 @@
 #include "types.h"
 
 #include <ucs/stats/stats_fwd.h>
+#include <ucs/type/cpu_set.h>
 #include <ucs/type/status.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -78,6 +79,12 @@ typedef struct {
     /* Signal number used by async handler (for signal mode) */
     unsigned                 async_signo;
 
+    /* Number of async progress threads, 0 - one per NUMA node */
+    unsigned                 async_threads;
+
+    /* CPUs to run the async progress threads on, empty - no binding */
+    ucs_cpu_set_t            async_thread_affinity;
+
     /* Destination for detailed memory tracking results: none / stdout / stderr
      */
     char                     *memtrack_dest;
@@ -91,6 +98,9 @@ typedef struct {
     /* Limit for profiling log size */
      size_t                   profile_log_size;
 
+    /* Whether to write the profiling log continuously */
+    int                      profile_stream;
+
     /* Counters to be included in statistics summary */
     ucs_config_names_array_t stats_filter;
 
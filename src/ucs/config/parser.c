@@ -422,6 +422,36 @@ int ucs_config_sprintf_memunits(char *buf, size_t max, void *src, const void *ar
     return 1;
 }
 
+int ucs_config_sscanf_ulunits(const char *buf, void *dest, const void *arg)
+{
+    /* Special value: infinity */
+    if (!strcasecmp(buf, "inf")) {
+        *(unsigned long*)dest = UCS_CONFIG_ULUNITS_INF;
+        return 1;
+    }
+
+    /* Special value: auto */
+    if (!strcasecmp(buf, "auto")) {
+        *(unsigned long*)dest = UCS_CONFIG_ULUNITS_AUTO;
+        return 1;
+    }
+
+    return ucs_config_sscanf_ulong(buf, dest, arg);
+}
+
+int ucs_config_sprintf_ulunits(char *buf, size_t max, void *src, const void *arg)
+{
+    unsigned long val = *(unsigned long*)src;
+
+    if (val == UCS_CONFIG_ULUNITS_INF) {
+        return snprintf(buf, max, "inf");
+    } else if (val == UCS_CONFIG_ULUNITS_AUTO) {
+        return snprintf(buf, max, "auto");
+    }
+
+    return ucs_config_sprintf_ulong(buf, max, src, arg);
+}
+
 int ucs_config_sscanf_range_spec(const char *buf, void *dest, const void *arg)
 {
     ucs_range_spec_t *range_spec = dest;
@@ -486,6 +516,48 @@ ucs_status_t ucs_config_clone_range_spec(void *src, void *dest, const void *arg)
     return UCS_OK;
 }
 
+int ucs_config_sscanf_cpu_set(const char *buf, void *dest, const void *arg)
+{
+    return ucs_parse_cpu_list(buf, dest) == UCS_OK;
+}
+
+int ucs_config_sprintf_cpu_set(char *buf, size_t max, void *src, const void *arg)
+{
+    ucs_cpu_set_t *cpu_set = src;
+    size_t length = 0;
+    int first, last;
+
+    buf[0] = '\0';
+    for (first = 0; first < UCS_CPU_SETSIZE; first = last + 1) {
+        if (!ucs_cpu_is_set(first, cpu_set)) {
+            last = first;
+            continue;
+        }
+
+        for (last = first;
+             (last + 1 < UCS_CPU_SETSIZE) && ucs_cpu_is_set(last + 1, cpu_set);
+             ++last);
+        if (length >= max) {
+            break;
+        }
+
+        if (first == last) {
+            length += snprintf(buf + length, max - length, "%s%d",
+                               (length > 0) ? "," : "", first);
+        } else {
+            length += snprintf(buf + length, max - length, "%s%d-%d",
+                               (length > 0) ? "," : "", first, last);
+        }
+    }
+    return 1;
+}
+
+ucs_status_t ucs_config_clone_cpu_set(void *src, void *dest, const void *arg)
+{
+    memcpy(dest, src, sizeof(ucs_cpu_set_t));
+    return UCS_OK;
+}
+
 int ucs_config_sscanf_array(const char *buf, void *dest, const void *arg)
 {
     ucs_config_array_field_t *field = dest;
@@ -123,10 +123,17 @@ int ucs_config_sprintf_signo(char *buf, size_t max, void *src, const void *arg);
 int ucs_config_sscanf_memunits(const char *buf, void *dest, const void *arg);
 int ucs_config_sprintf_memunits(char *buf, size_t max, void *src, const void *arg);
 
+int ucs_config_sscanf_ulunits(const char *buf, void *dest, const void *arg);
+int ucs_config_sprintf_ulunits(char *buf, size_t max, void *src, const void *arg);
+
 int ucs_config_sscanf_range_spec(const char *buf, void *dest, const void *arg);
 int ucs_config_sprintf_range_spec(char *buf, size_t max, void *src, const void *arg);
 ucs_status_t ucs_config_clone_range_spec(void *src, void *dest, const void *arg);
 
+int ucs_config_sscanf_cpu_set(const char *buf, void *dest, const void *arg);
+int ucs_config_sprintf_cpu_set(char *buf, size_t max, void *src, const void *arg);
+ucs_status_t ucs_config_clone_cpu_set(void *src, void *dest, const void *arg);
+
 int ucs_config_sscanf_array(const char *buf, void *dest, const void *arg);
 int ucs_config_sprintf_array(char *buf, size_t max, void *src, const void *arg);
 ucs_status_t ucs_config_clone_array(void *src, void *dest, const void *arg);
@@ -207,6 +214,11 @@ void ucs_config_help_generic(char *buf, size_t max, const void *arg);
                                     ucs_config_help_generic,     \
                                     "memory units: <number>[b|kb|mb|gb], \"inf\", or \"auto\""}
 
+#define UCS_CONFIG_TYPE_ULUNITS    {ucs_config_sscanf_ulunits,   ucs_config_sprintf_ulunits, \
+                                    ucs_config_clone_ulong,      ucs_config_release_nop, \
+                                    ucs_config_help_generic,     \
+                                    "unsigned long: <number>, \"inf\", or \"auto\""}
+
 #define UCS_CONFIG_TYPE_ARRAY(a)   {ucs_config_sscanf_array,     ucs_config_sprintf_array, \
                                     ucs_config_clone_array,      ucs_config_release_array, \
                                     ucs_config_help_array,       &ucs_config_array_##a}
@@ -219,6 +231,11 @@ void ucs_config_help_generic(char *buf, size_t max, const void *arg);
                                     ucs_config_clone_range_spec, ucs_config_release_nop, \
                                     ucs_config_help_generic,     "numbers range: <number>-<number>"}
 
+#define UCS_CONFIG_TYPE_CPU_SET    {ucs_config_sscanf_cpu_set,   ucs_config_sprintf_cpu_set, \
+                                    ucs_config_clone_cpu_set,    ucs_config_release_nop, \
+                                    ucs_config_help_generic,     \
+                                    "list of CPUs: <number>[-<number>][,...], or empty"}
+
 /*
  * Helpers for using an array of strings.
  */
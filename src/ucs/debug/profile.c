@@ -6,11 +6,37 @@
 
 #include "profile.h"
 
+#include <ucs/datastruct/queue.h>
 #include <ucs/sys/string.h>
 #include <ucs/sys/sys.h>
+#include <signal.h>
 
 #if HAVE_PROFILING
 
+/* Number of parts the log buffer of a thread is split into in streaming mode */
+#define UCS_PROFILE_STREAM_NUM_SEGMENTS  4
+
+/* How often the writer thread looks for full segments, in milliseconds */
+#define UCS_PROFILE_STREAM_INTERVAL_MS   10
+
+/* Number of records made to estimate the cost of a single record */
+#define UCS_PROFILE_CALIBRATE_ITERS      1024
+
+
+/*
+ * Part of a thread's log buffer, which is passed as a whole to the writer
+ * thread in streaming mode.
+ */
+typedef struct ucs_profile_segment {
+    ucs_queue_elem_t             queue;       /* Entry in the writer queue */
+    ucs_profile_thread_context_t *ctx;        /* Thread which made the records */
+    ucs_profile_record_t         *start;      /* First record of the segment */
+    ucs_profile_record_t         *end;        /* End of the segment buffer */
+    size_t                       num_records; /* Number of records to write */
+    volatile int                 busy;        /* Passed to the writer thread */
+} ucs_profile_segment_t;
+
+
 const char *ucs_profile_mode_names[] = {
     [UCS_PROFILE_MODE_ACCUM] = "accum",
     [UCS_PROFILE_MODE_LOG]   = "log",
@@ -18,14 +44,19 @@ const char *ucs_profile_mode_names[] = {
 };
 
 ucs_profile_global_context_t ucs_profile_ctx = {
-    .locations       = NULL,
-    .log.start       = NULL,
-    .log.end         = NULL,
-    .log.current     = NULL,
-    .log.wraparound  = 0,
-    .accum.stack_top = -1,
-    .num_locations   = 0,
-    .max_locations   = 0,
+    .locations         = NULL,
+    .num_locations     = 0,
+    .max_locations     = 0,
+    .lock              = PTHREAD_MUTEX_INITIALIZER,
+    .tls_key_valid     = 0,
+    .thread_list       = UCS_LIST_INITIALIZER(&ucs_profile_ctx.thread_list,
+                                              &ucs_profile_ctx.thread_list),
+    .num_threads       = 0,
+    .record_cost       = 0,
+    .stream.fd         = -1,
+    .stream.lock       = PTHREAD_MUTEX_INITIALIZER,
+    .stream.cond       = PTHREAD_COND_INITIALIZER,
+    .stream.file_lock  = PTHREAD_MUTEX_INITIALIZER
 };
 
 static void ucs_profile_file_write_data(int fd, void *data, size_t size)
@@ -39,23 +70,30 @@ static void ucs_profile_file_write_data(int fd, void *data, size_t size)
     }
 }
 
+static void ucs_profile_file_pwrite_data(int fd, void *data, size_t size,
+                                         off_t offset)
+{
+    ssize_t written = pwrite(fd, data, size, offset);
+    if (written < 0) {
+        ucs_warn("failed to write %Zu bytes to profiling file: %m", size);
+    } else if (size != written) {
+        ucs_warn("wrote only %Zd of %Zu bytes to profiling file: %m",
+                 written, size);
+    }
+}
+
 static void ucs_profile_file_write_records(int fd, ucs_profile_record_t *begin,
                                            ucs_profile_record_t *end)
 {
     ucs_profile_file_write_data(fd, begin, (void*)end - (void*)begin);
 }
 
-static void ucs_profile_write()
+static int ucs_profile_file_open()
 {
-    ucs_profile_header_t header;
     char fullpath[1024] = {0};
     char filename[1024] = {0};
     int fd;
 
-    if (!ucs_global_opts.profile_mode) {
-        return;
-    }
-
     ucs_fill_filename_template(ucs_global_opts.profile_file,
                                filename, sizeof(filename));
     ucs_expand_path(filename, fullpath, sizeof(fullpath) - 1);
@@ -63,38 +101,416 @@ static void ucs_profile_write()
     fd = open(fullpath, O_WRONLY|O_CREAT|O_TRUNC, 0600);
     if (fd < 0) {
         ucs_error("failed to write profiling data to '%s': %m", fullpath);
+    }
+
+    return fd;
+}
+
+static size_t ucs_profile_thread_num_records(ucs_profile_thread_context_t *ctx)
+{
+    return ctx->log.wraparound ? (ctx->log.end     - ctx->log.start) :
+                                 (ctx->log.current - ctx->log.start);
+}
+
+static void ucs_profile_write_thread(int fd, ucs_profile_thread_context_t *ctx)
+{
+    ucs_profile_thread_header_t thread_hdr;
+
+    thread_hdr.tid         = ctx->tid;
+    thread_hdr.start_time  = ctx->start_time;
+    thread_hdr.num_records = ucs_profile_thread_num_records(ctx);
+    ucs_profile_file_write_data(fd, &thread_hdr, sizeof(thread_hdr));
+
+    if (ctx->log.wraparound > 0) {
+        ucs_profile_file_write_records(fd, ctx->log.current, ctx->log.end);
+    }
+    ucs_profile_file_write_records(fd, ctx->log.start, ctx->log.current);
+}
+
+/* Sum up the accumulated time of all threads into the locations array */
+static void ucs_profile_merge_locations()
+{
+    ucs_profile_thread_context_t *ctx;
+    ucs_profile_location_t *loc;
+    unsigned i;
+
+    for (i = 0; i < ucs_profile_ctx.num_locations; ++i) {
+        loc             = &ucs_profile_ctx.locations[i];
+        loc->total_time = 0;
+        loc->count      = 0;
+        ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+            if (i < ctx->accum.num_locations) {
+                loc->total_time += ctx->accum.locations[i].total_time;
+                loc->count      += ctx->accum.locations[i].count;
+            }
+        }
+    }
+}
+
+static void ucs_profile_stream_push(ucs_profile_segment_t *seg,
+                                    size_t num_records)
+{
+    seg->num_records = num_records;
+    seg->busy        = 1;
+
+    /* The writer thread is not woken up here, to keep the cost of the
+     * hand-off low; it picks up the queued segments periodically */
+    pthread_mutex_lock(&ucs_profile_ctx.stream.lock);
+    ucs_queue_push(&ucs_profile_ctx.stream.queue, &seg->queue);
+    ++ucs_profile_ctx.stream.pending;
+    pthread_mutex_unlock(&ucs_profile_ctx.stream.lock);
+}
+
+static void ucs_profile_stream_set_segment(ucs_profile_thread_context_t *ctx,
+                                           unsigned index)
+{
+    ucs_profile_segment_t *seg = &ctx->stream.segments[index];
+
+    ctx->stream.current = index;
+    ctx->log.current    = seg->start;
+    ctx->log.end        = seg->end;
+}
+
+static void ucs_profile_stream_write_segment(ucs_profile_segment_t *seg)
+{
+    int fd = ucs_profile_ctx.stream.fd;
+    ucs_profile_thread_header_t thread_hdr;
+
+    thread_hdr.tid         = seg->ctx->tid;
+    thread_hdr.start_time  = seg->ctx->start_time;
+    thread_hdr.num_records = seg->num_records;
+
+    pthread_mutex_lock(&ucs_profile_ctx.stream.file_lock);
+    ucs_profile_file_pwrite_data(fd, &thread_hdr, sizeof(thread_hdr),
+                                 ucs_profile_ctx.stream.offset);
+    ucs_profile_ctx.stream.offset += sizeof(thread_hdr);
+    ucs_profile_file_pwrite_data(fd, seg->start,
+                                 sizeof(*seg->start) * seg->num_records,
+                                 ucs_profile_ctx.stream.offset);
+    ucs_profile_ctx.stream.offset      += sizeof(*seg->start) * seg->num_records;
+    ucs_profile_ctx.stream.num_records += seg->num_records;
+    ++ucs_profile_ctx.stream.num_segments;
+    pthread_mutex_unlock(&ucs_profile_ctx.stream.file_lock);
+}
+
+static void ucs_profile_fill_header(ucs_profile_header_t *header)
+{
+    ucs_profile_thread_context_t *ctx;
+    ucs_time_t handoff_time;
+
+    memset(header, 0, sizeof(*header));
+    ucs_read_file(header->cmdline, sizeof(header->cmdline), 1, "/proc/self/cmdline");
+    strncpy(header->hostname, ucs_get_host_name(), sizeof(header->hostname) - 1);
+    header->pid           = getpid();
+    header->mode          = ucs_global_opts.profile_mode;
+    header->num_locations = ucs_profile_ctx.num_locations;
+    header->record_cost   = ucs_profile_ctx.record_cost;
+    header->one_second    = ucs_time_from_sec(1.0);
+
+    handoff_time = 0;
+    ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+        header->num_dropped += ctx->stream.num_dropped;
+        handoff_time        += ctx->stream.handoff_time;
+    }
+
+    if (ucs_profile_ctx.stream.fd >= 0) {
+        header->num_segments     = ucs_profile_ctx.stream.num_segments;
+        header->num_records      = ucs_profile_ctx.stream.num_records;
+        header->segments_offset  = sizeof(*header);
+        header->locations_offset = ucs_profile_ctx.stream.offset;
+    } else {
+        header->num_segments     = ucs_profile_ctx.num_threads;
+        ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+            header->num_records += ucs_profile_thread_num_records(ctx);
+        }
+        header->locations_offset = sizeof(*header);
+        header->segments_offset  = sizeof(*header) +
+                                   (sizeof(*ucs_profile_ctx.locations) *
+                                    ucs_profile_ctx.num_locations);
+    }
+
+    header->overhead = ((header->num_records + header->num_dropped) *
+                        header->record_cost) + handoff_time;
+}
+
+/*
+ * Write the locations after the last segment, and the header which points to
+ * them. Called with ucs_profile_ctx.lock held.
+ */
+static void ucs_profile_stream_write_index()
+{
+    int fd = ucs_profile_ctx.stream.fd;
+    ucs_profile_header_t header;
+    size_t locations_size;
+    int ret;
+
+    pthread_mutex_lock(&ucs_profile_ctx.stream.file_lock);
+
+    ucs_profile_fill_header(&header);
+    ucs_profile_merge_locations();
+
+    /* The next segment will overwrite the locations, and they would be
+     * written again after it */
+    locations_size = sizeof(*ucs_profile_ctx.locations) *
+                     ucs_profile_ctx.num_locations;
+    ucs_profile_file_pwrite_data(fd, ucs_profile_ctx.locations, locations_size,
+                                 header.locations_offset);
+    ret = ftruncate(fd, header.locations_offset + locations_size);
+    if (ret < 0) {
+        ucs_warn("failed to truncate profiling file: %m");
+    }
+    ucs_profile_file_pwrite_data(fd, &header, sizeof(header), 0);
+    ucs_profile_ctx.stream.index_locations = ucs_profile_ctx.num_locations;
+    ucs_profile_ctx.stream.index_segments  = ucs_profile_ctx.stream.num_segments;
+
+    pthread_mutex_unlock(&ucs_profile_ctx.stream.file_lock);
+}
+
+static void ucs_profile_stream_wait(unsigned timeout_ms)
+{
+    struct timespec abstime;
+
+    clock_gettime(CLOCK_REALTIME, &abstime);
+    abstime.tv_nsec += timeout_ms * (UCS_NSEC_PER_SEC / UCS_MSEC_PER_SEC);
+    abstime.tv_sec  += abstime.tv_nsec / UCS_NSEC_PER_SEC;
+    abstime.tv_nsec %= UCS_NSEC_PER_SEC;
+    pthread_cond_timedwait(&ucs_profile_ctx.stream.cond,
+                           &ucs_profile_ctx.stream.lock, &abstime);
+}
+
+/*
+ * Keep the file parseable while the application is running: after new segments
+ * or locations, rewrite the locations and the header. Skipped if the lock is
+ * taken, since ucs_profile_stream_flush() holds it while waiting for the
+ * writer thread; the next interval will try again.
+ */
+static void ucs_profile_stream_update_index()
+{
+    if ((ucs_profile_ctx.stream.index_segments ==
+         ucs_profile_ctx.stream.num_segments) &&
+        (ucs_profile_ctx.stream.index_locations ==
+         ucs_profile_ctx.num_locations)) {
         return;
     }
 
-    /* write header */
+    if (pthread_mutex_trylock(&ucs_profile_ctx.lock) != 0) {
+        return;
+    }
+
+    ucs_profile_stream_write_index();
+    pthread_mutex_unlock(&ucs_profile_ctx.lock);
+}
+
+static void *ucs_profile_stream_thread_func(void *arg)
+{
+    ucs_profile_segment_t *seg;
+    sigset_t sigset;
+
+    /* Signals (e.g debug signal which dumps the profile) are handled by the
+     * application threads */
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+    pthread_mutex_lock(&ucs_profile_ctx.stream.lock);
+    for (;;) {
+        while (!ucs_profile_ctx.stream.stop &&
+               ucs_queue_is_empty(&ucs_profile_ctx.stream.queue)) {
+            pthread_mutex_unlock(&ucs_profile_ctx.stream.lock);
+            ucs_profile_stream_update_index();
+            pthread_mutex_lock(&ucs_profile_ctx.stream.lock);
+            ucs_profile_stream_wait(UCS_PROFILE_STREAM_INTERVAL_MS);
+        }
+
+        if (ucs_queue_is_empty(&ucs_profile_ctx.stream.queue)) {
+            break;
+        }
+
+        seg = ucs_queue_pull_elem_non_empty(&ucs_profile_ctx.stream.queue,
+                                            ucs_profile_segment_t, queue);
+        pthread_mutex_unlock(&ucs_profile_ctx.stream.lock);
+
+        ucs_profile_stream_write_segment(seg);
+
+        pthread_mutex_lock(&ucs_profile_ctx.stream.lock);
+        /* the owner thread may reuse the segment after busy is cleared */
+        ucs_memory_cpu_fence();
+        seg->busy = 0;
+        if (--ucs_profile_ctx.stream.pending == 0) {
+            pthread_cond_broadcast(&ucs_profile_ctx.stream.cond);
+        }
+    }
+    pthread_mutex_unlock(&ucs_profile_ctx.stream.lock);
+
+    return NULL;
+}
+
+/*
+ * Pass the partially filled segments of all threads to the writer and wait
+ * until everything is written. Other threads are expected not to make records
+ * meanwhile, as with ucs_profile_dump() in general.
+ */
+static void ucs_profile_stream_flush()
+{
+    ucs_profile_thread_context_t *ctx;
+    ucs_profile_segment_t *seg;
+
+    pthread_mutex_lock(&ucs_profile_ctx.lock);
+    ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+        seg = &ctx->stream.segments[ctx->stream.current];
+        if (ctx->log.current > seg->start) {
+            ucs_profile_stream_push(seg, ctx->log.current - seg->start);
+        }
+    }
+
+    pthread_mutex_lock(&ucs_profile_ctx.stream.lock);
+    pthread_cond_broadcast(&ucs_profile_ctx.stream.cond);
+    while (ucs_profile_ctx.stream.pending > 0) {
+        pthread_cond_wait(&ucs_profile_ctx.stream.cond,
+                          &ucs_profile_ctx.stream.lock);
+    }
+    pthread_mutex_unlock(&ucs_profile_ctx.stream.lock);
+
+    ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+        ucs_profile_stream_set_segment(ctx, ctx->stream.current);
+    }
+    pthread_mutex_unlock(&ucs_profile_ctx.lock);
+}
+
+static ucs_status_t ucs_profile_stream_init()
+{
+    ucs_profile_header_t header;
+    int ret;
+
+    ucs_profile_ctx.stream.fd = ucs_profile_file_open();
+    if (ucs_profile_ctx.stream.fd < 0) {
+        return UCS_ERR_IO_ERROR;
+    }
+
+    /* The header is rewritten by the writer thread, and when the profile is
+     * dumped */
     memset(&header, 0, sizeof(header));
-    ucs_read_file(header.cmdline, sizeof(header.cmdline), 1, "/proc/self/cmdline");
-    strncpy(header.hostname, ucs_get_host_name(), sizeof(header.hostname) - 1);
-    header.pid = getpid();
-    header.mode = ucs_global_opts.profile_mode;
-    header.num_locations = ucs_profile_ctx.num_locations;
-    header.num_records   = ucs_profile_ctx.log.wraparound ?
-                    (ucs_profile_ctx.log.end     - ucs_profile_ctx.log.start) :
-                    (ucs_profile_ctx.log.current - ucs_profile_ctx.log.start);
-    header.one_second    = ucs_time_from_sec(1.0);
+    ucs_profile_file_write_data(ucs_profile_ctx.stream.fd, &header,
+                                sizeof(header));
+
+    ucs_queue_head_init(&ucs_profile_ctx.stream.queue);
+    ucs_profile_ctx.stream.pending         = 0;
+    ucs_profile_ctx.stream.stop            = 0;
+    ucs_profile_ctx.stream.offset          = sizeof(header);
+    ucs_profile_ctx.stream.num_segments    = 0;
+    ucs_profile_ctx.stream.num_records     = 0;
+    ucs_profile_ctx.stream.index_segments  = 0;
+    ucs_profile_ctx.stream.index_locations = 0;
+
+    ret = pthread_create(&ucs_profile_ctx.stream.thread, NULL,
+                         ucs_profile_stream_thread_func, NULL);
+    if (ret != 0) {
+        ucs_warn("failed to create profiling writer thread: %s", strerror(ret));
+        close(ucs_profile_ctx.stream.fd);
+        ucs_profile_ctx.stream.fd = -1;
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return UCS_OK;
+}
+
+static void ucs_profile_stream_cleanup()
+{
+    if (ucs_profile_ctx.stream.fd < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&ucs_profile_ctx.stream.lock);
+    ucs_profile_ctx.stream.stop = 1;
+    pthread_cond_broadcast(&ucs_profile_ctx.stream.cond);
+    pthread_mutex_unlock(&ucs_profile_ctx.stream.lock);
+    pthread_join(ucs_profile_ctx.stream.thread, NULL);
+
+    close(ucs_profile_ctx.stream.fd);
+    ucs_profile_ctx.stream.fd = -1;
+}
+
+/*
+ * In streaming mode the segments are already in the file, so only the
+ * locations are written after them, and the header is updated.
+ */
+static void ucs_profile_stream_write()
+{
+    ucs_profile_stream_flush();
+
+    pthread_mutex_lock(&ucs_profile_ctx.lock);
+    ucs_profile_stream_write_index();
+    pthread_mutex_unlock(&ucs_profile_ctx.lock);
+}
+
+static void ucs_profile_write()
+{
+    ucs_profile_thread_context_t *ctx;
+    ucs_profile_header_t header;
+    int fd;
+
+    if (!ucs_global_opts.profile_mode) {
+        return;
+    }
+
+    if (ucs_profile_ctx.stream.fd >= 0) {
+        ucs_profile_stream_write();
+        return;
+    }
+
+    fd = ucs_profile_file_open();
+    if (fd < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&ucs_profile_ctx.lock);
+
+    /* write header */
+    ucs_profile_fill_header(&header);
     ucs_profile_file_write_data(fd, &header, sizeof(header));
 
     /* write locations */
+    ucs_profile_merge_locations();
     ucs_profile_file_write_data(fd, ucs_profile_ctx.locations,
                                 sizeof(*ucs_profile_ctx.locations) *
                                 ucs_profile_ctx.num_locations);
 
-    /* write records */
-    if (ucs_profile_ctx.log.wraparound > 0) {
-        ucs_profile_file_write_records(fd, ucs_profile_ctx.log.current,
-                                       ucs_profile_ctx.log.end);
+    /* write the records of every thread */
+    ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+        ucs_profile_write_thread(fd, ctx);
     }
-    ucs_profile_file_write_records(fd, ucs_profile_ctx.log.start,
-                                   ucs_profile_ctx.log.current);
+
+    pthread_mutex_unlock(&ucs_profile_ctx.lock);
 
     close(fd);
 }
 
+void ucs_profile_log_full(ucs_profile_thread_context_t *ctx)
+{
+    ucs_profile_segment_t *seg, *next;
+    ucs_time_t start_time;
+
+    if (ctx->stream.segments == NULL) {
+        ctx->log.current    = ctx->log.start;
+        ctx->log.wraparound = 1;
+        return;
+    }
+
+    start_time = ucs_get_time();
+    seg        = &ctx->stream.segments[ctx->stream.current];
+    next       = &ctx->stream.segments[(ctx->stream.current + 1) %
+                                       UCS_PROFILE_STREAM_NUM_SEGMENTS];
+    if (next->busy) {
+        /* The writer thread fell behind - drop the records of the current
+         * segment rather than blocking the application */
+        ctx->stream.num_dropped += seg->end - seg->start;
+        ctx->log.current         = seg->start;
+    } else {
+        ucs_profile_stream_push(seg, seg->end - seg->start);
+        ucs_profile_stream_set_segment(ctx, next - ctx->stream.segments);
+    }
+    ctx->stream.handoff_time += ucs_get_time() - start_time;
+}
+
 void ucs_profile_get_location(ucs_profile_type_t type, const char *name,
                               const char *file, int line, const char *function,
                               int *loc_id_p)
@@ -108,8 +524,12 @@ void ucs_profile_get_location(ucs_profile_type_t type, const char *name,
         return;
     }
 
-    /* Location ID must be uninitialized */
-    ucs_assert(*loc_id_p == -1);
+    pthread_mutex_lock(&ucs_profile_ctx.lock);
+
+    /* Location ID could be initialized by another thread */
+    if (*loc_id_p != -1) {
+        goto out_unlock;
+    }
 
     location = ucs_profile_ctx.num_locations++;
 
@@ -123,7 +543,7 @@ void ucs_profile_get_location(ucs_profile_type_t type, const char *name,
         if (ucs_profile_ctx.locations == NULL) {
             ucs_warn("failed to expand locations array");
             *loc_id_p = 0;
-            return;
+            goto out_unlock;
         }
     }
 
@@ -138,11 +558,198 @@ void ucs_profile_get_location(ucs_profile_type_t type, const char *name,
     loc->count      = 0;
     loc->loc_id_p   = loc_id_p;
     *loc_id_p       = location + 1;
+
+out_unlock:
+    pthread_mutex_unlock(&ucs_profile_ctx.lock);
+}
+
+static ucs_profile_thread_context_t *ucs_profile_thread_create()
+{
+    ucs_profile_thread_context_t *ctx;
+    size_t num_records, seg_records;
+    ucs_profile_segment_t *seg;
+    unsigned i;
+
+    ctx = ucs_memalign(UCS_SYS_CACHE_LINE_SIZE, sizeof(*ctx),
+                       "profile_thread_ctx");
+    if (ctx == NULL) {
+        ucs_warn("failed to allocate profiling thread context");
+        return NULL;
+    }
+
+    ctx->tid                   = ucs_get_tid();
+    ctx->start_time            = ucs_get_time();
+    ctx->log.start             = NULL;
+    ctx->log.end               = NULL;
+    ctx->log.current           = NULL;
+    ctx->log.wraparound        = 0;
+    ctx->accum.num_locations   = 0;
+    ctx->accum.locations       = NULL;
+    ctx->accum.stack_top       = -1;
+    ctx->stream.segments       = NULL;
+    ctx->stream.current        = 0;
+    ctx->stream.num_dropped    = 0;
+    ctx->stream.handoff_time   = 0;
+
+    if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
+        num_records    = ucs_global_opts.profile_log_size /
+                         sizeof(ucs_profile_record_t);
+        if (ucs_profile_ctx.stream.fd >= 0) {
+            num_records = ucs_max(num_records, UCS_PROFILE_STREAM_NUM_SEGMENTS);
+        }
+
+        ctx->log.start = ucs_calloc(num_records, sizeof(ucs_profile_record_t),
+                                    "profile_log");
+        if (ctx->log.start == NULL) {
+            ucs_warn("failed to allocate profiling log");
+            goto err_free_ctx;
+        }
+
+        ctx->log.end     = ctx->log.start + num_records;
+        ctx->log.current = ctx->log.start;
+
+        if (ucs_profile_ctx.stream.fd >= 0) {
+            ctx->stream.segments = ucs_calloc(UCS_PROFILE_STREAM_NUM_SEGMENTS,
+                                              sizeof(*ctx->stream.segments),
+                                              "profile_segments");
+            if (ctx->stream.segments == NULL) {
+                ucs_warn("failed to allocate profiling log segments");
+                goto err_free_log;
+            }
+
+            seg_records = num_records / UCS_PROFILE_STREAM_NUM_SEGMENTS;
+            for (i = 0; i < UCS_PROFILE_STREAM_NUM_SEGMENTS; ++i) {
+                seg        = &ctx->stream.segments[i];
+                seg->ctx   = ctx;
+                seg->start = ctx->log.start + (i * seg_records);
+                seg->end   = seg->start + seg_records;
+                seg->busy  = 0;
+            }
+            ucs_profile_stream_set_segment(ctx, 0);
+        }
+    }
+
+    pthread_setspecific(ucs_profile_ctx.tls_key, ctx);
+
+    pthread_mutex_lock(&ucs_profile_ctx.lock);
+    ucs_list_add_tail(&ucs_profile_ctx.thread_list, &ctx->list);
+    ++ucs_profile_ctx.num_threads;
+    pthread_mutex_unlock(&ucs_profile_ctx.lock);
+
+    ucs_debug("created profiling context %p for thread %d", ctx, ctx->tid);
+    return ctx;
+
+err_free_log:
+    ucs_free(ctx->log.start);
+err_free_ctx:
+    ucs_free(ctx);
+    return NULL;
+}
+
+ucs_profile_thread_context_t *
+ucs_profile_thread_prepare(ucs_profile_thread_context_t *ctx, int loc_id)
+{
+    ucs_profile_thread_location_t *locations;
+    unsigned num_locations;
+
+    if (ctx == NULL) {
+        ctx = ucs_profile_thread_create();
+        if (ctx == NULL) {
+            return NULL;
+        }
+    }
+
+    if (loc_id <= ctx->accum.num_locations) {
+        return ctx;
+    }
+
+    /* Only the owner thread accesses the array, apart from ucs_profile_write()
+     * which holds the lock */
+    pthread_mutex_lock(&ucs_profile_ctx.lock);
+    num_locations = ucs_max(loc_id, ucs_profile_ctx.max_locations);
+    locations     = ucs_realloc(ctx->accum.locations,
+                                sizeof(*locations) * num_locations,
+                                "profile_thread_locations");
+    if (locations != NULL) {
+        memset(locations + ctx->accum.num_locations, 0,
+               sizeof(*locations) * (num_locations - ctx->accum.num_locations));
+        ctx->accum.locations     = locations;
+        ctx->accum.num_locations = num_locations;
+    }
+    pthread_mutex_unlock(&ucs_profile_ctx.lock);
+
+    if (locations == NULL) {
+        ucs_warn("failed to expand thread locations array");
+        return NULL;
+    }
+
+    return ctx;
+}
+
+static void ucs_profile_thread_destroy(ucs_profile_thread_context_t *ctx)
+{
+    ucs_free(ctx->stream.segments);
+    ucs_free(ctx->accum.locations);
+    ucs_free(ctx->log.start);
+    ucs_free(ctx);
+}
+
+/*
+ * Measure the cost of a record by making records through ucs_profile_record().
+ * They go to a temporary context of the calling thread, so the profile is not
+ * affected.
+ */
+static ucs_time_t ucs_profile_calibrate_record_cost()
+{
+    ucs_profile_thread_context_t *prev_ctx, *ctx;
+    ucs_profile_thread_location_t location;
+    ucs_profile_record_t *records;
+    ucs_time_t start_time, cost;
+    unsigned i;
+    int loc_id;
+
+    ctx     = ucs_memalign(UCS_SYS_CACHE_LINE_SIZE, sizeof(*ctx),
+                           "profile_calibrate_ctx");
+    records = ucs_calloc(UCS_PROFILE_CALIBRATE_ITERS + 1, sizeof(*records),
+                         "profile_calibrate_log");
+    if ((ctx == NULL) || (records == NULL)) {
+        ucs_free(records);
+        ucs_free(ctx);
+        return 0;
+    }
+
+    /* The log does not become full, and the location is already known */
+    memset(&location, 0, sizeof(location));
+    ctx->log.start           = records;
+    ctx->log.end             = records + UCS_PROFILE_CALIBRATE_ITERS + 1;
+    ctx->log.current         = records;
+    ctx->log.wraparound      = 0;
+    ctx->accum.num_locations = 1;
+    ctx->accum.locations     = &location;
+    ctx->accum.stack_top     = -1;
+    ctx->stream.segments     = NULL;
+    loc_id                   = 1;
+
+    prev_ctx = pthread_getspecific(ucs_profile_ctx.tls_key);
+    pthread_setspecific(ucs_profile_ctx.tls_key, ctx);
+
+    start_time = ucs_get_time();
+    for (i = 0; i < UCS_PROFILE_CALIBRATE_ITERS; ++i) {
+        ucs_profile_record(UCS_PROFILE_TYPE_SAMPLE, "calibrate", i, i,
+                           __FILE__, __LINE__, __FUNCTION__, &loc_id);
+    }
+    cost = (ucs_get_time() - start_time) / UCS_PROFILE_CALIBRATE_ITERS;
+
+    pthread_setspecific(ucs_profile_ctx.tls_key, prev_ctx);
+    ucs_free(records);
+    ucs_free(ctx);
+    return cost;
 }
 
 void ucs_profile_global_init()
 {
-    size_t num_records;
+    ucs_status_t status;
+    int ret;
 
     if (!ucs_global_opts.profile_mode) {
         goto off;
@@ -153,27 +760,30 @@ void ucs_profile_global_init()
         goto disable;
     }
 
-    if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
-        num_records = ucs_global_opts.profile_log_size / sizeof(ucs_profile_record_t);
-        ucs_profile_ctx.log.start = ucs_calloc(num_records,
-                                               sizeof(ucs_profile_record_t),
-                                               "profile_log");
-        if (ucs_profile_ctx.log.start == NULL) {
-            ucs_warn("failed to allocate profiling log");
-            goto disable;
-        }
-
-        ucs_profile_ctx.log.end     = ucs_profile_ctx.log.start + num_records;
-        ucs_profile_ctx.log.current = ucs_profile_ctx.log.start;
+    /* Thread contexts are created lazily, on the first record of each thread.
+     * Creating a new key makes any contexts left from a previous
+     * initialization invisible to their threads. */
+    ret = pthread_key_create(&ucs_profile_ctx.tls_key, NULL);
+    if (ret != 0) {
+        ucs_warn("failed to create profiling thread key: %s", strerror(ret));
+        goto disable;
     }
 
-    if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_ACCUM)) {
-        ucs_profile_ctx.accum.stack_top = -1;
+    if ((ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) &&
+        ucs_global_opts.profile_stream) {
+        status = ucs_profile_stream_init();
+        if (status != UCS_OK) {
+            goto err_delete_key;
+        }
     }
 
+    ucs_profile_ctx.tls_key_valid = 1;
+    ucs_profile_ctx.record_cost   = ucs_profile_calibrate_record_cost();
     ucs_info("profiling is enabled");
     return;
 
+err_delete_key:
+    pthread_key_delete(ucs_profile_ctx.tls_key);
 disable:
     ucs_global_opts.profile_mode = 0;
 off:
@@ -199,33 +809,44 @@ static void ucs_profile_reset_locations()
 
 void ucs_profile_global_cleanup()
 {
+    ucs_profile_thread_context_t *ctx, *tmp;
+
     ucs_profile_write();
-    ucs_free(ucs_profile_ctx.log.start);
-    ucs_profile_ctx.log.start      = NULL;
-    ucs_profile_ctx.log.end        = NULL;
-    ucs_profile_ctx.log.current    = NULL;
-    ucs_profile_ctx.log.wraparound = 0;
+    ucs_profile_stream_cleanup();
+
+    ucs_list_for_each_safe(ctx, tmp, &ucs_profile_ctx.thread_list, list) {
+        ucs_list_del(&ctx->list);
+        ucs_profile_thread_destroy(ctx);
+    }
+    ucs_profile_ctx.num_threads = 0;
+
+    if (ucs_profile_ctx.tls_key_valid) {
+        pthread_key_delete(ucs_profile_ctx.tls_key);
+        ucs_profile_ctx.tls_key_valid = 0;
+    }
+
     ucs_profile_reset_locations();
 }
 
 void ucs_profile_dump()
 {
-    ucs_profile_location_t *loc;
+    ucs_profile_thread_context_t *ctx;
 
     ucs_profile_write();
 
-    for (loc = ucs_profile_ctx.locations;
-         loc < ucs_profile_ctx.locations + ucs_profile_ctx.num_locations;
-         ++loc)
-    {
-        loc->count      = 0;
-        loc->total_time = 0;
+    /* In streaming mode the file keeps all data since initialization */
+    if (ucs_profile_ctx.stream.fd >= 0) {
+        return;
     }
 
-    if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
-        ucs_profile_ctx.log.wraparound = 0;
-        ucs_profile_ctx.log.current    = ucs_profile_ctx.log.start;
+    pthread_mutex_lock(&ucs_profile_ctx.lock);
+    ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+        memset(ctx->accum.locations, 0,
+               sizeof(*ctx->accum.locations) * ctx->accum.num_locations);
+        ctx->log.wraparound = 0;
+        ctx->log.current    = ctx->log.start;
     }
+    pthread_mutex_unlock(&ucs_profile_ctx.lock);
 }
 
 #else
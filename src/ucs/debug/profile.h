@@ -11,9 +11,13 @@
 #  include "config.h"
 #endif
 
+#include <ucs/datastruct/list.h>
+#include <ucs/datastruct/queue_types.h>
+#include <ucs/arch/cpu.h>
 #include <ucs/sys/preprocessor.h>
 #include <ucs/time/time.h>
 #include <ucs/debug/log.h>
+#include <pthread.h>
 
 
 #define UCS_PROFILE_STACK_MAX 64
@@ -52,11 +56,31 @@ typedef struct ucs_profile_header {
     uint32_t                 pid;           /**< Process ID */
     uint32_t                 mode;          /**< Profiling mode */
     uint32_t                 num_locations; /**< Number of locations in the file */
-    uint64_t                 num_records;   /**< Number of records in the file */
+    uint32_t                 num_segments;  /**< Number of record segments in the file */
+    uint64_t                 num_records;   /**< Total number of records in the file */
+    uint64_t                 num_dropped;   /**< Records dropped because the writer fell behind */
+    uint64_t                 locations_offset; /**< File offset of the locations array */
+    uint64_t                 segments_offset;  /**< File offset of the first segment */
+    uint64_t                 record_cost;   /**< Estimated time to make a single record */
+    uint64_t                 overhead;      /**< Estimated total time spent on profiling */
     uint64_t                 one_second;    /**< How much time is one second on the sampled machine */
 } UCS_S_PACKED ucs_profile_header_t;
 
 
+/**
+ * Profile output file segment header. The records of every thread are written
+ * as one or more segments, which follow each other starting at
+ * segments_offset. Each segment header is followed by the records made by
+ * that thread. In streaming mode a thread has a segment for every part of
+ * its log which was flushed, in the order of recording.
+ */
+typedef struct ucs_profile_thread_header {
+    uint32_t                 tid;           /**< System thread ID */
+    uint64_t                 start_time;    /**< Time of the first record made by the thread */
+    uint64_t                 num_records;   /**< Number of records in the segment */
+} UCS_S_PACKED ucs_profile_thread_header_t;
+
+
 /**
  * Profile output file sample record
  */
@@ -84,13 +108,19 @@ typedef struct ucs_profile_location {
 
 
 /**
- * Profiling global context
+ * Accumulated time of a location in a single thread
  */
-typedef struct ucs_profile_global_context {
+typedef struct ucs_profile_thread_location {
+    uint64_t                 total_time;    /**< Total interval from previous location */
+    size_t                   count;         /**< Number of times we've hit this location */
+} ucs_profile_thread_location_t;
 
-    ucs_profile_location_t   *locations;    /**< Array of all locations */
-    unsigned                 num_locations; /**< Number of valid locations */
-    unsigned                 max_locations; /**< Size of locations array */
+
+/**
+ * Profiling context of a single thread. Created on the first record made by
+ * the thread, and used only by that thread until the data is written out.
+ */
+typedef struct ucs_profile_thread_context {
 
     struct {
         ucs_profile_record_t *start, *end;  /**< Circular log buffer */
@@ -99,10 +129,59 @@ typedef struct ucs_profile_global_context {
     } log;
 
     struct {
-        int                  stack_top;     /**< Index of stack top */
+        unsigned                      num_locations; /**< Size of locations array */
+        ucs_profile_thread_location_t *locations;    /**< Per-location totals */
+        int                           stack_top;     /**< Index of stack top */
         ucs_time_t           stack[UCS_PROFILE_STACK_MAX]; /**< Timestamps for each nested scope */
     } accum;
 
+    struct {
+        struct ucs_profile_segment    *segments;     /**< Parts of the log buffer */
+        unsigned                      current;       /**< Segment being filled */
+        uint64_t                      num_dropped;   /**< Number of dropped records */
+        ucs_time_t                    handoff_time;  /**< Time spent on passing
+                                                          segments to the writer */
+    } stream;
+
+    pid_t                    tid;           /**< System thread ID */
+    ucs_time_t               start_time;    /**< Time of the first record */
+    ucs_list_link_t          list;          /**< Entry in the threads list */
+
+} UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE) ucs_profile_thread_context_t;
+
+
+/**
+ * Profiling global context
+ */
+typedef struct ucs_profile_global_context {
+
+    ucs_profile_location_t   *locations;    /**< Array of all locations */
+    unsigned                 num_locations; /**< Number of valid locations */
+    unsigned                 max_locations; /**< Size of locations array */
+
+    pthread_mutex_t          lock;          /**< Protects locations and threads list */
+    pthread_key_t            tls_key;       /**< Key of the thread context */
+    int                      tls_key_valid; /**< Whether tls_key was created */
+    ucs_list_link_t          thread_list;   /**< List of thread contexts */
+    unsigned                 num_threads;   /**< Number of thread contexts */
+    ucs_time_t               record_cost;   /**< Measured time to make a record */
+
+    struct {
+        int                  fd;            /**< Profile file, -1 if not streaming */
+        pthread_t            thread;        /**< Writer thread */
+        pthread_mutex_t      lock;          /**< Protects the queue */
+        pthread_cond_t       cond;          /**< Signaled when queue state changes */
+        pthread_mutex_t      file_lock;     /**< Serializes writes to the file */
+        ucs_queue_head_t     queue;         /**< Full segments to be written */
+        unsigned             pending;       /**< Segments queued or being written */
+        int                  stop;          /**< Writer thread should exit */
+        uint64_t             offset;        /**< File offset of the next segment */
+        unsigned             num_segments;  /**< Number of written segments */
+        uint64_t             num_records;   /**< Number of written records */
+        unsigned             index_segments;  /**< num_segments in the file header */
+        unsigned             index_locations; /**< Number of locations in the file */
+    } stream;
+
 } ucs_profile_global_context_t;
 
 
@@ -147,6 +226,30 @@ void ucs_profile_get_location(ucs_profile_type_t type, const char *name,
                               int *loc_id_p);
 
 
+/*
+ * Create the profiling context of the calling thread, or expand its array of
+ * accumulated locations so that it would contain the given location.
+ * Should not be used directly - use UCS_PROFILE macros instead.
+ *
+ * @param [in]  ctx       Current context of the calling thread, or NULL.
+ * @param [in]  loc_id    Location ID which is about to be recorded.
+ *
+ * @return Thread context, or NULL if it could not be created.
+ */
+ucs_profile_thread_context_t *
+ucs_profile_thread_prepare(ucs_profile_thread_context_t *ctx, int loc_id);
+
+
+/*
+ * Called when the current part of the thread's log buffer is full. Rotates
+ * the log, or in streaming mode passes the records to the writer thread.
+ * Should not be used directly - use UCS_PROFILE macros instead.
+ *
+ * @param [in]  ctx       Context of the calling thread.
+ */
+void ucs_profile_log_full(ucs_profile_thread_context_t *ctx);
+
+
 /*
  * Store a new record with the given data.
  * Should not be used directly - use UCS_PROFILE macros instead.
@@ -166,9 +269,9 @@ static inline void ucs_profile_record(ucs_profile_type_t type, const char *name,
                                       const char *function, int *loc_id_p)
 {
     extern ucs_profile_global_context_t ucs_profile_ctx;
-    ucs_profile_global_context_t *ctx = &ucs_profile_ctx;
-    ucs_profile_record_t   *rec;
-    ucs_profile_location_t *loc;
+    ucs_profile_thread_context_t  *ctx;
+    ucs_profile_thread_location_t *loc;
+    ucs_profile_record_t          *rec;
     ucs_time_t current_time;
     int loc_id;
 
@@ -183,9 +286,18 @@ retry:
         goto retry;
     }
 
+    ctx = (ucs_profile_thread_context_t*)
+          pthread_getspecific(ucs_profile_ctx.tls_key);
+    if (ucs_unlikely((ctx == NULL) || (loc_id > ctx->accum.num_locations))) {
+        ctx = ucs_profile_thread_prepare(ctx, loc_id);
+        if (ctx == NULL) {
+            return;
+        }
+    }
+
     current_time = ucs_get_time();
     if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_ACCUM)) {
-        loc              = &ctx->locations[loc_id - 1];
+        loc              = &ctx->accum.locations[loc_id - 1];
         switch (type) {
         case UCS_PROFILE_TYPE_SCOPE_BEGIN:
             ctx->accum.stack[++ctx->accum.stack_top] = current_time;
@@ -207,9 +319,8 @@ retry:
         rec->param64     = param64;
         rec->param32     = param32;
         rec->location    = loc_id - 1;
-        if (++ctx->log.current >= ctx->log.end) {
-            ctx->log.current    = ctx->log.start;
-            ctx->log.wraparound = 1;
+        if (ucs_unlikely(++ctx->log.current >= ctx->log.end)) {
+            ucs_profile_log_full(ctx);
         }
     }
 }
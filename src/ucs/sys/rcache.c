@@ -37,6 +37,24 @@
     ((_prot) & PROT_READ)  ? 'r' : '-', \
     ((_prot) & PROT_WRITE) ? 'w' : '-'
 
+/* Set in the reference count of a region when it's invalidated. The release
+ * of the last reference destroys the region if it's set. */
+#define UCS_RCACHE_REGION_REFCOUNT_INVALID  UCS_BIT(31)
+
+
+#if ENABLE_STATS
+static ucs_stats_class_t ucs_rcache_stats_class = {
+    .name           = "rcache",
+    .num_counters   = UCS_RCACHE_STAT_LAST,
+    .counter_names  = {
+        [UCS_RCACHE_STAT_HITS]          = "hits",
+        [UCS_RCACHE_STAT_MISSES]        = "misses",
+        [UCS_RCACHE_STAT_EVICTIONS]     = "evictions",
+        [UCS_RCACHE_STAT_INVALIDATIONS] = "invalidations"
+    }
+};
+#endif
+
 
 typedef struct ucs_rcache_inv_entry {
     ucs_queue_elem_t         queue;
@@ -73,7 +91,7 @@ static void __ucs_rcache_region_log(const char *file, int line, const char *func
               (region->flags & UCS_RCACHE_REGION_FLAG_PGTABLE)    ? 't' : '-',
               (region->flags & UCS_RCACHE_REGION_FLAG_INVALID)    ? 'i' : '-',
               UCS_RCACHE_PROT_ARG(region->prot),
-              region->refcount,
+              (unsigned)(region->refcount & ~UCS_RCACHE_REGION_REFCOUNT_INVALID),
               region_desc);
 }
 
@@ -155,14 +173,49 @@ static void ucs_mem_region_destroy_internal(ucs_rcache_t *rcache,
                                             ucs_rcache_region_t *region)
 {
     ucs_rcache_region_trace(rcache, region, "destroy");
+    ucs_assert(!region->in_lru);
     if (region->flags & UCS_RCACHE_REGION_FLAG_REGISTERED) {
         UCS_PROFILE_CODE("mem_dereg") {
             rcache->params.ops->mem_dereg(rcache->params.context, rcache, region);
         }
+        --rcache->num_regions;
+        rcache->total_size -= region->super.end - region->super.start;
     }
     ucs_free(region);
 }
 
+/* LRU lock must be held */
+static void ucs_rcache_region_lru_remove(ucs_rcache_t *rcache,
+                                         ucs_rcache_region_t *region)
+{
+    if (region->in_lru) {
+        ucs_list_del(&region->lru_list);
+        region->in_lru = 0;
+    }
+}
+
+/* LRU lock must be held */
+static void ucs_rcache_region_lru_add(ucs_rcache_t *rcache,
+                                      ucs_rcache_region_t *region)
+{
+    ucs_list_add_tail(&rcache->lru, &region->lru_list);
+    region->in_lru         = 1;
+    region->lru_referenced = 0;
+}
+
+/* Mark the reference count of a region as invalid, return its previous value */
+static uint32_t ucs_rcache_region_refcount_invalidate(ucs_rcache_region_t *region)
+{
+    uint32_t refcount;
+
+    do {
+        refcount = region->refcount;
+    } while (ucs_atomic_cswap32(&region->refcount, refcount,
+                                refcount | UCS_RCACHE_REGION_REFCOUNT_INVALID) !=
+             refcount);
+    return refcount;
+}
+
 /* Lock must be held in write mode */
 static void ucs_rcache_region_invalidate(ucs_rcache_t *rcache,
                                          ucs_rcache_region_t *region,
@@ -170,6 +223,7 @@ static void ucs_rcache_region_invalidate(ucs_rcache_t *rcache,
                                          int must_be_destroyed)
 {
     ucs_status_t status;
+    uint32_t refcount;
 
     ucs_rcache_region_trace(rcache, region, "invalidate");
 
@@ -187,13 +241,22 @@ static void ucs_rcache_region_invalidate(ucs_rcache_t *rcache,
 
     /* If no one is using the region, we can completely destroy it.
      * Otherwise, just mark it as invalid, and it would be destroyed when the
-     * reference count drops to 0.
+     * reference count drops to 0. The mark is set atomically with reading the
+     * reference count, so exactly one of us and the release of the last
+     * reference destroys the region. Once it's marked, it's not added to the
+     * LRU list again.
      */
-    if (region->refcount == 0) {
+    region->flags |= UCS_RCACHE_REGION_FLAG_INVALID;
+    refcount       = ucs_rcache_region_refcount_invalidate(region);
+
+    pthread_spin_lock(&rcache->lru_lock);
+    ucs_rcache_region_lru_remove(rcache, region);
+    pthread_spin_unlock(&rcache->lru_lock);
+
+    if (refcount == 0) {
         ucs_mem_region_destroy_internal(rcache, region);
     } else {
         ucs_assert(!must_be_destroyed);
-        region->flags |= UCS_RCACHE_REGION_FLAG_INVALID;
     }
 }
 
@@ -209,6 +272,7 @@ static void ucs_rcache_invalidate_range(ucs_rcache_t *rcache, ucs_pgt_addr_t sta
     ucs_rcache_find_regions(rcache, start, end - 1, &region_list);
     ucs_list_for_each_safe(region, tmp, &region_list, list) {
         ucs_rcache_region_invalidate(rcache, region, 0, 0);
+        UCS_STATS_UPDATE_COUNTER(rcache->stats, UCS_RCACHE_STAT_INVALIDATIONS, 1);
     }
 }
 
@@ -284,10 +348,50 @@ static void ucs_rcache_purge(ucs_rcache_t *rcache)
             ucs_rcache_region_warn(rcache, region, "destroying inuse");
         }
         region->flags &= ~UCS_RCACHE_REGION_FLAG_PGTABLE;
+        ucs_rcache_region_lru_remove(rcache, region);
         ucs_mem_region_destroy_internal(rcache, region);
     }
 }
 
+/* Lock must be held in write mode */
+static void ucs_rcache_lru_evict(ucs_rcache_t *rcache, size_t length)
+{
+    ucs_rcache_region_t *region;
+    size_t max_scan;
+
+    if ((rcache->num_regions < rcache->params.max_regions) &&
+        (rcache->total_size + length <= rcache->params.max_size)) {
+        return;
+    }
+
+    pthread_spin_lock(&rcache->lru_lock);
+
+    /* Every region gets at most one second chance */
+    max_scan = 2 * ucs_list_length(&rcache->lru);
+    while ((max_scan-- > 0) &&
+           ((rcache->num_regions >= rcache->params.max_regions) ||
+            (rcache->total_size + length > rcache->params.max_size)))
+    {
+        region = ucs_list_head(&rcache->lru, ucs_rcache_region_t, lru_list);
+        if (region->lru_referenced || (region->refcount > 0)) {
+            /* Used since it was added to the tail, or still in use */
+            region->lru_referenced = 0;
+            ucs_list_del(&region->lru_list);
+            ucs_list_add_tail(&rcache->lru, &region->lru_list);
+            continue;
+        }
+
+        /* Nobody can take a reference while we hold the lock in write mode */
+        ucs_rcache_region_lru_remove(rcache, region);
+        pthread_spin_unlock(&rcache->lru_lock);
+        ucs_rcache_region_trace(rcache, region, "evict");
+        ucs_rcache_region_invalidate(rcache, region, 1, 1);
+        UCS_STATS_UPDATE_COUNTER(rcache->stats, UCS_RCACHE_STAT_EVICTIONS, 1);
+        pthread_spin_lock(&rcache->lru_lock);
+    }
+    pthread_spin_unlock(&rcache->lru_lock);
+}
+
 static inline int ucs_rcache_region_test(ucs_rcache_region_t *region, int prot)
 {
     return (region->flags & UCS_RCACHE_REGION_FLAG_REGISTERED) &&
@@ -409,6 +513,7 @@ retry:
          * the lock)
          */
         status = region->status;
+        UCS_STATS_UPDATE_COUNTER(rcache->stats, UCS_RCACHE_STAT_HITS, 1);
         goto out_set_region;
     } else if (status != UCS_OK) {
         /* Could not create a region because there are overlapping regions which
@@ -417,6 +522,9 @@ retry:
         goto out_unlock;
     }
 
+    /* Make room for the new region by releasing least recently used ones */
+    ucs_rcache_lru_evict(rcache, end - start);
+
     /* Allocate structure for new region */
     region = ucs_memalign(UCS_PGT_ENTRY_MIN_ALIGN, rcache->params.region_struct_size,
                           "rcache_region");
@@ -464,6 +572,9 @@ retry:
 
     region->flags   |= UCS_RCACHE_REGION_FLAG_REGISTERED;
     region->refcount = 1;
+    ++rcache->num_regions;
+    rcache->total_size += region->super.end - region->super.start;
+    UCS_STATS_UPDATE_COUNTER(rcache->stats, UCS_RCACHE_STAT_MISSES, 1);
 
     ucs_rcache_region_trace(rcache, region, "created");
 
@@ -501,6 +612,7 @@ ucs_status_t ucs_rcache_get(ucs_rcache_t *rcache, void *address, size_t length,
                 ucs_rcache_region_hold(rcache, region);
                 *region_p = region;
                 pthread_rwlock_unlock(&rcache->lock);
+                UCS_STATS_UPDATE_COUNTER(rcache->stats, UCS_RCACHE_STAT_HITS, 1);
                 return UCS_OK;
             }
         }
@@ -520,14 +632,29 @@ void ucs_rcache_region_put(ucs_rcache_t *rcache, ucs_rcache_region_t *region)
 {
     ucs_rcache_region_trace(rcache, region, "put");
 
-    ucs_assert(region->refcount > 0);
-    ucs_atomic_add32(&region->refcount, -1);
+    ucs_assert((region->refcount & ~UCS_RCACHE_REGION_REFCOUNT_INVALID) > 0);
 
-    if (ucs_unlikely(region->flags & UCS_RCACHE_REGION_FLAG_INVALID) &&
-        (region->refcount == 0))
-    {
+    /* A region is added to the LRU list when it's released for the first
+     * time, and stays there until it's invalidated. Releasing it again only
+     * marks it as referenced, without taking the LRU lock, and eviction moves
+     * referenced regions to the tail instead of evicting them.
+     */
+    if (ucs_likely(region->in_lru)) {
+        region->lru_referenced = 1;
+    } else {
+        pthread_spin_lock(&rcache->lru_lock);
+        if (!region->in_lru &&
+            !(region->refcount & UCS_RCACHE_REGION_REFCOUNT_INVALID)) {
+            ucs_rcache_region_lru_add(rcache, region);
+        }
+        pthread_spin_unlock(&rcache->lru_lock);
+    }
+
+    if (ucs_unlikely(ucs_atomic_fadd32(&region->refcount, -1) ==
+                     (UCS_RCACHE_REGION_REFCOUNT_INVALID | 1))) {
+        /* Released the last reference of a region invalidated while in use */
         pthread_rwlock_wrlock(&rcache->lock);
-        ucs_rcache_region_invalidate(rcache, region, 0, 1);
+        ucs_mem_region_destroy_internal(rcache, region);
         pthread_rwlock_unlock(&rcache->lock);
     }
 }
@@ -577,10 +704,27 @@ static UCS_CLASS_INIT_FUNC(ucs_rcache_t, const ucs_rcache_params_t *params,
         goto err_destroy_rwlock;
     }
 
+    ret = pthread_spin_init(&self->lru_lock, 0);
+    if (ret) {
+        ucs_error("pthread_spin_init() failed: %m");
+        status = UCS_ERR_INVALID_PARAM;
+        goto err_destroy_inv_q_lock;
+    }
+
+    ucs_list_head_init(&self->lru);
+    self->num_regions = 0;
+    self->total_size  = 0;
+
+    status = UCS_STATS_NODE_ALLOC(&self->stats, &ucs_rcache_stats_class,
+                                  stats_parent, "-%s-%p", name, self);
+    if (status != UCS_OK) {
+        goto err_destroy_lru_lock;
+    }
+
     status = ucs_pgtable_init(&self->pgtable, ucs_rcache_pgt_dir_alloc,
                               ucs_rcache_pgt_dir_release);
     if (status != UCS_OK) {
-        goto err_destroy_inv_q_lock;
+        goto err_free_stats;
     }
 
     status = ucs_mpool_init(&self->inv_mp, 0, sizeof(ucs_rcache_inv_entry_t), 0,
@@ -602,6 +746,10 @@ err_destroy_mp:
     ucs_mpool_cleanup(&self->inv_mp, 1);
 err_cleanup_pgtable:
     ucs_pgtable_cleanup(&self->pgtable);
+err_free_stats:
+    UCS_STATS_NODE_FREE(self->stats);
+err_destroy_lru_lock:
+    pthread_spin_destroy(&self->lru_lock);
 err_destroy_inv_q_lock:
     pthread_spin_destroy(&self->inv_lock);
 err_destroy_rwlock:
@@ -621,6 +769,8 @@ static UCS_CLASS_CLEANUP_FUNC(ucs_rcache_t)
 
     ucs_mpool_cleanup(&self->inv_mp, 1);
     ucs_pgtable_cleanup(&self->pgtable);
+    UCS_STATS_NODE_FREE(self->stats);
+    pthread_spin_destroy(&self->lru_lock);
     pthread_spin_destroy(&self->inv_lock);
     pthread_rwlock_destroy(&self->lock);
     free(self->name);
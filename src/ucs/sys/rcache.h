@@ -10,6 +10,8 @@
 /*
  * Memory registration cache - holds registered memory regions, takes care of
  * memory invalidation (if it's unmapped), merging of regions, protection flags.
+ * Unused regions are evicted in (second-chance) LRU order when a new region would
+ * exceed the limit on the number or total size of registered regions.
  * This data structure is thread safe.
  */
 #include <ucs/datastruct/pgtable.h>
@@ -24,6 +26,18 @@ typedef struct ucs_rcache_ops     ucs_rcache_ops_t;
 typedef struct ucs_rcache_params  ucs_rcache_params_t;
 typedef struct ucs_rcache_region  ucs_rcache_region_t;
 
+/*
+ * Registration cache statistics counters.
+ */
+enum {
+    UCS_RCACHE_STAT_HITS,          /**< Lookups satisfied by a cached region */
+    UCS_RCACHE_STAT_MISSES,        /**< Lookups which registered a new region */
+    UCS_RCACHE_STAT_EVICTIONS,     /**< Unused regions evicted to stay in budget */
+    UCS_RCACHE_STAT_INVALIDATIONS, /**< Regions invalidated by memory unmapping */
+    UCS_RCACHE_STAT_LAST
+};
+
+
 /*
  * Memory region flags.
  */
@@ -96,6 +110,10 @@ struct ucs_rcache_params {
     const ucs_rcache_ops_t *ops;                /**< Memory operations functions */
     void                   *context;            /**< User-defined context that will
                                                      be passed to mem_reg/mem_dereg */
+    size_t                 max_regions;         /**< Maximal number of registered
+                                                     regions, SIZE_MAX for unlimited */
+    size_t                 max_size;            /**< Maximal total size of registered
+                                                     regions, SIZE_MAX for unlimited */
 };
 
 
@@ -106,6 +124,11 @@ struct ucs_rcache_region {
     ucs_status_t           status;   /**< Current status code */
     uint8_t                prot;     /**< Protection bits */
     uint16_t               flags;    /**< Status flags. Protected by page table lock. */
+    uint8_t                in_lru;   /**< Whether the region is on the LRU list.
+                                          Protected by LRU lock. */
+    uint8_t                lru_referenced; /**< Released again since it was
+                                                moved to the LRU tail */
+    ucs_list_link_t        lru_list; /**< LRU list element */
 };
 
 
@@ -125,7 +148,15 @@ struct ucs_rcache {
                                           since we cannot use regulat malloc().
                                           The backing storage is original mmap()
                                           which does not generate memory events */
+    pthread_spinlock_t     lru_lock; /**< Lock for the LRU list */
+    ucs_list_link_t        lru;      /**< Released regions, in the order they were
+                                          added. Regions stay on the list until
+                                          they are invalidated, and eviction moves
+                                          referenced or used regions to the tail. */
+    size_t                 num_regions; /**< Number of registered regions */
+    size_t                 total_size;  /**< Total size of registered regions */
     char                   *name;
+    UCS_STATS_NODE_DECLARE(stats);
 };
 
 
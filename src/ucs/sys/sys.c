@@ -212,6 +212,62 @@ int ucs_get_first_cpu()
     return total_cpus;
 }
 
+ucs_status_t ucs_parse_cpu_list(const char *str, ucs_cpu_set_t *cpu_set)
+{
+    unsigned first, last, cpu;
+    const char *p;
+    char *end;
+
+    UCS_CPU_ZERO(cpu_set);
+
+    p = str;
+    while ((*p != '\0') && (*p != '\n')) {
+        first = strtoul(p, &end, 10);
+        if (end == p) {
+            return UCS_ERR_INVALID_PARAM;
+        }
+
+        if (*end == '-') {
+            p    = end + 1;
+            last = strtoul(p, &end, 10);
+            if ((end == p) || (last < first)) {
+                return UCS_ERR_INVALID_PARAM;
+            }
+        } else {
+            last = first;
+        }
+
+        if (last >= UCS_CPU_SETSIZE) {
+            return UCS_ERR_INVALID_PARAM;
+        }
+
+        for (cpu = first; cpu <= last; ++cpu) {
+            UCS_CPU_SET(cpu, cpu_set);
+        }
+
+        p = end;
+        if (*p == ',') {
+            ++p;
+        } else if ((*p != '\0') && (*p != '\n')) {
+            return UCS_ERR_INVALID_PARAM;
+        }
+    }
+
+    return UCS_OK;
+}
+
+ucs_status_t ucs_get_numa_node_cpus(unsigned node, ucs_cpu_set_t *cpu_set)
+{
+    char buf[1024];
+
+    if (ucs_read_file(buf, sizeof(buf), 1,
+                      "/sys/devices/system/node/node%u/cpulist", node) < 0) {
+        return UCS_ERR_NO_ELEM;
+    }
+
+    return ucs_parse_cpu_list(buf, cpu_set);
+}
+
 uint64_t ucs_generate_uuid(uint64_t seed)
 {
     struct timeval tv;
@@ -15,6 +15,7 @@
 
 #include <ucs/sys/compiler.h>
 #include <ucs/type/status.h>
+#include <ucs/type/cpu_set.h>
 #include <ucs/debug/memtrack.h>
 
 #include <errno.h>
@@ -91,6 +92,28 @@ uint64_t ucs_machine_guid();
 int ucs_get_first_cpu();
 
 
+/**
+ * Parse a list of processors, such as "0-3,8", to a CPU set.
+ *
+ * @param str      List of processor numbers and ranges, separated by commas.
+ * @param cpu_set  Filled with the processors from the list.
+ *
+ * @return UCS_ERR_INVALID_PARAM if the list is malformed.
+ */
+ucs_status_t ucs_parse_cpu_list(const char *str, ucs_cpu_set_t *cpu_set);
+
+
+/**
+ * Get the processors of a NUMA node.
+ *
+ * @param node     NUMA node number.
+ * @param cpu_set  Filled with the processors of the node.
+ *
+ * @return UCS_ERR_NO_ELEM if there is no such node.
+ */
+ucs_status_t ucs_get_numa_node_cpus(unsigned node, ucs_cpu_set_t *cpu_set);
+
+
 /**
  * Generate a world-wide unique ID
  *
@@ -6,108 +6,300 @@
 
 #include "timerq.h"
 
+#include <ucs/arch/atomic.h>
+#include <ucs/arch/bitops.h>
 #include <ucs/debug/log.h>
 #include <ucs/debug/memtrack.h>
 #include <ucs/sys/math.h>
 
 
+#define UCS_TIMERQ_NUM_SLOTS     (UCS_TIMERQ_LEVELS * UCS_TIMERQ_LEVEL_SLOTS)
+#define UCS_TIMERQ_MAX_DELTA     UCS_MASK(UCS_TIMERQ_LEVELS * UCS_TIMERQ_LEVEL_BITS)
+
+
 ucs_status_t ucs_timerq_init(ucs_timer_queue_t *timerq)
 {
+    unsigned i;
+
     ucs_trace_func("timerq=%p", timerq);
 
+    timerq->wheel = ucs_malloc(UCS_TIMERQ_NUM_SLOTS * sizeof(*timerq->wheel),
+                               "timerq_wheel");
+    if (timerq->wheel == NULL) {
+        ucs_error("failed to allocate timer wheel");
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < UCS_TIMERQ_NUM_SLOTS; ++i) {
+        ucs_list_head_init(&timerq->wheel[i]);
+    }
+    for (i = 0; i < UCS_TIMERQ_LEVELS; ++i) {
+        timerq->bitmap[i] = 0;
+    }
+
     pthread_spin_init(&timerq->lock, 0);
-    timerq->timers       = NULL;
+    ucs_list_head_init(&timerq->expired);
+    kh_init_inplace(ucs_timerq_timers, &timerq->timers);
+    kh_init_inplace(ucs_timerq_intervals, &timerq->intervals);
+    timerq->now          = 0;
     timerq->num_timers   = 0;
     /* coverity[missing_lock] */
-    timerq->min_interval = UCS_TIME_INFINITY;
+    timerq->min_interval       = UCS_TIME_INFINITY;
+    timerq->min_interval_stale = 0;
     return UCS_OK;
 }
 
 void ucs_timerq_cleanup(ucs_timer_queue_t *timerq)
 {
+    ucs_timer_t *timer;
+
     ucs_trace_func("timerq=%p", timerq);
 
     if (timerq->num_timers > 0) {
         ucs_warn("timer queue with %d timers being destroyed", timerq->num_timers);
     }
-    ucs_free(timerq->timers);
+
+    kh_foreach_value(&timerq->timers, timer, {
+        ucs_free(timer);
+    });
+    kh_destroy_inplace(ucs_timerq_timers, &timerq->timers);
+    kh_destroy_inplace(ucs_timerq_intervals, &timerq->intervals);
+    ucs_free(timerq->wheel);
+}
+
+/* Put the timer on the wheel slot which covers its expiration */
+static void ucs_timerq_insert(ucs_timer_queue_t *timerq, ucs_timer_t *timer)
+{
+    ucs_time_t delta, expiration;
+    unsigned level, index;
+
+    if (timer->expiration <= timerq->now) {
+        timer->slot = UCS_TIMERQ_SLOT_EXPIRED;
+        ucs_list_add_tail(&timerq->expired, &timer->list);
+        return;
+    }
+
+    /* Timers beyond the wheel range are moved down from the last slot which
+     * the wheel covers, and placed again */
+    delta      = ucs_min(timer->expiration - timerq->now, UCS_TIMERQ_MAX_DELTA);
+    expiration = timerq->now + delta;
+    level      = ucs_ilog2(delta) / UCS_TIMERQ_LEVEL_BITS;
+    index      = (expiration >> (level * UCS_TIMERQ_LEVEL_BITS)) &
+                 (UCS_TIMERQ_LEVEL_SLOTS - 1);
+
+    timer->slot = (level * UCS_TIMERQ_LEVEL_SLOTS) + index;
+    ucs_list_add_tail(&timerq->wheel[timer->slot], &timer->list);
+    timerq->bitmap[level] |= UCS_BIT(index);
+}
+
+/* Remove the timer from its wheel slot or the expired list */
+static void ucs_timerq_unlink(ucs_timer_queue_t *timerq, ucs_timer_t *timer)
+{
+    unsigned level, index;
+
+    ucs_list_del(&timer->list);
+    if (timer->slot == UCS_TIMERQ_SLOT_EXPIRED) {
+        return;
+    }
+
+    if (ucs_list_is_empty(&timerq->wheel[timer->slot])) {
+        level = timer->slot / UCS_TIMERQ_LEVEL_SLOTS;
+        index = timer->slot % UCS_TIMERQ_LEVEL_SLOTS;
+        timerq->bitmap[level] &= ~UCS_BIT(index);
+    }
+}
+
+/* Take all timers from a slot and place them again, on lower levels */
+static void ucs_timerq_cascade(ucs_timer_queue_t *timerq, unsigned level,
+                               unsigned index)
+{
+    ucs_list_link_t *head = &timerq->wheel[(level * UCS_TIMERQ_LEVEL_SLOTS) + index];
+    ucs_timer_t *timer;
+
+    timerq->bitmap[level] &= ~UCS_BIT(index);
+    while (!ucs_list_is_empty(head)) {
+        timer = ucs_list_extract_head(head, ucs_timer_t, list);
+        ucs_timerq_insert(timerq, timer);
+    }
+}
+
+/* Next time, after the current one, when a non-empty slot of the level is due */
+static ucs_time_t ucs_timerq_level_next(ucs_timer_queue_t *timerq, unsigned level)
+{
+    unsigned shift   = level * UCS_TIMERQ_LEVEL_BITS;
+    ucs_time_t cycle = timerq->now >> shift;
+    unsigned first   = (cycle + 1) & (UCS_TIMERQ_LEVEL_SLOTS - 1);
+    uint64_t bitmap  = timerq->bitmap[level];
+    unsigned offset;
+
+    /* Rotate the bitmap so that the next slot is the lowest bit */
+    bitmap = (bitmap >> first) | ((first == 0) ? 0 : (bitmap << (64 - first)));
+    offset = ucs_ffs64(bitmap);
+    return (cycle + 1 + offset) << shift;
+}
+
+void ucs_timerq_sweep(ucs_timer_queue_t *timerq, ucs_time_t current_time)
+{
+    ucs_time_t next;
+    unsigned level;
+
+    while (timerq->now < current_time) {
+        /* Skip to the next time a non-empty slot is due */
+        next = current_time;
+        for (level = 0; level < UCS_TIMERQ_LEVELS; ++level) {
+            if (timerq->bitmap[level] != 0) {
+                next = ucs_min(next, ucs_timerq_level_next(timerq, level));
+            }
+        }
+
+        /* Move down the timers from the slots which start now, starting from
+         * the upper levels. Since no slot was due before, these slots hold only
+         * timers which expire during the slot. */
+        timerq->now = next;
+        for (level = UCS_TIMERQ_LEVELS - 1; level > 0; --level) {
+            if (next & UCS_MASK(level * UCS_TIMERQ_LEVEL_BITS)) {
+                continue;
+            }
+            ucs_timerq_cascade(timerq, level,
+                               (next >> (level * UCS_TIMERQ_LEVEL_BITS)) &
+                               (UCS_TIMERQ_LEVEL_SLOTS - 1));
+        }
+        ucs_timerq_cascade(timerq, 0, next & (UCS_TIMERQ_LEVEL_SLOTS - 1));
+    }
+}
+
+void ucs_timerq_reschedule(ucs_timer_queue_t *timerq, ucs_timer_t *timer,
+                           ucs_time_t current_time)
+{
+    ucs_list_del(&timer->list);
+    timer->expiration = ucs_max(current_time, timerq->now) + timer->interval;
+    ucs_timerq_insert(timerq, timer);
+}
+
+void ucs_timerq_update_min_interval(ucs_timer_queue_t *timerq)
+{
+    ucs_time_t min_interval;
+    khiter_t iter;
+
+    pthread_spin_lock(&timerq->lock);
+    if (timerq->min_interval_stale) {
+        min_interval = UCS_TIME_INFINITY;
+        for (iter = kh_begin(&timerq->intervals);
+             iter != kh_end(&timerq->intervals); ++iter) {
+            if (kh_exist(&timerq->intervals, iter)) {
+                min_interval = ucs_min(min_interval,
+                                       kh_key(&timerq->intervals, iter));
+            }
+        }
+        timerq->min_interval       = min_interval;
+        ucs_memory_cpu_store_fence();
+        timerq->min_interval_stale = 0;
+    }
+    pthread_spin_unlock(&timerq->lock);
 }
 
 ucs_status_t ucs_timerq_add(ucs_timer_queue_t *timerq, int timer_id,
                             ucs_time_t interval)
 {
     ucs_status_t status;
-    ucs_timer_t *ptr;
+    ucs_timer_t *timer;
+    khiter_t iter;
+    int ret;
 
     ucs_trace_func("timerq=%p interval=%.2fus timer_id=%d", timerq,
                    ucs_time_to_usec(interval), timer_id);
 
+    /* A timer with zero interval would be rescheduled to expire right away */
+    if (interval == 0) {
+        ucs_error("timer %d: interval must be positive", timer_id);
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    timer = ucs_malloc(sizeof(*timer), "timer");
+    if (timer == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
     pthread_spin_lock(&timerq->lock);
 
     /* Make sure ID is unique */
-    for (ptr = timerq->timers; ptr < timerq->timers + timerq->num_timers; ++ptr) {
-        if (ptr->id == timer_id) {
-            status = UCS_ERR_ALREADY_EXISTS;
-            goto out_unlock;
-        }
+    iter = kh_put(ucs_timerq_timers, &timerq->timers, timer_id, &ret);
+    if (ret == -1) {
+        status = UCS_ERR_NO_MEMORY;
+        goto err_unlock;
+    } else if (ret == 0) {
+        status = UCS_ERR_ALREADY_EXISTS;
+        goto err_unlock;
     }
+    kh_value(&timerq->timers, iter) = timer;
 
-    /* Resize timer array */
-    ptr = ucs_realloc(timerq->timers, (timerq->num_timers + 1) * sizeof(ucs_timer_t),
-                      "timerq");
-    if (ptr == NULL) {
+    iter = kh_put(ucs_timerq_intervals, &timerq->intervals, interval, &ret);
+    if (ret == -1) {
+        kh_del(ucs_timerq_timers, &timerq->timers,
+               kh_get(ucs_timerq_timers, &timerq->timers, timer_id));
         status = UCS_ERR_NO_MEMORY;
-        goto out_unlock;
+        goto err_unlock;
+    } else if (ret != 0) {
+        kh_value(&timerq->intervals, iter) = 0;
     }
-    timerq->timers = ptr;
+    ++kh_value(&timerq->intervals, iter);
+
     ++timerq->num_timers;
-    timerq->min_interval = ucs_min(interval, timerq->min_interval);
-    ucs_assert(timerq->min_interval != UCS_TIME_INFINITY);
+    if (!timerq->min_interval_stale) {
+        timerq->min_interval = ucs_min(interval, timerq->min_interval);
+        ucs_assert(timerq->min_interval != UCS_TIME_INFINITY);
+    }
 
     /* Initialize the new timer */
-    ptr = &timerq->timers[timerq->num_timers - 1];
-    ptr->expiration = 0; /* will fire the next time sweep is called */
-    ptr->interval   = interval;
-    ptr->id         = timer_id;
+    timer->expiration = 0; /* will fire the next time sweep is called */
+    timer->interval   = interval;
+    timer->id         = timer_id;
+    ucs_timerq_insert(timerq, timer);
 
-    status = UCS_OK;
+    pthread_spin_unlock(&timerq->lock);
+    return UCS_OK;
 
-out_unlock:
+err_unlock:
     pthread_spin_unlock(&timerq->lock);
+    ucs_free(timer);
     return status;
 }
 
 ucs_status_t ucs_timerq_remove(ucs_timer_queue_t *timerq, int timer_id)
 {
-    ucs_status_t status;
-    ucs_timer_t *ptr;
+    ucs_timer_t *timer;
+    khiter_t iter;
 
     ucs_trace_func("timerq=%p timer_id=%d", timerq, timer_id);
 
-    status = UCS_ERR_NO_ELEM;
-
     pthread_spin_lock(&timerq->lock);
-    timerq->min_interval = UCS_TIME_INFINITY;
-    ptr = timerq->timers;
-    while (ptr < timerq->timers + timerq->num_timers) {
-        if (ptr->id == timer_id) {
-            *ptr = timerq->timers[--timerq->num_timers];
-            status = UCS_OK;
-        } else {
-            timerq->min_interval = ucs_min(timerq->min_interval, ptr->interval);
-            ++ptr;
-        }
+
+    iter = kh_get(ucs_timerq_timers, &timerq->timers, timer_id);
+    if (iter == kh_end(&timerq->timers)) {
+        pthread_spin_unlock(&timerq->lock);
+        return UCS_ERR_NO_ELEM;
     }
 
-    /* TODO realloc - shrink */
-    if (timerq->num_timers == 0) {
-        ucs_assert(timerq->min_interval == UCS_TIME_INFINITY);
-        free(timerq->timers);
-        timerq->timers = NULL;
-    } else {
-        ucs_assert(timerq->min_interval != UCS_TIME_INFINITY);
+    timer = kh_value(&timerq->timers, iter);
+    kh_del(ucs_timerq_timers, &timerq->timers, iter);
+    ucs_timerq_unlink(timerq, timer);
+    --timerq->num_timers;
+
+    /* The minimal interval is recalculated when it's needed, after its last
+     * timer is removed */
+    iter = kh_get(ucs_timerq_intervals, &timerq->intervals, timer->interval);
+    ucs_assert(iter != kh_end(&timerq->intervals));
+    if (--kh_value(&timerq->intervals, iter) == 0) {
+        kh_del(ucs_timerq_intervals, &timerq->intervals, iter);
+        if (timerq->num_timers == 0) {
+            timerq->min_interval       = UCS_TIME_INFINITY;
+            timerq->min_interval_stale = 0;
+        } else if (timer->interval == timerq->min_interval) {
+            timerq->min_interval_stale = 1;
+        }
     }
 
     pthread_spin_unlock(&timerq->lock);
-    return status;
+    ucs_free(timer);
+    return UCS_OK;
 }
@@ -7,24 +7,52 @@
 #ifndef UCS_TIMERQ_H
 #define UCS_TIMERQ_H
 
+#include <ucs/datastruct/khash.h>
+#include <ucs/datastruct/list.h>
 #include <ucs/datastruct/queue.h>
 #include <ucs/time/time.h>
 #include <ucs/sys/preprocessor.h>
 #include <pthread.h>
 
 
+#define UCS_TIMERQ_LEVEL_BITS    6   /* Every level has 64 slots */
+#define UCS_TIMERQ_LEVEL_SLOTS   UCS_BIT(UCS_TIMERQ_LEVEL_BITS)
+#define UCS_TIMERQ_LEVELS        8   /* The wheel covers 2^48 time units */
+#define UCS_TIMERQ_SLOT_EXPIRED  (-1)
+
+
 typedef struct ucs_timer {
     ucs_time_t                 expiration;/* Absolute timer expiration time */
     ucs_time_t                 interval;  /* Re-scheduling interval */
     int                        id;
+    int                        slot;      /* Wheel slot, or UCS_TIMERQ_SLOT_EXPIRED */
+    ucs_list_link_t            list;      /* Link in the wheel slot */
 } ucs_timer_t;
 
 
+KHASH_MAP_INIT_INT(ucs_timerq_timers, ucs_timer_t*);
+KHASH_MAP_INIT_INT64(ucs_timerq_intervals, unsigned);
+
+
+/*
+ * Timers are kept in a hierarchical timer wheel: level N has 64 slots of
+ * 64^N time units each, and a timer is placed on the lowest level which covers
+ * its expiration. When the time crosses a slot of an upper level, its timers
+ * are moved to the lower levels, until they reach the expired list. Adding and
+ * removing a timer is O(1), and dispatching skips empty slots using a bitmap
+ * of non-empty slots per level, so it does not depend on the number of timers.
+ */
 typedef struct ucs_timer_queue {
     pthread_spinlock_t         lock;
     ucs_time_t                 min_interval; /* Expiration of next timer */
-    ucs_timer_t                *timers;      /* Array of timers */
+    int                        min_interval_stale; /* Needs to be recalculated */
+    ucs_time_t                 now;          /* Time the wheel was advanced to */
     unsigned                   num_timers;   /* Number of timers */
+    ucs_list_link_t            expired;      /* Timers to dispatch */
+    uint64_t                   bitmap[UCS_TIMERQ_LEVELS]; /* Non-empty slots */
+    ucs_list_link_t            *wheel;       /* Slots of all levels */
+    khash_t(ucs_timerq_timers)     timers;    /* Timer ID to timer */
+    khash_t(ucs_timerq_intervals)  intervals; /* Interval to number of timers */
 } ucs_timer_queue_t;
 
 
@@ -49,7 +77,7 @@ void ucs_timerq_cleanup(ucs_timer_queue_t *timerq);
  *
  * @param timerq     Timer queue to schedule on.
  * @param timer_id   Timer ID to add.
- * @param interval   Timer interval.
+ * @param interval   Timer interval, must be positive.
  */
 ucs_status_t ucs_timerq_add(ucs_timer_queue_t *timerq, int timer_id,
                             ucs_time_t interval);
@@ -64,10 +92,20 @@ ucs_status_t ucs_timerq_add(ucs_timer_queue_t *timerq, int timer_id,
 ucs_status_t ucs_timerq_remove(ucs_timer_queue_t *timerq, int timer_id);
 
 
+/**
+ * Recalculate the minimal interval, after the timers with the minimal interval
+ * were removed.
+ */
+void ucs_timerq_update_min_interval(ucs_timer_queue_t *timerq);
+
+
 /**
  * @return Minimal timer interval.
  */
 static inline ucs_time_t ucs_timerq_min_interval(ucs_timer_queue_t *timerq) {
+    if (ucs_unlikely(timerq->min_interval_stale)) {
+        ucs_timerq_update_min_interval(timerq);
+    }
     return timerq->min_interval;
 }
 
@@ -88,6 +126,21 @@ static inline int ucs_timerq_is_empty(ucs_timer_queue_t *timerq) {
 }
 
 
+/**
+ * Advance the timer wheel, and move the timers which expired until the given
+ * time to the expired list. Has to be called with the lock held.
+ */
+void ucs_timerq_sweep(ucs_timer_queue_t *timerq, ucs_time_t current_time);
+
+
+/**
+ * Reschedule an expired timer to its next interval. Has to be called with the
+ * lock held.
+ */
+void ucs_timerq_reschedule(ucs_timer_queue_t *timerq, ucs_timer_t *timer,
+                           ucs_time_t current_time);
+
+
 /**
  * Go through the expired timers in the timer queue.
  *
@@ -97,20 +150,19 @@ static inline int ucs_timerq_is_empty(ucs_timer_queue_t *timerq) {
  *
  * @note Timers which expired between calls to this function will also be dispatched.
  * @note There is no guarantee on the order of dispatching.
+ * @note If the loop is stopped by "break", the remaining expired timers are
+ *       dispatched the next time.
  */
 #define ucs_timerq_for_each_expired(_timer, _timerq, _current_time, _code) \
     { \
         ucs_time_t __current_time = _current_time; \
         pthread_spin_lock(&(_timerq)->lock); /* Grab lock */ \
-        for (_timer = (_timerq)->timers; \
-             _timer != (_timerq)->timers + (_timerq)->num_timers; \
-             ++_timer) \
-        { \
-            if (__current_time >= (_timer)->expiration) { \
-                /* Update expiration time */ \
-                (_timer)->expiration = __current_time + (_timer)->interval; \
-                _code; \
-            } \
+        ucs_timerq_sweep(_timerq, __current_time); \
+        while (!ucs_list_is_empty(&(_timerq)->expired)) { \
+            _timer = ucs_list_head(&(_timerq)->expired, ucs_timer_t, list); \
+            /* Update expiration time */ \
+            ucs_timerq_reschedule(_timerq, _timer, __current_time); \
+            _code; \
         } \
         pthread_spin_unlock(&(_timerq)->lock); /* Release lock  */ \
     }
@@ -0,0 +1,367 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2001-2017.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#ifndef UCS_TYPE_EPOCH_H_
+#define UCS_TYPE_EPOCH_H_
+
+#include <ucs/arch/atomic.h>
+#include <ucs/arch/cpu.h>
+#include <ucs/sys/compiler.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+
+
+/*
+ * Epoch based reclamation of shared data, which is read without a lock.
+ *
+ * Every reading thread has a record, in which it publishes the epoch when it
+ * started reading, so reading does not write shared memory. A writer replaces
+ * the data, advances the epoch, and waits for the readers of older epochs
+ * before releasing the old data. Threads without a record, for example while
+ * a record is allocated for them, are counted in one of two shared counters,
+ * selected by the parity of the epoch. A writer waits only for the counter of
+ * the epoch it retires, so readers which enter later do not delay it.
+ * The record of a thread is released when it exits.
+ *
+ * Defined in the header, so the memory hooks library can use it as well.
+ */
+
+
+/* Size of memory to allocate records from */
+#define UCS_EPOCH_READERS_CHUNK_SIZE  4096
+
+
+/* Read section, as returned by ucs_epoch_enter() */
+enum {
+    UCS_EPOCH_SECTION_NESTED,      /* Nested in another one, not left */
+    UCS_EPOCH_SECTION_RECORD,      /* Published in the record of the thread */
+    UCS_EPOCH_SECTION_SHARED       /* Counted in shared counter 0, or 1 if
+                                      one more than that */
+};
+
+
+/* Reader state of a thread */
+enum {
+    UCS_EPOCH_THREAD_UNREGISTERED,
+    UCS_EPOCH_THREAD_REGISTERING,
+    UCS_EPOCH_THREAD_REGISTERED,
+    UCS_EPOCH_THREAD_EXITED
+};
+
+
+/**
+ * Reader record. Records are never released, so the list of records can be
+ * walked without a lock, and are reused after a thread exits.
+ */
+typedef struct ucs_epoch_reader {
+    struct ucs_epoch_reader * volatile next;
+    volatile uint64_t                  epoch;   /* Epoch when entered, or 0 if outside */
+    int                                in_use;  /* Owned by a thread */
+} UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE) ucs_epoch_reader_t;
+
+
+/**
+ * Allocate memory for reader records, aligned to cache line size.
+ * Returns NULL if failed.
+ */
+typedef void* (*ucs_epoch_alloc_func_t)(size_t size);
+
+
+typedef struct ucs_epoch {
+    volatile uint64_t             current;      /* Current epoch */
+    volatile uint32_t             unregistered[2]; /* Readers without a record,
+                                                     by epoch parity */
+    ucs_epoch_reader_t * volatile readers;      /* List of records */
+    pthread_mutex_t               lock;         /* Protects records allocation */
+    pthread_mutex_t               sync_lock;    /* Serializes the writers */
+    ucs_epoch_reader_t            *chunk;       /* Records not allocated yet */
+    size_t                        chunk_left;
+    ucs_epoch_alloc_func_t        alloc;
+    pthread_key_t                 thread_key;   /* Releases records on exit */
+    int                           thread_key_created;
+} ucs_epoch_t;
+
+
+/**
+ * Reader state of a thread. Should be a zero-initialized thread-local variable,
+ * with initial-exec TLS model if used from memory hooks, since a dynamic TLS
+ * access could allocate memory.
+ */
+typedef struct ucs_epoch_thread {
+    ucs_epoch_t                   *epoch;
+    ucs_epoch_reader_t            *reader;
+    int                           state;
+} ucs_epoch_thread_t;
+
+
+#define UCS_EPOCH_INITIALIZER(_alloc) \
+    { \
+        .current            = 1, \
+        .unregistered       = {0, 0}, \
+        .readers            = NULL, \
+        .lock               = PTHREAD_MUTEX_INITIALIZER, \
+        .sync_lock          = PTHREAD_MUTEX_INITIALIZER, \
+        .chunk              = NULL, \
+        .chunk_left         = 0, \
+        .alloc              = (_alloc), \
+        .thread_key_created = 0 \
+    }
+
+
+/**
+ * Return the record of an exiting thread.
+ */
+static inline void ucs_epoch_reader_put(ucs_epoch_t *epoch,
+                                        ucs_epoch_reader_t *reader)
+{
+    pthread_mutex_lock(&epoch->lock);
+    reader->in_use = 0;
+    pthread_mutex_unlock(&epoch->lock);
+}
+
+
+static inline void ucs_epoch_thread_exit(void *arg)
+{
+    ucs_epoch_thread_t *thread = (ucs_epoch_thread_t*)arg;
+
+    thread->state = UCS_EPOCH_THREAD_EXITED;
+    ucs_epoch_reader_put(thread->epoch, thread->reader);
+}
+
+
+/**
+ * Get a record for the calling thread.
+ *
+ * @return Unused record, or NULL if out of memory.
+ */
+static inline ucs_epoch_reader_t *ucs_epoch_reader_get(ucs_epoch_t *epoch)
+{
+    ucs_epoch_reader_t *reader;
+
+    pthread_mutex_lock(&epoch->lock);
+
+    if (!epoch->thread_key_created) {
+        epoch->thread_key_created = !pthread_key_create(&epoch->thread_key,
+                                                        ucs_epoch_thread_exit);
+    }
+
+    for (reader = epoch->readers; reader != NULL; reader = reader->next) {
+        if (!reader->in_use) {
+            goto out;
+        }
+    }
+
+    if (epoch->chunk_left == 0) {
+        epoch->chunk = (ucs_epoch_reader_t*)epoch->alloc(UCS_EPOCH_READERS_CHUNK_SIZE);
+        if (epoch->chunk == NULL) {
+            reader = NULL;
+            goto out_unlock;
+        }
+        epoch->chunk_left = UCS_EPOCH_READERS_CHUNK_SIZE / sizeof(*reader);
+    }
+
+    reader        = epoch->chunk++;
+    --epoch->chunk_left;
+    reader->epoch = 0;
+    reader->next  = epoch->readers;
+    ucs_memory_cpu_store_fence();
+    epoch->readers = reader;
+
+out:
+    reader->in_use = 1;
+out_unlock:
+    pthread_mutex_unlock(&epoch->lock);
+    return reader;
+}
+
+
+/**
+ * Get a record for the calling thread, unless it already has one or has
+ * exited. Sections entered while registering, for example when the thread
+ * key needs memory, are counted as unregistered.
+ */
+static inline void ucs_epoch_thread_register(ucs_epoch_t *epoch,
+                                             ucs_epoch_thread_t *thread)
+{
+    if (thread->state != UCS_EPOCH_THREAD_UNREGISTERED) {
+        return;
+    }
+
+    thread->state  = UCS_EPOCH_THREAD_REGISTERING;
+    thread->epoch  = epoch;
+    thread->reader = ucs_epoch_reader_get(epoch);
+    if (thread->reader == NULL) {
+        thread->state = UCS_EPOCH_THREAD_UNREGISTERED;
+        return;
+    }
+
+    /* Without the key, the record is not reused after the thread exits */
+    if (epoch->thread_key_created) {
+        pthread_setspecific(epoch->thread_key, thread);
+    }
+    thread->state = UCS_EPOCH_THREAD_REGISTERED;
+}
+
+
+/**
+ * @return Record of the calling thread, or NULL if it has none.
+ */
+static inline ucs_epoch_reader_t *
+ucs_epoch_thread_reader(ucs_epoch_thread_t *thread)
+{
+    return (thread->state == UCS_EPOCH_THREAD_REGISTERED) ? thread->reader : NULL;
+}
+
+
+/**
+ * Enter a read section.
+ *
+ * @param reader  Record of the calling thread, or NULL if it has none.
+ *
+ * @return Section to pass to @ref ucs_epoch_leave, or UCS_EPOCH_SECTION_NESTED
+ *         (zero) if it should not be left.
+ *
+ * A section entered while the thread is already in one, for example from a
+ * signal handler, is nested in the outer one and does not have to be left.
+ */
+static inline int ucs_epoch_enter(ucs_epoch_t *epoch, ucs_epoch_reader_t *reader)
+{
+    unsigned index;
+
+    if (reader == NULL) {
+        index = epoch->current & 1;
+        ucs_atomic_add32(&epoch->unregistered[index], 1);
+        ucs_memory_bus_fence();
+        return UCS_EPOCH_SECTION_SHARED + index;
+    }
+
+    if (reader->epoch != 0) {
+        return UCS_EPOCH_SECTION_NESTED;
+    }
+
+    /* The epoch must be visible before reading the shared data */
+    reader->epoch = epoch->current;
+    ucs_memory_bus_fence();
+    return UCS_EPOCH_SECTION_RECORD;
+}
+
+
+/**
+ * Leave a read section.
+ *
+ * @param reader   Record which was passed to @ref ucs_epoch_enter.
+ * @param section  Section returned by @ref ucs_epoch_enter.
+ */
+static inline void ucs_epoch_leave(ucs_epoch_t *epoch, ucs_epoch_reader_t *reader,
+                                   int section)
+{
+    ucs_memory_cpu_fence();
+    if (section == UCS_EPOCH_SECTION_RECORD) {
+        reader->epoch = 0;
+    } else if (section != UCS_EPOCH_SECTION_NESTED) {
+        ucs_atomic_add32(&epoch->unregistered[section - UCS_EPOCH_SECTION_SHARED],
+                         -1);
+    }
+}
+
+
+static inline void ucs_epoch_wait_unregistered(ucs_epoch_t *epoch,
+                                               unsigned index)
+{
+    while (epoch->unregistered[index] != 0) {
+        sched_yield();
+    }
+}
+
+
+/**
+ * Wait until the read sections which could see the replaced data are done.
+ * Must not be called from a read section.
+ */
+static inline void ucs_epoch_synchronize(ucs_epoch_t *epoch)
+{
+    ucs_epoch_reader_t *reader;
+    uint64_t current;
+    unsigned index;
+
+    pthread_mutex_lock(&epoch->sync_lock);
+
+    /* Readers without a record which read the epoch before the previous
+     * writer advanced it may still be counted by the other parity. They are
+     * done before it is given to the new readers. */
+    index = epoch->current & 1;
+    ucs_epoch_wait_unregistered(epoch, !index);
+
+    current = epoch->current + 1;
+    epoch->current = current;
+    ucs_memory_bus_fence();
+
+    for (reader = epoch->readers; reader != NULL; reader = reader->next) {
+        while ((reader->epoch != 0) && (reader->epoch < current)) {
+            sched_yield();
+        }
+    }
+
+    /* Readers which entered after the epoch was advanced use the other
+     * counter, and do not delay the writer */
+    ucs_epoch_wait_unregistered(epoch, index);
+
+    pthread_mutex_unlock(&epoch->sync_lock);
+}
+
+
+/**
+ * Handlers for fork(): the records of threads which do not exist in the child
+ * process are released.
+ */
+static inline void ucs_epoch_fork_prepare(ucs_epoch_t *epoch)
+{
+    pthread_mutex_lock(&epoch->sync_lock);
+    pthread_mutex_lock(&epoch->lock);
+}
+
+static inline void ucs_epoch_fork_parent(ucs_epoch_t *epoch)
+{
+    pthread_mutex_unlock(&epoch->lock);
+    pthread_mutex_unlock(&epoch->sync_lock);
+}
+
+static inline void ucs_epoch_fork_child(ucs_epoch_t *epoch,
+                                        ucs_epoch_thread_t *self)
+{
+    ucs_epoch_reader_t *reader;
+
+    for (reader = epoch->readers; reader != NULL; reader = reader->next) {
+        if (reader != ucs_epoch_thread_reader(self)) {
+            reader->epoch  = 0;
+            reader->in_use = 0;
+        }
+    }
+    epoch->unregistered[0] = 0;
+    epoch->unregistered[1] = 0;
+
+    pthread_mutex_unlock(&epoch->lock);
+    pthread_mutex_unlock(&epoch->sync_lock);
+}
+
+
+/**
+ * Stop releasing the records of exiting threads, before the code which uses
+ * the epoch is unloaded.
+ */
+static inline void ucs_epoch_cleanup(ucs_epoch_t *epoch)
+{
+    pthread_mutex_lock(&epoch->lock);
+    if (epoch->thread_key_created) {
+        pthread_key_delete(epoch->thread_key);
+        epoch->thread_key_created = 0;
+    }
+    pthread_mutex_unlock(&epoch->lock);
+}
+
+#endif
@@ -376,6 +376,10 @@ struct uct_iface_attr {
     double                   bandwidth;    /**< Maximal bandwidth, bytes/second */
     uct_linear_growth_t      latency;      /**< Latency model */
     uint8_t                  priority;     /**< Priority of device */
+    uint64_t                 numa_node_mask; /**< Mask of NUMA nodes the receive
+                                                  resources of the interface are
+                                                  placed on, 0 if they are not
+                                                  placed on specific nodes */
 };
 
 
@@ -423,8 +427,11 @@ enum {
                                               remote memory key for remote memory
                                               operations */
     UCT_MD_FLAG_ADVISE    = UCS_BIT(4),  /**< MD support memory advice */
-    UCT_MD_FLAG_FIXED     = UCS_BIT(5)   /**< MD support memory allocation with
+    UCT_MD_FLAG_FIXED     = UCS_BIT(5),  /**< MD support memory allocation with
                                               fixed address */
+    UCT_MD_FLAG_RCACHE    = UCS_BIT(6)   /**< MD caches memory registrations,
+                                              so registering the same buffer
+                                              again is cheap */
 };
 
 
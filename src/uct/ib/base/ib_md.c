@@ -77,6 +77,16 @@ static ucs_config_field_t uct_ib_md_config_table[] = {
   {"RCACHE_OVERHEAD", "90ns", "Registration cache lookup overhead",
    ucs_offsetof(uct_ib_md_config_t, rcache.overhead), UCS_CONFIG_TYPE_TIME},
 
+  {"RCACHE_MAX_REGIONS", "inf",
+   "Maximal number of regions in the registration cache. Unused regions are\n"
+   "released in least recently used order to stay below the limit.",
+   ucs_offsetof(uct_ib_md_config_t, rcache.max_regions), UCS_CONFIG_TYPE_ULUNITS},
+
+  {"RCACHE_MAX_SIZE", "inf",
+   "Maximal total size of the regions in the registration cache. Unused regions\n"
+   "are released in least recently used order to stay below the limit.",
+   ucs_offsetof(uct_ib_md_config_t, rcache.max_size), UCS_CONFIG_TYPE_MEMUNITS},
+
   {"MEM_REG_OVERHEAD", "16us", "Memory registration overhead", /* TODO take default from device */
    ucs_offsetof(uct_ib_md_config_t, uc_reg_cost.overhead), UCS_CONFIG_TYPE_TIME},
 
@@ -166,6 +176,10 @@ static ucs_status_t uct_ib_md_query(uct_md_h uct_md, uct_md_attr_t *md_attr)
         md_attr->cap.flags |= UCT_MD_FLAG_ALLOC;
     }
 
+    if (md->rcache != NULL) {
+        md_attr->cap.flags |= UCT_MD_FLAG_RCACHE;
+    }
+
     md_attr->reg_cost      = md->reg_cost;
     md_attr->local_cpus    = md->dev.local_cpus;
     return UCS_OK;
@@ -1197,6 +1211,8 @@ uct_ib_md_open(const char *md_name, const uct_md_config_t *uct_md_config, uct_md
         rcache_params.ucm_event_priority = md_config->rcache.event_prio;
         rcache_params.context            = md;
         rcache_params.ops                = &uct_ib_rcache_ops;
+        rcache_params.max_regions        = md_config->rcache.max_regions;
+        rcache_params.max_size           = md_config->rcache.max_size;
         status = ucs_rcache_create(&rcache_params, uct_ib_device_name(&md->dev)
                                    UCS_STATS_ARG(md->stats), &md->rcache);
         if (status == UCS_OK) {
@@ -4,6 +4,7 @@
 */
 
 #include "sm_ep.h"
+#include "sm_iface.h"
 
 #include <ucs/arch/atomic.h>
 
@@ -39,6 +40,30 @@ ssize_t uct_sm_ep_put_bcopy(uct_ep_h tl_ep, uct_pack_callback_t pack_cb,
     return length;
 }
 
+ucs_status_t uct_sm_ep_put_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov,
+                                 size_t iovcnt, uint64_t remote_addr,
+                                 uct_rkey_t rkey, uct_completion_t *comp)
+{
+    void *dest = (void *)(rkey + remote_addr);
+    size_t iov_it, length;
+
+    UCT_CHECK_IOV_SIZE(iovcnt, (size_t)UCT_SM_MAX_IOV, "uct_sm_ep_put_zcopy");
+
+    /* the remote segment is mapped, so the data is copied directly from the
+     * user buffers and the operation is completed immediately */
+    for (iov_it = 0; iov_it < iovcnt; ++iov_it) {
+        length = uct_iov_get_length(&iov[iov_it]);
+        memcpy(dest, iov[iov_it].buffer, length);
+        dest += length;
+    }
+
+    uct_sm_ep_trace_data(remote_addr, rkey, "PUT_ZCOPY [length %zu]",
+                         uct_iov_total_length(iov, iovcnt));
+    UCT_TL_EP_STAT_OP(ucs_derived_of(tl_ep, uct_base_ep_t), PUT, ZCOPY,
+                      uct_iov_total_length(iov, iovcnt));
+    return UCS_OK;
+}
+
 ucs_status_t uct_sm_ep_get_bcopy(uct_ep_h tl_ep, uct_unpack_callback_t unpack_cb,
                                  void *arg, size_t length,
                                  uint64_t remote_addr, uct_rkey_t rkey,
@@ -54,6 +79,28 @@ ucs_status_t uct_sm_ep_get_bcopy(uct_ep_h tl_ep, uct_unpack_callback_t unpack_cb
     return UCS_OK;
 }
 
+ucs_status_t uct_sm_ep_get_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov,
+                                 size_t iovcnt, uint64_t remote_addr,
+                                 uct_rkey_t rkey, uct_completion_t *comp)
+{
+    void *src = (void *)(rkey + remote_addr);
+    size_t iov_it, length;
+
+    UCT_CHECK_IOV_SIZE(iovcnt, (size_t)UCT_SM_MAX_IOV, "uct_sm_ep_get_zcopy");
+
+    for (iov_it = 0; iov_it < iovcnt; ++iov_it) {
+        length = uct_iov_get_length(&iov[iov_it]);
+        memcpy(iov[iov_it].buffer, src, length);
+        src += length;
+    }
+
+    uct_sm_ep_trace_data(remote_addr, rkey, "GET_ZCOPY [length %zu]",
+                         uct_iov_total_length(iov, iovcnt));
+    UCT_TL_EP_STAT_OP(ucs_derived_of(tl_ep, uct_base_ep_t), GET, ZCOPY,
+                      uct_iov_total_length(iov, iovcnt));
+    return UCS_OK;
+}
+
 ucs_status_t uct_sm_ep_atomic_add64(uct_ep_h tl_ep, uint64_t add,
                                     uint64_t remote_addr, uct_rkey_t rkey)
 {
@@ -12,6 +12,7 @@
 #include <ucs/sys/string.h>
 #include <ucs/sys/sys.h>
 #include <ucs/arch/cpu.h>
+#include <sys/poll.h>
 
 
 static uint64_t uct_sm_iface_node_guid(uct_base_iface_t *iface)
@@ -51,3 +52,51 @@ ucs_status_t uct_sm_ep_fence(uct_ep_t *tl_ep, unsigned flags)
     UCT_TL_EP_STAT_FENCE(ucs_derived_of(tl_ep, uct_base_ep_t));
     return UCS_OK;
 }
+
+ucs_status_t uct_sm_iface_wakeup_get_fd(uct_wakeup_h wakeup, int *fd_p)
+{
+    *fd_p = wakeup->fd;
+    return UCS_OK;
+}
+
+/* Consume the signals of a wakeup fd, returns UCS_ERR_BUSY if there were any */
+ucs_status_t uct_sm_iface_wakeup_drain(int fd)
+{
+    int dummy, count, ret;
+
+    count = 0;
+    while ((ret = read(fd, &dummy, sizeof(dummy))) > 0) {
+        ++count;
+    }
+
+    if ((ret < 0) && (errno != EAGAIN)) {
+        ucs_error("failed to read from wakeup fd %d: %m", fd);
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return (count > 0) ? UCS_ERR_BUSY : UCS_OK;
+}
+
+ucs_status_t uct_sm_iface_wakeup_wait(uct_wakeup_h wakeup)
+{
+    struct pollfd polled = { .fd = wakeup->fd, .events = POLLIN };
+    ucs_status_t status;
+    int res;
+
+    status = wakeup->iface->ops.iface_wakeup_arm(wakeup);
+    if (status == UCS_ERR_BUSY) { /* there are events to process, don't poll() */
+        return UCS_OK;
+    } else if (status != UCS_OK) {
+        return status;
+    }
+
+    do {
+        res = poll(&polled, 1, -1);
+    } while ((res == -1) && (errno == EINTR));
+
+    if ((res != 1) || (polled.revents != POLLIN)) {
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return UCS_OK;
+}
@@ -24,6 +24,12 @@ ucs_status_t uct_sm_iface_fence(uct_iface_t *tl_iface, unsigned flags);
 
 ucs_status_t uct_sm_ep_fence(uct_ep_t *tl_ep, unsigned flags);
 
+ucs_status_t uct_sm_iface_wakeup_get_fd(uct_wakeup_h wakeup, int *fd_p);
+
+ucs_status_t uct_sm_iface_wakeup_drain(int fd);
+
+ucs_status_t uct_sm_iface_wakeup_wait(uct_wakeup_h wakeup);
+
 static UCS_F_ALWAYS_INLINE size_t uct_sm_get_max_iov() {
     return ucs_min(UCT_SM_MAX_IOV, ucs_get_max_iov());
 }
@@ -0,0 +1,443 @@
+/**
+ * Copyright (C) Mellanox Technologies Ltd. 2001-2017.  ALL RIGHTS RESERVED.
+ *
+ * See file LICENSE for terms.
+ */
+
+#define _GNU_SOURCE
+#include "cma_ep.h"
+
+#include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
+
+
+/**
+ * Fill the local iov of the part [offset, offset + length) of the operation.
+ *
+ * @return Number of entries in local_iov.
+ */
+static size_t uct_cma_copy_op_slice(const uct_cma_copy_op_t *op, size_t offset,
+                                    size_t length, struct iovec *local_iov)
+{
+    size_t iov_it, iov_offset, local_iov_it;
+
+    iov_offset   = 0;
+    local_iov_it = 0;
+    for (iov_it = 0; (iov_it < op->iovcnt) && (length > 0); ++iov_it) {
+        if (iov_offset + op->iov[iov_it].iov_len <= offset) {
+            /* the whole iov element is before the slice */
+            iov_offset += op->iov[iov_it].iov_len;
+            continue;
+        }
+
+        local_iov[local_iov_it].iov_base = op->iov[iov_it].iov_base +
+                                           (offset - iov_offset);
+        local_iov[local_iov_it].iov_len  = ucs_min(op->iov[iov_it].iov_len -
+                                                   (offset - iov_offset),
+                                                   length);
+        offset     += local_iov[local_iov_it].iov_len;
+        length     -= local_iov[local_iov_it].iov_len;
+        iov_offset += op->iov[iov_it].iov_len;
+        ++local_iov_it;
+    }
+
+    return local_iov_it;
+}
+
+/**
+ * Copy a single chunk of the operation. Called from a helper thread.
+ */
+static ucs_status_t uct_cma_copy_chunk(uct_cma_copy_op_t *op, size_t offset,
+                                       size_t length)
+{
+    struct iovec local_iov[UCT_SM_MAX_IOV];
+    struct iovec remote_iov;
+    size_t local_iovcnt;
+    ssize_t ret;
+
+    while (length > 0) {
+        local_iovcnt        = uct_cma_copy_op_slice(op, offset, length, local_iov);
+        remote_iov.iov_base = (void*)(op->remote_addr + offset);
+        remote_iov.iov_len  = length;
+
+        if (op->is_put) {
+            ret = process_vm_writev(op->remote_pid, local_iov, local_iovcnt,
+                                    &remote_iov, 1, 0);
+        } else {
+            ret = process_vm_readv(op->remote_pid, local_iov, local_iovcnt,
+                                   &remote_iov, 1, 0);
+        }
+        if (ret < 0) {
+            ucs_error("%s at offset %zu length %zu failed: %m",
+                      op->is_put ? "process_vm_writev" : "process_vm_readv",
+                      offset, length);
+            return UCS_ERR_IO_ERROR;
+        }
+
+        offset += ret;
+        length -= ret;
+    }
+
+    return UCS_OK;
+}
+
+static void *uct_cma_copy_thread_func(void *arg)
+{
+    uct_cma_iface_t *iface = arg;
+    uct_cma_copy_op_t *op;
+    ucs_status_t status;
+    size_t offset, length;
+
+    pthread_mutex_lock(&iface->engine.lock);
+    for (;;) {
+        while (!iface->engine.stop && ucs_queue_is_empty(&iface->engine.pending)) {
+            pthread_cond_wait(&iface->engine.cond, &iface->engine.lock);
+        }
+
+        if (iface->engine.stop) {
+            break;
+        }
+
+        /* take the next chunk of the first operation */
+        op         = ucs_queue_head_elem_non_empty(&iface->engine.pending,
+                                                   uct_cma_copy_op_t, queue);
+        offset     = op->offset;
+        length     = ucs_min(op->length - offset, iface->config.copy_chunk);
+        op->offset = offset + length;
+        if (op->offset == op->length) {
+            ucs_queue_pull_non_empty(&iface->engine.pending);
+        }
+        pthread_mutex_unlock(&iface->engine.lock);
+
+        status = uct_cma_copy_chunk(op, offset, length);
+
+        pthread_mutex_lock(&iface->engine.lock);
+        if (status != UCS_OK) {
+            op->status = status;
+        }
+        if (--op->chunks_left == 0) {
+            ucs_queue_push(&iface->engine.completed, &op->queue);
+            ++iface->engine.num_completed;
+            if (iface->engine.wakeup_armed) {
+                iface->engine.wakeup_armed = 0;
+                ucs_async_pipe_push(&iface->wakeup_pipe);
+            }
+        }
+    }
+    pthread_mutex_unlock(&iface->engine.lock);
+
+    return NULL;
+}
+
+static ucs_status_t uct_cma_iface_copy_start(uct_cma_iface_t *iface)
+{
+    unsigned i;
+    int ret;
+
+    iface->engine.threads = ucs_calloc(iface->config.copy_threads,
+                                       sizeof(*iface->engine.threads),
+                                       "cma_copy_threads");
+    if (iface->engine.threads == NULL) {
+        ucs_error("Failed to allocate CMA copy threads array");
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < iface->config.copy_threads; ++i) {
+        ret = pthread_create(&iface->engine.threads[i], NULL,
+                             uct_cma_copy_thread_func, iface);
+        if (ret != 0) {
+            ucs_error("Failed to create CMA copy thread: %s", strerror(ret));
+            break;
+        }
+    }
+
+    iface->engine.num_threads = i;
+    if (i == 0) {
+        ucs_free(iface->engine.threads);
+        iface->engine.threads = NULL;
+        return UCS_ERR_IO_ERROR;
+    }
+
+    ucs_debug("cma iface %p: started %u copy threads", iface, i);
+    return UCS_OK;
+}
+
+ucs_status_t uct_cma_iface_copy_post(uct_cma_iface_t *iface, uct_cma_ep_t *ep,
+                                     const uct_iov_t *iov, size_t iovcnt,
+                                     uint64_t remote_addr, int is_put,
+                                     uct_completion_t *comp)
+{
+    uct_cma_copy_op_t *op;
+    ucs_status_t status;
+    size_t iov_it;
+
+    if (ucs_unlikely(iface->engine.num_threads == 0)) {
+        status = uct_cma_iface_copy_start(iface);
+        if (status != UCS_OK) {
+            return status;
+        }
+    }
+
+    op = ucs_mpool_get(&iface->op_mp);
+    if (op == NULL) {
+        return UCS_ERR_NO_RESOURCE;
+    }
+
+    op->ep          = ep;
+    op->remote_pid  = ep->remote_pid;
+    op->comp        = comp;
+    op->is_put      = is_put;
+    op->remote_addr = remote_addr;
+    op->length      = 0;
+    op->offset      = 0;
+    op->status      = UCS_OK;
+    op->iovcnt      = 0;
+    for (iov_it = 0; iov_it < iovcnt; ++iov_it) {
+        if (uct_iov_get_length(&iov[iov_it]) == 0) {
+            continue;
+        }
+        op->iov[op->iovcnt].iov_base = iov[iov_it].buffer;
+        op->iov[op->iovcnt].iov_len  = uct_iov_get_length(&iov[iov_it]);
+        op->length                  += op->iov[op->iovcnt].iov_len;
+        ++op->iovcnt;
+    }
+    op->chunks_left = ucs_div_round_up(op->length, iface->config.copy_chunk);
+
+    if (iface->outstanding++ == 0) {
+        uct_worker_progress_register(iface->super.worker,
+                                     uct_cma_iface_copy_progress, iface);
+    }
+    ++ep->outstanding;
+    ucs_list_add_tail(&iface->outstanding_ops, &op->list);
+
+    pthread_mutex_lock(&iface->engine.lock);
+    ucs_queue_push(&iface->engine.pending, &op->queue);
+    pthread_cond_broadcast(&iface->engine.cond);
+    pthread_mutex_unlock(&iface->engine.lock);
+
+    return UCS_INPROGRESS;
+}
+
+static void uct_cma_ep_copy_complete(uct_cma_ep_t *ep)
+{
+    uct_cma_copy_op_t *op;
+
+    if (--ep->outstanding > 0) {
+        return;
+    }
+
+    ep->fenced = 0;
+
+    /* complete flush requests which were waiting for the copy operations */
+    while (!ucs_queue_is_empty(&ep->flush_q)) {
+        op = ucs_queue_pull_elem_non_empty(&ep->flush_q, uct_cma_copy_op_t, queue);
+        uct_invoke_completion(op->comp, UCS_OK);
+        ucs_mpool_put(op);
+    }
+}
+
+void uct_cma_iface_copy_progress(void *arg)
+{
+    uct_cma_iface_t *iface = arg;
+    uct_cma_pending_req_priv_t *priv;
+    ucs_queue_head_t completed;
+    uct_cma_copy_op_t *op;
+
+    /* the queue itself is read only with the lock held */
+    if (iface->engine.num_completed == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&iface->engine.lock);
+    ucs_queue_head_init(&completed);
+    ucs_queue_splice(&completed, &iface->engine.completed);
+    iface->engine.num_completed = 0;
+    pthread_mutex_unlock(&iface->engine.lock);
+
+    ucs_queue_for_each_extract(op, &completed, queue, 1) {
+        ucs_trace_data("cma: completed %s of %zu bytes to 0x%"PRIx64": %s",
+                       op->is_put ? "put" : "get", op->length, op->remote_addr,
+                       ucs_status_string(op->status));
+        if (op->comp != NULL) {
+            uct_invoke_completion(op->comp, op->status);
+        }
+        if (op->ep != NULL) {
+            uct_cma_ep_copy_complete(op->ep);
+        }
+        ucs_list_del(&op->list);
+        ucs_mpool_put(op);
+
+        if (--iface->outstanding == 0) {
+            iface->fenced = 0;
+            uct_worker_progress_unregister(iface->super.worker,
+                                           uct_cma_iface_copy_progress, iface);
+        }
+    }
+
+    /* resume the requests which were waiting for a fence */
+    uct_pending_queue_dispatch(priv, &iface->pending_q,
+                               !uct_cma_ep_is_fenced(iface, priv->ep));
+}
+
+ucs_status_t uct_cma_ep_flush(uct_ep_h tl_ep, unsigned flags,
+                              uct_completion_t *comp)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_cma_iface_t);
+    uct_cma_ep_t *ep       = ucs_derived_of(tl_ep, uct_cma_ep_t);
+    uct_cma_copy_op_t *op;
+
+    if (ep->outstanding == 0) {
+        UCT_TL_EP_STAT_FLUSH(&ep->super);
+        return UCS_OK;
+    }
+
+    if (comp != NULL) {
+        op = ucs_mpool_get(&iface->op_mp);
+        if (op == NULL) {
+            return UCS_ERR_NO_RESOURCE;
+        }
+
+        op->comp   = comp;
+        op->length = 0;
+        ucs_queue_push(&ep->flush_q, &op->queue);
+    }
+
+    UCT_TL_EP_STAT_FLUSH_WAIT(&ep->super);
+    return UCS_INPROGRESS;
+}
+
+ucs_status_t uct_cma_iface_flush(uct_iface_h tl_iface, unsigned flags,
+                                 uct_completion_t *comp)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(tl_iface, uct_cma_iface_t);
+
+    if (comp != NULL) {
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    if (iface->outstanding > 0) {
+        UCT_TL_IFACE_STAT_FLUSH_WAIT(&iface->super);
+        return UCS_INPROGRESS;
+    }
+
+    UCT_TL_IFACE_STAT_FLUSH(&iface->super);
+    return UCS_OK;
+}
+
+ucs_status_t uct_cma_ep_fence(uct_ep_h tl_ep, unsigned flags)
+{
+    uct_cma_ep_t *ep = ucs_derived_of(tl_ep, uct_cma_ep_t);
+
+    /* operations posted after the fence must not pass copies in progress, so
+     * they are rejected until these are completed, instead of waiting here */
+    if (ep->outstanding > 0) {
+        ep->fenced = 1;
+    }
+
+    return uct_sm_ep_fence(tl_ep, flags);
+}
+
+ucs_status_t uct_cma_iface_fence(uct_iface_h tl_iface, unsigned flags)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(tl_iface, uct_cma_iface_t);
+
+    if (iface->outstanding > 0) {
+        iface->fenced = 1;
+    }
+
+    return uct_sm_iface_fence(tl_iface, flags);
+}
+
+ucs_status_t uct_cma_ep_pending_add(uct_ep_h tl_ep, uct_pending_req_t *req)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_cma_iface_t);
+    uct_cma_ep_t *ep       = ucs_derived_of(tl_ep, uct_cma_ep_t);
+
+    if (!uct_cma_ep_is_fenced(iface, ep)) {
+        return UCS_ERR_BUSY;
+    }
+
+    UCS_STATIC_ASSERT(sizeof(uct_cma_pending_req_priv_t) <= UCT_PENDING_REQ_PRIV_LEN);
+    ucs_derived_of(uct_pending_req_priv(req), uct_cma_pending_req_priv_t)->ep = ep;
+    uct_pending_req_push(&iface->pending_q, req);
+    return UCS_OK;
+}
+
+void uct_cma_ep_pending_purge(uct_ep_h tl_ep, uct_pending_purge_callback_t cb,
+                              void *arg)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_cma_iface_t);
+    uct_cma_ep_t *ep       = ucs_derived_of(tl_ep, uct_cma_ep_t);
+    uct_cma_pending_req_priv_t *priv;
+    uct_pending_req_t *req;
+    ucs_queue_iter_t iter;
+
+    ucs_queue_for_each_safe(priv, iter, &iface->pending_q, super.queue) {
+        if (priv->ep != ep) {
+            continue;
+        }
+
+        ucs_queue_del_iter(&iface->pending_q, iter);
+        req = ucs_container_of(priv, uct_pending_req_t, priv);
+        if (cb != NULL) {
+            cb(req, arg);
+        } else {
+            ucs_warn("ep=%p cancelling user pending request %p", ep, req);
+        }
+    }
+}
+
+/**
+ * Detach a destroyed endpoint from its copy operations. The helper threads
+ * finish them without the endpoint, and progress releases them, without
+ * invoking the user completions, as well as the flush requests.
+ */
+void uct_cma_ep_copy_detach(uct_cma_ep_t *ep)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(ep->super.super.iface,
+                                            uct_cma_iface_t);
+    uct_cma_copy_op_t *op;
+
+    ucs_list_for_each(op, &iface->outstanding_ops, list) {
+        if (op->ep == ep) {
+            op->ep   = NULL;
+            op->comp = NULL;
+        }
+    }
+
+    ucs_queue_for_each_extract(op, &ep->flush_q, queue, 1) {
+        ucs_mpool_put(op);
+    }
+
+    uct_cma_ep_pending_purge(&ep->super.super, NULL, NULL);
+}
+
+void uct_cma_iface_copy_cleanup(uct_cma_iface_t *iface)
+{
+    uct_cma_copy_op_t *op, *tmp;
+    unsigned i;
+
+    /* the threads stop after the chunks they are copying now */
+    pthread_mutex_lock(&iface->engine.lock);
+    iface->engine.stop = 1;
+    pthread_cond_broadcast(&iface->engine.cond);
+    pthread_mutex_unlock(&iface->engine.lock);
+
+    for (i = 0; i < iface->engine.num_threads; ++i) {
+        pthread_join(iface->engine.threads[i], NULL);
+    }
+    ucs_free(iface->engine.threads);
+
+    /* release the copies which were not completed */
+    if (iface->outstanding > 0) {
+        ucs_debug("cma iface %p: canceling %u copy operations", iface,
+                  iface->outstanding);
+        ucs_list_for_each_safe(op, tmp, &iface->outstanding_ops, list) {
+            ucs_list_del(&op->list);
+            ucs_mpool_put(op);
+        }
+        uct_worker_progress_unregister(iface->super.worker,
+                                       uct_cma_iface_copy_progress, iface);
+        iface->outstanding = 0;
+    }
+}
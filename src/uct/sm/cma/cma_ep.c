@@ -22,13 +22,17 @@ static UCS_CLASS_INIT_FUNC(uct_cma_ep_t, uct_iface_t *tl_iface,
     uct_cma_iface_t *iface = ucs_derived_of(tl_iface, uct_cma_iface_t);
 
     UCS_CLASS_CALL_SUPER_INIT(uct_base_ep_t, &iface->super);
-    self->remote_pid = *(const pid_t*)iface_addr;
+    self->remote_pid  = *(const pid_t*)iface_addr;
+    self->outstanding = 0;
+    self->fenced      = 0;
+    ucs_queue_head_init(&self->flush_q);
     return UCS_OK;
 }
 
 static UCS_CLASS_CLEANUP_FUNC(uct_cma_ep_t)
 {
-    /* No op */
+    /* the helper threads may still be copying on behalf of this endpoint */
+    uct_cma_ep_copy_detach(self);
 }
 
 UCS_CLASS_DEFINE(uct_cma_ep_t, uct_base_ep_t)
@@ -120,19 +124,48 @@ ucs_status_t uct_cma_ep_common_zcopy(uct_ep_h tl_ep,
     return UCS_OK;
 }
 
+/**
+ * Large transfers are split to chunks and copied by the helper threads, so
+ * several cores can drive process_vm_* calls of the same message in parallel.
+ */
+static UCS_F_ALWAYS_INLINE int
+uct_cma_ep_is_copy_async(uct_cma_iface_t *iface, const uct_iov_t *iov,
+                         size_t iovcnt)
+{
+    return (iface->config.copy_threads > 0) &&
+           (uct_iov_total_length(iov, iovcnt) > iface->config.copy_chunk);
+}
+
 ucs_status_t uct_cma_ep_put_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov, size_t iovcnt,
                                   uint64_t remote_addr, uct_rkey_t rkey,
                                   uct_completion_t *comp)
 {
+    uct_cma_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_cma_iface_t);
+    uct_cma_ep_t *ep       = ucs_derived_of(tl_ep, uct_cma_ep_t);
+    ucs_status_t ret;
+
     UCT_CHECK_IOV_SIZE(iovcnt, uct_sm_get_max_iov(), "uct_cma_ep_put_zcopy");
 
-    int ret = uct_cma_ep_common_zcopy(tl_ep,
+    if (ucs_unlikely(uct_cma_ep_is_fenced(iface, ep))) {
+        return UCS_ERR_NO_RESOURCE;
+    }
+
+    if (uct_cma_ep_is_copy_async(iface, iov, iovcnt)) {
+        ret = uct_cma_iface_copy_post(iface, ep, iov, iovcnt, remote_addr, 1,
+                                      comp);
+    } else {
+        ret = uct_cma_ep_common_zcopy(tl_ep,
                                       iov,
                                       iovcnt,
                                       remote_addr,
                                       comp,
                                       process_vm_writev,
                                       "process_vm_writev");
+    }
+
+    if ((ret != UCS_OK) && (ret != UCS_INPROGRESS)) {
+        return ret;
+    }
 
     UCT_TL_EP_STAT_OP(ucs_derived_of(tl_ep, uct_base_ep_t), PUT, ZCOPY,
                       uct_iov_total_length(iov, iovcnt));
@@ -145,15 +178,32 @@ ucs_status_t uct_cma_ep_get_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov, size_t i
                                   uint64_t remote_addr, uct_rkey_t rkey,
                                   uct_completion_t *comp)
 {
+    uct_cma_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_cma_iface_t);
+    uct_cma_ep_t *ep       = ucs_derived_of(tl_ep, uct_cma_ep_t);
+    ucs_status_t ret;
+
     UCT_CHECK_IOV_SIZE(iovcnt, uct_sm_get_max_iov(), "uct_cma_ep_get_zcopy");
 
-    int ret = uct_cma_ep_common_zcopy(tl_ep,
+    if (ucs_unlikely(uct_cma_ep_is_fenced(iface, ep))) {
+        return UCS_ERR_NO_RESOURCE;
+    }
+
+    if (uct_cma_ep_is_copy_async(iface, iov, iovcnt)) {
+        ret = uct_cma_iface_copy_post(iface, ep, iov, iovcnt, remote_addr, 0,
+                                      comp);
+    } else {
+        ret = uct_cma_ep_common_zcopy(tl_ep,
                                       iov,
                                       iovcnt,
                                       remote_addr,
                                       comp,
                                       process_vm_readv,
                                       "process_vm_readv");
+    }
+
+    if ((ret != UCS_OK) && (ret != UCS_INPROGRESS)) {
+        return ret;
+    }
 
     UCT_TL_EP_STAT_OP(ucs_derived_of(tl_ep, uct_base_ep_t), GET, ZCOPY,
                       uct_iov_total_length(iov, iovcnt));
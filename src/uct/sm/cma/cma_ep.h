@@ -12,10 +12,34 @@
 #include <uct/base/uct_log.h>
 
 
-typedef struct uct_cma_ep {
-    uct_base_ep_t super;
-    pid_t         remote_pid;
-} uct_cma_ep_t;
+struct uct_cma_ep {
+    uct_base_ep_t    super;
+    pid_t            remote_pid;
+    unsigned         outstanding;  /* Copy operations in progress */
+    int              fenced;       /* New operations wait for them */
+    ucs_queue_head_t flush_q;      /* Flush requests waiting for them */
+};
+
+
+/**
+ * CMA endpoint pending request private data. The requests of all endpoints
+ * are queued on the interface, in order to be dispatched from progress.
+ */
+typedef struct {
+    uct_pending_req_priv_t super;
+    uct_cma_ep_t           *ep;
+} uct_cma_pending_req_priv_t;
+
+
+/**
+ * Operations issued after a fence are rejected until the copies which were
+ * started before it are completed.
+ */
+static UCS_F_ALWAYS_INLINE int
+uct_cma_ep_is_fenced(uct_cma_iface_t *iface, uct_cma_ep_t *ep)
+{
+    return iface->fenced || ep->fenced;
+}
 
 UCS_CLASS_DECLARE_NEW_FUNC(uct_cma_ep_t, uct_ep_t, uct_iface_t*,
                            const uct_device_addr_t *, const uct_iface_addr_t *);
@@ -26,4 +50,11 @@ ucs_status_t uct_cma_ep_put_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov, size_t i
 ucs_status_t uct_cma_ep_get_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov, size_t iovcnt,
                                   uint64_t remote_addr, uct_rkey_t rkey,
                                   uct_completion_t *comp);
+ucs_status_t uct_cma_ep_flush(uct_ep_h tl_ep, unsigned flags,
+                              uct_completion_t *comp);
+ucs_status_t uct_cma_ep_fence(uct_ep_h tl_ep, unsigned flags);
+ucs_status_t uct_cma_ep_pending_add(uct_ep_h tl_ep, uct_pending_req_t *req);
+void uct_cma_ep_pending_purge(uct_ep_h tl_ep, uct_pending_purge_callback_t cb,
+                              void *arg);
+void uct_cma_ep_copy_detach(uct_cma_ep_t *ep);
 #endif
@@ -10,6 +10,7 @@
 
 #include <uct/base/uct_md.h>
 #include <uct/sm/base/sm_iface.h>
+#include <ucs/arch/cpu.h>
 #include <ucs/sys/string.h>
 
 
@@ -19,6 +20,17 @@ static ucs_config_field_t uct_cma_iface_config_table[] = {
     {"", "ALLOC=huge,mmap,heap", NULL,
     ucs_offsetof(uct_cma_iface_config_t, super),
     UCS_CONFIG_TYPE_TABLE(uct_iface_config_table)},
+
+    {"COPY_THREADS", "2",
+     "Number of helper threads which copy large zero-copy operations. 0 means\n"
+     "all operations are copied by the calling thread.",
+     ucs_offsetof(uct_cma_iface_config_t, copy_threads), UCS_CONFIG_TYPE_UINT},
+
+    {"COPY_CHUNK", "1m",
+     "Size of the chunks a large operation is split to among the copy threads.\n"
+     "Operations up to this size are copied by the calling thread.",
+     ucs_offsetof(uct_cma_iface_config_t, copy_chunk), UCS_CONFIG_TYPE_MEMUNITS},
+
     {NULL}
 };
 
@@ -57,6 +69,7 @@ static ucs_status_t uct_cma_iface_query(uct_iface_h tl_iface,
     iface_attr->cap.flags               = UCT_IFACE_FLAG_GET_ZCOPY |
                                           UCT_IFACE_FLAG_PUT_ZCOPY |
                                           UCT_IFACE_FLAG_PENDING   |
+                                          UCT_IFACE_FLAG_WAKEUP    |
                                           UCT_IFACE_FLAG_CONNECT_TO_IFACE;
     iface_attr->latency.overhead        = 80e-9; /* 80 ns */
     iface_attr->latency.growth          = 0;
@@ -65,6 +78,76 @@ static ucs_status_t uct_cma_iface_query(uct_iface_h tl_iface,
     return UCS_OK;
 }
 
+/* The copy operations which are posted to the helper threads are the only
+ * events of the interface. A helper thread which completes an operation while
+ * the interface is armed signals the wakeup pipe. */
+static ucs_status_t uct_cma_iface_wakeup_open(uct_iface_h tl_iface,
+                                              unsigned events,
+                                              uct_wakeup_h wakeup)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(tl_iface, uct_cma_iface_t);
+    ucs_status_t status;
+
+    if (iface->wakeup_pipe.read_fd != -1) {
+        ucs_error("cma iface %p already has a wakeup handle", iface);
+        return UCS_ERR_ALREADY_EXISTS;
+    }
+
+    status = ucs_async_pipe_create(&iface->wakeup_pipe);
+    if (status != UCS_OK) {
+        iface->wakeup_pipe.read_fd = -1;
+        return status;
+    }
+
+    wakeup->fd = ucs_async_pipe_rfd(&iface->wakeup_pipe);
+    return UCS_OK;
+}
+
+static ucs_status_t uct_cma_iface_wakeup_arm(uct_wakeup_h wakeup)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(wakeup->iface, uct_cma_iface_t);
+    ucs_status_t status;
+
+    status = uct_sm_iface_wakeup_drain(wakeup->fd);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    if (!(wakeup->events & UCT_WAKEUP_TX_COMPLETION)) {
+        return UCS_OK;
+    }
+
+    pthread_mutex_lock(&iface->engine.lock);
+    if (!ucs_queue_is_empty(&iface->engine.completed)) {
+        status = UCS_ERR_BUSY;
+    } else {
+        iface->engine.wakeup_armed = 1;
+    }
+    pthread_mutex_unlock(&iface->engine.lock);
+
+    return status;
+}
+
+static ucs_status_t uct_cma_iface_wakeup_signal(uct_wakeup_h wakeup)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(wakeup->iface, uct_cma_iface_t);
+
+    ucs_async_pipe_push(&iface->wakeup_pipe);
+    return UCS_OK;
+}
+
+static void uct_cma_iface_wakeup_close(uct_wakeup_h wakeup)
+{
+    uct_cma_iface_t *iface = ucs_derived_of(wakeup->iface, uct_cma_iface_t);
+
+    pthread_mutex_lock(&iface->engine.lock);
+    iface->engine.wakeup_armed = 0;
+    pthread_mutex_unlock(&iface->engine.lock);
+
+    ucs_async_pipe_destroy(&iface->wakeup_pipe);
+    iface->wakeup_pipe.read_fd = -1;
+}
+
 static UCS_CLASS_DECLARE_DELETE_FUNC(uct_cma_iface_t, uct_iface_t);
 
 static uct_iface_ops_t uct_cma_iface_ops = {
@@ -73,29 +156,82 @@ static uct_iface_ops_t uct_cma_iface_ops = {
     .iface_get_address   = uct_cma_iface_get_address,
     .iface_get_device_address = uct_sm_iface_get_device_address,
     .iface_is_reachable  = uct_sm_iface_is_reachable,
-    .iface_fence         = uct_sm_iface_fence,
+    .iface_flush         = uct_cma_iface_flush,
+    .iface_fence         = uct_cma_iface_fence,
+    .iface_wakeup_open   = uct_cma_iface_wakeup_open,
+    .iface_wakeup_get_fd = uct_sm_iface_wakeup_get_fd,
+    .iface_wakeup_arm    = uct_cma_iface_wakeup_arm,
+    .iface_wakeup_wait   = uct_sm_iface_wakeup_wait,
+    .iface_wakeup_signal = uct_cma_iface_wakeup_signal,
+    .iface_wakeup_close  = uct_cma_iface_wakeup_close,
     .ep_put_zcopy        = uct_cma_ep_put_zcopy,
     .ep_get_zcopy        = uct_cma_ep_get_zcopy,
-    .ep_fence            = uct_sm_ep_fence,
+    .ep_flush            = uct_cma_ep_flush,
+    .ep_fence            = uct_cma_ep_fence,
     .ep_create_connected = UCS_CLASS_NEW_FUNC_NAME(uct_cma_ep_t),
     .ep_destroy          = UCS_CLASS_DELETE_FUNC_NAME(uct_cma_ep_t),
-    .ep_pending_purge    = (void*)ucs_empty_function_return_success,
+    .ep_pending_add      = uct_cma_ep_pending_add,
+    .ep_pending_purge    = uct_cma_ep_pending_purge,
+};
+
+static ucs_mpool_ops_t uct_cma_copy_op_mpool_ops = {
+    .chunk_alloc   = ucs_mpool_chunk_malloc,
+    .chunk_release = ucs_mpool_chunk_free,
+    .obj_init      = NULL,
+    .obj_cleanup   = NULL
 };
 
 static UCS_CLASS_INIT_FUNC(uct_cma_iface_t, uct_md_h md, uct_worker_h worker,
                            const uct_iface_params_t *params,
                            const uct_iface_config_t *tl_config)
 {
+    uct_cma_iface_config_t *config = ucs_derived_of(tl_config,
+                                                    uct_cma_iface_config_t);
+    ucs_status_t status;
+
     UCS_CLASS_CALL_SUPER_INIT(uct_base_iface_t, &uct_cma_iface_ops, md, worker,
                               params, tl_config UCS_STATS_ARG(params->stats_root)
                               UCS_STATS_ARG(UCT_CMA_TL_NAME));
     uct_sm_get_max_iov(); /* to initialize ucs_get_max_iov static variable */
 
+    if (config->copy_chunk == 0) {
+        ucs_error("CMA copy chunk size must be non-zero");
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    self->config.copy_threads = config->copy_threads;
+    self->config.copy_chunk   = config->copy_chunk;
+    self->outstanding         = 0;
+    self->fenced              = 0;
+    ucs_list_head_init(&self->outstanding_ops);
+    ucs_queue_head_init(&self->pending_q);
+
+    status = ucs_mpool_init(&self->op_mp, 0, sizeof(uct_cma_copy_op_t), 0,
+                            UCS_SYS_CACHE_LINE_SIZE, 16, UINT_MAX,
+                            &uct_cma_copy_op_mpool_ops, "cma_copy_op");
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    pthread_mutex_init(&self->engine.lock, NULL);
+    pthread_cond_init(&self->engine.cond, NULL);
+    ucs_queue_head_init(&self->engine.pending);
+    ucs_queue_head_init(&self->engine.completed);
+    self->engine.threads       = NULL;
+    self->engine.num_threads   = 0;
+    self->engine.num_completed = 0;
+    self->engine.stop          = 0;
+    self->engine.wakeup_armed  = 0;
+    self->wakeup_pipe.read_fd  = -1;
     return UCS_OK;
 }
 
 static UCS_CLASS_CLEANUP_FUNC(uct_cma_iface_t)
 {
+    uct_cma_iface_copy_cleanup(self);
+    pthread_cond_destroy(&self->engine.cond);
+    pthread_mutex_destroy(&self->engine.lock);
+    ucs_mpool_cleanup(&self->op_mp, 1);
 }
 
 UCS_CLASS_DEFINE(uct_cma_iface_t, uct_base_iface_t);
@@ -109,8 +245,15 @@ static ucs_status_t uct_cma_query_tl_resources(uct_md_h md,
                                               uct_tl_resource_desc_t **resource_p,
                                               unsigned *num_resources_p)
 {
+    uct_cma_md_t *cma_md = ucs_derived_of(md, uct_cma_md_t);
     uct_tl_resource_desc_t *resource;
 
+    if (!cma_md->peer_access) {
+        *num_resources_p = 0;
+        *resource_p      = NULL;
+        return UCS_OK;
+    }
+
     resource = ucs_calloc(1, sizeof(uct_tl_resource_desc_t), "resource desc");
     if (NULL == resource) {
         ucs_error("Failed to allocate memory");
@@ -8,20 +8,96 @@
 #define UCT_CMA_IFACE_H
 
 #include <uct/base/uct_iface.h>
+#include <uct/sm/base/sm_iface.h>
+#include <ucs/async/pipe.h>
+#include <ucs/datastruct/queue.h>
+#include <ucs/datastruct/list.h>
+#include <sys/uio.h>
+#include <pthread.h>
 
 #define UCT_CMA_TL_NAME "cma"
 
 
+typedef struct uct_cma_ep uct_cma_ep_t;
+
+
 typedef struct uct_cma_iface_config {
     uct_iface_config_t      super;
+    unsigned                copy_threads;  /* Number of helper copy threads */
+    size_t                  copy_chunk;    /* Size of a single copy chunk */
 } uct_cma_iface_config_t;
 
 
+/**
+ * A zero-copy operation which is copied by the helper threads, chunk by chunk.
+ * An operation with zero length is a flush request, waiting on the endpoint
+ * until all its previous operations are completed.
+ */
+typedef struct uct_cma_copy_op {
+    ucs_queue_elem_t        queue;        /* Element in engine/ep queues */
+    ucs_list_link_t         list;         /* Element in iface outstanding list */
+    uct_cma_ep_t            *ep;          /* Endpoint which issued the operation,
+                                             NULL if it was destroyed */
+    pid_t                   remote_pid;   /* Process to copy to/from */
+    uct_completion_t        *comp;        /* User completion */
+    int                     is_put;       /* Write to the remote process */
+    uint64_t                remote_addr;  /* Remote address to copy to/from */
+    size_t                  length;       /* Total length to copy */
+    size_t                  offset;       /* Offset of the next chunk to copy */
+    unsigned                chunks_left;  /* Chunks which were not copied yet */
+    ucs_status_t            status;       /* Status of the whole operation */
+    size_t                  iovcnt;
+    struct iovec            iov[UCT_SM_MAX_IOV];
+} uct_cma_copy_op_t;
+
+
 typedef struct uct_cma_iface {
     uct_base_iface_t        super;
+    struct {
+        unsigned            copy_threads;
+        size_t              copy_chunk;
+    } config;
+    ucs_mpool_t             op_mp;        /* Copy operations */
+    unsigned                outstanding;  /* Copy operations in progress */
+    ucs_list_link_t         outstanding_ops; /* List of these operations, used
+                                                only by the main thread */
+    int                     fenced;       /* New operations wait for the
+                                             outstanding ones to complete */
+    ucs_queue_head_t        pending_q;    /* Requests waiting for a fence */
+
+    /* Copy engine. The helper threads are created on first use. */
+    struct {
+        pthread_mutex_t     lock;
+        pthread_cond_t      cond;         /* Signaled when there is work */
+        ucs_queue_head_t    pending;      /* Operations with chunks to copy */
+        ucs_queue_head_t    completed;    /* Copied operations */
+        volatile unsigned   num_completed;/* Length of completed, modified with
+                                             the lock held and read without it */
+        pthread_t           *threads;
+        unsigned            num_threads;  /* Number of running threads */
+        int                 stop;
+        int                 wakeup_armed; /* Signal the wakeup pipe on the next
+                                             completion */
+    } engine;
+
+    ucs_async_pipe_t        wakeup_pipe;  /* Signaled by the helper threads */
 } uct_cma_iface_t;
 
 
+ucs_status_t uct_cma_iface_copy_post(uct_cma_iface_t *iface, uct_cma_ep_t *ep,
+                                     const uct_iov_t *iov, size_t iovcnt,
+                                     uint64_t remote_addr, int is_put,
+                                     uct_completion_t *comp);
+
+void uct_cma_iface_copy_progress(void *arg);
+
+void uct_cma_iface_copy_cleanup(uct_cma_iface_t *iface);
+
+ucs_status_t uct_cma_iface_flush(uct_iface_h tl_iface, unsigned flags,
+                                 uct_completion_t *comp);
+
+ucs_status_t uct_cma_iface_fence(uct_iface_h tl_iface, unsigned flags);
+
 extern uct_tl_component_t uct_cma_tl;
 
 #endif
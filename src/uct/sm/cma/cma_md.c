@@ -7,10 +7,94 @@
 
 #define _GNU_SOURCE
 #include <sys/uio.h>
+#include <sys/prctl.h>
+#include <pthread.h>
 #include "cma_md.h"
 
+#include <ucs/sys/sys.h>
+
+#define UCT_CMA_PTRACE_SCOPE_FILE "/proc/sys/kernel/yama/ptrace_scope"
+
+static ucs_config_field_t uct_cma_md_config_table[] = {
+  {"", "", NULL,
+   ucs_offsetof(uct_cma_md_config_t, super), UCS_CONFIG_TYPE_TABLE(uct_md_config_table)},
+
+  {"SET_PTRACER", "no",
+   "When the Yama security module allows ptrace access only to descendant processes\n"
+   "(" UCT_CMA_PTRACE_SCOPE_FILE " is 1), declare any process as a ptracer\n"
+   "of this process with prctl(PR_SET_PTRACER), so peer processes could read and\n"
+   "write its memory. Note this also lets any process of the same user attach a\n"
+   "debugger to it. If disabled, CMA is not used at this ptrace scope.",
+   ucs_offsetof(uct_cma_md_config_t, set_ptracer), UCS_CONFIG_TYPE_BOOL},
+
+  {NULL}
+};
+
 uct_md_component_t uct_cma_md_component;
 
+static pthread_once_t uct_cma_ptrace_scope_once = PTHREAD_ONCE_INIT;
+static int uct_cma_ptrace_scope                 = 0;
+
+static void uct_cma_read_ptrace_scope()
+{
+    char buffer[32];
+    ssize_t nread;
+
+    nread = ucs_read_file(buffer, sizeof(buffer) - 1, 1, UCT_CMA_PTRACE_SCOPE_FILE);
+    if (nread <= 0) {
+        return; /* Yama is not present */
+    }
+
+    buffer[nread] = '\0';
+    if (sscanf(buffer, "%d", &uct_cma_ptrace_scope) != 1) {
+        uct_cma_ptrace_scope = 0;
+    }
+}
+
+/**
+ * Return the ptrace scope of the Yama security module, or 0 if it's not present.
+ * The file is read once.
+ */
+static int uct_cma_get_ptrace_scope()
+{
+    pthread_once(&uct_cma_ptrace_scope_once, uct_cma_read_ptrace_scope);
+    return uct_cma_ptrace_scope;
+}
+
+/**
+ * Check whether peer processes of the same user may access our memory. With
+ * ptrace scope 1, only descendants may do it, unless the process declares any
+ * process as its tracer, which is done only if the configuration allows it.
+ * With scope 2 and above, CMA between peer processes would fail.
+ */
+static int uct_cma_md_check_peer_access(const uct_cma_md_config_t *md_config)
+{
+    int scope = uct_cma_get_ptrace_scope();
+
+    if (scope == 0) {
+        return 1;
+    } else if (scope > 1) {
+        ucs_debug("CMA is disabled: %s is %d", UCT_CMA_PTRACE_SCOPE_FILE, scope);
+        return 0;
+    } else if (!md_config->set_ptracer) {
+        ucs_debug("CMA is disabled: %s is 1, and setting the ptracer is not "
+                  "allowed by configuration", UCT_CMA_PTRACE_SCOPE_FILE);
+        return 0;
+    }
+
+#ifdef PR_SET_PTRACER
+    if (prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY, 0, 0, 0) != 0) {
+        ucs_debug("CMA is disabled: prctl(PR_SET_PTRACER) failed: %m");
+        return 0;
+    }
+    return 1;
+#else
+    ucs_debug("CMA is disabled: %s is 1 and PR_SET_PTRACER is not supported",
+              UCT_CMA_PTRACE_SCOPE_FILE);
+    return 0;
+#endif
+}
+
 static ucs_status_t uct_cma_query_md_resources(uct_md_resource_desc_t **resources_p,
                                                unsigned *num_resources_p)
 {
@@ -28,14 +112,26 @@ static ucs_status_t uct_cma_query_md_resources(uct_md_resource_desc_t **resource
         ucs_debug("CMA is disabled:"
                   "process_vm_writev delivered %zu instead of %zu",
                    delivered, sizeof(test_dst));
-        *resources_p     = NULL;
-        *num_resources_p = 0;
-        return UCS_OK;
+        goto out_disabled;
+    }
+
+    /* Writing to our own memory always succeeds, but rendezvous reads from
+     * the memory of a peer process. At scope 1 it depends on the md
+     * configuration, which is checked when the md is opened. */
+    if (uct_cma_get_ptrace_scope() > 1) {
+        ucs_debug("CMA is disabled: %s is %d", UCT_CMA_PTRACE_SCOPE_FILE,
+                  uct_cma_get_ptrace_scope());
+        goto out_disabled;
     }
 
     return uct_single_md_resource(&uct_cma_md_component,
                                   resources_p,
                                   num_resources_p);
+
+out_disabled:
+    *resources_p     = NULL;
+    *num_resources_p = 0;
+    return UCS_OK;
 }
 
 static ucs_status_t uct_cma_mem_reg(uct_md_h md, void *address, size_t length,
@@ -49,11 +145,18 @@ static ucs_status_t uct_cma_mem_reg(uct_md_h md, void *address, size_t length,
     return UCS_OK;
 }
 
-static ucs_status_t uct_cma_md_open(const char *md_name, const uct_md_config_t *md_config,
+static void uct_cma_md_close(uct_md_h md)
+{
+    ucs_free(md);
+}
+
+static ucs_status_t uct_cma_md_open(const char *md_name, const uct_md_config_t *uct_md_config,
                                     uct_md_h *md_p)
 {
+    const uct_cma_md_config_t *md_config = ucs_derived_of(uct_md_config,
+                                                          uct_cma_md_config_t);
     static uct_md_ops_t md_ops = {
-        .close        = (void*)ucs_empty_function,
+        .close        = uct_cma_md_close,
         .query        = uct_cma_md_query,
         .mem_alloc    = (void*)ucs_empty_function_return_success,
         .mem_free     = (void*)ucs_empty_function_return_success,
@@ -61,12 +164,20 @@ static ucs_status_t uct_cma_md_open(const char *md_name, const uct_md_config_t *
         .mem_reg      = uct_cma_mem_reg,
         .mem_dereg    = (void*)ucs_empty_function_return_success
     };
-    static uct_md_t md = {
-        .ops          = &md_ops,
-        .component    = &uct_cma_md_component
-    };
+    uct_cma_md_t *md;
+
+    md = ucs_malloc(sizeof(*md), "uct_cma_md_t");
+    if (md == NULL) {
+        ucs_error("Failed to allocate memory for uct_cma_md_t");
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    md->super.ops       = &md_ops;
+    md->super.component = &uct_cma_md_component;
+    /* Without peer access the md has no transport resources */
+    md->peer_access     = uct_cma_md_check_peer_access(md_config);
 
-    *md_p = &md;
+    *md_p = &md->super;
     return UCS_OK;
 }
 
@@ -74,7 +185,7 @@ UCT_MD_COMPONENT_DEFINE(uct_cma_md_component, "cma",
                         uct_cma_query_md_resources, uct_cma_md_open, NULL,
                         uct_md_stub_rkey_unpack,
                         ucs_empty_function_return_success, "CMA_",
-                        uct_md_config_table, uct_md_config_t)
+                        uct_cma_md_config_table, uct_cma_md_config_t)
 
 ucs_status_t uct_cma_md_query(uct_md_h md, uct_md_attr_t *md_attr)
 {
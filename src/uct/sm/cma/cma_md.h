@@ -18,6 +18,27 @@
 
 extern uct_md_component_t uct_cma_md_component;
 
+
+/**
+ * CMA memory domain configuration
+ */
+typedef struct uct_cma_md_config {
+    uct_md_config_t          super;
+    int                      set_ptracer;  /* Declare any process as our ptracer
+                                              when Yama restricts ptrace access */
+} uct_cma_md_config_t;
+
+
+/**
+ * CMA memory domain
+ */
+typedef struct uct_cma_md {
+    uct_md_t                 super;
+    int                      peer_access;  /* Whether peer processes may access
+                                              our memory */
+} uct_cma_md_t;
+
+
 ucs_status_t uct_cma_md_query(uct_md_h md, uct_md_attr_t *md_attr);
 
 #endif
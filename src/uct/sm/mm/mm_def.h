@@ -19,8 +19,6 @@ typedef struct uct_mm_fifo_element      uct_mm_fifo_element_t;
 typedef struct uct_mm_recv_desc         uct_mm_recv_desc_t;
 typedef struct uct_mm_remote_seg        uct_mm_remote_seg_t;
 
-#define UCT_MM_BASE_ADDRESS_HASH_SIZE    64
-
 enum {
     UCT_MM_FIFO_ELEM_FLAG_OWNER  = UCS_BIT(0), /* new/old info */
     UCT_MM_FIFO_ELEM_FLAG_INLINE = UCS_BIT(1), /* if inline or not */
@@ -57,6 +55,8 @@ typedef struct uct_mm_md_config {
 typedef struct uct_mm_iface_addr {
     uint64_t   id;
     uintptr_t  vaddr;
+    uint32_t   fifo_stride;   /* distance between the FIFO and its lanes */
+    uint8_t    fifo_lanes;    /* number of per-sender lanes in the FIFO */
 } UCS_S_PACKED uct_mm_iface_addr_t;
 
 
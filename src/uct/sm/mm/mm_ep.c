@@ -8,23 +8,65 @@
 #include "mm_ep.h"
 
 #include <ucs/arch/atomic.h>
-
-SGLIB_DEFINE_LIST_FUNCTIONS(uct_mm_remote_seg_t, uct_mm_remote_seg_compare, next)
-SGLIB_DEFINE_HASHED_CONTAINER_FUNCTIONS(uct_mm_remote_seg_t,
-                                        UCT_MM_BASE_ADDRESS_HASH_SIZE,
-                                        uct_mm_remote_seg_hash)
+#include <ucs/arch/bitops.h>
 
 static ucs_status_t uct_mm_ep_signal_remote(uct_mm_ep_t *ep,
                                             uct_mm_iface_conn_signal_t sig);
 
+/* Claim a free lane in the remote FIFO, which has @a num_lanes lanes.
+ * Returns -1 if all lanes are taken. */
+static int uct_mm_ep_claim_fifo_lane(uct_mm_fifo_ctl_t *fifo_ctl,
+                                     unsigned num_lanes)
+{
+    uint64_t lane_map, free_lanes;
+    int lane;
+
+    do {
+        lane_map   = fifo_ctl->lane_map;
+        free_lanes = ~lane_map & UCS_MASK_SAFE(num_lanes);
+        if (free_lanes == 0) {
+            return -1;
+        }
+        lane = ucs_ffs64(free_lanes);
+    } while (ucs_atomic_cswap64(&fifo_ctl->lane_map, lane_map,
+                                lane_map | UCS_BIT(lane)) != lane_map);
+
+    return lane;
+}
+
 void uct_mm_ep_connected(uct_mm_ep_t *ep)
 {
-    /* point the ep->fifo_ctl to the remote fifo.
-     * it's an aligned pointer to the beginning of the ctl struct in the remote FIFO */
-    ep->fifo_ctl    = uct_mm_set_fifo_ctl(ep->mapped_desc.address);
+    uct_mm_iface_t *iface = ucs_derived_of(ep->super.super.iface, uct_mm_iface_t);
+    uct_mm_fifo_ctl_t *fifo_ctl = ep->remote_fifo_ctl;
+
+    /* point the ep->fifo_ctl to the remote fifo */
+    ep->fifo_lane = -1;
+    if (ep->peer->fifo_lanes > 0) {
+        ep->fifo_lane = uct_mm_ep_claim_fifo_lane(fifo_ctl, ep->peer->fifo_lanes);
+    }
+
+    if (ep->fifo_lane >= 0) {
+        /* the lane continues from where its previous sender stopped */
+        ep->fifo_ctl = UCT_MM_GET_FIFO_LANE_CTL(iface, fifo_ctl, ep->fifo_lane);
+        uct_mm_set_fifo_elems_ptr(ep->fifo_ctl, &ep->fifo);
+        ucs_debug("mm: ep %p claimed remote FIFO lane %d", ep, ep->fifo_lane);
+    } else {
+        ep->fifo_ctl = fifo_ctl;
+    }
     ep->cached_tail = ep->fifo_ctl->tail;
 }
 
+/* Let the receiver return the lane to the free lanes, after reading all the
+ * elements written to it */
+static void uct_mm_ep_release_fifo_lane(uct_mm_ep_t *ep)
+{
+    uct_mm_fifo_ctl_t *fifo_ctl = ep->remote_fifo_ctl;
+
+    ucs_memory_cpu_store_fence();
+    ucs_atomic_add64(&fifo_ctl->lane_released, UCS_BIT(ep->fifo_lane));
+    ep->fifo_lane = -1;
+}
+
 static void
 uct_mm_ep_signal_remote_slow_path_callback(ucs_callbackq_slow_elem_t *self)
 {
@@ -105,58 +147,42 @@ static UCS_CLASS_INIT_FUNC(uct_mm_ep_t, uct_iface_t *tl_iface,
     uct_mm_iface_t *iface = ucs_derived_of(tl_iface, uct_mm_iface_t);
     const uct_mm_iface_addr_t *addr = (const void*)iface_addr;
     ucs_status_t status;
-    size_t size_to_attach;
-    uct_mm_fifo_ctl_t *remote_fifo_ctl;
 
     UCS_CLASS_CALL_SUPER_INIT(uct_base_ep_t, &iface->super);
 
     /* Connect to the remote address (remote FIFO) */
-    /* Attach the address's memory */
-    size_to_attach = UCT_MM_GET_FIFO_SIZE(iface);
-    status =
-        uct_mm_md_mapper_ops(iface->super.md)->attach(addr->id,
-                                                      size_to_attach,
-                                                      (void *)addr->vaddr,
-                                                      &self->mapped_desc.address,
-                                                      &self->mapped_desc.cookie,
-                                                      iface->path);
+    /* Attach the address's memory, unless another ep has done it */
+    status = uct_mm_iface_attach_peer(iface, addr, &self->peer);
     if (status != UCS_OK) {
-        ucs_error("failed to connect to remote peer with mm. remote mm_id: %zu",
-                   addr->id);
         return status;
     }
 
-    self->mapped_desc.length     = size_to_attach;
-    self->mapped_desc.mmid       = addr->id;
-
     /* Set the fifo ctl to a dummy struct. It will switch to the real fifo_ctl,
      * which points to the remote peer's fifo, once the connection establishment
      * message is sent successfully on the unix socket */
     self->fifo_ctl = &iface->dummy_fifo_ctl;
 
     self->cached_tail = self->fifo_ctl->tail;
+    self->fifo_lane   = -1;
 
     /* set the ep->fifo ptr to point to the beginning of the fifo elements at
      * the remote peer */
-    uct_mm_set_fifo_elems_ptr(self->mapped_desc.address, &self->fifo);
+    uct_mm_set_fifo_elems_ptr(self->peer->fifo.address, &self->fifo);
 
-    remote_fifo_ctl   = uct_mm_set_fifo_ctl(self->mapped_desc.address);
-    self->cached_signal_addrlen  = remote_fifo_ctl->signal_addrlen;
-    self->cached_signal_sockaddr = remote_fifo_ctl->signal_sockaddr;
+    /* an aligned pointer to the beginning of the ctl struct in the remote FIFO */
+    self->remote_fifo_ctl        = uct_mm_set_fifo_ctl(self->peer->fifo.address);
+    self->cached_signal_addrlen  = self->remote_fifo_ctl->signal_addrlen;
+    self->cached_signal_sockaddr = self->remote_fifo_ctl->signal_sockaddr;
 
     self->cbq_elem_on = 0;
 
     /* Send connect message to remote side so it will start polling */
     status = uct_mm_ep_signal_remote(self, UCT_MM_IFACE_SIGNAL_CONNECT);
     if (status != UCS_OK) {
-        uct_mm_md_mapper_ops(iface->super.md)->detach(&self->mapped_desc);
+        uct_mm_iface_detach_peer(iface, self->peer);
         return status;
     }
 
-    /* Initiate the hash which will keep the base_adresses of remote memory
-     * chunks that hold the descriptors for bcopy. */
-    sglib_hashed_uct_mm_remote_seg_t_init(self->remote_segments_hash);
-
     ucs_arbiter_group_init(&self->arb_group);
 
     /* Register for send side progress */
@@ -171,9 +197,6 @@ static UCS_CLASS_INIT_FUNC(uct_mm_ep_t, uct_iface_t *tl_iface,
 static UCS_CLASS_CLEANUP_FUNC(uct_mm_ep_t)
 {
     uct_mm_iface_t *iface = ucs_derived_of(self->super.super.iface, uct_mm_iface_t);
-    ucs_status_t status;
-    uct_mm_remote_seg_t *remote_seg;
-    struct sglib_hashed_uct_mm_remote_seg_t_iterator iter;
 
     /* don't send a disconnect message for now since it may prevent the receiver
      * from progressing and reading incoming messages  */
@@ -187,23 +210,11 @@ static UCS_CLASS_CLEANUP_FUNC(uct_mm_ep_t)
     uct_worker_progress_unregister(iface->super.worker, uct_mm_iface_progress,
                                    iface);
 
-    for (remote_seg = sglib_hashed_uct_mm_remote_seg_t_it_init(&iter, self->remote_segments_hash);
-         remote_seg != NULL; remote_seg = sglib_hashed_uct_mm_remote_seg_t_it_next(&iter)) {
-            sglib_hashed_uct_mm_remote_seg_t_delete(self->remote_segments_hash, remote_seg);
-            /* detach the remote proceess's descriptors segment */
-            status = uct_mm_md_mapper_ops(iface->super.md)->detach(remote_seg);
-            if (status != UCS_OK) {
-                ucs_warn("Unable to detach shared memory segment of descriptors: %s",
-                         ucs_status_string(status));
-            }
-            ucs_free(remote_seg);
+    if (self->fifo_lane >= 0) {
+        uct_mm_ep_release_fifo_lane(self);
     }
 
-    /* detach the remote proceess's shared memory segment (remote recv FIFO) */
-    status = uct_mm_md_mapper_ops(iface->super.md)->detach(&self->mapped_desc);
-    if (status != UCS_OK) {
-        ucs_error("error detaching from remote FIFO");
-    }
+    uct_mm_iface_detach_peer(iface, self->peer);
 
     uct_mm_ep_pending_purge(&self->super.super, NULL, NULL);
 }
@@ -213,45 +224,40 @@ UCS_CLASS_DEFINE_NEW_FUNC(uct_mm_ep_t, uct_ep_t, uct_iface_t*,
                           const uct_device_addr_t *, const uct_iface_addr_t *);
 UCS_CLASS_DEFINE_DELETE_FUNC(uct_mm_ep_t, uct_ep_t);
 
-void *uct_mm_ep_attach_remote_seg(uct_mm_ep_t *ep, uct_mm_iface_t *iface, uct_mm_fifo_element_t *elem)
+/* Wake up the remote process, which sleeps on its wakeup socket */
+static void uct_mm_ep_signal_wakeup(uct_mm_ep_t *ep, uct_mm_fifo_ctl_t *fifo_ctl)
 {
-    uct_mm_remote_seg_t *remote_seg, search;
-    ucs_status_t status;
-
-    /* take the mmid of the chunk that the desc belongs to, (the desc that the fifo_elem
-     * is 'assigned' to), and check if the ep has already attached to it.
-     */
-    search.mmid = elem->desc_mmid;
-    remote_seg = sglib_hashed_uct_mm_remote_seg_t_find_member(ep->remote_segments_hash, &search);
-    if (remote_seg == NULL) {
-        /* not in the hash. attach to the memory the mmid refers to. the attach call
-         * will return the base address of the mmid's chunk -
-         * save this base address in a hash table (which maps mmid to base address). */
-        remote_seg = ucs_malloc(sizeof(*remote_seg), "mm_desc");
-        if (remote_seg == NULL) {
-            ucs_fatal("Failed to allocated memory for a remote segment identifier. %m");
-        }
+    uct_mm_iface_t *iface          = ucs_derived_of(ep->super.super.iface,
+                                                    uct_mm_iface_t);
+    uct_mm_iface_conn_signal_t sig = UCT_MM_IFACE_SIGNAL_WAKEUP;
+    struct sockaddr_un addr        = fifo_ctl->wakeup_sockaddr;
+    int ret;
 
-        status = uct_mm_md_mapper_ops(iface->super.md)->attach(elem->desc_mmid,
-                                                               elem->desc_mpool_size,
-                                                               elem->desc_chunk_base_addr,
-                                                               &remote_seg->address,
-                                                               &remote_seg->cookie,
-                                                               iface->path);
-        if (status != UCS_OK) {
-            ucs_fatal("Failed to attach to remote mmid:%zu. %s ",
-                      elem->desc_mmid, ucs_status_string(status));
-        }
+    ret = sendto(iface->signal_fd, &sig, sizeof(sig), 0,
+                 (const struct sockaddr*)&addr, fifo_ctl->wakeup_addrlen);
+    if ((ret < 0) && (errno != EAGAIN)) {
+        /* the remote side may have closed its wakeup socket */
+        ucs_debug("failed to send wakeup signal: %m");
+    }
+}
 
-        remote_seg->mmid   = elem->desc_mmid;
-        remote_seg->length = elem->desc_mpool_size;
+/* If the receiver is armed for a wakeup, signal it about the element which
+ * was just written. Only one sender does it, the one which disarms it. */
+static UCS_F_ALWAYS_INLINE void uct_mm_ep_check_remote_wakeup(uct_mm_ep_t *ep)
+{
+    uct_mm_fifo_ctl_t *fifo_ctl = ep->remote_fifo_ctl;
 
-        /* put the base address into the ep's hash table */
-        sglib_hashed_uct_mm_remote_seg_t_add(ep->remote_segments_hash, remote_seg);
+    if (ucs_likely(!fifo_ctl->wakeup_enabled)) {
+        return;
     }
 
-    return remote_seg->address;
-
+    /* the element must be visible before reading the armed flag, since the
+     * receiver reads the FIFO after setting it */
+    ucs_memory_bus_fence();
+    if (fifo_ctl->wakeup_armed &&
+        (ucs_atomic_cswap64(&fifo_ctl->wakeup_armed, 1, 0) == 1)) {
+        uct_mm_ep_signal_wakeup(ep, fifo_ctl);
+    }
 }
 
 static inline ucs_status_t uct_mm_ep_get_remote_elem(uct_mm_ep_t *ep, uint64_t head,
@@ -262,9 +268,15 @@ static inline ucs_status_t uct_mm_ep_get_remote_elem(uct_mm_ep_t *ep, uint64_t h
                                /* must be smaller than fifo size */
     uint64_t returned_val;
 
-    elem_index = ep->fifo_ctl->head & iface->fifo_mask;
+    elem_index = head & iface->fifo_mask;
     *elem = UCT_MM_IFACE_GET_FIFO_ELEM(iface, ep->fifo, elem_index);
 
+    if (ep->fifo_lane >= 0) {
+        /* this ep is the only writer to its lane */
+        ep->fifo_ctl->head = head + 1;
+        return UCS_OK;
+    }
+
     /* try to get ownership of the head element */
     returned_val = ucs_atomic_cswap64(&ep->fifo_ctl->head, head, head+1);
     if (returned_val != head) {
@@ -338,7 +350,7 @@ uct_mm_ep_am_common_send(const unsigned is_short, uct_mm_ep_t *ep, uct_mm_iface_
         /* AM_BCOPY */
         /* write to the remote descriptor */
         /* get the base_address: local ptr to remote memory chunk after attaching to it */
-        base_address = uct_mm_ep_attach_remote_seg(ep, iface, elem);
+        base_address = uct_mm_iface_get_remote_seg(iface, ep->peer, elem);
         length = pack_cb(base_address + elem->desc_offset, arg);
 
         elem->flags &= ~UCT_MM_FIFO_ELEM_FLAG_INLINE;
@@ -364,6 +376,8 @@ uct_mm_ep_am_common_send(const unsigned is_short, uct_mm_ep_t *ep, uct_mm_iface_
         elem->flags &= ~UCT_MM_FIFO_ELEM_FLAG_OWNER;
     }
 
+    uct_mm_ep_check_remote_wakeup(ep);
+
     if (is_short) {
         return UCS_OK;
     } else {
@@ -423,6 +437,29 @@ ucs_status_t uct_mm_ep_pending_add(uct_ep_h tl_ep, uct_pending_req_t *n)
     return UCS_OK;
 }
 
+/**
+ * Check if the pending requests of the endpoint can be sent, since the remote
+ * FIFO has room for them. The requests are kept in the arbiter.
+ */
+ucs_arbiter_cb_result_t uct_mm_ep_check_pending(ucs_arbiter_t *arbiter,
+                                                ucs_arbiter_elem_t *elem,
+                                                void *arg)
+{
+    uct_mm_ep_t *ep   = ucs_container_of(ucs_arbiter_elem_group(elem),
+                                         uct_mm_ep_t, arb_group);
+    int *can_progress = arg;
+
+    ucs_memory_cpu_load_fence();
+    ep->cached_tail = ep->fifo_ctl->tail;
+
+    if (uct_mm_ep_has_tx_resources(ep)) {
+        *can_progress = 1;
+        return UCS_ARBITER_CB_RESULT_STOP;
+    }
+
+    return UCS_ARBITER_CB_RESULT_RESCHED_GROUP;
+}
+
 ucs_arbiter_cb_result_t uct_mm_ep_process_pending(ucs_arbiter_t *arbiter,
                                                   ucs_arbiter_elem_t *elem,
                                                   void *arg)
@@ -10,9 +10,6 @@
 
 #include "mm_iface.h"
 
-#include <ucs/datastruct/sglib.h>
-#include <ucs/datastruct/sglib_wrapper.h>
-
 
 struct uct_mm_ep {
     uct_base_ep_t       super;
@@ -24,9 +21,13 @@ struct uct_mm_ep {
     uint64_t             cached_tail; /* the sender's own copy of the remote FIFO's tail.
                                          it is not always updated with the actual remote tail value */
 
-    /* mapped remote memory chunks to which remote descriptors belong to.
-     * (after attaching to them) */
-    uct_mm_remote_seg_t  *remote_segments_hash[UCT_MM_BASE_ADDRESS_HASH_SIZE];
+    int                  fifo_lane;   /* the lane claimed in the remote FIFO, which
+                                         only this ep writes to, or -1 if the
+                                         shared FIFO is used */
+
+    /* the remote peer, with its attached FIFO and descriptor chunks, which
+     * is shared by all the eps to it */
+    uct_mm_remote_peer_t *peer;
 
     ucs_arbiter_group_t  arb_group;   /* the group that holds this ep's pending operations */
 
@@ -39,8 +40,8 @@ struct uct_mm_ep {
     ucs_callbackq_slow_elem_t cbq_elem;           /* Slow-path callback */
     uint8_t                   cbq_elem_on;
 
-    /* Remote peer */
-    uct_mm_remote_seg_t  mapped_desc; /* pointer to the descriptor of the destination's shared_mem (FIFO) */
+    uct_mm_fifo_ctl_t    *remote_fifo_ctl; /* the destination's receive FIFO ctl,
+                                              which is not the lane's one */
 };
 
 UCS_CLASS_DECLARE_NEW_FUNC(uct_mm_ep_t, uct_ep_t, uct_iface_t*,
@@ -60,21 +61,11 @@ ucs_status_t uct_mm_ep_pending_add(uct_ep_h tl_ep, uct_pending_req_t *n);
 void uct_mm_ep_pending_purge(uct_ep_h ep, uct_pending_purge_callback_t cb,
                              void *arg);
 
+ucs_arbiter_cb_result_t uct_mm_ep_check_pending(ucs_arbiter_t *arbiter,
+                                                ucs_arbiter_elem_t *elem,
+                                                void *arg);
 ucs_arbiter_cb_result_t uct_mm_ep_process_pending(ucs_arbiter_t *arbiter,
                                                   ucs_arbiter_elem_t *elem,
                                                   void *arg);
 
-static inline uint64_t uct_mm_remote_seg_hash(uct_mm_remote_seg_t *seg)
-{
-    return seg->mmid % UCT_MM_BASE_ADDRESS_HASH_SIZE;
-}
-
-static inline int64_t uct_mm_remote_seg_compare(uct_mm_remote_seg_t *seg1, uct_mm_remote_seg_t *seg2)
-{
-    return  seg1->mmid - seg2->mmid;
-}
-
-SGLIB_DEFINE_LIST_PROTOTYPES(uct_mm_remote_seg_t, uct_mm_remote_seg_compare, next)
-SGLIB_DEFINE_HASHED_CONTAINER_PROTOTYPES(uct_mm_remote_seg_t, UCT_MM_BASE_ADDRESS_HASH_SIZE, uct_mm_remote_seg_hash)
-
 #endif
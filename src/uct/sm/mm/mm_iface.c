@@ -4,6 +4,7 @@
  * See file LICENSE for terms.
  */
 
+#define _GNU_SOURCE /* for sched_getcpu() */
 #include "mm_iface.h"
 #include "mm_ep.h"
 
@@ -15,6 +16,19 @@
 #include <ucs/sys/string.h>
 #include <sys/poll.h>
 
+#ifndef UCT_MD_DISABLE_NUMA
+#include <numaif.h>
+#include <numa.h>
+#endif
+
+
+static const char *uct_mm_numa_policy_names[] = {
+    [UCT_MM_NUMA_POLICY_DEFAULT]   = "default",
+    [UCT_MM_NUMA_POLICY_PREFERRED] = "preferred",
+    [UCT_MM_NUMA_POLICY_BIND]      = "bind",
+    [UCT_MM_NUMA_POLICY_LAST]      = NULL,
+};
+
 
 static ucs_config_field_t uct_mm_iface_config_table[] = {
     {"", "ALLOC=md", NULL,
@@ -25,6 +39,18 @@ static ucs_config_field_t uct_mm_iface_config_table[] = {
      "Size of the receive FIFO in the memory-map UCTs.",
      ucs_offsetof(uct_mm_iface_config_t, fifo_size), UCS_CONFIG_TYPE_UINT},
 
+    {"FIFO_MAX_POLL", "16",
+     "Maximal number of receive FIFO elements to process in a single progress\n"
+     "call. Larger values let the receiver keep up with many senders.",
+     ucs_offsetof(uct_mm_iface_config_t, fifo_max_poll), UCS_CONFIG_TYPE_UINT},
+
+    {"FIFO_LANES", "0",
+     "Number of per-sender lanes in the receive FIFO. A sender which claims a lane\n"
+     "when connecting is the only writer to it, and does not contend with other\n"
+     "senders on the FIFO head. Senders which find no free lane use the shared\n"
+     "FIFO. The value must be the same on all peers, and at most 64.",
+     ucs_offsetof(uct_mm_iface_config_t, fifo_lanes), UCS_CONFIG_TYPE_UINT},
+
     {"FIFO_RELEASE_FACTOR", "0.5",
      "Frequency of resource releasing on the receiver's side in the MM UCT.\n"
      "This value refers to the percentage of the FIFO size. (must be >= 0 and < 1)",
@@ -41,6 +67,22 @@ static ucs_config_field_t uct_mm_iface_config_table[] = {
      " try - Try to allocate memory using huge pages and if it fails, allocate regular pages.\n",
      ucs_offsetof(uct_mm_iface_config_t, hugetlb_mode), UCS_CONFIG_TYPE_TERNARY},
 
+    {"NUMA_POLICY", "preferred",
+     "NUMA policy for the receive FIFO and receive descriptors, which are polled\n"
+     "by the thread which creates the interface:\n"
+     " default   - Use the memory policy of the process.\n"
+     " preferred - Prefer allocating them on the node set by NUMA_NODE.\n"
+     " bind      - Allocate them only on the node set by NUMA_NODE.\n"
+     "If the memory policy of the process is bind, it is kept.",
+     ucs_offsetof(uct_mm_iface_config_t, numa_policy),
+     UCS_CONFIG_TYPE_ENUM(uct_mm_numa_policy_names)},
+
+    {"NUMA_NODE", "-1",
+     "NUMA node for the receive FIFO and receive descriptors. -1 means the node\n"
+     "of the CPUs which the thread creating the interface may run on. If these\n"
+     "CPUs are on more than one node, the memory is not placed.",
+     ucs_offsetof(uct_mm_iface_config_t, numa_node), UCS_CONFIG_TYPE_INT},
+
     {NULL}
 };
 
@@ -50,8 +92,10 @@ static ucs_status_t uct_mm_iface_get_address(uct_iface_t *tl_iface,
     uct_mm_iface_t *iface = ucs_derived_of(tl_iface, uct_mm_iface_t);
     uct_mm_iface_addr_t *iface_addr = (void*)addr;
 
-    iface_addr->id    = iface->fifo_mm_id;
-    iface_addr->vaddr = (uintptr_t)iface->shared_mem;
+    iface_addr->id          = iface->fifo_mm_id;
+    iface_addr->vaddr       = (uintptr_t)iface->shared_mem;
+    iface_addr->fifo_stride = UCT_MM_FIFO_STRIDE(iface);
+    iface_addr->fifo_lanes  = iface->config.fifo_lanes;
     return UCS_OK;
 }
 
@@ -88,14 +132,14 @@ static ucs_status_t uct_mm_iface_query(uct_iface_h tl_iface,
     iface_attr->cap.put.max_zcopy       = SIZE_MAX;
     iface_attr->cap.put.opt_zcopy_align = UCS_SYS_CACHE_LINE_SIZE;
     iface_attr->cap.put.align_mtu       = iface_attr->cap.put.opt_zcopy_align;
-    iface_attr->cap.put.max_iov         = 1;
+    iface_attr->cap.put.max_iov         = UCT_SM_MAX_IOV;
 
     iface_attr->cap.get.max_bcopy       = SIZE_MAX;
     iface_attr->cap.get.min_zcopy       = 0;
     iface_attr->cap.get.max_zcopy       = SIZE_MAX;
     iface_attr->cap.get.opt_zcopy_align = UCS_SYS_CACHE_LINE_SIZE;
     iface_attr->cap.get.align_mtu       = iface_attr->cap.get.opt_zcopy_align;
-    iface_attr->cap.get.max_iov         = 1;
+    iface_attr->cap.get.max_iov         = UCT_SM_MAX_IOV;
 
     iface_attr->cap.am.max_short        = iface->config.fifo_elem_size -
                                           sizeof(uct_mm_fifo_element_t);
@@ -106,11 +150,16 @@ static ucs_status_t uct_mm_iface_query(uct_iface_h tl_iface,
     iface_attr->cap.am.align_mtu        = iface_attr->cap.am.opt_zcopy_align;
     iface_attr->cap.am.max_iov          = 1;
 
+    if (iface->numa_node >= 0) {
+        iface_attr->numa_node_mask      = UCS_BIT(iface->numa_node);
+    }
+
     iface_attr->iface_addr_len          = sizeof(uct_mm_iface_addr_t);
     iface_attr->device_addr_len         = UCT_SM_IFACE_DEVICE_ADDR_LEN;
     iface_attr->ep_addr_len             = 0;
     iface_attr->cap.flags               = UCT_IFACE_FLAG_PUT_SHORT        |
                                           UCT_IFACE_FLAG_PUT_BCOPY        |
+                                          UCT_IFACE_FLAG_PUT_ZCOPY        |
                                           UCT_IFACE_FLAG_ATOMIC_ADD32     |
                                           UCT_IFACE_FLAG_ATOMIC_ADD64     |
                                           UCT_IFACE_FLAG_ATOMIC_FADD64    |
@@ -121,10 +170,12 @@ static ucs_status_t uct_mm_iface_query(uct_iface_h tl_iface,
                                           UCT_IFACE_FLAG_ATOMIC_CSWAP32   |
                                           UCT_IFACE_FLAG_ATOMIC_CPU       |
                                           UCT_IFACE_FLAG_GET_BCOPY        |
+                                          UCT_IFACE_FLAG_GET_ZCOPY        |
                                           UCT_IFACE_FLAG_AM_SHORT         |
                                           UCT_IFACE_FLAG_AM_BCOPY         |
                                           UCT_IFACE_FLAG_PENDING          |
                                           UCT_IFACE_FLAG_AM_CB_SYNC       |
+                                          UCT_IFACE_FLAG_WAKEUP           |
                                           UCT_IFACE_FLAG_CONNECT_TO_IFACE;
 
     iface_attr->latency.overhead        = 80e-9; /* 80 ns */
@@ -137,6 +188,22 @@ static ucs_status_t uct_mm_iface_query(uct_iface_h tl_iface,
 
 static UCS_CLASS_DECLARE_DELETE_FUNC(uct_mm_iface_t, uct_iface_t);
 
+static int uct_mm_iface_pending_can_progress(uct_mm_iface_t *iface)
+{
+    int can_progress = 0;
+
+    ucs_arbiter_dispatch(&iface->arbiter, 1, uct_mm_ep_check_pending,
+                         &can_progress);
+    return can_progress;
+}
+
+static ucs_status_t uct_mm_iface_wakeup_open(uct_iface_h tl_iface,
+                                             unsigned events,
+                                             uct_wakeup_h wakeup);
+static ucs_status_t uct_mm_iface_wakeup_arm(uct_wakeup_h wakeup);
+static ucs_status_t uct_mm_iface_wakeup_signal(uct_wakeup_h wakeup);
+static void uct_mm_iface_wakeup_close(uct_wakeup_h wakeup);
+
 static uct_iface_ops_t uct_mm_iface_ops = {
     .iface_close         = UCS_CLASS_DELETE_FUNC_NAME(uct_mm_iface_t),
     .iface_query         = uct_mm_iface_query,
@@ -145,9 +212,17 @@ static uct_iface_ops_t uct_mm_iface_ops = {
     .iface_is_reachable  = uct_sm_iface_is_reachable,
     .iface_flush         = uct_mm_iface_flush,
     .iface_fence         = uct_sm_iface_fence,
+    .iface_wakeup_open   = uct_mm_iface_wakeup_open,
+    .iface_wakeup_get_fd = uct_sm_iface_wakeup_get_fd,
+    .iface_wakeup_arm    = uct_mm_iface_wakeup_arm,
+    .iface_wakeup_wait   = uct_sm_iface_wakeup_wait,
+    .iface_wakeup_signal = uct_mm_iface_wakeup_signal,
+    .iface_wakeup_close  = uct_mm_iface_wakeup_close,
     .ep_put_short        = uct_sm_ep_put_short,
     .ep_put_bcopy        = uct_sm_ep_put_bcopy,
+    .ep_put_zcopy        = uct_sm_ep_put_zcopy,
     .ep_get_bcopy        = uct_sm_ep_get_bcopy,
+    .ep_get_zcopy        = uct_sm_ep_get_zcopy,
     .ep_am_short         = uct_mm_ep_am_short,
     .ep_am_bcopy         = uct_mm_ep_am_bcopy,
     .ep_atomic_add64     = uct_sm_ep_atomic_add64,
@@ -166,14 +241,19 @@ static uct_iface_ops_t uct_mm_iface_ops = {
     .ep_destroy          = UCS_CLASS_DELETE_FUNC_NAME(uct_mm_ep_t),
 };
 
-static inline void uct_mm_progress_fifo_tail(uct_mm_iface_t *iface)
+static inline void uct_mm_progress_fifo_tail(uct_mm_iface_t *iface,
+                                             uct_mm_fifo_ctl_t *fifo_ctl,
+                                             uint64_t read_index,
+                                             uint64_t prev_read_index)
 {
-    /* don't progress the tail every time - release in batches. improves performance */
-    if (iface->read_index & iface->fifo_release_factor_mask) {
+    /* don't progress the tail every time - release in batches. improves performance.
+     * the tail is published when the read_index crossed a release boundary
+     * since the previous call. */
+    if (!((prev_read_index ^ read_index) & ~iface->fifo_release_factor_mask)) {
         return;
     }
 
-    iface->recv_fifo_ctl->tail = iface->read_index;
+    fifo_ctl->tail = read_index;
 }
 
 ucs_status_t uct_mm_assign_desc_to_fifo_elem(uct_mm_iface_t *iface,
@@ -230,57 +310,286 @@ static inline ucs_status_t uct_mm_iface_process_recv(uct_mm_iface_t *iface,
     return status;
 }
 
-static inline void uct_mm_iface_poll_fifo(uct_mm_iface_t *iface)
+static inline int uct_mm_iface_fifo_elem_ready(uct_mm_iface_t *iface,
+                                               uint64_t read_index,
+                                               uct_mm_fifo_element_t *elem)
+{
+    /* check the owner bit of the element against the read_index */
+    return ((read_index >> iface->fifo_shift) & 1) == (elem->flags & 1);
+}
+
+/* Process the ready elements of a receive FIFO, or of a FIFO lane.
+ * Returns how many elements were ready. */
+static inline unsigned uct_mm_iface_poll_fifo(uct_mm_iface_t *iface,
+                                              uct_mm_fifo_ctl_t *fifo_ctl,
+                                              void *fifo_elements,
+                                              uint64_t *read_index_p)
 {
-    uint64_t read_index_loc, read_index;
+    uint64_t prev_read_index, read_index;
     uct_mm_fifo_element_t* read_index_elem;
     ucs_status_t status;
-
-    /* check the memory pool to make sure that there is a new descriptor available */
-    if (ucs_unlikely(iface->last_recv_desc == NULL)) {
-        UCT_TL_IFACE_GET_RX_DESC(&iface->super, &iface->recv_desc_mp,
-                                 iface->last_recv_desc, return);
+    unsigned count, i;
+
+    /* count how many consecutive elements are ready to be read, up to the
+     * configured batch size */
+    prev_read_index = read_index = *read_index_p;
+    for (count = 0; count < iface->config.fifo_max_poll; ++count, ++read_index) {
+        read_index_elem = UCT_MM_IFACE_GET_FIFO_ELEM(iface, fifo_elements,
+                                                     read_index & iface->fifo_mask);
+        if (!uct_mm_iface_fifo_elem_ready(iface, read_index, read_index_elem)) {
+            break;
+        }
     }
 
-    read_index = iface->read_index;
-    read_index_loc = (read_index & iface->fifo_mask);
-    /* the fifo_element which the read_index points to */
-    read_index_elem = UCT_MM_IFACE_GET_FIFO_ELEM(iface, iface->recv_fifo_elements ,read_index_loc);
+    if (count == 0) {
+        return 0;
+    }
 
-    /* check the read_index to see if there is a new item to read (checking the owner bit) */
-    if (((read_index >> iface->fifo_shift) & 1) == ((read_index_elem->flags) & 1)) {
+    /* read the contents of all ready elements after their owner bits */
+    ucs_memory_cpu_load_fence();
+    ucs_assert(*read_index_p + count <= fifo_ctl->head);
 
-        /* read from read_index_elem */
-        ucs_memory_cpu_load_fence();
-        ucs_assert(iface->read_index <= iface->recv_fifo_ctl->head);
+    for (i = 0; i < count; ++i) {
+        read_index_elem = UCT_MM_IFACE_GET_FIFO_ELEM(iface, fifo_elements,
+                                                     *read_index_p & iface->fifo_mask);
 
         status = uct_mm_iface_process_recv(iface, read_index_elem);
+
+        /* raise the read_index. */
+        ++(*read_index_p);
+
         if (status != UCS_OK) {
             /* the last_recv_desc is in use. get a new descriptor for it */
             UCT_TL_IFACE_GET_RX_DESC(&iface->super, &iface->recv_desc_mp,
-                                     iface->last_recv_desc, ucs_debug("recv mpool is empty"));
+                                     iface->last_recv_desc,
+                                     ucs_debug("recv mpool is empty"); break);
         }
+    }
 
-        /* raise the read_index. */
-        iface->read_index++;
+    uct_mm_progress_fifo_tail(iface, fifo_ctl, *read_index_p, prev_read_index);
+    return count;
+}
+
+/* Poll the lanes claimed by senders, starting from a different lane every time.
+ * A released lane is returned to the free lanes only after it is drained, so
+ * the next sender to claim it would not overtake the messages of the previous
+ * one. */
+static void uct_mm_iface_poll_lanes(uct_mm_iface_t *iface)
+{
+    uct_mm_fifo_ctl_t *fifo_ctl = iface->recv_fifo_ctl;
+    uint64_t lane_map, lane_released;
+    uct_mm_fifo_lane_t *lane;
+    unsigned i, lane_index;
+
+    lane_map = fifo_ctl->lane_map;
+    if (lane_map == 0) {
+        return;
     }
 
-    uct_mm_progress_fifo_tail(iface);
+    /* a lane which was released is drained if no elements are ready after
+     * reading the released mask */
+    lane_released = fifo_ctl->lane_released;
+    ucs_memory_cpu_load_fence();
+
+    for (i = 0; i < iface->config.fifo_lanes; ++i) {
+        lane_index = (iface->next_lane + i) % iface->config.fifo_lanes;
+        if (!(lane_map & UCS_BIT(lane_index))) {
+            continue;
+        }
+
+        lane = &iface->lanes[lane_index];
+        if ((uct_mm_iface_poll_fifo(iface, lane->ctl, lane->elements,
+                                    &lane->read_index) == 0) &&
+            (lane_released & UCS_BIT(lane_index)))
+        {
+            ucs_debug("mm_iface %p: lane %u is drained", iface, lane_index);
+            lane->ctl->tail = lane->read_index;
+            ucs_atomic_add64(&fifo_ctl->lane_released, -UCS_BIT(lane_index));
+            ucs_atomic_add64(&fifo_ctl->lane_map, -UCS_BIT(lane_index));
+        }
+
+        if (ucs_unlikely(iface->last_recv_desc == NULL)) {
+            break;
+        }
+    }
+
+    iface->next_lane = (iface->next_lane + 1) % iface->config.fifo_lanes;
 }
 
 void uct_mm_iface_progress(void *arg)
 {
     uct_mm_iface_t *iface = arg;
 
+    /* check the memory pool to make sure that there is a new descriptor available */
+    if (ucs_unlikely(iface->last_recv_desc == NULL)) {
+        UCT_TL_IFACE_GET_RX_DESC(&iface->super, &iface->recv_desc_mp,
+                                 iface->last_recv_desc, goto out);
+    }
+
     /* progress receive */
-    uct_mm_iface_poll_fifo(iface);
+    uct_mm_iface_poll_fifo(iface, iface->recv_fifo_ctl, iface->recv_fifo_elements,
+                           &iface->read_index);
+    if ((iface->config.fifo_lanes > 0) &&
+        ucs_likely(iface->last_recv_desc != NULL)) {
+        uct_mm_iface_poll_lanes(iface);
+    }
 
+out:
     /* progress the pending sends (if there are any) */
     ucs_arbiter_dispatch(&iface->arbiter, 1, uct_mm_ep_process_pending, NULL);
 }
 
+#ifndef UCT_MD_DISABLE_NUMA
+/* The NUMA node of the cpus the calling thread may run on, or -1 if they are
+ * on more than one node */
+static int uct_mm_iface_thread_numa_node()
+{
+    cpu_set_t affinity;
+    int cpu, cpu_node, node;
+
+    if (pthread_getaffinity_np(pthread_self(), sizeof(affinity), &affinity)) {
+        ucs_debug("mm: failed to get the thread cpu affinity");
+        return -1;
+    }
+
+    node = -1;
+    for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &affinity)) {
+            continue;
+        }
+
+        cpu_node = numa_node_of_cpu(cpu);
+        if ((cpu_node < 0) || ((node >= 0) && (cpu_node != node))) {
+            return -1;
+        }
+        node = cpu_node;
+    }
+
+    return node;
+}
+#endif
+
+/* Set the NUMA node of the receive FIFO and descriptors */
+static ucs_status_t uct_mm_iface_init_numa(uct_mm_iface_t *iface,
+                                           uct_mm_iface_config_t *config)
+{
+#ifndef UCT_MD_DISABLE_NUMA
+    int old_policy;
+#endif
+
+    iface->numa_node = -1;
+    iface->numa_mode = 0;
+
+    if (config->numa_policy == UCT_MM_NUMA_POLICY_DEFAULT) {
+        return UCS_OK;
+    }
+
+#ifndef UCT_MD_DISABLE_NUMA
+    if (numa_available() < 0) {
+        ucs_debug("mm: NUMA is not available, not placing the receive FIFO");
+        return UCS_OK;
+    }
+
+    if (get_mempolicy(&old_policy, NULL, 0, NULL, 0) < 0) {
+        ucs_debug("mm: get_mempolicy() failed, not placing the receive FIFO: %m");
+        return UCS_OK;
+    }
+
+    /* if the current policy is BIND, keep it as-is */
+    if (old_policy == MPOL_BIND) {
+        ucs_debug("mm: the memory is bound by the process policy, not placing "
+                  "the receive FIFO");
+        return UCS_OK;
+    }
+
+    if (config->numa_node < 0) {
+        /* the node of the thread which is going to poll the FIFO, if it may
+         * run only there */
+        iface->numa_node = uct_mm_iface_thread_numa_node();
+        if ((iface->numa_node < 0) ||
+            (iface->numa_node >= (sizeof(unsigned long) * 8))) {
+            ucs_debug("mm: the thread is not bound to a single NUMA node, not "
+                      "placing the receive FIFO");
+            iface->numa_node = -1;
+            return UCS_OK;
+        }
+    } else if ((config->numa_node > numa_max_node()) ||
+               (config->numa_node >= (sizeof(unsigned long) * 8))) {
+        ucs_error("The MM NUMA node must be at most %d.",
+                  ucs_min(numa_max_node(), (int)sizeof(unsigned long) * 8 - 1));
+        return UCS_ERR_INVALID_PARAM;
+    } else {
+        iface->numa_node = config->numa_node;
+    }
+
+    iface->numa_mode = (config->numa_policy == UCT_MM_NUMA_POLICY_BIND) ?
+                       MPOL_BIND : MPOL_PREFERRED;
+#else
+    ucs_debug("mm: NUMA support is disabled, not placing the receive FIFO");
+#endif
+    return UCS_OK;
+}
+
+/* Place receive memory on the NUMA node of the iface. The pages which are
+ * already touched are moved there, and the rest are allocated there on first
+ * touch. */
+static void uct_mm_iface_set_numa_policy(uct_mm_iface_t *iface, void *address,
+                                         size_t length, const char *name)
+{
+#ifndef UCT_MD_DISABLE_NUMA
+    unsigned long nodemask;
+    uintptr_t start, end;
+    int ret;
+
+    if (iface->numa_node < 0) {
+        return;
+    }
+
+    nodemask = UCS_BIT(iface->numa_node);
+    start    = ucs_align_down_pow2((uintptr_t)address, ucs_get_page_size());
+    end      = ucs_align_up_pow2((uintptr_t)address + length, ucs_get_page_size());
+
+    ret = mbind((void*)start, end - start, iface->numa_mode, &nodemask,
+                sizeof(nodemask) * 8 + 1, MPOL_MF_MOVE);
+    if (ret != 0) {
+        /* the preferred node is only a hint, and it's the default, so don't
+         * warn about every interface and chunk when it can't be used */
+        ucs_log((iface->numa_mode == MPOL_BIND) ? UCS_LOG_LEVEL_WARN :
+                                                  UCS_LOG_LEVEL_DEBUG,
+                "mbind(%s addr=0x%lx length=%ld node=%d) failed: %m", name,
+                start, end - start, iface->numa_node);
+    } else {
+        ucs_trace("mm: placed %s 0x%lx..0x%lx on NUMA node %d", name, start,
+                  end, iface->numa_node);
+    }
+#endif
+}
+
+/* Advertise a new receive descriptor chunk to the senders */
+static void uct_mm_iface_advertise_seg(uct_mm_iface_t *iface, uct_mm_seg_t *seg)
+{
+    uct_mm_seg_table_t *seg_table = iface->seg_table;
+    uct_mm_adv_seg_t *adv_seg;
+    unsigned count;
+
+    count = seg_table->count;
+    if (count == UCT_MM_MAX_ADV_SEGS) {
+        return;
+    }
+
+    adv_seg          = &seg_table->segs[count];
+    adv_seg->mmid    = seg->mmid;
+    adv_seg->address = (uintptr_t)seg->address;
+    adv_seg->length  = seg->length;
+
+    /* the entry must be visible before the senders see the new count */
+    ucs_memory_cpu_store_fence();
+    seg_table->count = count + 1;
+}
+
 void uct_mm_iface_recv_desc_init(uct_iface_h tl_iface, void *obj, uct_mem_h memh)
 {
+    uct_mm_iface_t *iface = ucs_derived_of(tl_iface, uct_mm_iface_t);
     uct_mm_recv_desc_t *desc = obj;
     uct_mm_seg_t *seg = memh;
 
@@ -289,21 +598,322 @@ void uct_mm_iface_recv_desc_init(uct_iface_h tl_iface, void *obj, uct_mem_h memh
     desc->key          = seg->mmid;
     desc->base_address = seg->address;
     desc->mpool_length = seg->length;
+
+    /* the descriptors of a chunk are initialized one after another, the first
+     * one of a chunk sets it up */
+    if (seg != iface->last_desc_seg) {
+        uct_mm_iface_set_numa_policy(iface, seg->address, seg->length,
+                                     "receive descriptors");
+        uct_mm_iface_advertise_seg(iface, seg);
+        iface->last_desc_seg = seg;
+    }
+}
+
+/* Attach to a remote descriptor chunk, unless it's already attached */
+static ucs_status_t uct_mm_iface_add_remote_seg(uct_mm_iface_t *iface,
+                                                uct_mm_remote_peer_t *peer,
+                                                uct_mm_id_t mmid, size_t length,
+                                                void *remote_address)
+{
+    uct_mm_remote_seg_key_t key;
+    uct_mm_remote_seg_t *remote_seg;
+    ucs_status_t status;
+    khiter_t iter;
+    int ret;
+
+    key.peer_id = peer->fifo.mmid;
+    key.mmid    = mmid;
+    iter        = kh_put(uct_mm_remote_segs, &iface->remote_segs, key, &ret);
+    if (ret == -1) {
+        ucs_error("Failed to add a remote segment to the MM hash");
+        return UCS_ERR_NO_MEMORY;
+    } else if (ret == 0) {
+        return UCS_OK; /* already attached */
+    }
+
+    remote_seg = &kh_val(&iface->remote_segs, iter);
+    status     = uct_mm_md_mapper_ops(iface->super.md)->attach(mmid, length,
+                                                               remote_address,
+                                                               &remote_seg->address,
+                                                               &remote_seg->cookie,
+                                                               iface->path);
+    if (status != UCS_OK) {
+        kh_del(uct_mm_remote_segs, &iface->remote_segs, iter);
+        return status;
+    }
+
+    remote_seg->mmid   = mmid;
+    remote_seg->length = length;
+
+    ucs_debug("mm: attached remote mmid %zu of peer %zu at %p", mmid,
+              peer->fifo.mmid, remote_seg->address);
+    return UCS_OK;
 }
 
-static void uct_mm_iface_free_rx_descs(uct_mm_iface_t *iface, unsigned num_elems)
+/* Attach to the chunks the peer advertised since the last time */
+static ucs_status_t uct_mm_iface_attach_adv_segs(uct_mm_iface_t *iface,
+                                                 uct_mm_remote_peer_t *peer)
+{
+    unsigned count = peer->seg_table->count;
+    uct_mm_adv_seg_t *adv_seg;
+    ucs_status_t status;
+
+    ucs_memory_cpu_load_fence();
+
+    for (; peer->num_adv_segs < count; ++peer->num_adv_segs) {
+        adv_seg = &peer->seg_table->segs[peer->num_adv_segs];
+        status  = uct_mm_iface_add_remote_seg(iface, peer, adv_seg->mmid,
+                                              adv_seg->length,
+                                              (void*)adv_seg->address);
+        if (status != UCS_OK) {
+            return status;
+        }
+    }
+
+    return UCS_OK;
+}
+
+void *uct_mm_iface_attach_remote_seg(uct_mm_iface_t *iface,
+                                     uct_mm_remote_peer_t *peer,
+                                     uct_mm_fifo_element_t *elem)
+{
+    uct_mm_remote_seg_key_t key;
+    ucs_status_t status;
+    khiter_t iter;
+
+    /* the chunk is usually a new one which the peer has just advertised.
+     * if it's not advertised, attach to the memory the mmid refers to */
+    status = uct_mm_iface_attach_adv_segs(iface, peer);
+    if (status == UCS_OK) {
+        status = uct_mm_iface_add_remote_seg(iface, peer, elem->desc_mmid,
+                                             elem->desc_mpool_size,
+                                             elem->desc_chunk_base_addr);
+    }
+    if (status != UCS_OK) {
+        ucs_fatal("Failed to attach to remote mmid:%zu. %s ",
+                  elem->desc_mmid, ucs_status_string(status));
+    }
+
+    key.peer_id = peer->fifo.mmid;
+    key.mmid    = elem->desc_mmid;
+    iter        = kh_get(uct_mm_remote_segs, &iface->remote_segs, key);
+    ucs_assert(iter != kh_end(&iface->remote_segs));
+    return kh_val(&iface->remote_segs, iter).address;
+}
+
+static void uct_mm_iface_detach_remote_seg(uct_mm_iface_t *iface,
+                                           uct_mm_remote_seg_t *remote_seg,
+                                           const char *name)
+{
+    ucs_status_t status;
+
+    status = uct_mm_md_mapper_ops(iface->super.md)->detach(remote_seg);
+    if (status != UCS_OK) {
+        ucs_warn("Unable to detach shared memory segment of %s: %s", name,
+                 ucs_status_string(status));
+    }
+}
+
+ucs_status_t uct_mm_iface_attach_peer(uct_mm_iface_t *iface,
+                                      const uct_mm_iface_addr_t *addr,
+                                      uct_mm_remote_peer_t **peer_p)
+{
+    uct_mm_remote_peer_t *peer;
+    ucs_status_t status;
+    khiter_t iter;
+    int ret;
+
+    iter = kh_put(uct_mm_remote_peers, &iface->remote_peers, addr->id, &ret);
+    if (ret == -1) {
+        ucs_error("Failed to add a remote peer to the MM hash");
+        return UCS_ERR_NO_MEMORY;
+    } else if (ret == 0) {
+        /* another ep is already connected to this peer */
+        peer = kh_val(&iface->remote_peers, iter);
+        ++peer->refcount;
+        *peer_p = peer;
+        return UCS_OK;
+    }
+
+    /* the elements are written with the local FIFO layout */
+    if (addr->fifo_stride != UCT_MM_FIFO_STRIDE(iface)) {
+        ucs_error("The MM FIFO of remote peer mm_id %zu has a different layout "
+                  "(stride %u, local %zu), check the UCX_MM_FIFO_SIZE and "
+                  "UCX_MM_MAX_SHORT settings", addr->id, addr->fifo_stride,
+                  (size_t)UCT_MM_FIFO_STRIDE(iface));
+        status = UCS_ERR_UNREACHABLE;
+        goto err_del;
+    }
+
+    peer = ucs_malloc(sizeof(*peer), "mm_remote_peer");
+    if (peer == NULL) {
+        ucs_error("Failed to allocate a MM remote peer");
+        status = UCS_ERR_NO_MEMORY;
+        goto err_del;
+    }
+
+    /* Attach the remote FIFO, which has the lanes of the peer */
+    peer->fifo_lanes  = addr->fifo_lanes;
+    peer->fifo.mmid   = addr->id;
+    peer->fifo.length = UCT_MM_GET_FIFO_SIZE(iface, peer->fifo_lanes);
+    status = uct_mm_md_mapper_ops(iface->super.md)->attach(addr->id,
+                                                           peer->fifo.length,
+                                                           (void*)addr->vaddr,
+                                                           &peer->fifo.address,
+                                                           &peer->fifo.cookie,
+                                                           iface->path);
+    if (status != UCS_OK) {
+        ucs_error("failed to connect to remote peer with mm. remote mm_id: %zu",
+                  addr->id);
+        goto err_free;
+    }
+
+    peer->seg_table    = UCT_MM_GET_SEG_TABLE(iface,
+                                              uct_mm_set_fifo_ctl(peer->fifo.address),
+                                              peer->fifo_lanes);
+    peer->num_adv_segs = 0;
+    peer->refcount     = 1;
+    kh_val(&iface->remote_peers, iter) = peer;
+
+    /* Attach the descriptor chunks the peer has so far, so the first sends to
+     * them would not have to */
+    status = uct_mm_iface_attach_adv_segs(iface, peer);
+    if (status != UCS_OK) {
+        uct_mm_iface_detach_peer(iface, peer);
+        return status;
+    }
+
+    *peer_p = peer;
+    return UCS_OK;
+
+err_free:
+    ucs_free(peer);
+err_del:
+    kh_del(uct_mm_remote_peers, &iface->remote_peers, iter);
+    return status;
+}
+
+void uct_mm_iface_detach_peer(uct_mm_iface_t *iface, uct_mm_remote_peer_t *peer)
+{
+    uct_mm_remote_seg_key_t key;
+    khiter_t iter;
+
+    if (--peer->refcount > 0) {
+        return;
+    }
+
+    /* detach the remote process's descriptor chunks */
+    for (iter = kh_begin(&iface->remote_segs);
+         iter != kh_end(&iface->remote_segs); ++iter) {
+        if (!kh_exist(&iface->remote_segs, iter)) {
+            continue;
+        }
+
+        key = kh_key(&iface->remote_segs, iter);
+        if (key.peer_id == peer->fifo.mmid) {
+            uct_mm_iface_detach_remote_seg(iface, &kh_val(&iface->remote_segs, iter),
+                                           "descriptors");
+            kh_del(uct_mm_remote_segs, &iface->remote_segs, iter);
+        }
+    }
+
+    /* detach the remote process's shared memory segment (remote recv FIFO) */
+    uct_mm_iface_detach_remote_seg(iface, &peer->fifo, "remote FIFO");
+
+    iter = kh_get(uct_mm_remote_peers, &iface->remote_peers, peer->fifo.mmid);
+    ucs_assert(iter != kh_end(&iface->remote_peers));
+    kh_del(uct_mm_remote_peers, &iface->remote_peers, iter);
+    ucs_free(peer);
+}
+
+static void uct_mm_iface_free_rx_descs(uct_mm_iface_t *iface, void *fifo_elements,
+                                       unsigned num_elems)
 {
     uct_mm_fifo_element_t* fifo_elem_p;
     uct_mm_recv_desc_t *desc;
     unsigned i;
 
     for (i = 0; i < num_elems; i++) {
-        fifo_elem_p = UCT_MM_IFACE_GET_FIFO_ELEM(iface, iface->recv_fifo_elements, i);
+        fifo_elem_p = UCT_MM_IFACE_GET_FIFO_ELEM(iface, fifo_elements, i);
         desc = UCT_MM_IFACE_GET_DESC_START(iface, fifo_elem_p);
         ucs_mpool_put(desc);
     }
 }
 
+/* Initiate the owner bit in all the FIFO elements and assign a receive
+ * descriptor per every FIFO element */
+static ucs_status_t uct_mm_iface_init_fifo_elems(uct_mm_iface_t *iface,
+                                                 void *fifo_elements)
+{
+    uct_mm_fifo_element_t* fifo_elem_p;
+    ucs_status_t status;
+    unsigned i;
+
+    for (i = 0; i < iface->config.fifo_size; i++) {
+        fifo_elem_p = UCT_MM_IFACE_GET_FIFO_ELEM(iface, fifo_elements, i);
+        fifo_elem_p->flags = UCT_MM_FIFO_ELEM_FLAG_OWNER;
+
+        status = uct_mm_assign_desc_to_fifo_elem(iface, fifo_elem_p, 1);
+        if (status != UCS_OK) {
+            ucs_error("Failed to allocate a descriptor for MM");
+            uct_mm_iface_free_rx_descs(iface, fifo_elements, i);
+            return status;
+        }
+    }
+
+    return UCS_OK;
+}
+
+static void uct_mm_iface_cleanup_lanes(uct_mm_iface_t *iface, unsigned num_lanes)
+{
+    unsigned i;
+
+    for (i = 0; i < num_lanes; i++) {
+        uct_mm_iface_free_rx_descs(iface, iface->lanes[i].elements,
+                                   iface->config.fifo_size);
+    }
+    ucs_free(iface->lanes);
+}
+
+static ucs_status_t uct_mm_iface_init_lanes(uct_mm_iface_t *iface)
+{
+    uct_mm_fifo_lane_t *lane;
+    ucs_status_t status;
+    unsigned i;
+
+    iface->recv_fifo_ctl->lane_map      = 0;
+    iface->recv_fifo_ctl->lane_released = 0;
+    iface->next_lane                    = 0;
+    iface->lanes                        = NULL;
+    if (iface->config.fifo_lanes == 0) {
+        return UCS_OK;
+    }
+
+    iface->lanes = ucs_calloc(iface->config.fifo_lanes, sizeof(*iface->lanes),
+                              "mm_fifo_lanes");
+    if (iface->lanes == NULL) {
+        ucs_error("Failed to allocate %u MM FIFO lanes", iface->config.fifo_lanes);
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < iface->config.fifo_lanes; i++) {
+        lane             = &iface->lanes[i];
+        lane->ctl        = UCT_MM_GET_FIFO_LANE_CTL(iface, iface->recv_fifo_ctl, i);
+        lane->ctl->head  = 0;
+        lane->ctl->tail  = 0;
+        lane->read_index = 0;
+        uct_mm_set_fifo_elems_ptr(lane->ctl, &lane->elements);
+
+        status = uct_mm_iface_init_fifo_elems(iface, lane->elements);
+        if (status != UCS_OK) {
+            uct_mm_iface_cleanup_lanes(iface, i);
+            return status;
+        }
+    }
+
+    return UCS_OK;
+}
+
 ucs_status_t uct_mm_allocate_fifo_mem(uct_mm_iface_t *iface,
                                       uct_mm_iface_config_t *config, uct_md_h md)
 {
@@ -312,7 +922,7 @@ ucs_status_t uct_mm_allocate_fifo_mem(uct_mm_iface_t *iface,
     ucs_status_t status;
 
     /* allocate the receive FIFO */
-    size_to_alloc = UCT_MM_GET_FIFO_SIZE(iface);
+    size_to_alloc = UCT_MM_GET_FIFO_SIZE(iface, iface->config.fifo_lanes);
 
     status = uct_mm_md_mapper_ops(md)->alloc(md, &size_to_alloc, config->hugetlb_mode,
                                              &iface->shared_mem, &iface->fifo_mm_id,
@@ -323,6 +933,10 @@ ucs_status_t uct_mm_allocate_fifo_mem(uct_mm_iface_t *iface,
         return status;
     }
 
+    /* place the FIFO before it's initialized */
+    uct_mm_iface_set_numa_policy(iface, iface->shared_mem, size_to_alloc,
+                                 "receive FIFO");
+
     ctl = uct_mm_set_fifo_ctl(iface->shared_mem);
     uct_mm_set_fifo_elems_ptr(iface->shared_mem, &iface->recv_fifo_elements);
 
@@ -339,23 +953,26 @@ ucs_status_t uct_mm_allocate_fifo_mem(uct_mm_iface_t *iface,
     return UCS_OK;
 }
 
-static ucs_status_t uct_mm_iface_create_signal_fd(uct_mm_iface_t *iface)
+/* Create a non-blocking, auto-bound UNIX domain datagram socket, and return
+ * its address so it could be shared with the remote processes */
+static ucs_status_t uct_mm_iface_create_socket(int *fd_p,
+                                               struct sockaddr_un *addr,
+                                               socklen_t *addrlen_p)
 {
     ucs_status_t status;
     socklen_t addrlen;
     struct sockaddr_un bind_addr;
-    int ret;
+    int ret, fd;
 
-    /* Create a UNIX domain socket to send and receive wakeup signal from remote processes */
-    iface->signal_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-    if (iface->signal_fd < 0) {
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) {
         ucs_error("Failed to create unix domain socket for signal: %m");
         status = UCS_ERR_IO_ERROR;
         goto err;
     }
 
     /* Set the signal socket to non-blocking mode */
-    status = ucs_sys_fcntl_modfl(iface->signal_fd, O_NONBLOCK, 0);
+    status = ucs_sys_fcntl_modfl(fd, O_NONBLOCK, 0);
     if (status != UCS_OK) {
         goto err_close;
     }
@@ -363,36 +980,184 @@ static ucs_status_t uct_mm_iface_create_signal_fd(uct_mm_iface_t *iface)
     /* Bind the signal socket to automatic address */
     bind_addr.sun_family = AF_UNIX;
     memset(bind_addr.sun_path, 0, sizeof(bind_addr.sun_path));
-    ret = bind(iface->signal_fd, (struct sockaddr*)&bind_addr, sizeof(sa_family_t));
+    ret = bind(fd, (struct sockaddr*)&bind_addr, sizeof(sa_family_t));
     if (ret < 0) {
         ucs_error("Failed to auto-bind unix domain socket: %m");
         status = UCS_ERR_IO_ERROR;
         goto err_close;
     }
 
-    /* Share the socket address on the FIFO control area, so we would not have
-     * to enlarge the interface address size.
-     */
     addrlen = sizeof(struct sockaddr_un);
-    memset(&iface->recv_fifo_ctl->signal_sockaddr, 0, addrlen);
-    ret = getsockname(iface->signal_fd,
-                      (struct sockaddr *)&iface->recv_fifo_ctl->signal_sockaddr,
-                      &addrlen);
+    memset(addr, 0, addrlen);
+    ret = getsockname(fd, (struct sockaddr *)addr, &addrlen);
     if (ret < 0) {
         ucs_error("Failed to retrieve unix domain socket address: %m");
         status = UCS_ERR_IO_ERROR;
         goto err_close;
     }
 
-    iface->recv_fifo_ctl->signal_addrlen = addrlen;
+    *addrlen_p = addrlen;
+    *fd_p      = fd;
     return UCS_OK;
 
 err_close:
-    close(iface->signal_fd);
+    close(fd);
 err:
     return status;
 }
 
+static ucs_status_t uct_mm_iface_create_signal_fd(uct_mm_iface_t *iface)
+{
+    struct sockaddr_un addr;
+    ucs_status_t status;
+    socklen_t addrlen;
+
+    /* Create a UNIX domain socket to send and receive connect signals from
+     * remote processes */
+    status = uct_mm_iface_create_socket(&iface->signal_fd, &addr, &addrlen);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* Share the socket address on the FIFO control area, so we would not have
+     * to enlarge the interface address size.
+     */
+    iface->recv_fifo_ctl->signal_sockaddr = addr;
+    iface->recv_fifo_ctl->signal_addrlen  = addrlen;
+    return UCS_OK;
+}
+
+/* Check if the progress has anything to do: FIFO elements which are ready, or
+ * lanes to drain */
+static int uct_mm_iface_rx_ready(uct_mm_iface_t *iface)
+{
+    uct_mm_fifo_ctl_t *fifo_ctl = iface->recv_fifo_ctl;
+    uct_mm_fifo_element_t *elem;
+    uct_mm_fifo_lane_t *lane;
+    uint64_t lane_map;
+    unsigned i;
+
+    elem = UCT_MM_IFACE_GET_FIFO_ELEM(iface, iface->recv_fifo_elements,
+                                      iface->read_index & iface->fifo_mask);
+    if (uct_mm_iface_fifo_elem_ready(iface, iface->read_index, elem)) {
+        return 1;
+    }
+
+    /* released lanes are returned to the free lanes by the progress */
+    if (fifo_ctl->lane_released != 0) {
+        return 1;
+    }
+
+    lane_map = fifo_ctl->lane_map;
+    for (i = 0; i < iface->config.fifo_lanes; ++i) {
+        if (!(lane_map & UCS_BIT(i))) {
+            continue;
+        }
+
+        lane = &iface->lanes[i];
+        elem = UCT_MM_IFACE_GET_FIFO_ELEM(iface, lane->elements,
+                                          lane->read_index & iface->fifo_mask);
+        if (uct_mm_iface_fifo_elem_ready(iface, lane->read_index, elem)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static ucs_status_t uct_mm_iface_wakeup_open(uct_iface_h tl_iface,
+                                             unsigned events,
+                                             uct_wakeup_h wakeup)
+{
+    uct_mm_iface_t *iface       = ucs_derived_of(tl_iface, uct_mm_iface_t);
+    uct_mm_fifo_ctl_t *fifo_ctl = iface->recv_fifo_ctl;
+    struct sockaddr_un addr;
+    ucs_status_t status;
+    socklen_t addrlen;
+
+    if (iface->wakeup_fd != -1) {
+        ucs_error("mm_iface %p already has a wakeup handle", iface);
+        return UCS_ERR_ALREADY_EXISTS;
+    }
+
+    status = uct_mm_iface_create_socket(&iface->wakeup_fd, &addr, &addrlen);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    fifo_ctl->wakeup_sockaddr = addr;
+    fifo_ctl->wakeup_addrlen  = addrlen;
+    fifo_ctl->wakeup_armed    = 0;
+    ucs_memory_cpu_store_fence();
+    fifo_ctl->wakeup_enabled  = 1;
+
+    wakeup->fd = iface->wakeup_fd;
+    return UCS_OK;
+}
+
+static ucs_status_t uct_mm_iface_wakeup_arm(uct_wakeup_h wakeup)
+{
+    uct_mm_iface_t *iface       = ucs_derived_of(wakeup->iface, uct_mm_iface_t);
+    uct_mm_fifo_ctl_t *fifo_ctl = iface->recv_fifo_ctl;
+    ucs_status_t status;
+
+    /* consume the signals which woke us up, and avoid arming the interface if
+     * there were any. The pending sends wait for the tail of the remote FIFO,
+     * which does not signal, so don't arm if some of them can be sent now.
+     * Otherwise they are resumed by the progress after the next wakeup. */
+    status = uct_sm_iface_wakeup_drain(iface->wakeup_fd);
+    if (status != UCS_OK) {
+        return status;
+    } else if (uct_mm_iface_pending_can_progress(iface)) {
+        return UCS_ERR_BUSY;
+    }
+
+    if (!(wakeup->events & (UCT_WAKEUP_RX_AM | UCT_WAKEUP_RX_SIGNALED_AM))) {
+        return UCS_OK;
+    }
+
+    /* The senders check the armed flag after writing their FIFO element, and
+     * the receiver checks the FIFO after setting the flag. Both need a full
+     * fence, since a store may otherwise pass a later load. */
+    fifo_ctl->wakeup_armed = 1;
+    ucs_memory_bus_fence();
+
+    if (uct_mm_iface_rx_ready(iface)) {
+        fifo_ctl->wakeup_armed = 0;
+        return UCS_ERR_BUSY;
+    }
+
+    return UCS_OK;
+}
+
+static ucs_status_t uct_mm_iface_wakeup_signal(uct_wakeup_h wakeup)
+{
+    uct_mm_iface_t *iface          = ucs_derived_of(wakeup->iface, uct_mm_iface_t);
+    uct_mm_iface_conn_signal_t sig = UCT_MM_IFACE_SIGNAL_WAKEUP;
+    struct sockaddr_un addr        = iface->recv_fifo_ctl->wakeup_sockaddr;
+    int ret;
+
+    ret = sendto(iface->signal_fd, &sig, sizeof(sig), 0,
+                 (const struct sockaddr*)&addr,
+                 iface->recv_fifo_ctl->wakeup_addrlen);
+    if ((ret < 0) && (errno != EAGAIN)) {
+        ucs_error("failed to send wakeup signal: %m");
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return UCS_OK;
+}
+
+static void uct_mm_iface_wakeup_close(uct_wakeup_h wakeup)
+{
+    uct_mm_iface_t *iface = ucs_derived_of(wakeup->iface, uct_mm_iface_t);
+
+    iface->recv_fifo_ctl->wakeup_enabled = 0;
+    iface->recv_fifo_ctl->wakeup_armed   = 0;
+    close(iface->wakeup_fd);
+    iface->wakeup_fd = -1;
+}
+
 static void uct_mm_iface_recv_messages(uct_mm_iface_t *iface)
 {
     uct_mm_iface_conn_signal_t sig;
@@ -434,9 +1199,7 @@ static UCS_CLASS_INIT_FUNC(uct_mm_iface_t, uct_md_h md, uct_worker_h worker,
                            const uct_iface_config_t *tl_config)
 {
     uct_mm_iface_config_t *mm_config = ucs_derived_of(tl_config, uct_mm_iface_config_t);
-    uct_mm_fifo_element_t* fifo_elem_p;
     ucs_status_t status;
-    unsigned i;
 
     UCS_CLASS_CALL_SUPER_INIT(uct_base_iface_t, &uct_mm_iface_ops, md, worker,
                               params, tl_config UCS_STATS_ARG(params->stats_root)
@@ -451,6 +1214,21 @@ static UCS_CLASS_INIT_FUNC(uct_mm_iface_t, uct_md_h md, uct_worker_h worker,
         goto err;
     }
 
+    /* check the number of FIFO elements to read in one progress call */
+    if (mm_config->fifo_max_poll == 0) {
+        ucs_error("The MM FIFO max poll value must be at least 1.");
+        status = UCS_ERR_INVALID_PARAM;
+        goto err;
+    }
+
+    /* check the number of FIFO lanes, which are tracked by a 64-bit mask */
+    if (mm_config->fifo_lanes > UCT_MM_MAX_FIFO_LANES) {
+        ucs_error("The MM FIFO lanes number must be at most %d.",
+                  UCT_MM_MAX_FIFO_LANES);
+        status = UCS_ERR_INVALID_PARAM;
+        goto err;
+    }
+
     /* check the value defining the FIFO batch release */
     if ((mm_config->release_fifo_factor < 0) || (mm_config->release_fifo_factor >= 1)) {
         ucs_error("The MM release FIFO factor must be: (0 =< factor < 1).");
@@ -469,6 +1247,8 @@ static UCS_CLASS_INIT_FUNC(uct_mm_iface_t, uct_md_h md, uct_worker_h worker,
 
     self->config.fifo_size         = mm_config->fifo_size;
     self->config.fifo_elem_size    = mm_config->super.max_short;
+    self->config.fifo_max_poll     = mm_config->fifo_max_poll;
+    self->config.fifo_lanes        = mm_config->fifo_lanes;
     self->config.seg_size          = mm_config->super.max_bcopy;
     self->fifo_release_factor_mask = UCS_MASK(ucs_ilog2(ucs_max((int)
                                      (mm_config->fifo_size * mm_config->release_fifo_factor),
@@ -478,6 +1258,11 @@ static UCS_CLASS_INIT_FUNC(uct_mm_iface_t, uct_md_h md, uct_worker_h worker,
     self->rx_headroom              = params->rx_headroom;
     self->release_desc.cb          = uct_mm_iface_release_desc;
 
+    status = uct_mm_iface_init_numa(self, mm_config);
+    if (status != UCS_OK) {
+        goto err;
+    }
+
     /* create the receive FIFO */
     /* use specific allocator to allocate and attach memory and check the
      * requested hugetlb allocation mode */
@@ -486,9 +1271,29 @@ static UCS_CLASS_INIT_FUNC(uct_mm_iface_t, uct_md_h md, uct_worker_h worker,
         goto err;
     }
 
-    self->recv_fifo_ctl->head   = 0;
-    self->recv_fifo_ctl->tail   = 0;
-    self->read_index            = 0;
+    /* the FIFO control fields are updated with 64-bit atomics */
+    UCS_STATIC_ASSERT(ucs_offsetof(uct_mm_fifo_ctl_t, head) % sizeof(uint64_t) == 0);
+    UCS_STATIC_ASSERT(ucs_offsetof(uct_mm_fifo_ctl_t, lane_map) % sizeof(uint64_t) == 0);
+    UCS_STATIC_ASSERT(ucs_offsetof(uct_mm_fifo_ctl_t, lane_released) %
+                      sizeof(uint64_t) == 0);
+    UCS_STATIC_ASSERT(ucs_offsetof(uct_mm_fifo_ctl_t, wakeup_armed) %
+                      sizeof(uint64_t) == 0);
+
+    self->recv_fifo_ctl->head           = 0;
+    self->recv_fifo_ctl->tail           = 0;
+    self->recv_fifo_ctl->wakeup_enabled = 0;
+    self->recv_fifo_ctl->wakeup_armed   = 0;
+    self->read_index                    = 0;
+    self->wakeup_fd                     = -1;
+
+    /* the receive descriptor chunks are advertised as they are allocated */
+    self->seg_table        = UCT_MM_GET_SEG_TABLE(self, self->recv_fifo_ctl,
+                                              self->config.fifo_lanes);
+    self->seg_table->count = 0;
+    self->last_desc_seg    = NULL;
+
+    kh_init_inplace(uct_mm_remote_peers, &self->remote_peers);
+    kh_init_inplace(uct_mm_remote_segs, &self->remote_segs);
 
     status = uct_mm_iface_create_signal_fd(self);
     if (status != UCS_OK) {
@@ -520,17 +1325,15 @@ static UCS_CLASS_INIT_FUNC(uct_mm_iface_t, uct_md_h md, uct_worker_h worker,
         goto destroy_recv_mpool;
     }
 
-    /* initiate the owner bit in all the FIFO elements and assign a receive descriptor
-     * per every FIFO element */
-    for (i = 0; i < mm_config->fifo_size; i++) {
-        fifo_elem_p = UCT_MM_IFACE_GET_FIFO_ELEM(self, self->recv_fifo_elements, i);
-        fifo_elem_p->flags = UCT_MM_FIFO_ELEM_FLAG_OWNER;
+    status = uct_mm_iface_init_fifo_elems(self, self->recv_fifo_elements);
+    if (status != UCS_OK) {
+        goto destroy_last_desc;
+    }
 
-        status = uct_mm_assign_desc_to_fifo_elem(self, fifo_elem_p, 1);
-        if (status != UCS_OK) {
-            ucs_error("Failed to allocate a descriptor for MM");
-            goto destroy_descs;
-        }
+    /* the lanes follow the receive FIFO in the same shared memory segment */
+    status = uct_mm_iface_init_lanes(self);
+    if (status != UCS_OK) {
+        goto destroy_descs;
     }
 
     uct_mm_iface_init_dummy_fifo_ctl(self);
@@ -541,19 +1344,25 @@ static UCS_CLASS_INIT_FUNC(uct_mm_iface_t, uct_md_h md, uct_worker_h worker,
                                 self->signal_fd, POLLIN, uct_mm_iface_singal_handler,
                                 self, worker->async);
 
-    ucs_debug("Created an MM iface. FIFO mm id: %zu", self->fifo_mm_id);
+    ucs_debug("Created an MM iface. FIFO mm id: %zu, NUMA node: %d",
+              self->fifo_mm_id, self->numa_node);
     return UCS_OK;
 
 destroy_descs:
-    uct_mm_iface_free_rx_descs(self, i);
+    uct_mm_iface_free_rx_descs(self, self->recv_fifo_elements,
+                               self->config.fifo_size);
+destroy_last_desc:
     ucs_mpool_put(self->last_recv_desc);
 destroy_recv_mpool:
     ucs_mpool_cleanup(&self->recv_desc_mp, 1);
 err_close_signal_fd:
     close(self->signal_fd);
 err_free_fifo:
+    kh_destroy_inplace(uct_mm_remote_segs, &self->remote_segs);
+    kh_destroy_inplace(uct_mm_remote_peers, &self->remote_peers);
     uct_mm_md_mapper_ops(md)->free(self->shared_mem, self->fifo_mm_id,
-                                   UCT_MM_GET_FIFO_SIZE(self), self->path);
+                                   UCT_MM_GET_FIFO_SIZE(self, self->config.fifo_lanes),
+                                   self->path);
 err:
     return status;
 }
@@ -570,13 +1379,20 @@ static UCS_CLASS_CLEANUP_FUNC(uct_mm_iface_t)
 
     /* return all the descriptors that are now 'assigned' to the FIFO,
      * to their mpool */
-    uct_mm_iface_free_rx_descs(self, self->config.fifo_size);
+    uct_mm_iface_free_rx_descs(self, self->recv_fifo_elements,
+                               self->config.fifo_size);
+    uct_mm_iface_cleanup_lanes(self, self->config.fifo_lanes);
 
     ucs_mpool_put(self->last_recv_desc);
     ucs_mpool_cleanup(&self->recv_desc_mp, 1);
     close(self->signal_fd);
 
-    size_to_free = UCT_MM_GET_FIFO_SIZE(self);
+    /* all the eps, which hold the remote peers, are destroyed by now */
+    ucs_assert(kh_size(&self->remote_peers) == 0);
+    kh_destroy_inplace(uct_mm_remote_segs, &self->remote_segs);
+    kh_destroy_inplace(uct_mm_remote_peers, &self->remote_peers);
+
+    size_to_free = UCT_MM_GET_FIFO_SIZE(self, self->config.fifo_lanes);
 
     /* release the memory allocated for the FIFO */
     status = uct_mm_md_mapper_ops(self->super.md)->free(self->shared_mem,
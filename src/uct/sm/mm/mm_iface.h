@@ -15,6 +15,7 @@
 #include <ucs/arch/cpu.h>
 #include <ucs/debug/memtrack.h>
 #include <ucs/datastruct/arbiter.h>
+#include <ucs/datastruct/khash.h>
 #include <ucs/sys/compiler.h>
 #include <ucs/sys/sys.h>
 #include <sys/shm.h>
@@ -24,23 +25,59 @@
 #define UCT_MM_TL_NAME "mm"
 #define UCT_MM_FIFO_CTL_SIZE_ALIGNED  ucs_align_up(sizeof(uct_mm_fifo_ctl_t),UCS_SYS_CACHE_LINE_SIZE)
 
-#define UCT_MM_GET_FIFO_SIZE(iface)  (UCS_SYS_CACHE_LINE_SIZE - 1 +  \
-                                      UCT_MM_FIFO_CTL_SIZE_ALIGNED + \
-                                     ((iface)->config.fifo_size *    \
-                                     (iface)->config.fifo_elem_size))
+/* Distance between the receive FIFO and the per-sender lanes which follow it,
+ * each lane has the same layout as the receive FIFO */
+#define UCT_MM_FIFO_STRIDE(iface)    ucs_align_up_pow2(UCT_MM_FIFO_CTL_SIZE_ALIGNED + \
+                                                       ((iface)->config.fifo_size *   \
+                                                       (iface)->config.fifo_elem_size), \
+                                                       UCS_SYS_CACHE_LINE_SIZE)
+
+/* The FIFO of a peer is laid out with the peer's number of lanes */
+#define UCT_MM_GET_FIFO_SIZE(iface, _num_lanes) \
+                                     (UCS_SYS_CACHE_LINE_SIZE - 1 +  \
+                                     ((1 + (_num_lanes)) * \
+                                     UCT_MM_FIFO_STRIDE(iface)) + \
+                                     sizeof(uct_mm_seg_table_t))
+
+#define UCT_MM_GET_FIFO_LANE_CTL(_iface, _fifo_ctl, _lane) \
+          ((uct_mm_fifo_ctl_t*) ((char*)(_fifo_ctl) + \
+          (((_lane) + 1) * UCT_MM_FIFO_STRIDE(_iface))))
+
+/* The table of advertised receive descriptor chunks follows the lanes */
+#define UCT_MM_GET_SEG_TABLE(_iface, _fifo_ctl, _num_lanes) \
+          ((uct_mm_seg_table_t*) ((char*)(_fifo_ctl) + \
+          ((1 + (_num_lanes)) * UCT_MM_FIFO_STRIDE(_iface))))
+
+#define UCT_MM_MAX_FIFO_LANES        64
+#define UCT_MM_MAX_ADV_SEGS          32
 
 
 typedef enum {
     UCT_MM_IFACE_SIGNAL_CONNECT    = 0,
+    UCT_MM_IFACE_SIGNAL_WAKEUP     = 1,
 } uct_mm_iface_conn_signal_t;
 
 
+typedef enum {
+    UCT_MM_NUMA_POLICY_DEFAULT,
+    UCT_MM_NUMA_POLICY_PREFERRED,
+    UCT_MM_NUMA_POLICY_BIND,
+    UCT_MM_NUMA_POLICY_LAST
+} uct_mm_numa_policy_t;
+
+
 typedef struct uct_mm_iface_config {
     uct_iface_config_t       super;
     unsigned                 fifo_size;            /* Size of the receive FIFO */
+    unsigned                 fifo_max_poll;        /* Max FIFO elements per progress */
+    unsigned                 fifo_lanes;           /* Number of per-sender FIFO lanes */
     double                   release_fifo_factor;
     ucs_ternary_value_t      hugetlb_mode;         /* Enable using huge pages for */
                                                    /* shared memory buffers */
+    uct_mm_numa_policy_t     numa_policy;          /* Placement of the receive FIFO */
+                                                   /* and descriptors */
+    int                      numa_node;            /* NUMA node to place them on, */
+                                                   /* or -1 for the local one */
     uct_iface_mpool_config_t mp;
 } uct_mm_iface_config_t;
 
@@ -54,7 +91,73 @@ struct uct_mm_fifo_ctl {
 
     /* 2nd cacheline */
     volatile uint64_t  tail;       /* how much was read */
-} UCS_S_PACKED;
+    volatile uint64_t  lane_map;   /* lanes claimed by senders */
+    volatile uint64_t  lane_released; /* lanes released by senders, and not yet
+                                         drained by the receiver */
+    UCS_CACHELINE_PADDING(uint64_t, uint64_t, uint64_t);
+
+    /* 3rd cacheline */
+    volatile uint64_t  wakeup_armed;     /* the receiver waits on the wakeup
+                                            socket, the sender which clears it
+                                            has to signal the socket */
+    volatile uint32_t  wakeup_enabled;   /* the receiver has a wakeup socket */
+    socklen_t          wakeup_addrlen;   /* address length of wakeup socket */
+    struct sockaddr_un wakeup_sockaddr;  /* address of wakeup socket */
+};
+
+
+/* A receive descriptor chunk, as advertised by the receiver */
+typedef struct uct_mm_adv_seg {
+    uct_mm_id_t        mmid;       /* mmid of the chunk */
+    uintptr_t          address;    /* address of the chunk in the receiver */
+    size_t             length;     /* size of the chunk */
+} UCS_S_PACKED uct_mm_adv_seg_t;
+
+
+/* Receive descriptor chunks of the receiver, which the senders attach to in
+ * advance instead of on the first send to each chunk. Chunks beyond
+ * UCT_MM_MAX_ADV_SEGS are not advertised, and are attached on first use. */
+typedef struct uct_mm_seg_table {
+    volatile uint32_t  count;      /* number of published entries */
+    uct_mm_adv_seg_t   segs[UCT_MM_MAX_ADV_SEGS];
+} UCS_S_PACKED uct_mm_seg_table_t;
+
+
+/* A remote peer, identified by the mmid of its receive FIFO */
+typedef struct uct_mm_remote_peer {
+    uct_mm_remote_seg_t     fifo;             /* the peer's receive FIFO */
+    uct_mm_seg_table_t      *seg_table;       /* the peer's advertised chunks */
+    unsigned                fifo_lanes;       /* number of lanes in the peer's FIFO */
+    unsigned                num_adv_segs;     /* advertised chunks attached so far */
+    unsigned                refcount;         /* number of eps to the peer */
+} uct_mm_remote_peer_t;
+
+
+/* Remote segment key - the peer and the mmid of the segment */
+typedef struct uct_mm_remote_seg_key {
+    uct_mm_id_t             peer_id;
+    uct_mm_id_t             mmid;
+} uct_mm_remote_seg_key_t;
+
+
+#define uct_mm_remote_seg_key_hash(_key) \
+    kh_int64_hash_func((_key).mmid ^ ((_key).peer_id * 31))
+
+#define uct_mm_remote_seg_key_equal(_key1, _key2) \
+    (((_key1).mmid == (_key2).mmid) && ((_key1).peer_id == (_key2).peer_id))
+
+
+KHASH_INIT(uct_mm_remote_segs, uct_mm_remote_seg_key_t, uct_mm_remote_seg_t, 1,
+           uct_mm_remote_seg_key_hash, uct_mm_remote_seg_key_equal);
+KHASH_MAP_INIT_INT64(uct_mm_remote_peers, uct_mm_remote_peer_t*);
+
+
+/* Receiver side of a FIFO lane, written by a single sender */
+typedef struct uct_mm_fifo_lane {
+    uct_mm_fifo_ctl_t       *ctl;             /* head and tail of the lane */
+    void                    *elements;        /* first element of the lane */
+    uint64_t                read_index;       /* actual reading location */
+} uct_mm_fifo_lane_t;
 
 
 struct uct_mm_iface {
@@ -75,14 +178,32 @@ struct uct_mm_iface {
                                                  /* in the receive fifo */
     uint64_t                read_index;          /* actual reading location */
 
+    uct_mm_fifo_lane_t      *lanes;              /* per-sender receive FIFOs */
+    unsigned                next_lane;           /* lane to poll first */
+
     uint8_t                 fifo_shift;          /* = log2(fifo_size) */
     unsigned                fifo_mask;           /* = 2^fifo_shift - 1 */
     uint64_t                fifo_release_factor_mask;
 
     ucs_mpool_t             recv_desc_mp;
     uct_mm_recv_desc_t      *last_recv_desc;    /* next receive descriptor to use */
+    uct_mm_seg_table_t      *seg_table;         /* receive descriptor chunks */
+                                                /* advertised to the senders */
+    uct_mm_seg_t            *last_desc_seg;     /* chunk of the last initialized */
+                                                /* receive descriptor */
+
+    int                     numa_node;        /* NUMA node of the receive FIFO and */
+                                              /* descriptors, or -1 if not placed */
+    int                     numa_mode;        /* memory policy of the placement */
+
+    /* Remote memory attached by the eps, shared by all eps to the same peer */
+    khash_t(uct_mm_remote_peers) remote_peers;  /* peers by FIFO mmid */
+    khash_t(uct_mm_remote_segs)  remote_segs;   /* descriptor chunks by */
+                                                /* (peer, mmid) */
 
     int                     signal_fd;        /* Unix socket for receiving remote signal */
+    int                     wakeup_fd;        /* Unix socket for wakeup signals, while
+                                               * a wakeup handle is open */
 
     size_t                  rx_headroom;
     ucs_arbiter_t           arbiter;
@@ -95,6 +216,8 @@ struct uct_mm_iface {
     struct {
         unsigned fifo_size;
         unsigned fifo_elem_size;
+        unsigned fifo_max_poll;               /* how many elements to read per progress */
+        unsigned fifo_lanes;                  /* number of per-sender FIFO lanes */
         unsigned seg_size;                    /* size of the receive descriptor (for payload)*/
     } config;
 };
@@ -168,6 +291,37 @@ static inline void uct_mm_set_fifo_elems_ptr(void *mem_region, void **fifo_elems
    *fifo_elems = (void*) fifo_ctl + UCT_MM_FIFO_CTL_SIZE_ALIGNED;
 }
 
+void *uct_mm_iface_attach_remote_seg(uct_mm_iface_t *iface,
+                                     uct_mm_remote_peer_t *peer,
+                                     uct_mm_fifo_element_t *elem);
+
+/**
+ * Find the local address of the remote descriptor chunk which a FIFO element
+ * points to. Attaches to the chunk if it was not attached yet.
+ */
+static UCS_F_ALWAYS_INLINE void*
+uct_mm_iface_get_remote_seg(uct_mm_iface_t *iface, uct_mm_remote_peer_t *peer,
+                            uct_mm_fifo_element_t *elem)
+{
+    uct_mm_remote_seg_key_t key;
+    khiter_t iter;
+
+    key.peer_id = peer->fifo.mmid;
+    key.mmid    = elem->desc_mmid;
+    iter        = kh_get(uct_mm_remote_segs, &iface->remote_segs, key);
+    if (ucs_likely(iter != kh_end(&iface->remote_segs))) {
+        return kh_val(&iface->remote_segs, iter).address;
+    }
+
+    return uct_mm_iface_attach_remote_seg(iface, peer, elem);
+}
+
+ucs_status_t uct_mm_iface_attach_peer(uct_mm_iface_t *iface,
+                                      const uct_mm_iface_addr_t *addr,
+                                      uct_mm_remote_peer_t **peer_p);
+
+void uct_mm_iface_detach_peer(uct_mm_iface_t *iface, uct_mm_remote_peer_t *peer);
+
 void uct_mm_iface_release_desc(uct_recv_desc_t *self, void *desc);
 ucs_status_t uct_mm_flush();
 
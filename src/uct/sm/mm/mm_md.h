@@ -25,7 +25,6 @@ extern ucs_config_field_t uct_mm_md_config_table[];
  * Descriptor of the mapped memory
  */
 struct uct_mm_remote_seg {
-    uct_mm_remote_seg_t *next;
     uct_mm_id_t mmid;        /**< mmid of the remote memory chunk */
     void        *address;    /**< local memory address */
     uint64_t    cookie;      /**< cookie for mmap, xpmem, etc. */
@@ -6,6 +6,8 @@
 #include "self_ep.h"
 #include "self_iface.h"
 
+#include <ucs/arch/atomic.h>
+
 static UCS_CLASS_INIT_FUNC(uct_self_ep_t, uct_iface_t *tl_iface,
                            const uct_device_addr_t *dev_addr,
                            const uct_iface_addr_t *iface_addr)
@@ -28,6 +30,18 @@ UCS_CLASS_DEFINE_NEW_FUNC(uct_self_ep_t, uct_ep_t, uct_iface_t *,
                           const uct_device_addr_t *, const uct_iface_addr_t *);
 UCS_CLASS_DEFINE_DELETE_FUNC(uct_self_ep_t, uct_ep_t);
 
+/**
+ * Signal the wakeup pipe about a received message, if a wakeup handle is
+ * waiting for it
+ */
+static void UCS_F_ALWAYS_INLINE uct_self_ep_am_wakeup(uct_self_iface_t *self_iface)
+{
+    if (ucs_unlikely(self_iface->wakeup_armed) &&
+        (ucs_atomic_cswap32(&self_iface->wakeup_armed, 1, 0) == 1)) {
+        ucs_async_pipe_push(&self_iface->wakeup_pipe);
+    }
+}
+
 /**
  * Reserve the buffer and set the descriptor empty for later initialization
  * in case if UCS_ERR_NO_RESOURCE obtained from active message handler
@@ -74,6 +88,7 @@ ucs_status_t uct_self_ep_am_short(uct_ep_h tl_ep, uint8_t id, uint64_t header,
                        total_length, "RX: AM_SHORT");
     status = uct_iface_invoke_am(&self_iface->super, id, p_data, total_length,
                                  UCT_CB_FLAG_DESC);
+    uct_self_ep_am_wakeup(self_iface);
 
     if (ucs_unlikely(UCS_INPROGRESS == status)) {
         uct_self_ep_am_reserve_buffer(self_iface, desc);
@@ -122,6 +137,7 @@ ssize_t uct_self_ep_am_bcopy(uct_ep_h tl_ep, uint8_t id,
                        length, "RX: AM_BCOPY");
     status = uct_iface_invoke_am(&self_iface->super, id, payload, length,
                                  UCT_CB_FLAG_DESC);
+    uct_self_ep_am_wakeup(self_iface);
 
     if (ucs_unlikely(UCS_INPROGRESS == status)) {
         uct_self_ep_am_reserve_buffer(self_iface, desc);
@@ -8,6 +8,7 @@
 #include "self_ep.h"
 
 #include <uct/sm/base/sm_ep.h>
+#include <uct/sm/base/sm_iface.h>
 #include <ucs/type/class.h>
 #include <ucs/sys/string.h>
 
@@ -50,6 +51,7 @@ static ucs_status_t uct_self_iface_query(uct_iface_h iface, uct_iface_attr_t *at
                                    UCT_IFACE_FLAG_ATOMIC_CPU       |
                                    UCT_IFACE_FLAG_PENDING          |
                                    UCT_IFACE_FLAG_AM_CB_SYNC       |
+                                   UCT_IFACE_FLAG_WAKEUP           |
                                    UCT_IFACE_FLAG_EP_CHECK;
 
     attr->cap.put.max_short       = UINT_MAX;
@@ -117,6 +119,64 @@ static void uct_self_iface_release_desc(uct_recv_desc_t *self, void *desc)
     ucs_mpool_put(self_desc);
 }
 
+/* The messages are delivered by the sender, so the receiver never has
+ * unprocessed events. The wakeup pipe tells a waiting thread about messages
+ * which were delivered while it was waiting. */
+static ucs_status_t uct_self_iface_wakeup_open(uct_iface_h iface, unsigned events,
+                                               uct_wakeup_h wakeup)
+{
+    uct_self_iface_t *self_iface = ucs_derived_of(iface, uct_self_iface_t);
+    ucs_status_t status;
+
+    if (self_iface->wakeup_pipe.read_fd != -1) {
+        ucs_error("self iface %p already has a wakeup handle", iface);
+        return UCS_ERR_ALREADY_EXISTS;
+    }
+
+    status = ucs_async_pipe_create(&self_iface->wakeup_pipe);
+    if (status != UCS_OK) {
+        self_iface->wakeup_pipe.read_fd = -1;
+        return status;
+    }
+
+    self_iface->wakeup_armed = 0;
+    wakeup->fd               = ucs_async_pipe_rfd(&self_iface->wakeup_pipe);
+    return UCS_OK;
+}
+
+static ucs_status_t uct_self_iface_wakeup_arm(uct_wakeup_h wakeup)
+{
+    uct_self_iface_t *self_iface = ucs_derived_of(wakeup->iface, uct_self_iface_t);
+    ucs_status_t status;
+
+    status = uct_sm_iface_wakeup_drain(wakeup->fd);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    if (wakeup->events & (UCT_WAKEUP_RX_AM | UCT_WAKEUP_RX_SIGNALED_AM)) {
+        self_iface->wakeup_armed = 1;
+    }
+    return UCS_OK;
+}
+
+static ucs_status_t uct_self_iface_wakeup_signal(uct_wakeup_h wakeup)
+{
+    uct_self_iface_t *self_iface = ucs_derived_of(wakeup->iface, uct_self_iface_t);
+
+    ucs_async_pipe_push(&self_iface->wakeup_pipe);
+    return UCS_OK;
+}
+
+static void uct_self_iface_wakeup_close(uct_wakeup_h wakeup)
+{
+    uct_self_iface_t *self_iface = ucs_derived_of(wakeup->iface, uct_self_iface_t);
+
+    self_iface->wakeup_armed = 0;
+    ucs_async_pipe_destroy(&self_iface->wakeup_pipe);
+    self_iface->wakeup_pipe.read_fd = -1;
+}
+
 static UCS_CLASS_DEFINE_DELETE_FUNC(uct_self_iface_t, uct_iface_t);
 
 static uct_iface_ops_t uct_self_iface_ops = {
@@ -125,6 +185,12 @@ static uct_iface_ops_t uct_self_iface_ops = {
     .iface_get_address        = uct_self_iface_get_address,
     .iface_query              = uct_self_iface_query,
     .iface_is_reachable       = uct_self_iface_is_reachable,
+    .iface_wakeup_open        = uct_self_iface_wakeup_open,
+    .iface_wakeup_get_fd      = uct_sm_iface_wakeup_get_fd,
+    .iface_wakeup_arm         = uct_self_iface_wakeup_arm,
+    .iface_wakeup_wait        = uct_sm_iface_wakeup_wait,
+    .iface_wakeup_signal      = uct_self_iface_wakeup_signal,
+    .iface_wakeup_close       = uct_self_iface_wakeup_close,
     .ep_create_connected      = UCS_CLASS_NEW_FUNC_NAME(uct_self_ep_t),
     .ep_destroy               = UCS_CLASS_DELETE_FUNC_NAME(uct_self_ep_t),
     .ep_am_short              = uct_self_ep_am_short,
@@ -166,10 +232,12 @@ static UCS_CLASS_INIT_FUNC(uct_self_iface_t, uct_md_h md, uct_worker_h worker,
 
     self_config = ucs_derived_of(tl_config, uct_self_iface_config_t);
 
-    self->id              = ucs_generate_uuid((uintptr_t)self);
-    self->rx_headroom     = params->rx_headroom;
-    self->data_length     = self_config->super.max_bcopy;
-    self->release_desc.cb = uct_self_iface_release_desc;
+    self->id                  = ucs_generate_uuid((uintptr_t)self);
+    self->rx_headroom         = params->rx_headroom;
+    self->data_length         = self_config->super.max_bcopy;
+    self->release_desc.cb     = uct_self_iface_release_desc;
+    self->wakeup_pipe.read_fd = -1;
+    self->wakeup_armed        = 0;
 
     /* create a memory pool for data transferred */
     status = uct_iface_mpool_init(&self->super,
@@ -9,6 +9,7 @@
 
 #include <uct/base/uct_iface.h>
 #include <ucs/arch/cpu.h>
+#include <ucs/async/pipe.h>
 
 typedef uint64_t uct_self_iface_addr_t;
 
@@ -20,6 +21,8 @@ typedef struct uct_self_iface {
     uct_recv_desc_t       *msg_cur_desc; /* Current message descriptor to use */
     uct_recv_desc_t       release_desc; /* Callback to desc release func */
     ucs_mpool_t           msg_desc_mp;  /* Messages memory pool */
+    ucs_async_pipe_t      wakeup_pipe;  /* Signaled on receive, while armed */
+    volatile uint32_t     wakeup_armed; /* A wakeup handle waits for receives */
 } UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE) uct_self_iface_t;
 
 typedef struct uct_self_iface_config {
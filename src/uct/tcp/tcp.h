@@ -6,16 +6,240 @@
 #ifndef UCT_TCP_MD_H
 #define UCT_TCP_MD_H
 
+#include <uct/base/uct_iface.h>
 #include <uct/base/uct_md.h>
+#include <ucs/datastruct/arbiter.h>
 #include <ucs/datastruct/khash.h>
+#include <ucs/datastruct/list.h>
+#include <ucs/datastruct/queue.h>
+#include <ucs/type/spinlock.h>
 #include <net/if.h>
+#include <sys/uio.h>
 
-#define UCT_TCP_NAME "tcp"
+#define UCT_TCP_NAME                  "tcp"
+
+/* Maximal number of iov elements in am_zcopy, besides the frame and AM headers */
+#define UCT_TCP_EP_AM_ZCOPY_MAX_IOV   8
+#define UCT_TCP_IFACE_RX_MAX_FRAMES   16 /* Max. frames dispatched per progress */
+#define UCT_TCP_IFACE_MAX_EVENTS      16 /* Max. epoll events per progress */
+
+
+/**
+ * Frame types used by the RMA and atomic protocol. They follow the user active
+ * message IDs, and are handled by the transport itself.
+ */
+enum {
+    UCT_TCP_AM_ID_PUT = UCT_AM_ID_MAX, /* Write data to remote memory */
+    UCT_TCP_AM_ID_GET_REQ,             /* Read remote memory, expects a reply */
+    UCT_TCP_AM_ID_ATOMIC_REQ,          /* Atomic operation, a reply is expected
+                                          unless it is a non-fetching add */
+    UCT_TCP_AM_ID_FLUSH_REQ,           /* Reply after all previous requests are done */
+    UCT_TCP_AM_ID_REPLY                /* Reply to a request, sent back over the
+                                          same connection */
+};
+
+
+/**
+ * Interface address: the ports of the active message and RMA servers
+ */
+typedef struct uct_tcp_iface_addr {
+    in_port_t                     am_port;
+    in_port_t                     rma_port;
+} UCS_S_PACKED uct_tcp_iface_addr_t;
+
+
+/**
+ * Atomic operations executed by the target
+ */
+enum {
+    UCT_TCP_ATOMIC_OP_ADD,
+    UCT_TCP_ATOMIC_OP_FADD,
+    UCT_TCP_ATOMIC_OP_SWAP,
+    UCT_TCP_ATOMIC_OP_CSWAP
+};
+
+
+/**
+ * Types of requests which wait for a reply from the target
+ */
+typedef enum {
+    UCT_TCP_EP_REQ_GET_BCOPY,
+    UCT_TCP_EP_REQ_GET_ZCOPY,
+    UCT_TCP_EP_REQ_ATOMIC,
+    UCT_TCP_EP_REQ_FLUSH
+} uct_tcp_ep_req_type_t;
 
 
-/** Hash of fd->rsock */
 typedef struct uct_tcp_recv_sock uct_tcp_recv_sock_t;
-KHASH_MAP_INIT_INT64(uct_tcp_fd_hash, uct_tcp_recv_sock_t*);
+struct uct_tcp_iface;
+
+
+/**
+ * Header of an active message frame on the wire
+ */
+typedef struct uct_tcp_am_hdr {
+    uint8_t                       am_id;          /* Active message ID */
+    uint32_t                      length;         /* Length of the payload */
+} UCS_S_PACKED uct_tcp_am_hdr_t;
+
+
+/**
+ * Header of a put frame, followed by the data
+ */
+typedef struct uct_tcp_put_hdr {
+    uint64_t                      address;        /* Remote address to write to */
+    uint64_t                      rkey_id;        /* Registration id of the region */
+} UCS_S_PACKED uct_tcp_put_hdr_t;
+
+
+/**
+ * Get request, the reply carries the data
+ */
+typedef struct uct_tcp_get_hdr {
+    uint64_t                      address;        /* Remote address to read from */
+    uint64_t                      rkey_id;        /* Registration id of the region */
+    uint32_t                      length;         /* How many bytes to read */
+} UCS_S_PACKED uct_tcp_get_hdr_t;
+
+
+/**
+ * Atomic request, the reply (if any) carries the previous remote value
+ */
+typedef struct uct_tcp_atomic_hdr {
+    uint64_t                      address;        /* Remote address of the operand */
+    uint64_t                      rkey_id;        /* Registration id of the region */
+    uint64_t                      value;          /* Add or swap value */
+    uint64_t                      compare;        /* Compare value, for cswap */
+    uint8_t                       opcode;         /* UCT_TCP_ATOMIC_OP_xx */
+    uint8_t                       size;           /* Operand size: 4 or 8 */
+} UCS_S_PACKED uct_tcp_atomic_hdr_t;
+
+
+/**
+ * Memory handle and packed remote key: the registered memory region. The
+ * requests carry the registration id, and the target executes them only inside
+ * the region which is registered with this id.
+ */
+typedef struct uct_tcp_key {
+    uint64_t                      address;        /* Region start address */
+    size_t                        length;         /* Region length */
+    uint64_t                      id;             /* Registration id, not reused
+                                                     by the md */
+} uct_tcp_key_t;
+
+
+/**
+ * Memory handle. The RMA target holds a reference while it accesses the region,
+ * and deregistration waits until the last access is done.
+ */
+typedef struct uct_tcp_memh {
+    uct_tcp_key_t                 key;            /* Registered region */
+    volatile uint32_t             refcount;       /* Requests accessing the region */
+} uct_tcp_memh_t;
+
+
+KHASH_MAP_INIT_INT64(uct_tcp_memh, uct_tcp_memh_t*);
+
+
+/**
+ * TCP memory domain
+ */
+typedef struct uct_tcp_md {
+    uct_md_t                      super;
+    ucs_spinlock_t                lock;           /* Protects memhs, which the RMA
+                                                     target looks up from async
+                                                     context */
+    khash_t(uct_tcp_memh)         memhs;          /* Registered regions by id */
+    uint64_t                      next_id;        /* Id of the next registration */
+} uct_tcp_md_t;
+
+
+/**
+ * TCP data buffer, used for sending and receiving frames. The frames are
+ * placed after the descriptor, at iface->config.rx_offset.
+ */
+typedef struct uct_tcp_am_desc {
+    uct_recv_desc_t               release;        /* Release callback, used when
+                                                     the user keeps a frame */
+} uct_tcp_am_desc_t;
+
+
+/**
+ * TCP receive socket wrapper. Incoming frames are parsed in place from the
+ * receive buffer; [offset, length) is the received but not yet dispatched data.
+ * Since the epoll set is edge-triggered, a socket stays on the ready list until
+ * it is drained.
+ */
+struct uct_tcp_recv_sock {
+    int                           fd;             /* Socket file descriptor */
+    int                           ready;          /* Whether on the ready list */
+    ucs_list_link_t               list;           /* Entry in iface->rx_ready_list */
+    uct_tcp_am_desc_t             *buf;           /* Current receive buffer */
+    size_t                        offset;         /* Start of unprocessed data */
+    size_t                        length;         /* End of received data */
+    struct uct_tcp_ep             *ep;            /* Endpoint which receives RMA
+                                                     replies on this socket, or
+                                                     NULL for accepted sockets */
+};
+
+
+/**
+ * Server side of an RMA connection. Requests are executed from the async
+ * context, so they complete even if the target does not call progress. While a
+ * reply is pending, the socket waits for POLLOUT and no more requests are
+ * executed.
+ */
+typedef struct uct_tcp_rma_sock {
+    struct uct_tcp_iface          *iface;         /* Owning interface */
+    int                           fd;             /* Socket file descriptor */
+    size_t                        length;         /* Received data in buf */
+    char                          *reply_buf;     /* Reply which the socket did
+                                                     not take, after buf */
+    size_t                        reply_offset;   /* Sent part of reply_buf */
+    size_t                        reply_length;   /* Length of the pending reply,
+                                                     0 if there is none */
+    ucs_list_link_t               list;           /* Entry in iface->rma_sock_list */
+    char                          buf[0];         /* Receive buffer */
+} uct_tcp_rma_sock_t;
+
+
+/**
+ * Send side of a connection. Only one frame may be partially sent; the rest of
+ * it is kept in the buffer and sent from progress.
+ */
+typedef struct uct_tcp_ep_tx {
+    int                           fd;             /* Socket file descriptor */
+    uct_tcp_am_desc_t             *buf;           /* Buffer for bcopy and partial sends */
+    size_t                        offset;         /* Offset of unsent data in buffer */
+    size_t                        length;         /* End of valid data in buffer */
+    ucs_status_t                  status;         /* Error of the connection,
+                                                     returned by later operations */
+} uct_tcp_ep_tx_t;
+
+
+/**
+ * Request which is waiting for a reply from the target. The target processes
+ * the requests of a connection in order, so replies arrive in the same order.
+ */
+typedef struct uct_tcp_ep_req {
+    ucs_queue_elem_t              queue;          /* Entry in ep->rma.reqs */
+    uct_tcp_ep_req_type_t         type;           /* Request type */
+    uct_completion_t              *comp;          /* User completion callback */
+    union {
+        struct {
+            uct_unpack_callback_t unpack_cb;
+            void                  *arg;
+        } get_bcopy;
+        struct {
+            struct iovec          iov[UCT_TCP_EP_AM_ZCOPY_MAX_IOV];
+            size_t                iovcnt;
+        } get_zcopy;
+        struct {
+            void                  *result;
+            uint8_t               size;
+        } atomic;
+    };
+} uct_tcp_ep_req_t;
 
 
 /**
@@ -23,7 +247,21 @@ KHASH_MAP_INIT_INT64(uct_tcp_fd_hash, uct_tcp_recv_sock_t*);
  */
 typedef struct uct_tcp_ep {
     uct_base_ep_t                 super;
-    int                           fd;             /* Socket file descriptor */
+    uct_tcp_ep_tx_t               tx;             /* Active messages connection */
+    ucs_arbiter_group_t           arb_group;      /* Pending requests */
+    int                           in_pending;     /* Sending from pending dispatch */
+    ucs_list_link_t               list;           /* Entry in iface list of endpoints
+                                                     with unsent data */
+    struct {
+        struct sockaddr_in        dest_addr;      /* Address of the RMA server */
+        uct_tcp_ep_tx_t           tx;             /* RMA connection, established
+                                                     on first use */
+        uct_tcp_recv_sock_t       rx;             /* Receives replies to requests */
+        ucs_queue_head_t          reqs;           /* Requests waiting for a reply */
+        int                       unacked;        /* Writes were sent after the
+                                                     last flush request */
+    } rma;
+    ucs_list_link_t               iface_list;     /* Entry in iface->ep_list */
 } uct_tcp_ep_t;
 
 
@@ -33,17 +271,37 @@ typedef struct uct_tcp_ep {
 typedef struct uct_tcp_iface {
     uct_base_iface_t              super;          /* Parent class */
     ucs_mpool_t                   mp;             /* Memory pool for TX/RX buffers */
+    ucs_mpool_t                   rx_mp;          /* Memory pool for RX buffers */
+    ucs_mpool_t                   req_mp;         /* Memory pool for requests
+                                                     waiting for a reply */
     int                           listen_fd;      /* Server socket */
-    khash_t(uct_tcp_fd_hash)      fd_hash;        /* Hash table of all FDs */
+    int                           rma_listen_fd;  /* RMA server socket */
+    ucs_list_link_t               rma_sock_list;  /* Accepted RMA connections */
+    int                           epfd;           /* Edge-triggered epoll set of
+                                                     the receive sockets */
+    uct_tcp_recv_sock_t           **rsocks;       /* Receive sockets, indexed by fd */
+    int                           rsocks_length;  /* Size of rsocks array */
+    ucs_list_link_t               rx_ready_list;  /* Receive sockets which may have
+                                                     more data or frames to process */
+    uct_tcp_am_desc_t             *rx_spare_buf;  /* Receive buffer to switch to
+                                                     when the user keeps a frame */
     char                          if_name[IFNAMSIZ];/* Network interface name */
+    ucs_arbiter_t                 arbiter;        /* Pending operations arbiter */
+    ucs_list_link_t               tx_ep_list;     /* Endpoints with unsent data */
+    ucs_list_link_t               ep_list;        /* All endpoints */
 
     struct {
         struct sockaddr_in        ifaddr;         /* Network address */
+        in_port_t                 rma_port;       /* Port of the RMA server */
         struct sockaddr_in        netmask;        /* Network address mask */
         size_t                    max_bcopy;      /* Maximal bcopy size */
         int                       prefer_default; /* prefer default gateway */
-        ptrdiff_t                 am_hdr_offset;  /* offset to receive header */
-        ptrdiff_t                 headroom_offset;/* offset to receive headroom */
+        size_t                    rx_headroom;    /* User receive headroom */
+        ptrdiff_t                 rx_offset;      /* Offset of the first frame in
+                                                     a data buffer */
+        size_t                    seg_size;       /* Maximal frame size, including
+                                                     the frame header */
+        size_t                    rx_buf_size;    /* Size of a receive buffer */
     } config;
 
     struct {
@@ -60,16 +318,10 @@ typedef struct uct_tcp_iface_config {
     int                           prefer_default;
     unsigned                      backlog;
     int                           sockopt_nodelay;
+    size_t                        rx_buf_size;
 } uct_tcp_iface_config_t;
 
 
-/**
- * TCP receive socket wrapper/
- */
-struct uct_tcp_recv_sock {
-};
-
-
 extern uct_md_component_t uct_tcp_md;
 extern const char *uct_tcp_address_type_names[];
 
@@ -77,6 +329,10 @@ ucs_status_t uct_tcp_socket_create(int *fd_p);
 
 ucs_status_t uct_tcp_socket_connect(int fd, const struct sockaddr_in *dest_addr);
 
+ssize_t uct_tcp_socket_sendv(int fd, struct iovec *iov, int iovcnt);
+
+ssize_t uct_tcp_socket_recv(int fd, void *data, size_t length);
+
 int uct_tcp_netif_check(const char *if_name);
 
 ucs_status_t uct_tcp_netif_caps(const char *if_name, double *latency_p,
@@ -91,8 +347,103 @@ ucs_status_t uct_tcp_iface_set_sockopt(uct_tcp_iface_t *iface, int fd);
 
 ucs_status_t uct_tcp_iface_connection_accepted(uct_tcp_iface_t *iface, int fd);
 
+ucs_status_t uct_tcp_iface_recv_sock_init(uct_tcp_iface_t *iface,
+                                          uct_tcp_recv_sock_t *rsock, int fd,
+                                          uct_tcp_ep_t *ep);
+
+void uct_tcp_iface_recv_sock_cleanup(uct_tcp_iface_t *iface,
+                                     uct_tcp_recv_sock_t *rsock);
+
+void uct_tcp_iface_rma_connect_handler(int fd, void *arg);
+
+void uct_tcp_iface_rma_cleanup(uct_tcp_iface_t *iface);
+
 void uct_tcp_iface_recv_cleanup(uct_tcp_iface_t *iface);
 
+unsigned uct_tcp_iface_recv_progress(uct_tcp_iface_t *iface);
+
+void uct_tcp_iface_progress(void *arg);
+
+ucs_status_t uct_tcp_ep_am_short(uct_ep_h tl_ep, uint8_t am_id, uint64_t header,
+                                 const void *payload, unsigned length);
+
+ssize_t uct_tcp_ep_am_bcopy(uct_ep_h tl_ep, uint8_t am_id,
+                            uct_pack_callback_t pack_cb, void *arg);
+
+ucs_status_t uct_tcp_ep_am_zcopy(uct_ep_h tl_ep, uint8_t am_id, const void *header,
+                                 unsigned header_length, const uct_iov_t *iov,
+                                 size_t iovcnt, uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_put_short(uct_ep_h tl_ep, const void *buffer,
+                                  unsigned length, uint64_t remote_addr,
+                                  uct_rkey_t rkey);
+
+ssize_t uct_tcp_ep_put_bcopy(uct_ep_h tl_ep, uct_pack_callback_t pack_cb,
+                             void *arg, uint64_t remote_addr, uct_rkey_t rkey);
+
+ucs_status_t uct_tcp_ep_put_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov,
+                                  size_t iovcnt, uint64_t remote_addr,
+                                  uct_rkey_t rkey, uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_get_bcopy(uct_ep_h tl_ep, uct_unpack_callback_t unpack_cb,
+                                  void *arg, size_t length, uint64_t remote_addr,
+                                  uct_rkey_t rkey, uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_get_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov,
+                                  size_t iovcnt, uint64_t remote_addr,
+                                  uct_rkey_t rkey, uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_atomic_add64(uct_ep_h tl_ep, uint64_t add,
+                                     uint64_t remote_addr, uct_rkey_t rkey);
+
+ucs_status_t uct_tcp_ep_atomic_fadd64(uct_ep_h tl_ep, uint64_t add,
+                                      uint64_t remote_addr, uct_rkey_t rkey,
+                                      uint64_t *result, uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_atomic_swap64(uct_ep_h tl_ep, uint64_t swap,
+                                      uint64_t remote_addr, uct_rkey_t rkey,
+                                      uint64_t *result, uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_atomic_cswap64(uct_ep_h tl_ep, uint64_t compare,
+                                       uint64_t swap, uint64_t remote_addr,
+                                       uct_rkey_t rkey, uint64_t *result,
+                                       uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_atomic_add32(uct_ep_h tl_ep, uint32_t add,
+                                     uint64_t remote_addr, uct_rkey_t rkey);
+
+ucs_status_t uct_tcp_ep_atomic_fadd32(uct_ep_h tl_ep, uint32_t add,
+                                      uint64_t remote_addr, uct_rkey_t rkey,
+                                      uint32_t *result, uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_atomic_swap32(uct_ep_h tl_ep, uint32_t swap,
+                                      uint64_t remote_addr, uct_rkey_t rkey,
+                                      uint32_t *result, uct_completion_t *comp);
+
+ucs_status_t uct_tcp_ep_atomic_cswap32(uct_ep_h tl_ep, uint32_t compare,
+                                       uint32_t swap, uint64_t remote_addr,
+                                       uct_rkey_t rkey, uint32_t *result,
+                                       uct_completion_t *comp);
+
+void uct_tcp_ep_rma_failed(uct_tcp_ep_t *ep, ucs_status_t status);
+
+ucs_status_t uct_tcp_ep_handle_reply(uct_tcp_ep_t *ep, const void *data,
+                                     unsigned length);
+
+ucs_status_t uct_tcp_ep_pending_add(uct_ep_h tl_ep, uct_pending_req_t *req);
+
+void uct_tcp_ep_pending_purge(uct_ep_h tl_ep, uct_pending_purge_callback_t cb,
+                              void *arg);
+
+ucs_status_t uct_tcp_ep_flush(uct_ep_h tl_ep, unsigned flags,
+                              uct_completion_t *comp);
+
+void uct_tcp_ep_progress_tx(uct_tcp_ep_t *ep);
+
+ucs_arbiter_cb_result_t uct_tcp_ep_process_pending(ucs_arbiter_t *arbiter,
+                                                   ucs_arbiter_elem_t *elem,
+                                                   void *arg);
+
 UCS_CLASS_DECLARE_NEW_FUNC(uct_tcp_ep_t, uct_ep_t, uct_iface_t *,
                            const uct_device_addr_t *, const uct_iface_addr_t *);
 UCS_CLASS_DECLARE_DELETE_FUNC(uct_tcp_ep_t, uct_ep_t);
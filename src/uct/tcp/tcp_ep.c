@@ -8,53 +8,1083 @@
 #include <ucs/async/async.h>
 
 
-static UCS_CLASS_INIT_FUNC(uct_tcp_ep_t, uct_iface_t *tl_iface,
-                           const uct_device_addr_t *dev_addr,
-                           const uct_iface_addr_t *iface_addr)
+static void uct_tcp_ep_tx_init(uct_tcp_ep_tx_t *tx, int fd)
 {
-    uct_tcp_iface_t *iface = ucs_derived_of(tl_iface, uct_tcp_iface_t);
-    struct sockaddr_in dest_addr;
-    ucs_status_t status;
+    tx->fd     = fd;
+    tx->buf    = NULL;
+    tx->offset = 0;
+    tx->length = 0;
+    tx->status = UCS_OK;
+}
 
-    UCS_CLASS_CALL_SUPER_INIT(uct_base_ep_t, &iface->super)
+static ucs_status_t uct_tcp_ep_connect(uct_tcp_iface_t *iface,
+                                       const struct sockaddr_in *dest_addr,
+                                       int *fd_p)
+{
+    ucs_status_t status;
+    int fd;
 
-    status = uct_tcp_socket_create(&self->fd);
+    status = uct_tcp_socket_create(&fd);
     if (status != UCS_OK) {
         goto err;
     }
 
-    status = uct_tcp_iface_set_sockopt(iface, self->fd);
+    status = uct_tcp_iface_set_sockopt(iface, fd);
     if (status != UCS_OK) {
         goto err_close;
     }
 
-    memset(&dest_addr, 0, sizeof(dest_addr));
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port   = *(in_port_t*)iface_addr;
-    dest_addr.sin_addr   = *(struct in_addr*)dev_addr;
+    status = uct_tcp_socket_connect(fd, dest_addr);
+    if (status != UCS_OK) {
+        goto err_close;
+    }
 
-    status = uct_tcp_socket_connect(self->fd, &dest_addr);
+    /* Data is sent only from progress context, and must never block it */
+    status = ucs_sys_fcntl_modfl(fd, O_NONBLOCK, 0);
     if (status != UCS_OK) {
         goto err_close;
     }
 
-    ucs_debug("connected to %s:%d", inet_ntoa(dest_addr.sin_addr),
-              ntohs(dest_addr.sin_port));
+    ucs_debug("connected to %s:%d", inet_ntoa(dest_addr->sin_addr),
+              ntohs(dest_addr->sin_port));
+    *fd_p = fd;
     return UCS_OK;
 
 err_close:
-    close(self->fd);
+    close(fd);
 err:
     return status;
 }
 
+static UCS_CLASS_INIT_FUNC(uct_tcp_ep_t, uct_iface_t *tl_iface,
+                           const uct_device_addr_t *dev_addr,
+                           const uct_iface_addr_t *iface_addr)
+{
+    uct_tcp_iface_t *iface                = ucs_derived_of(tl_iface, uct_tcp_iface_t);
+    const uct_tcp_iface_addr_t *tcp_addr  = (const uct_tcp_iface_addr_t*)iface_addr;
+    struct sockaddr_in dest_addr;
+    ucs_status_t status;
+    int fd;
+
+    UCS_CLASS_CALL_SUPER_INIT(uct_base_ep_t, &iface->super)
+
+    memset(&dest_addr, 0, sizeof(dest_addr));
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port   = tcp_addr->am_port;
+    dest_addr.sin_addr   = *(struct in_addr*)dev_addr;
+
+    status = uct_tcp_ep_connect(iface, &dest_addr, &fd);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    uct_tcp_ep_tx_init(&self->tx, fd);
+    ucs_arbiter_group_init(&self->arb_group);
+    self->in_pending = 0;
+    ucs_list_head_init(&self->list);
+
+    /* The RMA connection is established by the first RMA operation */
+    self->rma.dest_addr          = dest_addr;
+    self->rma.dest_addr.sin_port = tcp_addr->rma_port;
+    uct_tcp_ep_tx_init(&self->rma.tx, -1);
+    ucs_queue_head_init(&self->rma.reqs);
+    self->rma.unacked            = 0;
+
+    ucs_list_add_tail(&iface->ep_list, &self->iface_list);
+    return UCS_OK;
+}
+
+static void uct_tcp_ep_tx_cleanup(uct_tcp_ep_t *ep, uct_tcp_ep_tx_t *tx)
+{
+    if (tx->length > tx->offset) {
+        ucs_debug("tcp ep %p: dropping %zu unsent bytes on fd %d", ep,
+                  tx->length - tx->offset, tx->fd);
+    }
+
+    if (tx->buf != NULL) {
+        ucs_mpool_put(tx->buf);
+    }
+
+    close(tx->fd);
+}
+
+static UCS_F_ALWAYS_INLINE int uct_tcp_ep_tx_has_unsent_data(uct_tcp_ep_tx_t *tx)
+{
+    /* the data of a failed connection stays in the buffer, but it would not
+     * be sent anymore */
+    return (tx->length > tx->offset) && (tx->status == UCS_OK);
+}
+
+static UCS_F_ALWAYS_INLINE int uct_tcp_ep_has_unsent_data(uct_tcp_ep_t *ep)
+{
+    return uct_tcp_ep_tx_has_unsent_data(&ep->tx) ||
+           uct_tcp_ep_tx_has_unsent_data(&ep->rma.tx);
+}
+
 static UCS_CLASS_CLEANUP_FUNC(uct_tcp_ep_t)
 {
+    uct_tcp_iface_t *iface = ucs_derived_of(self->super.super.iface,
+                                            uct_tcp_iface_t);
+    uct_tcp_ep_req_t *req;
+
     ucs_trace_func("self=%p", self);
-    close(self->fd);
+
+    uct_tcp_ep_pending_purge(&self->super.super, NULL, NULL);
+    ucs_list_del(&self->iface_list);
+
+    if (uct_tcp_ep_has_unsent_data(self)) {
+        ucs_list_del(&self->list);
+    }
+
+    if (self->rma.tx.fd >= 0) {
+        ucs_queue_for_each_extract(req, &self->rma.reqs, queue, 1) {
+            ucs_debug("tcp ep %p: dropping request %p waiting for reply", self,
+                      req);
+            ucs_mpool_put(req);
+        }
+        uct_tcp_iface_recv_sock_cleanup(iface, &self->rma.rx);
+        uct_tcp_ep_tx_cleanup(self, &self->rma.tx);
+    }
+
+    ucs_arbiter_group_cleanup(&self->arb_group);
+    uct_tcp_ep_tx_cleanup(self, &self->tx);
 }
 
 UCS_CLASS_DEFINE(uct_tcp_ep_t, uct_base_ep_t);
 UCS_CLASS_DEFINE_NEW_FUNC(uct_tcp_ep_t, uct_ep_t, uct_iface_t *,
                           const uct_device_addr_t *, const uct_iface_addr_t *);
 UCS_CLASS_DEFINE_DELETE_FUNC(uct_tcp_ep_t, uct_ep_t);
+
+
+static inline ucs_status_t uct_tcp_ep_get_tx_buf(uct_tcp_iface_t *iface,
+                                                 uct_tcp_ep_tx_t *tx)
+{
+    if (ucs_likely(tx->buf != NULL)) {
+        return UCS_OK;
+    }
+
+    UCT_TL_IFACE_GET_TX_DESC(&iface->super, &iface->mp, tx->buf,
+                             return UCS_ERR_NO_RESOURCE);
+    return UCS_OK;
+}
+
+static void uct_tcp_ep_tx_progress(uct_tcp_ep_t *ep, uct_tcp_ep_tx_t *tx)
+{
+    struct iovec iov;
+    ssize_t ret;
+
+    iov.iov_base = (void*)(tx->buf + 1) + tx->offset;
+    iov.iov_len  = tx->length - tx->offset;
+
+    ret = uct_tcp_socket_sendv(tx->fd, &iov, 1);
+    if (ucs_unlikely(ret < 0)) {
+        /* The connection is broken, no point in retrying. The operations which
+         * were already reported as sent are lost, so fail the following ones */
+        ucs_error("tcp ep %p: failed to send %zu buffered bytes on fd %d: %s",
+                  ep, tx->length - tx->offset, tx->fd,
+                  ucs_status_string((ucs_status_t)ret));
+        tx->status = (ucs_status_t)ret;
+        return;
+    }
+
+    tx->offset += ret;
+    if (tx->offset == tx->length) {
+        ucs_trace_data("tcp fd %d: sent all buffered data", tx->fd);
+        tx->offset = tx->length = 0;
+    }
+}
+
+void uct_tcp_ep_progress_tx(uct_tcp_ep_t *ep)
+{
+    ucs_assert(uct_tcp_ep_has_unsent_data(ep));
+
+    if (uct_tcp_ep_tx_has_unsent_data(&ep->tx)) {
+        uct_tcp_ep_tx_progress(ep, &ep->tx);
+    }
+    if (uct_tcp_ep_tx_has_unsent_data(&ep->rma.tx)) {
+        uct_tcp_ep_tx_progress(ep, &ep->rma.tx);
+    }
+
+    if (!uct_tcp_ep_has_unsent_data(ep)) {
+        ucs_list_del(&ep->list);
+    }
+}
+
+/**
+ * Save the part of the frame which was not sent by the socket, so it would be
+ * sent from progress, and the caller's buffers could be released immediately.
+ * The send buffer is reserved by uct_tcp_ep_check_tx_resources(), since once
+ * part of the frame is on the stream the operation can't be retried.
+ */
+static void uct_tcp_ep_buffer_unsent(uct_tcp_iface_t *iface, uct_tcp_ep_t *ep,
+                                     uct_tcp_ep_tx_t *tx,
+                                     const struct iovec *iov, int iovcnt,
+                                     size_t sent)
+{
+    size_t skip, length;
+    void *dst;
+    int i;
+
+    ucs_assert(tx->buf != NULL);
+
+    dst = (void*)(tx->buf + 1);
+    for (i = 0; i < iovcnt; ++i) {
+        if (sent >= iov[i].iov_len) {
+            sent -= iov[i].iov_len;
+            continue;
+        }
+
+        skip   = sent;
+        length = iov[i].iov_len - skip;
+        if (dst + length != iov[i].iov_base + skip) {
+            memmove(dst, iov[i].iov_base + skip, length);
+        }
+        dst  += length;
+        sent  = 0;
+    }
+
+    if (!uct_tcp_ep_has_unsent_data(ep)) {
+        ucs_list_add_tail(&iface->tx_ep_list, &ep->list);
+    }
+
+    tx->offset = 0;
+    tx->length = dst - (void*)(tx->buf + 1);
+    ucs_assert(tx->length <= iface->config.seg_size);
+}
+
+static UCS_F_ALWAYS_INLINE ucs_status_t
+uct_tcp_ep_check_tx_resources(uct_tcp_iface_t *iface, uct_tcp_ep_t *ep,
+                              uct_tcp_ep_tx_t *tx)
+{
+    if (ucs_unlikely(!ucs_arbiter_group_is_empty(&ep->arb_group) &&
+                     !ep->in_pending)) {
+        /* pending isn't empty. don't send now to prevent out-of-order sending */
+        UCS_STATS_UPDATE_COUNTER(ep->super.stats, UCT_EP_STAT_NO_RES, 1);
+        return UCS_ERR_NO_RESOURCE;
+    }
+
+    if (ucs_unlikely(uct_tcp_ep_tx_has_unsent_data(tx))) {
+        /* only one frame may be partially sent, try to complete it now */
+        uct_tcp_ep_progress_tx(ep);
+        if (uct_tcp_ep_tx_has_unsent_data(tx)) {
+            UCS_STATS_UPDATE_COUNTER(ep->super.stats, UCT_EP_STAT_NO_RES, 1);
+            return UCS_ERR_NO_RESOURCE;
+        }
+    }
+
+    if (ucs_unlikely(tx->status != UCS_OK)) {
+        return tx->status;
+    }
+
+    /* The remainder of a partially sent frame must be buffered, so get the
+     * buffer before anything is written to the stream */
+    return uct_tcp_ep_get_tx_buf(iface, tx);
+}
+
+static UCS_F_ALWAYS_INLINE ucs_status_t
+uct_tcp_ep_sendv(uct_tcp_iface_t *iface, uct_tcp_ep_t *ep, uct_tcp_ep_tx_t *tx,
+                 const struct iovec *iov, int iovcnt, size_t total_length)
+{
+    ssize_t ret;
+
+    ret = uct_tcp_socket_sendv(tx->fd, (struct iovec*)iov, iovcnt);
+    if (ucs_unlikely(ret < 0)) {
+        tx->status = (ucs_status_t)ret;
+        return tx->status;
+    }
+
+    if (ucs_likely(ret == total_length)) {
+        return UCS_OK;
+    }
+
+    uct_tcp_ep_buffer_unsent(iface, ep, tx, iov, iovcnt, ret);
+    return UCS_OK;
+}
+
+ucs_status_t uct_tcp_ep_am_short(uct_ep_h tl_ep, uint8_t am_id, uint64_t header,
+                                 const void *payload, unsigned length)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_tcp_am_hdr_t hdr;
+    struct iovec iov[3];
+    ucs_status_t status;
+
+    UCT_CHECK_AM_ID(am_id);
+    UCT_CHECK_LENGTH(length + sizeof(header), 0,
+                     iface->config.seg_size - sizeof(hdr), "am_short");
+
+    status = uct_tcp_ep_check_tx_resources(iface, ep, &ep->tx);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    hdr.am_id       = am_id;
+    hdr.length      = length + sizeof(header);
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len  = sizeof(hdr);
+    iov[1].iov_base = &header;
+    iov[1].iov_len  = sizeof(header);
+    iov[2].iov_base = (void*)payload;
+    iov[2].iov_len  = length;
+
+    status = uct_tcp_ep_sendv(iface, ep, &ep->tx, iov, 3,
+                              sizeof(hdr) + hdr.length);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    UCT_TL_EP_STAT_OP(&ep->super, AM, SHORT, hdr.length);
+    uct_iface_trace_am(&iface->super, UCT_AM_TRACE_TYPE_SEND, am_id, &header,
+                       sizeof(header), "TX: AM_SHORT [length %u]", hdr.length);
+    return UCS_OK;
+}
+
+ssize_t uct_tcp_ep_am_bcopy(uct_ep_h tl_ep, uint8_t am_id,
+                            uct_pack_callback_t pack_cb, void *arg)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_tcp_am_hdr_t *hdr;
+    ucs_status_t status;
+    struct iovec iov;
+    size_t length;
+
+    UCT_CHECK_AM_ID(am_id);
+
+    status = uct_tcp_ep_check_tx_resources(iface, ep, &ep->tx);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* The frame is packed directly into the send buffer, so if the socket
+     * accepts only part of it the rest is already in place. The buffer holds
+     * seg_size bytes, which is a header and max_bcopy of data. */
+    hdr         = (uct_tcp_am_hdr_t*)(ep->tx.buf + 1);
+    length      = pack_cb(hdr + 1, arg);
+    ucs_assertv(length <= iface->config.seg_size - sizeof(*hdr),
+                "am_bcopy packed %zu bytes, the limit is %zu", length,
+                iface->config.seg_size - sizeof(*hdr));
+    hdr->am_id  = am_id;
+    hdr->length = length;
+
+    iov.iov_base = hdr;
+    iov.iov_len  = sizeof(*hdr) + length;
+
+    status = uct_tcp_ep_sendv(iface, ep, &ep->tx, &iov, 1, iov.iov_len);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    UCT_TL_EP_STAT_OP(&ep->super, AM, BCOPY, length);
+    uct_iface_trace_am(&iface->super, UCT_AM_TRACE_TYPE_SEND, am_id, hdr + 1,
+                       length, "TX: AM_BCOPY");
+    return length;
+}
+
+ucs_status_t uct_tcp_ep_am_zcopy(uct_ep_h tl_ep, uint8_t am_id, const void *header,
+                                 unsigned header_length, const uct_iov_t *iov,
+                                 size_t iovcnt, uct_completion_t *comp)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    struct iovec io_vec[UCT_TCP_EP_AM_ZCOPY_MAX_IOV + 2];
+    uct_tcp_am_hdr_t hdr;
+    ucs_status_t status;
+    size_t iov_it;
+    int io_vec_cnt;
+
+    UCT_CHECK_AM_ID(am_id);
+    UCT_CHECK_IOV_SIZE(iovcnt, (size_t)UCT_TCP_EP_AM_ZCOPY_MAX_IOV,
+                       "uct_tcp_ep_am_zcopy");
+    UCT_CHECK_LENGTH(header_length + uct_iov_total_length(iov, iovcnt), 0,
+                     iface->config.seg_size - sizeof(hdr), "am_zcopy");
+
+    status = uct_tcp_ep_check_tx_resources(iface, ep, &ep->tx);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    hdr.am_id              = am_id;
+    hdr.length             = header_length;
+    io_vec[0].iov_base     = &hdr;
+    io_vec[0].iov_len      = sizeof(hdr);
+    io_vec[1].iov_base     = (void*)header;
+    io_vec[1].iov_len      = header_length;
+    io_vec_cnt             = 2;
+    for (iov_it = 0; iov_it < iovcnt; ++iov_it) {
+        io_vec[io_vec_cnt].iov_base = iov[iov_it].buffer;
+        io_vec[io_vec_cnt].iov_len  = uct_iov_get_length(&iov[iov_it]);
+        hdr.length                 += io_vec[io_vec_cnt].iov_len;
+        ++io_vec_cnt;
+    }
+
+    /* Whatever the socket did not take is copied to the send buffer, so the
+     * user buffers are always released when this function returns */
+    status = uct_tcp_ep_sendv(iface, ep, &ep->tx, io_vec, io_vec_cnt,
+                              sizeof(hdr) + hdr.length);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    UCT_TL_EP_STAT_OP(&ep->super, AM, ZCOPY, hdr.length);
+    uct_iface_trace_am(&iface->super, UCT_AM_TRACE_TYPE_SEND, am_id, header,
+                       header_length, "TX: AM_ZCOPY [length %u]", hdr.length);
+    return UCS_OK;
+}
+
+static ucs_status_t uct_tcp_ep_rma_connect(uct_tcp_iface_t *iface,
+                                           uct_tcp_ep_t *ep)
+{
+    ucs_status_t status;
+    int fd;
+
+    status = uct_tcp_ep_connect(iface, &ep->rma.dest_addr, &fd);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* Replies to the requests arrive on the same connection */
+    status = uct_tcp_iface_recv_sock_init(iface, &ep->rma.rx, fd, ep);
+    if (status != UCS_OK) {
+        close(fd);
+        return status;
+    }
+
+    ep->rma.tx.fd = fd;
+    return UCS_OK;
+}
+
+static UCS_F_ALWAYS_INLINE ucs_status_t
+uct_tcp_ep_check_rma_resources(uct_tcp_iface_t *iface, uct_tcp_ep_t *ep)
+{
+    ucs_status_t status;
+
+    if (ucs_unlikely(ep->rma.tx.status != UCS_OK)) {
+        return UCS_ERR_IO_ERROR;
+    }
+
+    if (ucs_unlikely(ep->rma.tx.fd < 0)) {
+        status = uct_tcp_ep_rma_connect(iface, ep);
+        if (status != UCS_OK) {
+            return status;
+        }
+    }
+
+    return uct_tcp_ep_check_tx_resources(iface, ep, &ep->rma.tx);
+}
+
+/**
+ * Send a frame on the RMA connection. The frame header is placed in iov[0].
+ */
+static ucs_status_t uct_tcp_ep_send_frame(uct_tcp_iface_t *iface,
+                                          uct_tcp_ep_t *ep, uint8_t am_id,
+                                          struct iovec *iov, int iovcnt)
+{
+    uct_tcp_am_hdr_t hdr;
+    int i;
+
+    hdr.am_id  = am_id;
+    hdr.length = 0;
+    for (i = 1; i < iovcnt; ++i) {
+        hdr.length += iov[i].iov_len;
+    }
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len  = sizeof(hdr);
+    return uct_tcp_ep_sendv(iface, ep, &ep->rma.tx, iov, iovcnt,
+                            sizeof(hdr) + hdr.length);
+}
+
+/**
+ * Return the registration id which the target checks the request against.
+ */
+static UCS_F_ALWAYS_INLINE uint64_t
+uct_tcp_ep_rkey_id(uct_rkey_t rkey, uint64_t remote_addr, size_t length)
+{
+    const uct_tcp_key_t *key = (const uct_tcp_key_t*)rkey;
+
+    ucs_assert(rkey != UCT_INVALID_RKEY);
+    ucs_assertv((remote_addr >= key->address) &&
+                (remote_addr + length <= key->address + key->length),
+                "remote_addr 0x%"PRIx64" length %zu is out of region "
+                "0x%"PRIx64"..0x%"PRIx64, remote_addr, length, key->address,
+                key->address + key->length);
+    return key->id;
+}
+
+/**
+ * Send a request which expects a reply, and add it to the list of outstanding
+ * requests. The caller fills the request specific fields.
+ */
+static ucs_status_t uct_tcp_ep_send_request(uct_tcp_iface_t *iface,
+                                            uct_tcp_ep_t *ep, uint8_t am_id,
+                                            struct iovec *iov, int iovcnt,
+                                            uct_tcp_ep_req_t *req,
+                                            uct_tcp_ep_req_type_t type,
+                                            uct_completion_t *comp)
+{
+    ucs_status_t status;
+
+    status = uct_tcp_ep_send_frame(iface, ep, am_id, iov, iovcnt);
+    if (status != UCS_OK) {
+        ucs_mpool_put(req);
+        return status;
+    }
+
+    req->type = type;
+    req->comp = comp;
+    ucs_queue_push(&ep->rma.reqs, &req->queue);
+    return UCS_INPROGRESS;
+}
+
+static UCS_F_ALWAYS_INLINE ucs_status_t
+uct_tcp_ep_get_req(uct_tcp_iface_t *iface, uct_tcp_ep_t *ep,
+                   uct_tcp_ep_req_t **req_p)
+{
+    ucs_status_t status;
+
+    status = uct_tcp_ep_check_rma_resources(iface, ep);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    *req_p = ucs_mpool_get(&iface->req_mp);
+    if (*req_p == NULL) {
+        return UCS_ERR_NO_RESOURCE;
+    }
+
+    return UCS_OK;
+}
+
+ucs_status_t uct_tcp_ep_put_short(uct_ep_h tl_ep, const void *buffer,
+                                  unsigned length, uint64_t remote_addr,
+                                  uct_rkey_t rkey)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_tcp_put_hdr_t put_hdr;
+    struct iovec iov[3];
+    ucs_status_t status;
+
+    UCT_CHECK_LENGTH(length, 0, iface->config.max_bcopy - sizeof(put_hdr),
+                     "put_short");
+    UCT_SKIP_ZERO_LENGTH(length);
+
+    status = uct_tcp_ep_check_rma_resources(iface, ep);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    put_hdr.address  = remote_addr;
+    put_hdr.rkey_id  = uct_tcp_ep_rkey_id(rkey, remote_addr, length);
+    iov[1].iov_base  = &put_hdr;
+    iov[1].iov_len   = sizeof(put_hdr);
+    iov[2].iov_base  = (void*)buffer;
+    iov[2].iov_len   = length;
+
+    status = uct_tcp_ep_send_frame(iface, ep, UCT_TCP_AM_ID_PUT, iov, 3);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    ep->rma.unacked = 1;
+    UCT_TL_EP_STAT_OP(&ep->super, PUT, SHORT, length);
+    ucs_trace_data("TX: PUT_SHORT [addr 0x%"PRIx64" length %u]", remote_addr,
+                   length);
+    return UCS_OK;
+}
+
+ssize_t uct_tcp_ep_put_bcopy(uct_ep_h tl_ep, uct_pack_callback_t pack_cb,
+                             void *arg, uint64_t remote_addr, uct_rkey_t rkey)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_tcp_put_hdr_t *put_hdr;
+    uct_tcp_am_hdr_t *hdr;
+    ucs_status_t status;
+    struct iovec iov;
+    size_t length;
+
+    status = uct_tcp_ep_check_rma_resources(iface, ep);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    hdr              = (uct_tcp_am_hdr_t*)(ep->rma.tx.buf + 1);
+    put_hdr          = (uct_tcp_put_hdr_t*)(hdr + 1);
+    length           = pack_cb(put_hdr + 1, arg);
+    ucs_assertv(length <= iface->config.max_bcopy - sizeof(*put_hdr),
+                "put_bcopy packed %zu bytes, the limit is %zu", length,
+                iface->config.max_bcopy - sizeof(*put_hdr));
+    UCT_SKIP_ZERO_LENGTH(length);
+    hdr->am_id       = UCT_TCP_AM_ID_PUT;
+    hdr->length      = sizeof(*put_hdr) + length;
+    put_hdr->address = remote_addr;
+    put_hdr->rkey_id = uct_tcp_ep_rkey_id(rkey, remote_addr, length);
+
+    iov.iov_base = hdr;
+    iov.iov_len  = sizeof(*hdr) + hdr->length;
+
+    status = uct_tcp_ep_sendv(iface, ep, &ep->rma.tx, &iov, 1, iov.iov_len);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    ep->rma.unacked = 1;
+    UCT_TL_EP_STAT_OP(&ep->super, PUT, BCOPY, length);
+    ucs_trace_data("TX: PUT_BCOPY [addr 0x%"PRIx64" length %zu]", remote_addr,
+                   length);
+    return length;
+}
+
+ucs_status_t uct_tcp_ep_put_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov,
+                                  size_t iovcnt, uint64_t remote_addr,
+                                  uct_rkey_t rkey, uct_completion_t *comp)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    struct iovec io_vec[UCT_TCP_EP_AM_ZCOPY_MAX_IOV + 2];
+    uct_tcp_put_hdr_t put_hdr;
+    ucs_status_t status;
+    size_t iov_it, length;
+
+    UCT_CHECK_IOV_SIZE(iovcnt, (size_t)UCT_TCP_EP_AM_ZCOPY_MAX_IOV,
+                       "uct_tcp_ep_put_zcopy");
+    length = uct_iov_total_length(iov, iovcnt);
+    UCT_CHECK_LENGTH(length, 0, iface->config.max_bcopy - sizeof(put_hdr),
+                     "put_zcopy");
+    UCT_SKIP_ZERO_LENGTH(length);
+
+    status = uct_tcp_ep_check_rma_resources(iface, ep);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    put_hdr.address    = remote_addr;
+    put_hdr.rkey_id    = uct_tcp_ep_rkey_id(rkey, remote_addr, length);
+    io_vec[1].iov_base = &put_hdr;
+    io_vec[1].iov_len  = sizeof(put_hdr);
+    for (iov_it = 0; iov_it < iovcnt; ++iov_it) {
+        io_vec[iov_it + 2].iov_base = iov[iov_it].buffer;
+        io_vec[iov_it + 2].iov_len  = uct_iov_get_length(&iov[iov_it]);
+    }
+
+    /* As with am_zcopy, unsent data is copied, so the operation is always
+     * completed locally */
+    status = uct_tcp_ep_send_frame(iface, ep, UCT_TCP_AM_ID_PUT, io_vec,
+                                   iovcnt + 2);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    ep->rma.unacked = 1;
+    UCT_TL_EP_STAT_OP(&ep->super, PUT, ZCOPY, length);
+    ucs_trace_data("TX: PUT_ZCOPY [addr 0x%"PRIx64" length %zu]", remote_addr,
+                   length);
+    return UCS_OK;
+}
+
+static ucs_status_t uct_tcp_ep_get(uct_tcp_iface_t *iface, uct_tcp_ep_t *ep,
+                                   uct_tcp_ep_req_t *req,
+                                   uct_tcp_ep_req_type_t type, size_t length,
+                                   uint64_t remote_addr, uct_rkey_t rkey,
+                                   uct_completion_t *comp)
+{
+    uct_tcp_get_hdr_t get_hdr;
+    struct iovec iov[2];
+
+    get_hdr.address = remote_addr;
+    get_hdr.rkey_id = uct_tcp_ep_rkey_id(rkey, remote_addr, length);
+    get_hdr.length  = length;
+    iov[1].iov_base = &get_hdr;
+    iov[1].iov_len  = sizeof(get_hdr);
+
+    return uct_tcp_ep_send_request(iface, ep, UCT_TCP_AM_ID_GET_REQ, iov, 2,
+                                   req, type, comp);
+}
+
+ucs_status_t uct_tcp_ep_get_bcopy(uct_ep_h tl_ep, uct_unpack_callback_t unpack_cb,
+                                  void *arg, size_t length, uint64_t remote_addr,
+                                  uct_rkey_t rkey, uct_completion_t *comp)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_tcp_ep_req_t *req;
+    ucs_status_t status;
+
+    UCT_CHECK_LENGTH(length, 0, iface->config.max_bcopy, "get_bcopy");
+    UCT_SKIP_ZERO_LENGTH(length);
+
+    status = uct_tcp_ep_get_req(iface, ep, &req);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    req->get_bcopy.unpack_cb = unpack_cb;
+    req->get_bcopy.arg       = arg;
+
+    status = uct_tcp_ep_get(iface, ep, req, UCT_TCP_EP_REQ_GET_BCOPY, length,
+                            remote_addr, rkey, comp);
+    UCT_TL_EP_STAT_OP_IF_SUCCESS(status, &ep->super, GET, BCOPY, length);
+    ucs_trace_data("TX: GET_BCOPY [addr 0x%"PRIx64" length %zu]", remote_addr,
+                   length);
+    return status;
+}
+
+ucs_status_t uct_tcp_ep_get_zcopy(uct_ep_h tl_ep, const uct_iov_t *iov,
+                                  size_t iovcnt, uint64_t remote_addr,
+                                  uct_rkey_t rkey, uct_completion_t *comp)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_tcp_ep_req_t *req;
+    ucs_status_t status;
+    size_t iov_it, length;
+
+    UCT_CHECK_IOV_SIZE(iovcnt, (size_t)UCT_TCP_EP_AM_ZCOPY_MAX_IOV,
+                       "uct_tcp_ep_get_zcopy");
+    length = uct_iov_total_length(iov, iovcnt);
+    UCT_CHECK_LENGTH(length, 0, iface->config.max_bcopy, "get_zcopy");
+    UCT_SKIP_ZERO_LENGTH(length);
+
+    status = uct_tcp_ep_get_req(iface, ep, &req);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    for (iov_it = 0; iov_it < iovcnt; ++iov_it) {
+        req->get_zcopy.iov[iov_it].iov_base = iov[iov_it].buffer;
+        req->get_zcopy.iov[iov_it].iov_len  = uct_iov_get_length(&iov[iov_it]);
+    }
+    req->get_zcopy.iovcnt = iovcnt;
+
+    status = uct_tcp_ep_get(iface, ep, req, UCT_TCP_EP_REQ_GET_ZCOPY, length,
+                            remote_addr, rkey, comp);
+    UCT_TL_EP_STAT_OP_IF_SUCCESS(status, &ep->super, GET, ZCOPY, length);
+    ucs_trace_data("TX: GET_ZCOPY [addr 0x%"PRIx64" length %zu]", remote_addr,
+                   length);
+    return status;
+}
+
+/**
+ * Post an atomic operation. If result is NULL, the target does not reply.
+ */
+static ucs_status_t uct_tcp_ep_atomic(uct_ep_h tl_ep, uint8_t opcode,
+                                      uint8_t size, uint64_t value,
+                                      uint64_t compare, uint64_t remote_addr,
+                                      uct_rkey_t rkey, void *result,
+                                      uct_completion_t *comp)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_tcp_atomic_hdr_t atomic_hdr;
+    uct_tcp_ep_req_t *req;
+    struct iovec iov[2];
+    ucs_status_t status;
+
+    atomic_hdr.address = remote_addr;
+    atomic_hdr.rkey_id = uct_tcp_ep_rkey_id(rkey, remote_addr, size);
+    atomic_hdr.value   = value;
+    atomic_hdr.compare = compare;
+    atomic_hdr.opcode  = opcode;
+    atomic_hdr.size    = size;
+    iov[1].iov_base    = &atomic_hdr;
+    iov[1].iov_len     = sizeof(atomic_hdr);
+
+    if (result == NULL) {
+        status = uct_tcp_ep_check_rma_resources(iface, ep);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        status = uct_tcp_ep_send_frame(iface, ep, UCT_TCP_AM_ID_ATOMIC_REQ,
+                                       iov, 2);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        ep->rma.unacked = 1;
+    } else {
+        status = uct_tcp_ep_get_req(iface, ep, &req);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        req->atomic.result = result;
+        req->atomic.size   = size;
+        status = uct_tcp_ep_send_request(iface, ep, UCT_TCP_AM_ID_ATOMIC_REQ,
+                                         iov, 2, req, UCT_TCP_EP_REQ_ATOMIC,
+                                         comp);
+        if (status != UCS_INPROGRESS) {
+            return status;
+        }
+    }
+
+    UCT_TL_EP_STAT_ATOMIC(&ep->super);
+    ucs_trace_data("TX: ATOMIC [op %d size %d addr 0x%"PRIx64"]", opcode, size,
+                   remote_addr);
+    return status;
+}
+
+ucs_status_t uct_tcp_ep_atomic_add64(uct_ep_h tl_ep, uint64_t add,
+                                     uint64_t remote_addr, uct_rkey_t rkey)
+{
+    return uct_tcp_ep_atomic(tl_ep, UCT_TCP_ATOMIC_OP_ADD, sizeof(uint64_t),
+                             add, 0, remote_addr, rkey, NULL, NULL);
+}
+
+ucs_status_t uct_tcp_ep_atomic_fadd64(uct_ep_h tl_ep, uint64_t add,
+                                      uint64_t remote_addr, uct_rkey_t rkey,
+                                      uint64_t *result, uct_completion_t *comp)
+{
+    return uct_tcp_ep_atomic(tl_ep, UCT_TCP_ATOMIC_OP_FADD, sizeof(uint64_t),
+                             add, 0, remote_addr, rkey, result, comp);
+}
+
+ucs_status_t uct_tcp_ep_atomic_swap64(uct_ep_h tl_ep, uint64_t swap,
+                                      uint64_t remote_addr, uct_rkey_t rkey,
+                                      uint64_t *result, uct_completion_t *comp)
+{
+    return uct_tcp_ep_atomic(tl_ep, UCT_TCP_ATOMIC_OP_SWAP, sizeof(uint64_t),
+                             swap, 0, remote_addr, rkey, result, comp);
+}
+
+ucs_status_t uct_tcp_ep_atomic_cswap64(uct_ep_h tl_ep, uint64_t compare,
+                                       uint64_t swap, uint64_t remote_addr,
+                                       uct_rkey_t rkey, uint64_t *result,
+                                       uct_completion_t *comp)
+{
+    return uct_tcp_ep_atomic(tl_ep, UCT_TCP_ATOMIC_OP_CSWAP, sizeof(uint64_t),
+                             swap, compare, remote_addr, rkey, result, comp);
+}
+
+ucs_status_t uct_tcp_ep_atomic_add32(uct_ep_h tl_ep, uint32_t add,
+                                     uint64_t remote_addr, uct_rkey_t rkey)
+{
+    return uct_tcp_ep_atomic(tl_ep, UCT_TCP_ATOMIC_OP_ADD, sizeof(uint32_t),
+                             add, 0, remote_addr, rkey, NULL, NULL);
+}
+
+ucs_status_t uct_tcp_ep_atomic_fadd32(uct_ep_h tl_ep, uint32_t add,
+                                      uint64_t remote_addr, uct_rkey_t rkey,
+                                      uint32_t *result, uct_completion_t *comp)
+{
+    return uct_tcp_ep_atomic(tl_ep, UCT_TCP_ATOMIC_OP_FADD, sizeof(uint32_t),
+                             add, 0, remote_addr, rkey, result, comp);
+}
+
+ucs_status_t uct_tcp_ep_atomic_swap32(uct_ep_h tl_ep, uint32_t swap,
+                                      uint64_t remote_addr, uct_rkey_t rkey,
+                                      uint32_t *result, uct_completion_t *comp)
+{
+    return uct_tcp_ep_atomic(tl_ep, UCT_TCP_ATOMIC_OP_SWAP, sizeof(uint32_t),
+                             swap, 0, remote_addr, rkey, result, comp);
+}
+
+ucs_status_t uct_tcp_ep_atomic_cswap32(uct_ep_h tl_ep, uint32_t compare,
+                                       uint32_t swap, uint64_t remote_addr,
+                                       uct_rkey_t rkey, uint32_t *result,
+                                       uct_completion_t *comp)
+{
+    return uct_tcp_ep_atomic(tl_ep, UCT_TCP_ATOMIC_OP_CSWAP, sizeof(uint32_t),
+                             swap, compare, remote_addr, rkey, result, comp);
+}
+
+/**
+ * The RMA connection is broken and the replies would never arrive. Complete the
+ * outstanding requests with the error, and fail the following RMA operations.
+ */
+void uct_tcp_ep_rma_failed(uct_tcp_ep_t *ep, ucs_status_t status)
+{
+    uct_tcp_ep_req_t *req;
+
+    ucs_assert(status != UCS_OK);
+    ucs_debug("tcp ep %p: RMA connection fd %d failed: %s", ep, ep->rma.tx.fd,
+              ucs_status_string(status));
+
+    ep->rma.tx.status = status;
+    ucs_queue_for_each_extract(req, &ep->rma.reqs, queue, 1) {
+        if (req->comp != NULL) {
+            uct_invoke_completion(req->comp, status);
+        }
+        ucs_mpool_put(req);
+    }
+}
+
+/**
+ * Complete the oldest outstanding request with the reply data.
+ */
+ucs_status_t uct_tcp_ep_handle_reply(uct_tcp_ep_t *ep, const void *data,
+                                     unsigned length)
+{
+    uct_tcp_ep_req_t *req;
+    size_t iov_it, size;
+
+    if (ucs_unlikely(ucs_queue_is_empty(&ep->rma.reqs))) {
+        ucs_error("tcp ep %p: unexpected reply of length %u", ep, length);
+        return UCS_ERR_IO_ERROR;
+    }
+
+    req = ucs_queue_pull_elem_non_empty(&ep->rma.reqs, uct_tcp_ep_req_t, queue);
+    ucs_trace_data("RX: REPLY [req %p type %d length %u]", req, req->type,
+                   length);
+
+    switch (req->type) {
+    case UCT_TCP_EP_REQ_GET_BCOPY:
+        req->get_bcopy.unpack_cb(req->get_bcopy.arg, data, length);
+        break;
+    case UCT_TCP_EP_REQ_GET_ZCOPY:
+        for (iov_it = 0; iov_it < req->get_zcopy.iovcnt; ++iov_it) {
+            size = ucs_min(req->get_zcopy.iov[iov_it].iov_len, length);
+            memcpy(req->get_zcopy.iov[iov_it].iov_base, data, size);
+            data   += size;
+            length -= size;
+        }
+        break;
+    case UCT_TCP_EP_REQ_ATOMIC:
+        ucs_assert(length == req->atomic.size);
+        memcpy(req->atomic.result, data, req->atomic.size);
+        break;
+    case UCT_TCP_EP_REQ_FLUSH:
+        break;
+    }
+
+    if (req->comp != NULL) {
+        uct_invoke_completion(req->comp, UCS_OK);
+    }
+    ucs_mpool_put(req);
+    return UCS_OK;
+}
+
+ucs_status_t uct_tcp_ep_pending_add(uct_ep_h tl_ep, uct_pending_req_t *req)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+
+    /* check if resources became available */
+    if (!uct_tcp_ep_has_unsent_data(ep) &&
+        ucs_arbiter_group_is_empty(&ep->arb_group)) {
+        return UCS_ERR_BUSY;
+    }
+
+    UCS_STATIC_ASSERT(sizeof(ucs_arbiter_elem_t) <= UCT_PENDING_REQ_PRIV_LEN);
+
+    ucs_arbiter_elem_init((ucs_arbiter_elem_t*)req->priv);
+    ucs_arbiter_group_push_elem(&ep->arb_group, (ucs_arbiter_elem_t*)req->priv);
+    ucs_arbiter_group_schedule(&iface->arbiter, &ep->arb_group);
+    return UCS_OK;
+}
+
+ucs_arbiter_cb_result_t uct_tcp_ep_process_pending(ucs_arbiter_t *arbiter,
+                                                   ucs_arbiter_elem_t *elem,
+                                                   void *arg)
+{
+    uct_pending_req_t *req = ucs_container_of(elem, uct_pending_req_t, priv);
+    uct_tcp_ep_t *ep       = ucs_container_of(ucs_arbiter_elem_group(elem),
+                                              uct_tcp_ep_t, arb_group);
+    ucs_status_t status;
+
+    if (uct_tcp_ep_has_unsent_data(ep)) {
+        return UCS_ARBITER_CB_RESULT_RESCHED_GROUP;
+    }
+
+    ep->in_pending = 1;
+    status         = req->func(req);
+    ep->in_pending = 0;
+    ucs_trace_data("progress pending request %p returned %s", req,
+                   ucs_status_string(status));
+
+    if (status == UCS_OK) {
+        return UCS_ARBITER_CB_RESULT_REMOVE_ELEM;
+    } else if (status == UCS_INPROGRESS) {
+        return UCS_ARBITER_CB_RESULT_NEXT_GROUP;
+    } else {
+        return UCS_ARBITER_CB_RESULT_RESCHED_GROUP;
+    }
+}
+
+static ucs_arbiter_cb_result_t uct_tcp_ep_abriter_purge_cb(ucs_arbiter_t *arbiter,
+                                                           ucs_arbiter_elem_t *elem,
+                                                           void *arg)
+{
+    uct_pending_req_t *req       = ucs_container_of(elem, uct_pending_req_t, priv);
+    uct_purge_cb_args_t *cb_args = arg;
+    uct_tcp_ep_t *ep             = ucs_container_of(ucs_arbiter_elem_group(elem),
+                                                    uct_tcp_ep_t, arb_group);
+
+    if (cb_args->cb != NULL) {
+        cb_args->cb(req, cb_args->arg);
+    } else {
+        ucs_warn("ep=%p canceling user pending request %p", ep, req);
+    }
+    return UCS_ARBITER_CB_RESULT_REMOVE_ELEM;
+}
+
+void uct_tcp_ep_pending_purge(uct_ep_h tl_ep, uct_pending_purge_callback_t cb,
+                              void *arg)
+{
+    uct_tcp_ep_t *ep          = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface    = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_purge_cb_args_t args  = {cb, arg};
+
+    ucs_arbiter_group_purge(&iface->arbiter, &ep->arb_group,
+                            uct_tcp_ep_abriter_purge_cb, &args);
+}
+
+ucs_status_t uct_tcp_ep_flush(uct_ep_h tl_ep, unsigned flags,
+                              uct_completion_t *comp)
+{
+    uct_tcp_ep_t *ep       = ucs_derived_of(tl_ep, uct_tcp_ep_t);
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_tcp_iface_t);
+    uct_tcp_ep_req_t *req;
+    struct iovec iov[1];
+    ucs_status_t status;
+
+    if (uct_tcp_ep_has_unsent_data(ep)) {
+        uct_tcp_ep_progress_tx(ep);
+        if (uct_tcp_ep_has_unsent_data(ep)) {
+            UCT_TL_EP_STAT_FLUSH_WAIT(&ep->super);
+            return UCS_ERR_NO_RESOURCE;
+        }
+    }
+
+    if (ucs_unlikely(ep->tx.status != UCS_OK)) {
+        /* the active messages which were not sent are lost */
+        return ep->tx.status;
+    } else if (ucs_unlikely(ep->rma.tx.status != UCS_OK)) {
+        /* the operations which were not completed remotely are lost */
+        return UCS_ERR_IO_ERROR;
+    }
+
+    if (!ep->rma.unacked && ucs_queue_is_empty(&ep->rma.reqs)) {
+        UCT_TL_EP_STAT_FLUSH(&ep->super);
+        return UCS_OK;
+    }
+
+    /* Without a completion callback the caller polls, so there is no need
+     * for another flush request if one is already on the way */
+    if ((comp == NULL) && !ep->rma.unacked &&
+        (ucs_queue_tail_elem_non_empty(&ep->rma.reqs, uct_tcp_ep_req_t,
+                                       queue)->type == UCT_TCP_EP_REQ_FLUSH)) {
+        UCT_TL_EP_STAT_FLUSH_WAIT(&ep->super);
+        return UCS_INPROGRESS;
+    }
+
+    /* Writes and requests are executed by the target in order, so they are
+     * remotely completed once the target replies to the flush request */
+    status = uct_tcp_ep_get_req(iface, ep, &req);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    status = uct_tcp_ep_send_request(iface, ep, UCT_TCP_AM_ID_FLUSH_REQ, iov,
+                                     1, req, UCT_TCP_EP_REQ_FLUSH, comp);
+    if (status != UCS_INPROGRESS) {
+        return status;
+    }
+
+    ep->rma.unacked = 0;
+    UCT_TL_EP_STAT_FLUSH_WAIT(&ep->super);
+    return UCS_INPROGRESS;
+}
@@ -9,6 +9,7 @@
 #include <ucs/sys/string.h>
 #include <sys/socket.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
 #include <netinet/tcp.h>
 #include <dirent.h>
 
@@ -31,6 +32,12 @@ static ucs_config_field_t uct_tcp_iface_config_table[] = {
    "option usually provides better performance",
    ucs_offsetof(uct_tcp_iface_config_t, sockopt_nodelay), UCS_CONFIG_TYPE_BOOL},
 
+  {"RX_BUF_SIZE", "64k",
+   "Size of the receive buffer of a connection. Several frames can be received\n"
+   "to it with a single system call. The actual size is at least the maximal\n"
+   "frame size.",
+   ucs_offsetof(uct_tcp_iface_config_t, rx_buf_size), UCS_CONFIG_TYPE_MEMUNITS},
+
   {NULL}
 };
 
@@ -47,9 +54,11 @@ static ucs_status_t uct_tcp_iface_get_device_address(uct_iface_h tl_iface,
 
 static ucs_status_t uct_tcp_iface_get_address(uct_iface_h tl_iface, uct_iface_addr_t *addr)
 {
-    uct_tcp_iface_t *iface = ucs_derived_of(tl_iface, uct_tcp_iface_t);
+    uct_tcp_iface_t *iface          = ucs_derived_of(tl_iface, uct_tcp_iface_t);
+    uct_tcp_iface_addr_t *iface_addr = (uct_tcp_iface_addr_t*)addr;
 
-    *(in_port_t*)addr = iface->config.ifaddr.sin_port;
+    iface_addr->am_port  = iface->config.ifaddr.sin_port;
+    iface_addr->rma_port = iface->config.rma_port;
     return UCS_OK;
 }
 
@@ -72,12 +81,54 @@ static ucs_status_t uct_tcp_iface_query(uct_iface_h tl_iface, uct_iface_attr_t *
     int is_default;
 
     memset(attr, 0, sizeof(*attr));
-    attr->iface_addr_len   = sizeof(in_port_t);
+    attr->iface_addr_len   = sizeof(uct_tcp_iface_addr_t);
     attr->device_addr_len  = sizeof(struct in_addr);
     attr->cap.flags        = UCT_IFACE_FLAG_CONNECT_TO_IFACE |
+                             UCT_IFACE_FLAG_AM_SHORT         |
+                             UCT_IFACE_FLAG_AM_BCOPY         |
+                             UCT_IFACE_FLAG_AM_ZCOPY         |
+                             UCT_IFACE_FLAG_PUT_SHORT        |
+                             UCT_IFACE_FLAG_PUT_BCOPY        |
+                             UCT_IFACE_FLAG_PUT_ZCOPY        |
+                             UCT_IFACE_FLAG_GET_BCOPY        |
+                             UCT_IFACE_FLAG_GET_ZCOPY        |
+                             UCT_IFACE_FLAG_ATOMIC_ADD32     |
+                             UCT_IFACE_FLAG_ATOMIC_ADD64     |
+                             UCT_IFACE_FLAG_ATOMIC_FADD32    |
+                             UCT_IFACE_FLAG_ATOMIC_FADD64    |
+                             UCT_IFACE_FLAG_ATOMIC_SWAP32    |
+                             UCT_IFACE_FLAG_ATOMIC_SWAP64    |
+                             UCT_IFACE_FLAG_ATOMIC_CSWAP32   |
+                             UCT_IFACE_FLAG_ATOMIC_CSWAP64   |
+                             UCT_IFACE_FLAG_ATOMIC_CPU       |
+                             UCT_IFACE_FLAG_AM_CB_SYNC       |
                              UCT_IFACE_FLAG_PENDING;
 
-    attr->cap.am.max_bcopy = iface->config.max_bcopy;
+    /* RMA and atomics are executed by the target from its async context */
+    attr->cap.put.max_short       = iface->config.max_bcopy -
+                                    sizeof(uct_tcp_put_hdr_t);
+    attr->cap.put.max_bcopy       = attr->cap.put.max_short;
+    attr->cap.put.min_zcopy       = 0;
+    attr->cap.put.max_zcopy       = attr->cap.put.max_short;
+    attr->cap.put.opt_zcopy_align = 1;
+    attr->cap.put.align_mtu       = attr->cap.put.opt_zcopy_align;
+    attr->cap.put.max_iov         = UCT_TCP_EP_AM_ZCOPY_MAX_IOV;
+
+    attr->cap.get.max_bcopy       = iface->config.max_bcopy;
+    attr->cap.get.min_zcopy       = 0;
+    attr->cap.get.max_zcopy       = iface->config.max_bcopy;
+    attr->cap.get.opt_zcopy_align = 1;
+    attr->cap.get.align_mtu       = attr->cap.get.opt_zcopy_align;
+    attr->cap.get.max_iov         = UCT_TCP_EP_AM_ZCOPY_MAX_IOV;
+
+    attr->cap.am.max_short       = iface->config.max_bcopy;
+    attr->cap.am.max_bcopy       = iface->config.max_bcopy;
+    attr->cap.am.min_zcopy       = 0;
+    attr->cap.am.max_zcopy       = iface->config.max_bcopy;
+    attr->cap.am.opt_zcopy_align = 1;
+    attr->cap.am.align_mtu       = attr->cap.am.opt_zcopy_align;
+    attr->cap.am.max_hdr         = iface->config.max_bcopy;
+    attr->cap.am.max_iov         = UCT_TCP_EP_AM_ZCOPY_MAX_IOV;
 
     status = uct_tcp_netif_caps(iface->if_name, &attr->latency.overhead,
                                 &attr->bandwidth);
@@ -141,34 +192,175 @@ ucs_status_t uct_tcp_iface_set_sockopt(uct_tcp_iface_t *iface, int fd)
     return UCS_OK;
 }
 
+static ucs_status_t uct_tcp_iface_flush(uct_iface_h tl_iface, unsigned flags,
+                                        uct_completion_t *comp)
+{
+    uct_tcp_iface_t *iface = ucs_derived_of(tl_iface, uct_tcp_iface_t);
+    ucs_status_t status;
+    uct_tcp_ep_t *ep;
+    int count;
+
+    if (comp != NULL) {
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    count = 0;
+    ucs_list_for_each(ep, &iface->ep_list, iface_list) {
+        status = uct_tcp_ep_flush(&ep->super.super, 0, NULL);
+        if (status != UCS_OK) {
+            ++count;
+        }
+    }
+
+    if (count > 0) {
+        UCT_TL_IFACE_STAT_FLUSH_WAIT(&iface->super);
+        return UCS_INPROGRESS;
+    }
+
+    UCT_TL_IFACE_STAT_FLUSH(&iface->super);
+    return UCS_OK;
+}
+
+void uct_tcp_iface_progress(void *arg)
+{
+    uct_tcp_iface_t *iface = arg;
+    uct_tcp_ep_t *ep, *tmp;
+
+    /* complete partially sent frames */
+    ucs_list_for_each_safe(ep, tmp, &iface->tx_ep_list, list) {
+        uct_tcp_ep_progress_tx(ep);
+    }
+
+    /* progress the pending sends (if there are any) */
+    ucs_arbiter_dispatch(&iface->arbiter, 1, uct_tcp_ep_process_pending, NULL);
+
+    uct_tcp_iface_recv_progress(iface);
+}
+
+static void uct_tcp_iface_release_desc(uct_recv_desc_t *self, void *desc)
+{
+    ucs_mpool_put(ucs_container_of(self, uct_tcp_am_desc_t, release));
+}
+
+static void uct_tcp_iface_desc_init(ucs_mpool_t *mp, void *obj, void *chunk)
+{
+    uct_tcp_am_desc_t *desc = obj;
+
+    desc->release.cb = uct_tcp_iface_release_desc;
+}
+
 static uct_iface_ops_t uct_tcp_iface_ops = {
     .iface_close              = UCS_CLASS_DELETE_FUNC_NAME(uct_tcp_iface_t),
     .iface_get_device_address = uct_tcp_iface_get_device_address,
     .iface_get_address        = uct_tcp_iface_get_address,
     .iface_query              = uct_tcp_iface_query,
     .iface_is_reachable       = uct_tcp_iface_is_reachable,
+    .iface_flush              = uct_tcp_iface_flush,
     .ep_create_connected      = UCS_CLASS_NEW_FUNC_NAME(uct_tcp_ep_t),
     .ep_destroy               = UCS_CLASS_DELETE_FUNC_NAME(uct_tcp_ep_t),
-    .ep_pending_add           = ucs_empty_function_return_busy,
-    .ep_pending_purge         = ucs_empty_function,
+    .ep_put_short             = uct_tcp_ep_put_short,
+    .ep_put_bcopy             = uct_tcp_ep_put_bcopy,
+    .ep_put_zcopy             = uct_tcp_ep_put_zcopy,
+    .ep_get_bcopy             = uct_tcp_ep_get_bcopy,
+    .ep_get_zcopy             = uct_tcp_ep_get_zcopy,
+    .ep_am_short              = uct_tcp_ep_am_short,
+    .ep_am_bcopy              = uct_tcp_ep_am_bcopy,
+    .ep_am_zcopy              = uct_tcp_ep_am_zcopy,
+    .ep_atomic_add64          = uct_tcp_ep_atomic_add64,
+    .ep_atomic_fadd64         = uct_tcp_ep_atomic_fadd64,
+    .ep_atomic_swap64         = uct_tcp_ep_atomic_swap64,
+    .ep_atomic_cswap64        = uct_tcp_ep_atomic_cswap64,
+    .ep_atomic_add32          = uct_tcp_ep_atomic_add32,
+    .ep_atomic_fadd32         = uct_tcp_ep_atomic_fadd32,
+    .ep_atomic_swap32         = uct_tcp_ep_atomic_swap32,
+    .ep_atomic_cswap32        = uct_tcp_ep_atomic_cswap32,
+    .ep_pending_add           = uct_tcp_ep_pending_add,
+    .ep_pending_purge         = uct_tcp_ep_pending_purge,
+    .ep_flush                 = uct_tcp_ep_flush,
 };
 
 static ucs_mpool_ops_t uct_tcp_mpool_ops = {
     .chunk_alloc   = ucs_mpool_chunk_mmap,
     .chunk_release = ucs_mpool_chunk_munmap,
+    .obj_init      = uct_tcp_iface_desc_init,
+    .obj_cleanup   = NULL
+};
+
+static ucs_mpool_ops_t uct_tcp_req_mpool_ops = {
+    .chunk_alloc   = ucs_mpool_chunk_malloc,
+    .chunk_release = ucs_mpool_chunk_free,
     .obj_init      = NULL,
     .obj_cleanup   = NULL
 };
 
+/**
+ * Create a non-blocking server socket, listening on a random port.
+ */
+static ucs_status_t uct_tcp_iface_listen(uct_tcp_iface_t *iface,
+                                         unsigned backlog, int *fd_p,
+                                         in_port_t *port_p)
+{
+    struct sockaddr_in bind_addr;
+    ucs_status_t status;
+    socklen_t addrlen;
+    int fd, ret;
+
+    status = uct_tcp_socket_create(&fd);
+    if (status != UCS_OK) {
+        goto err;
+    }
+
+    /* Set the server socket to non-blocking mode */
+    status = ucs_sys_fcntl_modfl(fd, O_NONBLOCK, 0);
+    if (status != UCS_OK) {
+        goto err_close_sock;
+    }
+
+    /* Bind socket to random available port */
+    bind_addr = iface->config.ifaddr;
+    bind_addr.sin_port = 0;
+    ret = bind(fd, (struct sockaddr *)&bind_addr, sizeof(bind_addr));
+    if (ret < 0) {
+        ucs_error("bind() failed: %m");
+        status = UCS_ERR_IO_ERROR;
+        goto err_close_sock;
+    }
+
+    /* Get the port which was selected for the socket */
+    addrlen = sizeof(bind_addr);
+    ret = getsockname(fd, (struct sockaddr*)&bind_addr, &addrlen);
+    if (ret < 0) {
+        ucs_error("getsockname(fd=%d) failed: %m", fd);
+        status = UCS_ERR_IO_ERROR;
+        goto err_close_sock;
+    }
+
+    /* Listen for connections */
+    ret = listen(fd, backlog);
+    if (ret < 0) {
+        ucs_error("listen(backlog=%d)", backlog);
+        status = UCS_ERR_IO_ERROR;
+        goto err_close_sock;
+    }
+
+    ucs_debug("listening for connections on %s:%d", inet_ntoa(bind_addr.sin_addr),
+              ntohs(bind_addr.sin_port));
+    *fd_p   = fd;
+    *port_p = bind_addr.sin_port;
+    return UCS_OK;
+
+err_close_sock:
+    close(fd);
+err:
+    return status;
+}
+
 static UCS_CLASS_INIT_FUNC(uct_tcp_iface_t, uct_md_h md, uct_worker_h worker,
                            const uct_iface_params_t *params,
                            const uct_iface_config_t *tl_config)
 {
     uct_tcp_iface_config_t *config = ucs_derived_of(tl_config, uct_tcp_iface_config_t);
-    struct sockaddr_in bind_addr;
     ucs_status_t status;
-    socklen_t addrlen;
-    int ret;
 
     UCS_CLASS_CALL_SUPER_INIT(uct_base_iface_t, &uct_tcp_iface_ops, md, worker,
                               params, tl_config UCS_STATS_ARG(params->stats_root)
@@ -177,9 +369,26 @@ static UCS_CLASS_INIT_FUNC(uct_tcp_iface_t, uct_md_h md, uct_worker_h worker,
     ucs_strncpy_zero(self->if_name, params->dev_name, sizeof(self->if_name));
     self->config.max_bcopy       = config->super.max_bcopy;
     self->config.prefer_default  = config->prefer_default;
+    self->config.rx_headroom     = params->rx_headroom;
+    self->config.seg_size        = sizeof(uct_tcp_am_hdr_t) +
+                                   config->super.max_bcopy;
+    /* the first frame in a buffer must leave room for the user headroom and
+     * the release descriptor pointer before its payload */
+    self->config.rx_offset       = sizeof(uct_tcp_am_desc_t) +
+                                   sizeof(uct_recv_desc_t*) +
+                                   params->rx_headroom;
+    self->config.rx_buf_size     = ucs_max(config->rx_buf_size,
+                                           self->config.seg_size);
     self->sockopt.nodelay        = config->sockopt_nodelay;
+    self->rsocks                 = NULL;
+    self->rsocks_length          = 0;
+    self->rx_spare_buf           = NULL;
 
-    kh_init_inplace(uct_tcp_fd_hash, &self->fd_hash);
+    ucs_arbiter_init(&self->arbiter);
+    ucs_list_head_init(&self->tx_ep_list);
+    ucs_list_head_init(&self->rx_ready_list);
+    ucs_list_head_init(&self->rma_sock_list);
+    ucs_list_head_init(&self->ep_list);
 
     status = uct_tcp_netif_inaddr(self->if_name, &self->config.ifaddr,
                                   &self->config.netmask);
@@ -188,7 +397,7 @@ static UCS_CLASS_INIT_FUNC(uct_tcp_iface_t, uct_md_h md, uct_worker_h worker,
     }
 
     status = ucs_mpool_init(&self->mp, 0,
-                            self->config.max_bcopy,
+                            self->config.rx_offset + self->config.seg_size,
                             0,                        /* alignment offset */
                             UCS_SYS_CACHE_LINE_SIZE,  /* alignment */
                             32,                       /* grow */
@@ -199,60 +408,84 @@ static UCS_CLASS_INIT_FUNC(uct_tcp_iface_t, uct_md_h md, uct_worker_h worker,
         goto err;
     }
 
-    /* Create the server socket for accepting incoming connections */
-    status = uct_tcp_socket_create(&self->listen_fd);
+    status = ucs_mpool_init(&self->rx_mp, 0,
+                            self->config.rx_offset + self->config.rx_buf_size,
+                            0,                        /* alignment offset */
+                            UCS_SYS_CACHE_LINE_SIZE,  /* alignment */
+                            8,                        /* grow */
+                            -1,                       /* max buffers */
+                            &uct_tcp_mpool_ops,
+                            "tcp_rx_desc");
     if (status != UCS_OK) {
         goto err_mpool_cleanup;
     }
 
-    /* Set the server socket to non-blocking mode */
-    status = ucs_sys_fcntl_modfl(self->listen_fd, O_NONBLOCK, 0);
+    status = ucs_mpool_init(&self->req_mp, 0, sizeof(uct_tcp_ep_req_t),
+                            0,                        /* alignment offset */
+                            UCS_SYS_CACHE_LINE_SIZE,  /* alignment */
+                            32,                       /* grow */
+                            -1,                       /* max requests */
+                            &uct_tcp_req_mpool_ops,
+                            "tcp_req");
     if (status != UCS_OK) {
-        goto err_close_sock;
+        goto err_rx_mpool_cleanup;
     }
 
-    /* Bind socket to random available port */
-    bind_addr = self->config.ifaddr;
-    bind_addr.sin_port = 0;
-    ret = bind(self->listen_fd, (struct sockaddr *)&bind_addr, sizeof(bind_addr));
-    if (ret < 0) {
-        ucs_error("bind() failed: %m");
-        goto err_close_sock;
+    /* Data sockets are polled from progress with a single epoll set */
+    self->epfd = epoll_create(1);
+    if (self->epfd < 0) {
+        ucs_error("epoll_create() failed: %m");
+        status = UCS_ERR_IO_ERROR;
+        goto err_req_mpool_cleanup;
     }
 
-    /* Get the port which was selected for the socket */
-    addrlen = sizeof(bind_addr);
-    ret = getsockname(self->listen_fd, (struct sockaddr*)&bind_addr, &addrlen);
-    if (ret < 0) {
-        ucs_error("getsockname(fd=%d) failed: %m", self->listen_fd);
-        goto err_close_sock;
+    /* Create the server socket for accepting incoming connections */
+    status = uct_tcp_iface_listen(self, config->backlog, &self->listen_fd,
+                                  &self->config.ifaddr.sin_port);
+    if (status != UCS_OK) {
+        goto err_close_epfd;
     }
-    self->config.ifaddr.sin_port = bind_addr.sin_port;
 
-    /* Listen for connections */
-    ret = listen(self->listen_fd, config->backlog);
-    if (ret < 0) {
-        ucs_error("listen(backlog=%d)", config->backlog);
-        status = UCS_ERR_IO_ERROR;
+    /* RMA requests are received on separate connections, and executed from
+     * the async context */
+    status = uct_tcp_iface_listen(self, config->backlog, &self->rma_listen_fd,
+                                  &self->config.rma_port);
+    if (status != UCS_OK) {
         goto err_close_sock;
     }
 
-    ucs_debug("listening for connections on %s:%d", inet_ntoa(bind_addr.sin_addr),
-              ntohs(bind_addr.sin_port));
-
     /* Register event handler for incoming connections */
     status = ucs_async_set_event_handler(worker->async->mode, self->listen_fd,
                                          POLLIN|POLLERR,
                                          uct_tcp_iface_connect_handler, self,
                                          worker->async);
     if (status != UCS_OK) {
-        goto err_close_sock;
+        goto err_close_rma_sock;
     }
 
+    status = ucs_async_set_event_handler(worker->async->mode,
+                                         self->rma_listen_fd, POLLIN|POLLERR,
+                                         uct_tcp_iface_rma_connect_handler,
+                                         self, worker->async);
+    if (status != UCS_OK) {
+        goto err_remove_handler;
+    }
+
+    uct_worker_progress_register(worker, uct_tcp_iface_progress, self);
     return UCS_OK;
 
+err_remove_handler:
+    ucs_async_remove_handler(self->listen_fd, 1);
+err_close_rma_sock:
+    close(self->rma_listen_fd);
 err_close_sock:
     close(self->listen_fd);
+err_close_epfd:
+    close(self->epfd);
+err_req_mpool_cleanup:
+    ucs_mpool_cleanup(&self->req_mp, 0);
+err_rx_mpool_cleanup:
+    ucs_mpool_cleanup(&self->rx_mp, 0);
 err_mpool_cleanup:
     ucs_mpool_cleanup(&self->mp, 0);
 err:
@@ -263,15 +496,29 @@ static UCS_CLASS_CLEANUP_FUNC(uct_tcp_iface_t)
 {
     ucs_status_t status;
 
+    uct_worker_progress_unregister(self->super.worker, uct_tcp_iface_progress,
+                                   self);
+
     status = ucs_async_remove_handler(self->listen_fd, 1);
     if (status != UCS_OK) {
         ucs_warn("failed to remove handler for server socket fd=%d", self->listen_fd);
     }
 
+    status = ucs_async_remove_handler(self->rma_listen_fd, 1);
+    if (status != UCS_OK) {
+        ucs_warn("failed to remove handler for RMA server socket fd=%d",
+                  self->rma_listen_fd);
+    }
+
+    uct_tcp_iface_rma_cleanup(self);
     uct_tcp_iface_recv_cleanup(self);
+    close(self->rma_listen_fd);
     close(self->listen_fd);
+    close(self->epfd);
+    ucs_mpool_cleanup(&self->req_mp, 1);
+    ucs_mpool_cleanup(&self->rx_mp, 1);
     ucs_mpool_cleanup(&self->mp, 1);
-    kh_destroy_inplace(uct_tcp_fd_hash, &self->fd_hash);
+    ucs_arbiter_cleanup(&self->arbiter);
 }
 
 UCS_CLASS_DEFINE(uct_tcp_iface_t, uct_base_iface_t);
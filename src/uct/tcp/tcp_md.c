@@ -5,13 +5,17 @@
 
 #include "tcp.h"
 
+#include <sched.h>
+
 
 static ucs_status_t uct_tcp_md_query(uct_md_h md, uct_md_attr_t *attr)
 {
-    attr->cap.flags         = 0;
+    /* Sockets can send from any memory, so registration only records the
+     * region, which the target checks remote accesses against */
+    attr->cap.flags         = UCT_MD_FLAG_REG | UCT_MD_FLAG_NEED_RKEY;
     attr->cap.max_alloc     = 0;
-    attr->cap.max_reg       = 0;
-    attr->rkey_packed_size  = 0;
+    attr->cap.max_reg       = ULONG_MAX;
+    attr->rkey_packed_size  = sizeof(uct_tcp_key_t);
     attr->reg_cost.overhead = 0;
     attr->reg_cost.growth   = 0;
     memset(&attr->local_cpus, 0xff, sizeof(attr->local_cpus));
@@ -24,27 +28,154 @@ static ucs_status_t uct_tcp_query_md_resources(uct_md_resource_desc_t **resource
     return uct_single_md_resource(&uct_tcp_md, resources_p, num_resources_p);
 }
 
+static ucs_status_t uct_tcp_mem_reg(uct_md_h uct_md, void *address,
+                                    size_t length, unsigned flags,
+                                    uct_mem_h *memh_p)
+{
+    uct_tcp_md_t *md = ucs_derived_of(uct_md, uct_tcp_md_t);
+    uct_tcp_memh_t *memh;
+    khiter_t iter;
+    int ret;
+
+    memh = ucs_malloc(sizeof(*memh), "tcp_memh");
+    if (memh == NULL) {
+        ucs_error("Failed to allocate memory for tcp memory handle");
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    memh->key.address = (uintptr_t)address;
+    memh->key.length  = length;
+    memh->refcount    = 0;
+
+    ucs_spin_lock(&md->lock);
+    memh->key.id = md->next_id++;
+    iter         = kh_put(uct_tcp_memh, &md->memhs, memh->key.id, &ret);
+    if (ret == -1) {
+        ucs_spin_unlock(&md->lock);
+        ucs_error("Failed to add tcp memory handle to the hash");
+        ucs_free(memh);
+        return UCS_ERR_NO_MEMORY;
+    }
+    kh_value(&md->memhs, iter) = memh;
+    ucs_spin_unlock(&md->lock);
+
+    *memh_p = memh;
+    return UCS_OK;
+}
+
+static ucs_status_t uct_tcp_mem_dereg(uct_md_h uct_md, uct_mem_h memh)
+{
+    uct_tcp_md_t *md       = ucs_derived_of(uct_md, uct_tcp_md_t);
+    uct_tcp_memh_t *tcp_mh = memh;
+    khiter_t iter;
+
+    /* Once removed, the target rejects new requests to the region */
+    ucs_spin_lock(&md->lock);
+    iter = kh_get(uct_tcp_memh, &md->memhs, tcp_mh->key.id);
+    ucs_assert(iter != kh_end(&md->memhs));
+    kh_del(uct_tcp_memh, &md->memhs, iter);
+    ucs_spin_unlock(&md->lock);
+
+    /* Wait for the requests which are still copying to or from the region, so
+     * the memory can be released when we return */
+    while (tcp_mh->refcount != 0) {
+        sched_yield();
+    }
+
+    ucs_free(tcp_mh);
+    return UCS_OK;
+}
+
+static ucs_status_t uct_tcp_mkey_pack(uct_md_h md, uct_mem_h memh,
+                                      void *rkey_buffer)
+{
+    uct_tcp_key_t *packed = rkey_buffer;
+    uct_tcp_key_t *key    = &((uct_tcp_memh_t*)memh)->key;
+
+    *packed = *key;
+    ucs_trace("packed rkey: id %"PRIu64" address 0x%"PRIx64" length %zu",
+              key->id, key->address, key->length);
+    return UCS_OK;
+}
+
+static ucs_status_t uct_tcp_rkey_unpack(uct_md_component_t *mdc,
+                                        const void *rkey_buffer,
+                                        uct_rkey_t *rkey_p, void **handle_p)
+{
+    const uct_tcp_key_t *packed = rkey_buffer;
+    uct_tcp_key_t *key;
+
+    key = ucs_malloc(sizeof(*key), "tcp_rkey");
+    if (key == NULL) {
+        ucs_error("Failed to allocate memory for tcp remote key");
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    *key      = *packed;
+    *handle_p = NULL;
+    *rkey_p   = (uintptr_t)key;
+    ucs_trace("unpacked rkey: key %p id %"PRIu64" address 0x%"PRIx64
+              " length %zu", key, key->id, key->address, key->length);
+    return UCS_OK;
+}
+
+static ucs_status_t uct_tcp_rkey_release(uct_md_component_t *mdc,
+                                         uct_rkey_t rkey, void *handle)
+{
+    ucs_assert(handle == NULL);
+    ucs_free((void*)rkey);
+    return UCS_OK;
+}
+
+static void uct_tcp_md_close(uct_md_h uct_md)
+{
+    uct_tcp_md_t *md = ucs_derived_of(uct_md, uct_tcp_md_t);
+
+    if (kh_size(&md->memhs) != 0) {
+        ucs_warn("tcp md %p: %u memory regions were not deregistered", md,
+                 kh_size(&md->memhs));
+    }
+
+    kh_destroy_inplace(uct_tcp_memh, &md->memhs);
+    ucs_spinlock_destroy(&md->lock);
+    ucs_free(md);
+}
+
 static ucs_status_t uct_tcp_md_open(const char *md_name, const uct_md_config_t *md_config,
                                     uct_md_h *md_p)
 {
     static uct_md_ops_t md_ops = {
-        .close        = ucs_empty_function,
+        .close        = uct_tcp_md_close,
         .query        = uct_tcp_md_query,
-        .mkey_pack    = ucs_empty_function_return_unsupported,
-        .mem_reg      = ucs_empty_function_return_unsupported,
-        .mem_dereg    = ucs_empty_function_return_unsupported
-    };
-    static uct_md_t md = {
-        .ops          = &md_ops,
-        .component    = &uct_tcp_md
+        .mkey_pack    = uct_tcp_mkey_pack,
+        .mem_reg      = uct_tcp_mem_reg,
+        .mem_dereg    = uct_tcp_mem_dereg
     };
+    uct_tcp_md_t *md;
+    ucs_status_t status;
+
+    md = ucs_malloc(sizeof(*md), "uct_tcp_md_t");
+    if (md == NULL) {
+        ucs_error("Failed to allocate memory for uct_tcp_md_t");
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    status = ucs_spinlock_init(&md->lock);
+    if (status != UCS_OK) {
+        ucs_free(md);
+        return status;
+    }
+
+    md->super.ops       = &md_ops;
+    md->super.component = &uct_tcp_md;
+    md->next_id         = 1; /* 0 is never a valid registration */
+    kh_init_inplace(uct_tcp_memh, &md->memhs);
 
-    *md_p = &md;
+    *md_p = &md->super;
     return UCS_OK;
 }
 
 UCT_MD_COMPONENT_DEFINE(uct_tcp_md, UCT_TCP_NAME,
                         uct_tcp_query_md_resources, uct_tcp_md_open, NULL,
-                        ucs_empty_function_return_unsupported,
-                        ucs_empty_function_return_success, "TCP_",
+                        uct_tcp_rkey_unpack, uct_tcp_rkey_release, "TCP_",
                         uct_md_config_table, uct_md_config_t);
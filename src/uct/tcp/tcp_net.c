@@ -16,6 +16,7 @@
 #include <linux/ethtool.h>
 #include <linux/if_ether.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <net/if_arp.h>
 #include <net/if.h>
 #include <netdb.h>
@@ -46,6 +47,45 @@ ucs_status_t uct_tcp_socket_connect(int fd, const struct sockaddr_in *dest_addr)
     return UCS_OK;
 }
 
+ssize_t uct_tcp_socket_sendv(int fd, struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg;
+    ssize_t ret;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = iovcnt;
+
+    ret = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (ret < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+            return 0;
+        }
+        ucs_error("sendmsg(fd=%d) failed: %m", fd);
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return ret;
+}
+
+ssize_t uct_tcp_socket_recv(int fd, void *data, size_t length)
+{
+    ssize_t ret;
+
+    ret = recv(fd, data, length, MSG_DONTWAIT);
+    if (ret > 0) {
+        return ret;
+    } else if (ret == 0) {
+        ucs_debug("fd %d is closed by remote peer", fd);
+        return UCS_ERR_CANCELED;
+    } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+        return 0;
+    } else {
+        ucs_error("recv(fd=%d) failed: %m", fd);
+        return UCS_ERR_IO_ERROR;
+    }
+}
+
 static ucs_status_t uct_tcp_netif_ioctl(const char *if_name, unsigned long request,
                                         struct ifreq *if_req)
 {
@@ -119,8 +159,10 @@ ucs_status_t uct_tcp_netif_caps(const char *if_name, double *latency_p,
 #else
         if ((speed_mbps == 0) || ((uint16_t)speed_mbps == (uint16_t)-1)) {
 #endif
-            ucs_error("speed of %s is UNKNOWN", if_name);
-            return UCS_ERR_NO_DEVICE;
+            /* Virtual and some paravirtual NICs do not report the link
+             * speed; use the same default as when ethtool is not supported */
+            ucs_debug("speed of %s is UNKNOWN, assuming 100 Mbps", if_name);
+            speed_mbps = 100;
         }
     } else {
         speed_mbps = 100; /* Default value if SIOCETHTOOL is not supported */
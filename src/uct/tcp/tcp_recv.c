@@ -7,31 +7,82 @@
 #include "tcp.h"
 
 #include <ucs/async/async.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
 
 
-static ucs_status_t uct_tcp_iface_recv_sock_add(uct_tcp_iface_t *iface, int fd,
+ucs_status_t uct_tcp_iface_recv_sock_init(uct_tcp_iface_t *iface,
+                                          uct_tcp_recv_sock_t *rsock, int fd,
+                                          uct_tcp_ep_t *ep)
+{
+    struct epoll_event event;
+    int ret;
+
+    rsock->fd        = fd;
+    rsock->ready     = 0;
+    rsock->buf       = NULL;
+    rsock->offset    = 0;
+    rsock->length    = 0;
+    rsock->ep        = ep;
+
+    memset(&event, 0, sizeof(event));
+    event.events   = EPOLLIN | EPOLLET;
+    event.data.ptr = rsock;
+    ret = epoll_ctl(iface->epfd, EPOLL_CTL_ADD, fd, &event);
+    if (ret < 0) {
+        ucs_error("epoll_ctl(epfd=%d, ADD, fd=%d) failed: %m", iface->epfd, fd);
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return UCS_OK;
+}
+
+/**
+ * Release the resources of the socket, but do not close it.
+ */
+void uct_tcp_iface_recv_sock_cleanup(uct_tcp_iface_t *iface,
+                                     uct_tcp_recv_sock_t *rsock)
+{
+    if (rsock->ready) {
+        ucs_list_del(&rsock->list);
+        rsock->ready = 0;
+    }
+    if (rsock->buf != NULL) {
+        ucs_mpool_put(rsock->buf);
+        rsock->buf = NULL;
+    }
+}
+
+/* Called from async context, with the async blocked */
+static ucs_status_t uct_tcp_iface_recv_sock_add(uct_tcp_iface_t *iface,
                                                 uct_tcp_recv_sock_t *rsock)
 {
-    int hash_extra_status;
-    khiter_t hash_it;
-
-    hash_it = kh_put(uct_tcp_fd_hash, &iface->fd_hash, fd, &hash_extra_status);
-    if (hash_extra_status == -1) {
-        ucs_error("failed to add socket to hash");
-        return UCS_ERR_NO_MEMORY;
-    } else {
-        ucs_assert_always(hash_it != kh_end(&iface->fd_hash));
-        if (hash_extra_status == 0) {
-            ucs_error("TCP rsock %d already exists [old: %p new: %p]", fd,
-                      kh_value(&iface->fd_hash, hash_it), rsock);
-            return UCS_ERR_ALREADY_EXISTS;
-        } else {
-            ucs_trace("added rsock %d [%p] to hash", fd, rsock);
-            kh_value(&iface->fd_hash, hash_it) = rsock;
-            return UCS_OK;
+    uct_tcp_recv_sock_t **rsocks;
+    int length;
+
+    if (rsock->fd >= iface->rsocks_length) {
+        length = ucs_max(rsock->fd + 1, iface->rsocks_length * 2);
+        rsocks = ucs_realloc(iface->rsocks, length * sizeof(*rsocks),
+                             "tcp_rsocks");
+        if (rsocks == NULL) {
+            ucs_error("failed to grow TCP receive sockets array to %d", length);
+            return UCS_ERR_NO_MEMORY;
         }
+
+        memset(rsocks + iface->rsocks_length, 0,
+               (length - iface->rsocks_length) * sizeof(*rsocks));
+        iface->rsocks        = rsocks;
+        iface->rsocks_length = length;
+    }
+
+    if (iface->rsocks[rsock->fd] != NULL) {
+        ucs_error("TCP rsock %d already exists [old: %p new: %p]", rsock->fd,
+                  iface->rsocks[rsock->fd], rsock);
+        return UCS_ERR_ALREADY_EXISTS;
     }
+
+    ucs_trace("added rsock %d [%p]", rsock->fd, rsock);
+    iface->rsocks[rsock->fd] = rsock;
+    return UCS_OK;
 }
 
 ucs_status_t uct_tcp_iface_connection_accepted(uct_tcp_iface_t *iface, int fd)
@@ -56,7 +107,12 @@ ucs_status_t uct_tcp_iface_connection_accepted(uct_tcp_iface_t *iface, int fd)
         goto err_close;
     }
 
-    status = uct_tcp_iface_recv_sock_add(iface, fd, rsock);
+    status = uct_tcp_iface_recv_sock_init(iface, rsock, fd, NULL);
+    if (status != UCS_OK) {
+        goto err_free;
+    }
+
+    status = uct_tcp_iface_recv_sock_add(iface, rsock);
     if (status != UCS_OK) {
         goto err_free;
     }
@@ -71,23 +127,301 @@ err_close:
 }
 
 static void uct_tcp_iface_recv_sock_destroy(uct_tcp_iface_t *iface,
-                                            uct_tcp_recv_sock_t *rsock, int fd,
-                                            int sync)
+                                            uct_tcp_recv_sock_t *rsock)
 {
+    uct_tcp_iface_recv_sock_cleanup(iface, rsock);
+
+    /* closing the socket also removes it from the epoll set */
+    close(rsock->fd);
     ucs_free(rsock);
-    close(fd);
 }
 
 void uct_tcp_iface_recv_cleanup(uct_tcp_iface_t *iface)
 {
-    uct_tcp_recv_sock_t *rsock;
     int fd;
 
     /* Destroy receive sockets */
     UCS_ASYNC_BLOCK(iface->super.worker->async);
-    kh_foreach(&iface->fd_hash, fd, rsock, {
-        uct_tcp_iface_recv_sock_destroy(iface, rsock, fd, 1);
-    });
-    kh_clear(uct_tcp_fd_hash, &iface->fd_hash);
+    for (fd = 0; fd < iface->rsocks_length; ++fd) {
+        if (iface->rsocks[fd] != NULL) {
+            uct_tcp_iface_recv_sock_destroy(iface, iface->rsocks[fd]);
+        }
+    }
+    ucs_free(iface->rsocks);
+    iface->rsocks        = NULL;
+    iface->rsocks_length = 0;
     UCS_ASYNC_UNBLOCK(iface->super.worker->async);
+
+    if (iface->rx_spare_buf != NULL) {
+        ucs_mpool_put(iface->rx_spare_buf);
+        iface->rx_spare_buf = NULL;
+    }
+}
+
+static UCS_F_ALWAYS_INLINE void *
+uct_tcp_iface_rx_data(uct_tcp_iface_t *iface, uct_tcp_am_desc_t *buf)
+{
+    return (void*)buf + iface->config.rx_offset;
+}
+
+/**
+ * Make sure there is a buffer to switch the socket to, in case the user keeps
+ * the frame which is about to be dispatched. If there is none, the frame stays
+ * in the socket buffer, and the dispatch is retried on the next progress.
+ */
+static UCS_F_ALWAYS_INLINE int
+uct_tcp_iface_recv_get_spare_buf(uct_tcp_iface_t *iface)
+{
+    if (ucs_likely(iface->rx_spare_buf != NULL)) {
+        return 1;
+    }
+
+    UCT_TL_IFACE_GET_RX_DESC(&iface->super, &iface->rx_mp, iface->rx_spare_buf,
+                             return 0);
+    return 1;
+}
+
+/**
+ * Switch the socket to the spare receive buffer, since the user kept a frame
+ * from the current one. The data which was not dispatched yet is moved along.
+ */
+static void uct_tcp_iface_recv_sock_replace_buf(uct_tcp_iface_t *iface,
+                                                uct_tcp_recv_sock_t *rsock)
+{
+    uct_tcp_am_desc_t *buf = iface->rx_spare_buf;
+    size_t remainder;
+
+    ucs_assert(buf != NULL);
+    iface->rx_spare_buf = NULL;
+
+    remainder = rsock->length - rsock->offset;
+    memcpy(uct_tcp_iface_rx_data(iface, buf),
+           uct_tcp_iface_rx_data(iface, rsock->buf) + rsock->offset, remainder);
+
+    rsock->buf    = buf;
+    rsock->offset = 0;
+    rsock->length = remainder;
+}
+
+/**
+ * Check whether the receive buffer of the socket holds a complete frame.
+ */
+static UCS_F_ALWAYS_INLINE int
+uct_tcp_iface_recv_sock_has_frame(uct_tcp_iface_t *iface,
+                                  uct_tcp_recv_sock_t *rsock)
+{
+    uct_tcp_am_hdr_t *hdr;
+
+    if (rsock->length - rsock->offset < sizeof(*hdr)) {
+        return 0;
+    }
+
+    hdr = uct_tcp_iface_rx_data(iface, rsock->buf) + rsock->offset;
+    return rsock->length - rsock->offset >= sizeof(*hdr) + hdr->length;
+}
+
+/**
+ * Pass a reply to an RMA request to the endpoint which sent the request. Only
+ * replies are expected on the RMA connection of an endpoint.
+ */
+static ucs_status_t uct_tcp_iface_recv_reply(uct_tcp_iface_t *iface,
+                                             uct_tcp_recv_sock_t *rsock,
+                                             uint8_t am_id, void *data,
+                                             unsigned length)
+{
+    if ((am_id != UCT_TCP_AM_ID_REPLY) || (rsock->ep == NULL)) {
+        ucs_error("tcp: unexpected frame type %d length %u on socket %d",
+                  am_id, length, rsock->fd);
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return uct_tcp_ep_handle_reply(rsock->ep, data, length);
+}
+
+/**
+ * Dispatch up to max_frames complete frames from the receive buffer of the
+ * socket. The rest stay buffered until the next progress call.
+ *
+ * @return Number of dispatched frames, or a negative error code.
+ */
+static ssize_t uct_tcp_iface_recv_sock_dispatch(uct_tcp_iface_t *iface,
+                                                uct_tcp_recv_sock_t *rsock,
+                                                unsigned max_frames)
+{
+    uct_tcp_am_hdr_t *hdr;
+    ucs_status_t status;
+    unsigned length;
+    ssize_t count;
+    uint8_t am_id;
+    void *data;
+
+    count = 0;
+    while ((count < max_frames) &&
+           (rsock->length - rsock->offset >= sizeof(*hdr))) {
+        hdr = uct_tcp_iface_rx_data(iface, rsock->buf) + rsock->offset;
+        if (ucs_unlikely(hdr->length > iface->config.seg_size - sizeof(*hdr))) {
+            ucs_error("tcp: received frame with invalid length %u (max: %zu)",
+                      hdr->length, iface->config.seg_size - sizeof(*hdr));
+            return UCS_ERR_IO_ERROR;
+        }
+
+        if (rsock->length - rsock->offset < sizeof(*hdr) + hdr->length) {
+            break; /* frame is incomplete */
+        }
+
+        if (ucs_unlikely(!uct_tcp_iface_recv_get_spare_buf(iface))) {
+            break; /* no buffer to switch to, retry on the next progress */
+        }
+
+        /* the user may overwrite the frame header with its headroom */
+        am_id          = hdr->am_id;
+        length         = hdr->length;
+        data           = hdr + 1;
+        rsock->offset += sizeof(*hdr) + length;
+        ++count;
+
+        if (ucs_unlikely(am_id >= UCT_AM_ID_MAX)) {
+            status = uct_tcp_iface_recv_reply(iface, rsock, am_id, data, length);
+            if (status != UCS_OK) {
+                return status;
+            }
+            continue;
+        }
+
+        uct_iface_trace_am(&iface->super, UCT_AM_TRACE_TYPE_RECV, am_id, data,
+                           length, "RX: AM");
+        status = uct_iface_invoke_am(&iface->super, am_id, data, length,
+                                     UCT_CB_FLAG_DESC);
+        if (status == UCS_INPROGRESS) {
+            /* the user owns the buffer now, it would be released by
+             * uct_tcp_iface_release_desc() */
+            uct_recv_desc(data - iface->config.rx_headroom) = &rsock->buf->release;
+            uct_tcp_iface_recv_sock_replace_buf(iface, rsock);
+        }
+    }
+
+    if (rsock->offset == rsock->length) {
+        rsock->offset = rsock->length = 0;
+    }
+    return count;
+}
+
+static UCS_F_ALWAYS_INLINE void
+uct_tcp_iface_recv_sock_set_idle(uct_tcp_recv_sock_t *rsock)
+{
+    /* the next edge would be reported by epoll */
+    ucs_list_del(&rsock->list);
+    rsock->ready = 0;
+}
+
+/**
+ * Read from the socket as much as fits in the receive buffer with a single
+ * system call, and dispatch the received frames.
+ *
+ * @return Number of dispatched frames, or a negative error code.
+ */
+static ssize_t uct_tcp_iface_recv_sock_progress(uct_tcp_iface_t *iface,
+                                                uct_tcp_recv_sock_t *rsock)
+{
+    ssize_t count, ret;
+    size_t max_length;
+    void *rx_data;
+
+    /* frames left over from the previous read are dispatched first */
+    if (rsock->length > rsock->offset) {
+        count = uct_tcp_iface_recv_sock_dispatch(iface, rsock,
+                                                 UCT_TCP_IFACE_RX_MAX_FRAMES);
+        if ((count != 0) || uct_tcp_iface_recv_sock_has_frame(iface, rsock)) {
+            /* keep the socket ready while there are frames to dispatch */
+            return count;
+        }
+    }
+
+    if (ucs_unlikely(rsock->buf == NULL)) {
+        UCT_TL_IFACE_GET_RX_DESC(&iface->super, &iface->rx_mp, rsock->buf,
+                                 return 0);
+    }
+
+    rx_data = uct_tcp_iface_rx_data(iface, rsock->buf);
+    if (rsock->offset > 0) {
+        /* move the beginning of an incomplete frame to the buffer start */
+        memmove(rx_data, rx_data + rsock->offset, rsock->length - rsock->offset);
+        rsock->length -= rsock->offset;
+        rsock->offset  = 0;
+    }
+
+    max_length = iface->config.rx_buf_size - rsock->length;
+    ret        = uct_tcp_socket_recv(rsock->fd, rx_data + rsock->length,
+                                     max_length);
+    if (ret <= 0) {
+        if (ret == 0) {
+            uct_tcp_iface_recv_sock_set_idle(rsock);
+        }
+        return ret;
+    }
+
+    rsock->length += ret;
+    count = uct_tcp_iface_recv_sock_dispatch(iface, rsock,
+                                             UCT_TCP_IFACE_RX_MAX_FRAMES);
+    if ((count >= 0) && (ret < max_length) &&
+        !uct_tcp_iface_recv_sock_has_frame(iface, rsock)) {
+        /* a short read means the socket was drained, and all complete frames
+         * were dispatched */
+        uct_tcp_iface_recv_sock_set_idle(rsock);
+    }
+    return count;
+}
+
+unsigned uct_tcp_iface_recv_progress(uct_tcp_iface_t *iface)
+{
+    struct epoll_event events[UCT_TCP_IFACE_MAX_EVENTS];
+    uct_tcp_recv_sock_t *rsock, *tmp;
+    int i, nevents;
+    unsigned count;
+    ssize_t ret;
+
+    nevents = epoll_wait(iface->epfd, events, UCT_TCP_IFACE_MAX_EVENTS, 0);
+    if (ucs_unlikely(nevents < 0)) {
+        if (errno != EINTR) {
+            ucs_error("epoll_wait(epfd=%d) failed: %m", iface->epfd);
+        }
+        nevents = 0;
+    }
+
+    for (i = 0; i < nevents; ++i) {
+        rsock = events[i].data.ptr;
+        if (!rsock->ready) {
+            ucs_list_add_tail(&iface->rx_ready_list, &rsock->list);
+            rsock->ready = 1;
+        }
+    }
+
+    count = 0;
+    ucs_list_for_each_safe(rsock, tmp, &iface->rx_ready_list, list) {
+        ret = uct_tcp_iface_recv_sock_progress(iface, rsock);
+        if (ucs_likely(ret >= 0)) {
+            count += ret;
+            continue;
+        }
+
+        if (rsock->ep != NULL) {
+            /* the endpoint owns the socket, stop receiving replies on it and
+             * fail the requests which wait for them */
+            ucs_debug("tcp: ep %p stops receiving on fd %d: %s", rsock->ep,
+                      rsock->fd, ucs_status_string(ret));
+            epoll_ctl(iface->epfd, EPOLL_CTL_DEL, rsock->fd, NULL);
+            uct_tcp_iface_recv_sock_cleanup(iface, rsock);
+            uct_tcp_ep_rma_failed(rsock->ep, (ucs_status_t)ret);
+            continue;
+        }
+
+        /* remote side closed the connection, or it is broken */
+        ucs_debug("tcp: closing rsock %d: %s", rsock->fd, ucs_status_string(ret));
+        UCS_ASYNC_BLOCK(iface->super.worker->async);
+        iface->rsocks[rsock->fd] = NULL;
+        UCS_ASYNC_UNBLOCK(iface->super.worker->async);
+        uct_tcp_iface_recv_sock_destroy(iface, rsock);
+    }
+
+    return count;
 }
@@ -0,0 +1,416 @@
+/**
+ * Copyright (C) Mellanox Technologies Ltd. 2001-2017.  ALL RIGHTS RESERVED.
+ *
+ * See file LICENSE for terms.
+ */
+
+#include "tcp.h"
+
+#include <ucs/arch/atomic.h>
+#include <ucs/async/async.h>
+#include <sys/poll.h>
+
+
+static void uct_tcp_rma_sock_destroy(uct_tcp_rma_sock_t *rma_sock)
+{
+    ucs_list_del(&rma_sock->list);
+    close(rma_sock->fd);
+    ucs_free(rma_sock);
+}
+
+/**
+ * Send a reply frame back to the requester. Whatever the socket does not take
+ * is copied to reply_buf, and sent when the socket becomes writable.
+ */
+static ucs_status_t uct_tcp_rma_sock_reply(uct_tcp_rma_sock_t *rma_sock,
+                                           const void *data, size_t length)
+{
+    uct_tcp_am_hdr_t hdr;
+    struct iovec iov[2];
+    ssize_t ret;
+
+    ucs_assert(rma_sock->reply_length == 0);
+
+    hdr.am_id       = UCT_TCP_AM_ID_REPLY;
+    hdr.length      = length;
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len  = sizeof(hdr);
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len  = length;
+
+    ret = uct_tcp_socket_sendv(rma_sock->fd, iov, 2);
+    if (ret < 0) {
+        return (ucs_status_t)ret;
+    } else if (ret == sizeof(hdr) + length) {
+        return UCS_OK;
+    }
+
+    memcpy(rma_sock->reply_buf, &hdr, sizeof(hdr));
+    memcpy(rma_sock->reply_buf + sizeof(hdr), data, length);
+    rma_sock->reply_offset = ret;
+    rma_sock->reply_length = sizeof(hdr) + length;
+    return UCS_OK;
+}
+
+/**
+ * Continue sending the pending reply.
+ */
+static ucs_status_t uct_tcp_rma_sock_reply_progress(uct_tcp_rma_sock_t *rma_sock)
+{
+    struct iovec iov;
+    ssize_t ret;
+
+    iov.iov_base = rma_sock->reply_buf + rma_sock->reply_offset;
+    iov.iov_len  = rma_sock->reply_length - rma_sock->reply_offset;
+
+    ret = uct_tcp_socket_sendv(rma_sock->fd, &iov, 1);
+    if (ret < 0) {
+        return (ucs_status_t)ret;
+    }
+
+    rma_sock->reply_offset += ret;
+    if (rma_sock->reply_offset == rma_sock->reply_length) {
+        rma_sock->reply_length = 0;
+    }
+    return UCS_OK;
+}
+
+/**
+ * Check that [address, address + length) is inside the region which is
+ * registered with rkey_id, and take a reference on the region so it stays
+ * registered while the request accesses it. The md lock is held only for the
+ * lookup.
+ */
+static uct_tcp_memh_t *uct_tcp_rma_sock_get_region(uct_tcp_md_t *md,
+                                                   uint64_t rkey_id,
+                                                   uint64_t address,
+                                                   size_t length)
+{
+    uct_tcp_memh_t *memh;
+    khiter_t iter;
+
+    ucs_spin_lock(&md->lock);
+
+    iter = kh_get(uct_tcp_memh, &md->memhs, rkey_id);
+    if (iter == kh_end(&md->memhs)) {
+        ucs_spin_unlock(&md->lock);
+        ucs_error("tcp: RMA request to unknown region id %"PRIu64, rkey_id);
+        return NULL;
+    }
+
+    memh = kh_value(&md->memhs, iter);
+    if ((address < memh->key.address) || (length > memh->key.length) ||
+        (address - memh->key.address > memh->key.length - length)) {
+        ucs_spin_unlock(&md->lock);
+        ucs_error("tcp: RMA request to 0x%"PRIx64" length %zu is out of "
+                  "region 0x%"PRIx64"..0x%"PRIx64, address, length,
+                  memh->key.address, memh->key.address + memh->key.length);
+        return NULL;
+    }
+
+    ucs_atomic_add32(&memh->refcount, 1);
+    ucs_spin_unlock(&md->lock);
+    return memh;
+}
+
+static void uct_tcp_rma_sock_put_region(uct_tcp_memh_t *memh)
+{
+    ucs_memory_cpu_fence();
+    ucs_atomic_add32(&memh->refcount, -1);
+}
+
+static uint64_t uct_tcp_rma_sock_atomic(const uct_tcp_atomic_hdr_t *hdr)
+{
+    void *ptr = (void*)(uintptr_t)hdr->address;
+
+    if (hdr->size == sizeof(uint32_t)) {
+        switch (hdr->opcode) {
+        case UCT_TCP_ATOMIC_OP_ADD:
+            ucs_atomic_add32(ptr, hdr->value);
+            return 0;
+        case UCT_TCP_ATOMIC_OP_FADD:
+            return ucs_atomic_fadd32(ptr, hdr->value);
+        case UCT_TCP_ATOMIC_OP_SWAP:
+            return ucs_atomic_swap32(ptr, hdr->value);
+        default:
+            return ucs_atomic_cswap32(ptr, hdr->compare, hdr->value);
+        }
+    } else {
+        switch (hdr->opcode) {
+        case UCT_TCP_ATOMIC_OP_ADD:
+            ucs_atomic_add64(ptr, hdr->value);
+            return 0;
+        case UCT_TCP_ATOMIC_OP_FADD:
+            return ucs_atomic_fadd64(ptr, hdr->value);
+        case UCT_TCP_ATOMIC_OP_SWAP:
+            return ucs_atomic_swap64(ptr, hdr->value);
+        default:
+            return ucs_atomic_cswap64(ptr, hdr->compare, hdr->value);
+        }
+    }
+}
+
+/**
+ * Execute a single request frame.
+ */
+static ucs_status_t uct_tcp_rma_sock_handle(uct_tcp_rma_sock_t *rma_sock,
+                                            uint8_t am_id, void *data,
+                                            unsigned length)
+{
+    uct_tcp_md_t *md = ucs_derived_of(rma_sock->iface->super.md, uct_tcp_md_t);
+    uct_tcp_atomic_hdr_t *atomic_hdr;
+    uct_tcp_put_hdr_t *put_hdr;
+    uct_tcp_get_hdr_t *get_hdr;
+    uct_tcp_memh_t *memh;
+    ucs_status_t status;
+    uint32_t result32;
+    uint64_t result;
+
+    switch (am_id) {
+    case UCT_TCP_AM_ID_PUT:
+        put_hdr = data;
+        if (length < sizeof(*put_hdr)) {
+            goto err_invalid;
+        }
+        memh = uct_tcp_rma_sock_get_region(md, put_hdr->rkey_id,
+                                           put_hdr->address,
+                                           length - sizeof(*put_hdr));
+        if (memh == NULL) {
+            return UCS_ERR_IO_ERROR;
+        }
+        ucs_trace_data("RX: PUT [addr 0x%"PRIx64" length %zu]",
+                       put_hdr->address, length - sizeof(*put_hdr));
+        memcpy((void*)(uintptr_t)put_hdr->address, put_hdr + 1,
+               length - sizeof(*put_hdr));
+        uct_tcp_rma_sock_put_region(memh);
+        return UCS_OK;
+    case UCT_TCP_AM_ID_GET_REQ:
+        get_hdr = data;
+        if ((length != sizeof(*get_hdr)) ||
+            (get_hdr->length > rma_sock->iface->config.max_bcopy)) {
+            goto err_invalid;
+        }
+        memh = uct_tcp_rma_sock_get_region(md, get_hdr->rkey_id,
+                                           get_hdr->address,
+                                           get_hdr->length);
+        if (memh == NULL) {
+            return UCS_ERR_IO_ERROR;
+        }
+        ucs_trace_data("RX: GET_REQ [addr 0x%"PRIx64" length %u]",
+                       get_hdr->address, get_hdr->length);
+        /* the reply copies whatever the socket does not take, so the region
+         * is not accessed after it returns */
+        status = uct_tcp_rma_sock_reply(rma_sock,
+                                        (void*)(uintptr_t)get_hdr->address,
+                                        get_hdr->length);
+        uct_tcp_rma_sock_put_region(memh);
+        return status;
+    case UCT_TCP_AM_ID_ATOMIC_REQ:
+        atomic_hdr = data;
+        if ((length != sizeof(*atomic_hdr)) ||
+            ((atomic_hdr->size != sizeof(uint32_t)) &&
+             (atomic_hdr->size != sizeof(uint64_t)))) {
+            goto err_invalid;
+        }
+        memh = uct_tcp_rma_sock_get_region(md, atomic_hdr->rkey_id,
+                                           atomic_hdr->address,
+                                           atomic_hdr->size);
+        if (memh == NULL) {
+            return UCS_ERR_IO_ERROR;
+        }
+        ucs_trace_data("RX: ATOMIC_REQ [op %d size %d addr 0x%"PRIx64"]",
+                       atomic_hdr->opcode, atomic_hdr->size,
+                       atomic_hdr->address);
+        result = uct_tcp_rma_sock_atomic(atomic_hdr);
+        uct_tcp_rma_sock_put_region(memh);
+        /* the result is on the stack, the region is not needed for the reply */
+        if (atomic_hdr->opcode == UCT_TCP_ATOMIC_OP_ADD) {
+            return UCS_OK;
+        } else if (atomic_hdr->size == sizeof(uint32_t)) {
+            result32 = result;
+            return uct_tcp_rma_sock_reply(rma_sock, &result32,
+                                          sizeof(result32));
+        } else {
+            return uct_tcp_rma_sock_reply(rma_sock, &result, sizeof(result));
+        }
+    case UCT_TCP_AM_ID_FLUSH_REQ:
+        /* all previous requests on this connection were already executed */
+        ucs_trace_data("RX: FLUSH_REQ");
+        return uct_tcp_rma_sock_reply(rma_sock, NULL, 0);
+    default:
+        goto err_invalid;
+    }
+
+err_invalid:
+    ucs_error("tcp: unexpected frame type %d length %u on RMA socket %d",
+              am_id, length, rma_sock->fd);
+    return UCS_ERR_IO_ERROR;
+}
+
+/**
+ * Execute the complete requests in the receive buffer. Stops when a reply
+ * could not be sent, so the requester is not flooded with replies it does not
+ * read.
+ */
+static ucs_status_t uct_tcp_rma_sock_dispatch(uct_tcp_rma_sock_t *rma_sock)
+{
+    uct_tcp_am_hdr_t *hdr;
+    ucs_status_t status;
+    size_t offset;
+
+    offset = 0;
+    while ((rma_sock->reply_length == 0) &&
+           (rma_sock->length - offset >= sizeof(*hdr))) {
+        hdr = (uct_tcp_am_hdr_t*)(rma_sock->buf + offset);
+        if (hdr->length > rma_sock->iface->config.seg_size - sizeof(*hdr)) {
+            ucs_error("tcp: received RMA frame with invalid length %u",
+                      hdr->length);
+            return UCS_ERR_IO_ERROR;
+        }
+
+        if (rma_sock->length - offset < sizeof(*hdr) + hdr->length) {
+            break; /* frame is incomplete */
+        }
+
+        status = uct_tcp_rma_sock_handle(rma_sock, hdr->am_id, hdr + 1,
+                                         hdr->length);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        offset += sizeof(*hdr) + hdr->length;
+    }
+
+    /* move the beginning of an incomplete frame to the buffer start */
+    memmove(rma_sock->buf, rma_sock->buf + offset, rma_sock->length - offset);
+    rma_sock->length -= offset;
+    return UCS_OK;
+}
+
+/**
+ * Read all available requests from the socket and execute them. Called from
+ * async context, so requests complete even if the target does not progress.
+ */
+static void uct_tcp_rma_sock_handler(int fd, void *arg)
+{
+    uct_tcp_rma_sock_t *rma_sock = arg;
+    size_t buf_size              = rma_sock->iface->config.rx_buf_size;
+    ucs_status_t status;
+    ssize_t ret;
+
+    if (rma_sock->reply_length > 0) {
+        status = uct_tcp_rma_sock_reply_progress(rma_sock);
+        if (status != UCS_OK) {
+            goto err;
+        } else if (rma_sock->reply_length > 0) {
+            return; /* wait until the socket is writable again */
+        }
+
+        status = ucs_async_modify_handler(fd, POLLIN|POLLERR);
+        if (status != UCS_OK) {
+            goto err;
+        }
+    }
+
+    for (;;) {
+        status = uct_tcp_rma_sock_dispatch(rma_sock);
+        if (status != UCS_OK) {
+            goto err;
+        }
+
+        if (rma_sock->reply_length > 0) {
+            status = ucs_async_modify_handler(fd, POLLOUT|POLLERR);
+            if (status != UCS_OK) {
+                goto err;
+            }
+            return;
+        }
+
+        ret = uct_tcp_socket_recv(fd, rma_sock->buf + rma_sock->length,
+                                  buf_size - rma_sock->length);
+        if (ret == 0) {
+            return; /* no more data */
+        } else if (ret < 0) {
+            status = ret;
+            goto err;
+        }
+
+        rma_sock->length += ret;
+    }
+
+err:
+    ucs_debug("tcp: closing RMA socket %d: %s", fd, ucs_status_string(status));
+    ucs_async_remove_handler(fd, 0);
+    uct_tcp_rma_sock_destroy(rma_sock);
+}
+
+void uct_tcp_iface_rma_connect_handler(int fd, void *arg)
+{
+    uct_tcp_iface_t *iface = arg;
+    uct_tcp_rma_sock_t *rma_sock;
+    ucs_status_t status;
+    int sockfd;
+
+    ucs_assert(fd == iface->rma_listen_fd);
+
+    sockfd = accept(iface->rma_listen_fd, NULL, NULL);
+    if (sockfd < 0) {
+        if (errno != EAGAIN) {
+            ucs_error("accept() failed: %m");
+        }
+        return;
+    }
+
+    status = ucs_sys_fcntl_modfl(sockfd, O_NONBLOCK, 0);
+    if (status != UCS_OK) {
+        goto err_close;
+    }
+
+    status = uct_tcp_iface_set_sockopt(iface, sockfd);
+    if (status != UCS_OK) {
+        goto err_close;
+    }
+
+    rma_sock = ucs_malloc(sizeof(*rma_sock) + iface->config.rx_buf_size +
+                          iface->config.seg_size, "tcp_rma_sock");
+    if (rma_sock == NULL) {
+        ucs_error("Failed to allocate TCP RMA socket");
+        goto err_close;
+    }
+
+    rma_sock->iface        = iface;
+    rma_sock->fd           = sockfd;
+    rma_sock->length       = 0;
+    rma_sock->reply_buf    = rma_sock->buf + iface->config.rx_buf_size;
+    rma_sock->reply_offset = 0;
+    rma_sock->reply_length = 0;
+    ucs_list_add_tail(&iface->rma_sock_list, &rma_sock->list);
+
+    status = ucs_async_set_event_handler(iface->super.worker->async->mode,
+                                         sockfd, POLLIN|POLLERR,
+                                         uct_tcp_rma_sock_handler, rma_sock,
+                                         iface->super.worker->async);
+    if (status != UCS_OK) {
+        uct_tcp_rma_sock_destroy(rma_sock);
+        return;
+    }
+
+    ucs_trace("accepted RMA connection %d [%p]", sockfd, rma_sock);
+    return;
+
+err_close:
+    close(sockfd);
+}
+
+void uct_tcp_iface_rma_cleanup(uct_tcp_iface_t *iface)
+{
+    uct_tcp_rma_sock_t *rma_sock, *tmp;
+
+    /* While the async context is blocked, the socket handlers are not running */
+    UCS_ASYNC_BLOCK(iface->super.worker->async);
+    ucs_list_for_each_safe(rma_sock, tmp, &iface->rma_sock_list, list) {
+        ucs_async_remove_handler(rma_sock->fd, 1);
+        uct_tcp_rma_sock_destroy(rma_sock);
+    }
+    UCS_ASYNC_UNBLOCK(iface->super.worker->async);
+}
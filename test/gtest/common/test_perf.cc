@@ -202,6 +202,7 @@ test_perf::test_result test_perf::run_multi_threaded(const test_spec &test, unsi
     ucs_strncpy_zero(params.uct.tl_name , tl_name.c_str(),  sizeof(params.uct.tl_name));
     params.uct.data_layout = (uct_perf_data_layout_t)test.data_layout;
     params.uct.fc_window   = UCT_PERF_TEST_MAX_FC_WINDOW;
+    params.uct.num_eps     = 1;
     params.msg_size_cnt    = test.msglencnt;
     params.msg_size_list   = (size_t *)test.msglen;
     params.iov_stride      = test.msg_stride;
@@ -13,12 +13,14 @@
 #include <common/test.h>
 #include <common/test_helpers.h>
 #include <pthread.h>
+#include <algorithm>
 #include <sstream>
 #include <stdint.h>
 
 extern "C" {
 #include <ucs/sys/sys.h>
 #include <malloc.h>
+#include <sys/mman.h>
 }
 
 class malloc_hook : public ucs::test {
@@ -48,6 +50,12 @@ protected:
                             " after allocating " << alloc_size << " bytes";
     }
 
+    static void unmapped_size_callback(ucm_event_type_t event_type,
+                                       ucm_event_t *event, void *arg)
+    {
+        *reinterpret_cast<size_t*>(arg) += event->vm_unmapped.size;
+    }
+
 public:
     static int            small_alloc_count;
     static const size_t   small_alloc_size  = 10000;
@@ -344,6 +352,111 @@ UCS_TEST_F(malloc_hook, fork) {
     }
 }
 
+UCS_TEST_F(malloc_hook, many_mmaped_blocks) {
+    /* Each block is above the mmap threshold, so it is mapped directly and
+     * tracked by the set of mmap'ed pointers */
+    static const size_t size  = 300 * 1024;
+    const size_t        count = 10000 / ucs::test_time_multiplier();
+    std::vector<void*>  ptrs;
+    size_t              unmapped_size = 0;
+
+    ucs_status_t result = ucm_set_event_handler(UCM_EVENT_VM_UNMAPPED, 0,
+                                                unmapped_size_callback,
+                                                reinterpret_cast<void*>(&unmapped_size));
+    ASSERT_UCS_OK(result);
+
+    for (size_t i = 0; i < count; ++i) {
+        void *ptr = malloc(size);
+        ASSERT_TRUE(ptr != NULL);
+        ptrs.push_back(ptr);
+    }
+
+    /* release in random order */
+    for (size_t i = count - 1; i > 0; --i) {
+        std::swap(ptrs[i], ptrs[ucs::rand() % (i + 1)]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        free(ptrs[i]);
+    }
+
+    ucm_unset_event_handler(UCM_EVENT_VM_UNMAPPED, unmapped_size_callback,
+                            reinterpret_cast<void*>(&unmapped_size));
+
+    EXPECT_GE(unmapped_size, size * count);
+}
+
+class malloc_hook_handlers : public malloc_hook {
+protected:
+    struct handler_arg {
+        volatile bool valid;
+    };
+
+    static void *unmap_thread_func(void *arg) {
+        malloc_hook_handlers *self = reinterpret_cast<malloc_hook_handlers*>(arg);
+        size_t page_size = sysconf(_SC_PAGESIZE);
+
+        while (!self->m_stop) {
+            void *ptr = mmap(NULL, page_size, PROT_READ|PROT_WRITE,
+                             MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+            if (ptr != MAP_FAILED) {
+                munmap(ptr, page_size);
+            }
+        }
+        return NULL;
+    }
+
+    static void mem_event_callback(ucm_event_type_t event_type, ucm_event_t *event,
+                                   void *arg)
+    {
+        if (!reinterpret_cast<handler_arg*>(arg)->valid) {
+            /* Called after the handler was removed */
+            ucs_atomic_add32(&m_late_calls, 1);
+        }
+    }
+
+    volatile bool            m_stop;
+    static volatile uint32_t m_late_calls;
+};
+
+volatile uint32_t malloc_hook_handlers::m_late_calls = 0;
+
+UCS_TEST_F(malloc_hook_handlers, set_unset_mt) {
+    static const int num_threads = 4;
+    const int        count       = 100 / ucs::test_time_multiplier();
+    std::vector<pthread_t> threads(num_threads);
+    ucs::ptr_vector<handler_arg> args;
+
+    m_stop       = false;
+    m_late_calls = 0;
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_create(&threads[i], NULL, unmap_thread_func,
+                       reinterpret_cast<void*>(this));
+    }
+
+    for (int i = 0; i < count; ++i) {
+        handler_arg *arg = new handler_arg();
+        arg->valid = true;
+        args.push_back(arg);
+
+        ucs_status_t result = ucm_set_event_handler(UCM_EVENT_VM_UNMAPPED, 0,
+                                                    mem_event_callback,
+                                                    reinterpret_cast<void*>(arg));
+        ASSERT_UCS_OK(result);
+
+        ucm_unset_event_handler(UCM_EVENT_VM_UNMAPPED, mem_event_callback,
+                                reinterpret_cast<void*>(arg));
+        /* No callback may run after the handler is removed */
+        arg->valid = false;
+    }
+
+    m_stop = true;
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    EXPECT_EQ(0u, m_late_calls);
+}
+
 class malloc_hook_cplusplus : public malloc_hook {
 public:
 
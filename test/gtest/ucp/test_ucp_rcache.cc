@@ -0,0 +1,200 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2001-2017.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include "ucp_test.h"
+extern "C" {
+#include <ucp/core/ucp_context.h>
+#include <ucp/core/ucp_mm.h>
+#include <uct/base/uct_md.h>
+}
+#include <sys/mman.h>
+
+
+class test_ucp_rcache : public ucp_test {
+public:
+    static ucp_params_t get_ctx_params() {
+        ucp_params_t params = ucp_test::get_ctx_params();
+        params.features |= UCP_FEATURE_TAG;
+        return params;
+    }
+
+    virtual void init() {
+        ucp_test::init();
+
+        m_md_index = find_rcache_md();
+        if (m_md_index == UCP_NULL_RESOURCE) {
+            return;
+        }
+
+        /* count the registrations which reach the memory domain */
+        m_md               = context()->tl_mds[m_md_index].md;
+        m_md_ops_orig      = m_md->ops;
+        m_md_ops           = *m_md->ops;
+        m_md_ops.mem_reg   = mem_reg_count;
+        m_md_ops.mem_dereg = mem_dereg_count;
+        m_md->ops          = &m_md_ops;
+        m_num_reg          = 0;
+        m_num_dereg        = 0;
+    }
+
+    virtual void cleanup() {
+        if (m_md_index != UCP_NULL_RESOURCE) {
+            m_md->ops = m_md_ops_orig;
+        }
+        ucp_test::cleanup();
+    }
+
+protected:
+    ucp_context_h context() {
+        return sender().ucph();
+    }
+
+    ucp_rsc_index_t find_rcache_md() {
+        ucp_rsc_index_t md_index;
+
+        for (md_index = 0; md_index < context()->num_mds; ++md_index) {
+            if (context()->tl_mds[md_index].rcache != NULL) {
+                return md_index;
+            }
+        }
+        return UCP_NULL_RESOURCE;
+    }
+
+    void check_rcache() {
+        if (m_md_index == UCP_NULL_RESOURCE) {
+            UCS_TEST_SKIP_R("no registration cache");
+        }
+    }
+
+    void *map(size_t length) {
+        void *ptr = mmap(NULL, length, PROT_READ|PROT_WRITE,
+                         MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        EXPECT_NE(MAP_FAILED, ptr) << strerror(errno);
+        return ptr;
+    }
+
+    ucp_mem_rcache_region_t *reg(void *address, size_t length) {
+        ucp_mem_rcache_region_t *rregion;
+        ucs_status_t status;
+        uct_mem_h memh;
+
+        status = ucp_mem_buffer_reg(context(), m_md_index, address, length,
+                                    PROT_READ|PROT_WRITE, &memh, &rregion);
+        ASSERT_UCS_OK(status);
+        EXPECT_TRUE(rregion != NULL);
+        return rregion;
+    }
+
+    void dereg(ucp_mem_rcache_region_t *rregion) {
+        ucp_mem_buffer_dereg(context(), m_md_index, rregion->memh, rregion);
+    }
+
+    static ucs_status_t mem_reg_count(uct_md_h md, void *address, size_t length,
+                                      unsigned flags, uct_mem_h *memh_p) {
+        ++m_num_reg;
+        return m_md_ops_orig->mem_reg(md, address, length, flags, memh_p);
+    }
+
+    static ucs_status_t mem_dereg_count(uct_md_h md, uct_mem_h memh) {
+        ++m_num_dereg;
+        return m_md_ops_orig->mem_dereg(md, memh);
+    }
+
+    ucp_rsc_index_t     m_md_index;
+    uct_md_h            m_md;
+    uct_md_ops_t        m_md_ops;
+    static uct_md_ops_t *m_md_ops_orig;
+    static unsigned     m_num_reg;
+    static unsigned     m_num_dereg;
+};
+
+uct_md_ops_t *test_ucp_rcache::m_md_ops_orig = NULL;
+unsigned test_ucp_rcache::m_num_reg          = 0;
+unsigned test_ucp_rcache::m_num_dereg        = 0;
+
+
+UCS_TEST_P(test_ucp_rcache, hit) {
+    const size_t length = 4 * ucs_get_page_size();
+    ucp_mem_rcache_region_t *rregion1, *rregion2;
+    char *buffer;
+
+    check_rcache();
+
+    buffer   = (char*)map(length);
+    rregion1 = reg(buffer, length);
+    EXPECT_EQ(1u, m_num_reg);
+    dereg(rregion1);
+
+    /* the same buffer and a part of it are found in the cache */
+    rregion2 = reg(buffer, length);
+    EXPECT_EQ(rregion1, rregion2);
+    dereg(rregion2);
+
+    rregion2 = reg(buffer + ucs_get_page_size(), ucs_get_page_size());
+    EXPECT_EQ(rregion1, rregion2);
+    dereg(rregion2);
+
+    EXPECT_EQ(1u, m_num_reg);
+    EXPECT_EQ(0u, m_num_dereg);
+
+    munmap(buffer, length);
+}
+
+UCS_TEST_P(test_ucp_rcache, invalidate_on_munmap) {
+    const size_t length = 4 * ucs_get_page_size();
+    ucp_mem_rcache_region_t *rregion;
+    void *buffer;
+
+    check_rcache();
+
+    buffer  = map(length);
+    rregion = reg(buffer, length);
+    dereg(rregion);
+    EXPECT_EQ(0u, m_num_dereg);
+
+    /* the unmapped region is released by the next cache lookup, and new
+     * memory is registered again even if it's mapped at the same address */
+    munmap(buffer, length);
+
+    buffer  = map(length);
+    rregion = reg(buffer, length);
+    dereg(rregion);
+    EXPECT_EQ(1u, m_num_dereg);
+    EXPECT_EQ(2u, m_num_reg);
+
+    munmap(buffer, length);
+}
+
+UCS_TEST_P(test_ucp_rcache, evict, "RCACHE_MAX_REGIONS=2") {
+    const size_t page_size = ucs_get_page_size();
+    ucp_mem_rcache_region_t *rregion[3];
+    char *buffer;
+    int i;
+
+    check_rcache();
+
+    /* three regions separated by a page, so they are not merged */
+    buffer = (char*)map(6 * page_size);
+    for (i = 0; i < 3; ++i) {
+        rregion[i] = reg(buffer + (2 * i * page_size), page_size);
+        dereg(rregion[i]);
+    }
+
+    /* the least recently used region is evicted to make room for the third */
+    EXPECT_EQ(3u, m_num_reg);
+    EXPECT_EQ(1u, m_num_dereg);
+
+    dereg(reg(buffer + (4 * page_size), page_size));
+    EXPECT_EQ(3u, m_num_reg);
+
+    dereg(reg(buffer, page_size));
+    EXPECT_EQ(4u, m_num_reg);
+    EXPECT_EQ(2u, m_num_dereg);
+
+    munmap(buffer, 6 * page_size);
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_rcache)
@@ -9,6 +9,10 @@
 
 #include <common/test_helpers.h>
 
+extern "C" {
+#include <ucp/core/ucp_context.h>
+}
+
 using namespace ucs; /* For vector<char> serialization */
 
 
@@ -36,6 +40,38 @@ public:
                                      test_case_name, tls, RECV_REQ_EXTERNAL, result);
         return result;
     }
+
+protected:
+    static ucp_tag_t hash_grow_tag(unsigned i) {
+        return (i % 2) ? ((ucp_tag_t)i << 40) : ((0xfffffful << 40) | i);
+    }
+
+    /* Check the entries are spread between the buckets, and no bucket is
+     * much longer than the average */
+    template <typename T>
+    void check_hash_spread(T *hash, size_t hash_mask, size_t num_entries) {
+        size_t num_buckets = hash_mask + 1;
+        size_t used = 0, total = 0, max_len = 0, len;
+
+        for (size_t i = 0; i < num_buckets; ++i) {
+            len      = bucket_length(&hash[i]);
+            used    += (len > 0);
+            total   += len;
+            max_len  = ucs_max(max_len, len);
+        }
+
+        EXPECT_EQ(num_entries, total);
+        EXPECT_GE(used, ucs_min(num_entries, num_buckets) / 2);
+        EXPECT_LE(max_len, 16 * ucs_max(num_entries / num_buckets, 1ul));
+    }
+
+    static size_t bucket_length(ucs_queue_head_t *queue) {
+        return ucs_queue_length(queue);
+    }
+
+    static size_t bucket_length(ucs_list_link_t *list) {
+        return ucs_list_length(list);
+    }
 };
 
 UCS_TEST_P(test_ucp_tag_match, send_recv_unexp) {
@@ -364,6 +400,73 @@ UCS_TEST_P(test_ucp_tag_match, send_nb_multiple_recv_unexp) {
     }
 }
 
+UCS_TEST_P(test_ucp_tag_match, send_recv_order_hash_grow) {
+    /* More messages than the initial hash tables hold before they are grown.
+     * Every message has its own tag. Wildcard receives use tags which differ
+     * only in their high bits, and exact receives use tags with all high bits
+     * set, so a wildcard receive never matches an exact tag. */
+    const unsigned  num_requests  = 5000;
+    const ucp_tag_t full_mask     = 0xfffffffffffffffful;
+    const ucp_tag_t wildcard_mask = 0xffffff0000000000ul;
+    ucp_tag_match_t *tm           = &receiver().ucph()->tm;
+    std::vector<uint64_t> recv_data(num_requests, 0);
+    std::vector<request*> recv_reqs;
+    ucp_tag_recv_info_t info;
+    ucs_status_t status;
+    uint64_t send_data;
+
+    /* expected receives must be matched in the order they were posted */
+    for (unsigned i = 0; i < num_requests; ++i) {
+        request *rreq = recv_nb(&recv_data[i], sizeof(recv_data[i]), DATATYPE,
+                                hash_grow_tag(i),
+                                (i % 2) ? wildcard_mask : full_mask);
+        ASSERT_TRUE(!UCS_PTR_IS_ERR(rreq));
+        recv_reqs.push_back(rreq);
+    }
+
+    EXPECT_GT(tm->expected.hash_mask + 1, (size_t)UCP_TAG_MATCH_HASH_SIZE);
+    check_hash_spread(tm->expected.hash, tm->expected.hash_mask, num_requests / 2);
+    check_hash_spread(tm->expected.wildcard, tm->expected.hash_mask,
+                      num_requests / 2);
+
+    for (unsigned i = 0; i < num_requests; ++i) {
+        send_data = i;
+        send_b(&send_data, sizeof(send_data), DATATYPE, hash_grow_tag(i));
+    }
+
+    for (unsigned i = 0; i < num_requests; ++i) {
+        wait(recv_reqs[i]);
+        EXPECT_EQ(UCS_OK, recv_reqs[i]->status);
+        EXPECT_EQ(i, recv_data[i]);
+        request_release(recv_reqs[i]);
+    }
+
+    /* unexpected messages must be matched in the order they arrived */
+    for (unsigned i = 0; i < num_requests; ++i) {
+        send_data = i;
+        send_b(&send_data, sizeof(send_data), DATATYPE, hash_grow_tag(i));
+    }
+
+    ucs_time_t timeout = ucs_get_time() + ucs_time_from_sec(10.0);
+    while ((tm->unexpected.count < num_requests) && (ucs_get_time() < timeout)) {
+        short_progress_loop();
+    }
+    ASSERT_EQ(num_requests, tm->unexpected.count);
+
+    EXPECT_GT(tm->unexpected.hash_mask + 1, (size_t)UCP_TAG_MATCH_HASH_SIZE);
+    check_hash_spread(tm->unexpected.hash, tm->unexpected.hash_mask,
+                      num_requests);
+
+    for (unsigned i = 0; i < num_requests; ++i) {
+        status = recv_b(&recv_data[i], sizeof(recv_data[i]), DATATYPE,
+                        hash_grow_tag(i), (i % 2) ? wildcard_mask : full_mask,
+                        &info);
+        ASSERT_UCS_OK(status);
+        EXPECT_EQ(i, recv_data[i]);
+        EXPECT_EQ(hash_grow_tag(i), info.sender_tag);
+    }
+}
+
 UCS_TEST_P(test_ucp_tag_match, sync_send_unexp) {
     ucp_tag_recv_info_t info;
     ucs_status_t status;
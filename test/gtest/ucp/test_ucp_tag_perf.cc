@@ -19,15 +19,24 @@ public:
     }
 
 protected:
-    static const size_t    COUNT    = 8192;
-    static const ucp_tag_t TAG_MASK = 0xffffffffffffffffUL;
-
-    double check_perf(size_t count, bool is_exp);
-    void check_scalability(double max_growth, bool is_exp, int retries);
-    void do_sends(size_t count);
+    static const size_t    COUNT         = 8192;
+    static const ucp_tag_t TAG_MASK      = 0xffffffffffffffffUL;
+    /* Like MPI_ANY_SOURCE, ignore the low bits which carry the sender */
+    static const ucp_tag_t WILDCARD_MASK = 0xffffffff00000000UL;
+    static const ucp_tag_t SENDER_TAG    = 0x5a;
+
+    double check_perf(size_t count, bool is_exp, bool is_wildcard);
+    void check_scalability(double max_growth, bool is_exp, bool is_wildcard,
+                           int retries);
+    void do_sends(size_t count, bool is_wildcard);
+
+    static ucp_tag_t recv_tag(size_t i, bool is_wildcard) {
+        return is_wildcard ? (i << 32) : i;
+    }
 };
 
-double test_ucp_tag_perf::check_perf(size_t count, bool is_exp)
+double test_ucp_tag_perf::check_perf(size_t count, bool is_exp,
+                                     bool is_wildcard)
 {
     ucs_time_t start_time;
 
@@ -35,14 +44,16 @@ double test_ucp_tag_perf::check_perf(size_t count, bool is_exp)
         std::vector<request*> rreqs;
 
         for (size_t i = 0; i < count; ++i) {
-            request *rreq = recv_nb(NULL, 0, DATATYPE, i, TAG_MASK);
+            request *rreq = recv_nb(NULL, 0, DATATYPE,
+                                    recv_tag(i, is_wildcard),
+                                    is_wildcard ? WILDCARD_MASK : TAG_MASK);
             ucs_assert(!UCS_PTR_IS_ERR(rreq));
             EXPECT_FALSE(rreq->completed);
             rreqs.push_back(rreq);
         }
 
         start_time = ucs_get_time();
-        do_sends(count);
+        do_sends(count, is_wildcard);
         while (!rreqs.empty()) {
             request *rreq = rreqs.back();
             rreqs.pop_back();
@@ -52,7 +63,7 @@ double test_ucp_tag_perf::check_perf(size_t count, bool is_exp)
         ucp_tag_recv_info_t info;
 
         send_b(NULL, 0, DATATYPE, 0xdeadbeef);
-        do_sends(count);
+        do_sends(count, false);
         recv_b(NULL, 0, DATATYPE, 0xdeadbeef, TAG_MASK, &info);
 
         start_time = ucs_get_time();
@@ -64,17 +75,18 @@ double test_ucp_tag_perf::check_perf(size_t count, bool is_exp)
     return ucs_time_to_sec(ucs_get_time() - start_time) / count;
 }
 
-void test_ucp_tag_perf::do_sends(size_t count)
+void test_ucp_tag_perf::do_sends(size_t count, bool is_wildcard)
 {
     size_t i = count;
     while (i > 0) {
         --i;
-        send_b(NULL, 0, DATATYPE, i);
+        send_b(NULL, 0, DATATYPE,
+               is_wildcard ? (recv_tag(i, true) | SENDER_TAG) : i);
     }
 }
 
 void test_ucp_tag_perf::check_scalability(double max_growth, bool is_exp,
-                                          int retries)
+                                          bool is_wildcard, int retries)
 {
     double prev_time = 0.0, total_growth = 0.0, avg_growth;
     size_t n = 0;
@@ -92,7 +104,7 @@ void test_ucp_tag_perf::check_scalability(double max_growth, bool is_exp,
             size_t iters = 10 * ucs_max(1ul, COUNT / count);
             double total_time = 0;
             for (size_t i = 0; i < iters; ++i) {
-                total_time += check_perf(count, is_exp);
+                total_time += check_perf(count, is_exp, is_wildcard);
             }
 
             double time = total_time / iters;
@@ -113,11 +125,15 @@ void test_ucp_tag_perf::check_scalability(double max_growth, bool is_exp,
 }
 
 UCS_TEST_P(test_ucp_tag_perf, multi_exp) {
-    check_scalability(1.5, true, 5);
+    check_scalability(1.5, true, false, 5);
+}
+
+UCS_TEST_P(test_ucp_tag_perf, multi_exp_wildcard) {
+    check_scalability(1.5, true, true, 5);
 }
 
 UCS_TEST_P(test_ucp_tag_perf, multi_unexp) {
-    check_scalability(1.5, false, 5);
+    check_scalability(1.5, false, false, 5);
 }
 
 UCP_INSTANTIATE_TEST_CASE(test_ucp_tag_perf)
@@ -14,6 +14,7 @@ extern "C" {
 
 #include <common/test_helpers.h>
 #include <iostream>
+#include <map>
 
 
 class test_ucp_tag_xfer : public test_ucp_tag {
@@ -644,6 +645,19 @@ UCS_TEST_P(test_ucp_tag_xfer, send_contig_recv_contig_exp_rndv_probe, "RNDV_THRE
     test_xfer_probe(true, true, true, false);
 }
 
+/* rndv data striped over several lanes, if the transports allow it */
+UCS_TEST_P(test_ucp_tag_xfer, contig_exp_rndv_multi_lane, "RNDV_THRESH=1000",
+                                                          "ZCOPY_THRESH=1248576",
+                                                          "MAX_RNDV_LANES=4") {
+    test_xfer(&test_ucp_tag_xfer::test_xfer_contig, true, false, false);
+}
+
+UCS_TEST_P(test_ucp_tag_xfer, contig_unexp_rndv_multi_lane, "RNDV_THRESH=1000",
+                                                            "ZCOPY_THRESH=1248576",
+                                                            "MAX_RNDV_LANES=4") {
+    test_xfer(&test_ucp_tag_xfer::test_xfer_contig, false, false, false);
+}
+
 /* rndv send_generic_recv_generic am_rndv with bcopy on the sender side */
 
 UCS_TEST_P(test_ucp_tag_xfer, send_generic_recv_generic_exp_rndv, "RNDV_THRESH=1000") {
@@ -845,6 +859,222 @@ UCS_TEST_P(test_ucp_tag_xfer, send_contig_recv_generic_exp_rndv_probe_zcopy, "RN
 UCP_INSTANTIATE_TEST_CASE(test_ucp_tag_xfer)
 
 
+class test_ucp_tag_rndv_lanes : public test_ucp_tag_xfer {
+public:
+    virtual void cleanup() {
+        restore_get_zcopy();
+        test_ucp_tag_xfer::cleanup();
+    }
+
+protected:
+    typedef ucs_status_t (*get_zcopy_func_t)(uct_ep_h ep, const uct_iov_t *iov,
+                                             size_t iovcnt, uint64_t remote_addr,
+                                             uct_rkey_t rkey,
+                                             uct_completion_t *comp);
+
+    static ucs_status_t get_zcopy_count(uct_ep_h ep, const uct_iov_t *iov,
+                                        size_t iovcnt, uint64_t remote_addr,
+                                        uct_rkey_t rkey, uct_completion_t *comp)
+    {
+        ucs_status_t status;
+        size_t length;
+
+        length = 0;
+        for (size_t i = 0; i < iovcnt; ++i) {
+            length += iov[i].length * iov[i].count;
+        }
+
+        status = m_get_zcopy_orig[ep->iface](ep, iov, iovcnt, remote_addr,
+                                             rkey, comp);
+        if ((status == UCS_OK) || (status == UCS_INPROGRESS)) {
+            m_get_bytes[ep] += length;
+        }
+        return status;
+    }
+
+    /* the transport can't read the sender's memory, as CMA which is denied
+     * access to the peer process */
+    static ucs_status_t get_zcopy_fail(uct_ep_h ep, const uct_iov_t *iov,
+                                       size_t iovcnt, uint64_t remote_addr,
+                                       uct_rkey_t rkey, uct_completion_t *comp)
+    {
+        ++m_get_failures;
+        return UCS_ERR_IO_ERROR;
+    }
+
+    /* the endpoint which the receiver uses to fetch the data, it's created
+     * when the first rendezvous request arrives */
+    ucp_ep_h receiver_ep() {
+        return ucp_worker_ep_find(receiver().worker(), sender().worker()->uuid);
+    }
+
+    void complete_wireup() {
+        test_xfer_contig(m_size, true, false, false);
+    }
+
+    ucp_lane_index_t rndv_lane(int index) {
+        return ucp_ep_config(receiver_ep())->key.rndv_lanes[index];
+    }
+
+    unsigned num_rndv_lanes() {
+        unsigned count = 0;
+        if (receiver_ep() == NULL) {
+            return 0;
+        }
+        while ((count < UCP_MAX_RNDV_LANES) &&
+               (rndv_lane(count) != UCP_NULL_LANE)) {
+            ++count;
+        }
+        return count;
+    }
+
+    uct_ep_h rndv_uct_ep(int index) {
+        return receiver_ep()->uct_eps[rndv_lane(index)];
+    }
+
+    void replace_get_zcopy(get_zcopy_func_t func) {
+        for (unsigned i = 0; i < num_rndv_lanes(); ++i) {
+            uct_iface_h iface = rndv_uct_ep(i)->iface;
+            if (m_get_zcopy_orig.find(iface) == m_get_zcopy_orig.end()) {
+                m_get_zcopy_orig[iface] = iface->ops.ep_get_zcopy;
+            }
+            iface->ops.ep_get_zcopy = func;
+        }
+        m_get_bytes.clear();
+        m_get_failures = 0;
+    }
+
+    /* count the bytes which the receiver fetches with get_zcopy on each of
+     * the rendezvous lanes */
+    void count_get_zcopy() {
+        replace_get_zcopy(get_zcopy_count);
+    }
+
+    void restore_get_zcopy() {
+        for (std::map<uct_iface_h, get_zcopy_func_t>::iterator iter =
+                        m_get_zcopy_orig.begin();
+             iter != m_get_zcopy_orig.end(); ++iter) {
+            iter->first->ops.ep_get_zcopy = iter->second;
+        }
+        m_get_zcopy_orig.clear();
+    }
+
+    size_t get_bytes(int index) {
+        std::map<uct_ep_h, size_t>::const_iterator iter =
+                        m_get_bytes.find(rndv_uct_ep(index));
+        return (iter == m_get_bytes.end()) ? 0 : iter->second;
+    }
+
+    size_t total_get_bytes() {
+        size_t total = 0;
+        for (unsigned i = 0; i < num_rndv_lanes(); ++i) {
+            total += get_bytes(i);
+        }
+        return total;
+    }
+
+    static const size_t                          m_size;
+    static std::map<uct_iface_h, get_zcopy_func_t> m_get_zcopy_orig;
+    static std::map<uct_ep_h, size_t>            m_get_bytes;
+    static unsigned                              m_get_failures;
+};
+
+const size_t test_ucp_tag_rndv_lanes::m_size = 1148544;
+std::map<uct_iface_h, test_ucp_tag_rndv_lanes::get_zcopy_func_t>
+                test_ucp_tag_rndv_lanes::m_get_zcopy_orig;
+std::map<uct_ep_h, size_t> test_ucp_tag_rndv_lanes::m_get_bytes;
+unsigned test_ucp_tag_rndv_lanes::m_get_failures = 0;
+
+/* the receiver reads the whole message from the sender's buffer with
+ * get_zcopy, so every byte is copied once */
+UCS_TEST_P(test_ucp_tag_rndv_lanes, single_copy, "RNDV_THRESH=1000",
+                                                 "ZCOPY_THRESH=1248576") {
+    complete_wireup();
+    if (num_rndv_lanes() == 0) {
+        UCS_TEST_SKIP_R("no rendezvous lane");
+    }
+
+    count_get_zcopy();
+    test_xfer_contig(m_size, true, false, false);
+    EXPECT_EQ(m_size, total_get_bytes());
+}
+
+/* if the receiver fails to fetch the data, the sender sends it with active
+ * messages instead */
+UCS_TEST_P(test_ucp_tag_rndv_lanes, get_zcopy_fallback, "RNDV_THRESH=1000",
+                                                        "ZCOPY_THRESH=1248576") {
+    complete_wireup();
+    if (num_rndv_lanes() == 0) {
+        UCS_TEST_SKIP_R("no rendezvous lane");
+    }
+
+    replace_get_zcopy(get_zcopy_fail);
+    test_xfer_contig(m_size, true, false, false);
+    EXPECT_GT(m_get_failures, 0u);
+
+    /* the data of the next message is fetched again once the lane works */
+    restore_get_zcopy();
+    count_get_zcopy();
+    test_xfer_contig(m_size, true, false, false);
+    EXPECT_EQ(m_size, total_get_bytes());
+}
+
+/* with several devices of comparable bandwidth, the rendezvous data is split
+ * between lanes on different devices, and each of them fetches a part of it */
+UCS_TEST_P(test_ucp_tag_rndv_lanes, multi_lane, "RNDV_THRESH=1000",
+                                                "ZCOPY_THRESH=1248576",
+           "MAX_RNDV_LANES=" UCS_PP_MAKE_STRING(UCP_MAX_RNDV_LANES)) {
+    ucp_context_h context = receiver().ucph();
+    ucp_rsc_index_t rsc_index1, rsc_index2;
+
+    complete_wireup();
+    if (num_rndv_lanes() < 2) {
+        UCS_TEST_SKIP_R("less than two rendezvous devices");
+    }
+
+    for (unsigned i = 0; i < num_rndv_lanes(); ++i) {
+        rsc_index1 = ucp_ep_get_rsc_index(receiver_ep(), rndv_lane(i));
+        for (unsigned j = 0; j < i; ++j) {
+            rsc_index2 = ucp_ep_get_rsc_index(receiver_ep(), rndv_lane(j));
+            EXPECT_STRNE(context->tl_rscs[rsc_index1].tl_rsc.dev_name,
+                         context->tl_rscs[rsc_index2].tl_rsc.dev_name);
+        }
+    }
+
+    count_get_zcopy();
+    test_xfer_contig(m_size, true, false, false);
+    for (unsigned i = 0; i < num_rndv_lanes(); ++i) {
+        EXPECT_GT(get_bytes(i), 0u) << "rendezvous lane " << i;
+    }
+    EXPECT_EQ(m_size, total_get_bytes());
+}
+
+/* Any lane is accepted regardless of its bandwidth, so shared memory and tcp
+ * lanes are striped over even on a single-device host */
+UCS_TEST_P(test_ucp_tag_rndv_lanes, two_lanes, "RNDV_THRESH=1000",
+                                               "ZCOPY_THRESH=1248576",
+                                               "MAX_RNDV_LANES=2",
+                                               "RNDV_MIN_BW_RATIO=0") {
+    complete_wireup();
+    if (num_rndv_lanes() < 2) {
+        UCS_TEST_SKIP_R("less than two rendezvous transports");
+    }
+
+    EXPECT_EQ(2u, num_rndv_lanes());
+    for (unsigned iter = 0; iter < 3; ++iter) {
+        count_get_zcopy();
+        test_xfer_contig(m_size, true, false, false);
+        for (unsigned i = 0; i < num_rndv_lanes(); ++i) {
+            EXPECT_GT(get_bytes(i), 0u) << "rendezvous lane " << i;
+        }
+        EXPECT_EQ(m_size, total_get_bytes());
+    }
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_tag_rndv_lanes)
+UCP_INSTANTIATE_TEST_CASE_TLS(test_ucp_tag_rndv_lanes, shm_tcp, "shm,tcp")
+
+
 #if ENABLE_STATS
 
 class test_ucp_tag_stats : public test_ucp_tag_xfer {
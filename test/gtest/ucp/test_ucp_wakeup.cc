@@ -8,6 +8,11 @@
 #include "poll.h"
 
 #include <algorithm>
+#include <pthread.h>
+
+extern "C" {
+#include <ucp/core/ucp_context.h>
+}
 
 class test_ucp_wakeup : public ucp_test {
 public:
@@ -114,6 +119,118 @@ UCS_TEST_P(test_ucp_wakeup, signal)
 
 UCP_INSTANTIATE_TEST_CASE(test_ucp_wakeup)
 
+class test_ucp_wakeup_wait : public test_ucp_wakeup {
+public:
+    static std::vector<ucp_test_param>
+    enum_test_params(const ucp_params_t& ctx_params,
+                     const ucp_worker_params_t& worker_params,
+                     const ucp_ep_params_t& ep_params,
+                     const std::string& name,
+                     const std::string& test_case_name,
+                     const std::string& tls)
+    {
+        std::vector<ucp_test_param> result;
+        for (int mode = 0; mode < UCP_WAIT_MODE_LAST; ++mode) {
+            generate_test_params_variant(ctx_params, worker_params, ep_params,
+                                         name, test_case_name + "/" +
+                                         wait_mode_names[mode], tls, mode,
+                                         result);
+        }
+        return result;
+    }
+
+    virtual void init() {
+        modify_config("WAIT_MODE", wait_mode_names[GetParam().variant]);
+        test_ucp_wakeup::init();
+    }
+
+protected:
+    /* Wait for the request completion with ucp_worker_wait() */
+    void wait_sleep(ucp_worker_h worker, void *req) {
+        progress();
+        while (!ucp_request_is_completed(req)) {
+            ASSERT_UCS_OK(ucp_worker_wait(worker));
+            progress();
+        }
+        ucp_request_release(req);
+    }
+
+    static void *signal_thread(void *arg) {
+        test_ucp_wakeup_wait *self = reinterpret_cast<test_ucp_wakeup_wait*>(arg);
+
+        /* Signal until the waiter returns, since a signal which arrives before
+         * the waiter is armed is consumed by the arm */
+        while (!self->m_done) {
+            ASSERT_UCS_OK(ucp_worker_signal(self->receiver().worker()));
+            usleep(1000);
+        }
+        return NULL;
+    }
+
+    static const char *wait_mode_names[];
+    volatile bool m_done;
+};
+
+/* Indexed by ucp_wait_mode_t */
+const char *test_ucp_wakeup_wait::wait_mode_names[] = {
+    "sleep", "poll", "spin", "adaptive"
+};
+
+UCS_TEST_P(test_ucp_wakeup_wait, tag)
+{
+    const ucp_datatype_t DATATYPE = ucp_dt_make_contig(1);
+    const uint64_t TAG            = 0xdeadbeef;
+    uint64_t send_data, recv_data;
+    void *sreq, *rreq;
+
+    sender().connect(&receiver());
+
+    for (int i = 0; i < 100 / ucs::test_time_multiplier(); ++i) {
+        send_data = i;
+        recv_data = 0;
+        rreq = ucp_tag_recv_nb(receiver().worker(), &recv_data,
+                               sizeof(recv_data), DATATYPE, TAG, (ucp_tag_t)-1,
+                               recv_completion);
+        ASSERT_TRUE(UCS_PTR_IS_PTR(rreq));
+
+        sreq = ucp_tag_send_nb(sender().ep(), &send_data, sizeof(send_data),
+                               DATATYPE, TAG, send_completion);
+        if (UCS_PTR_IS_PTR(sreq)) {
+            wait(sreq);
+        } else {
+            ASSERT_UCS_OK(UCS_PTR_STATUS(sreq));
+        }
+
+        wait_sleep(receiver().worker(), rreq);
+        EXPECT_EQ(send_data, recv_data);
+    }
+
+    ucp_worker_flush(sender().worker());
+}
+
+UCS_TEST_P(test_ucp_wakeup_wait, signal)
+{
+    pthread_t thread;
+
+    m_done = false;
+    pthread_create(&thread, NULL, signal_thread, reinterpret_cast<void*>(this));
+    EXPECT_UCS_OK(ucp_worker_wait(receiver().worker()));
+    m_done = true;
+    pthread_join(thread, NULL);
+}
+
+UCS_TEST_P(test_ucp_wakeup_wait, poll_timeout, "WAIT_SPIN_TIME=1ms")
+{
+    if (GetParam().variant != UCP_WAIT_MODE_POLL) {
+        UCS_TEST_SKIP_R("not poll mode");
+    }
+
+    /* returns after the spin time, also without an event */
+    EXPECT_UCS_OK(ucp_worker_wait(receiver().worker()));
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_wakeup_wait)
+
 class test_ucp_wakeup_events : public test_ucp_wakeup
 {
 public:
@@ -15,6 +15,9 @@ extern "C" {
 }
 
 #include <sys/poll.h>
+#include <sched.h>
+#include <set>
+#include <vector>
 
 
 class base {
@@ -376,6 +379,34 @@ UCS_TEST_P(test_async, global_timer) {
     EXPECT_GE(gt.count(), COUNT / 4);
 }
 
+UCS_TEST_P(test_async, many_timers) {
+    static const unsigned NUM_TIMERS = 100;
+    std::vector<global_timer*> timers;
+
+    /* Add timers while others are removed, so the table of timers grows and
+     * timer IDs are reused */
+    for (unsigned iter = 0; iter < 3; ++iter) {
+        while (timers.size() < NUM_TIMERS) {
+            timers.push_back(new global_timer(GetParam()));
+        }
+
+        suspend_and_poll(timers.front(), COUNT);
+        for (unsigned i = 0; i < timers.size(); ++i) {
+            EXPECT_GE(timers[i]->count(), 1) << "timer " << i;
+        }
+
+        for (unsigned i = 0; i < timers.size(); ++i) {
+            delete timers[i];
+            timers.erase(timers.begin() + i);
+        }
+    }
+
+    while (!timers.empty()) {
+        delete timers.back();
+        timers.pop_back();
+    }
+}
+
 UCS_TEST_P(test_async, max_events, "ASYNC_MAX_EVENTS=4") {
     ucs_status_t status;
     ucs_async_context_t async;
@@ -540,6 +571,28 @@ UCS_TEST_P(test_async, event_unset_from_handler) {
     EXPECT_EQ(1, le.count());
 }
 
+UCS_TEST_P(test_async, modify_event) {
+    local_event le(GetParam());
+    ucs_status_t status;
+
+    if (GetParam() != UCS_ASYNC_MODE_THREAD) {
+        UCS_TEST_SKIP_R("the handler is not filtered by events in this mode");
+    }
+
+    status = ucs_async_modify_handler(le.event_id(), 0);
+    ASSERT_UCS_OK(status);
+
+    le.push_event();
+    suspend_and_poll(&le, COUNT);
+    EXPECT_EQ(0, le.count());
+
+    status = ucs_async_modify_handler(le.event_id(), POLLIN);
+    ASSERT_UCS_OK(status);
+
+    suspend_and_poll(&le, COUNT);
+    EXPECT_GE(le.count(), 1);
+}
+
 class local_event_add_handler : public local_event {
 public:
     local_event_add_handler(ucs_async_mode_t mode) :
@@ -590,6 +643,132 @@ UCS_TEST_P(test_async, event_add_from_handler) {
     le.unset_handler(1);
 }
 
+class local_timer_thread : public local_timer {
+public:
+    local_timer_thread(ucs_async_mode_t mode) : local_timer(mode), m_cpu(-1) {
+    }
+
+    pthread_t thread() const {
+        return m_thread;
+    }
+
+    int cpu() const {
+        return m_cpu;
+    }
+
+protected:
+    virtual void handler() {
+         m_thread = pthread_self();
+         m_cpu    = sched_getcpu();
+         base::handler();
+    }
+
+    pthread_t m_thread;
+    int       m_cpu;
+};
+
+class test_async_thread_pool : public test_async {
+protected:
+    virtual void init() {
+        test_async::init();
+        ASSERT_EQ(0, sched_getaffinity(0, sizeof(m_orig_cpus), &m_orig_cpus));
+    }
+
+    virtual void cleanup() {
+        sched_setaffinity(0, sizeof(m_orig_cpus), &m_orig_cpus);
+        test_async::cleanup();
+    }
+
+    bool cpu_allowed(int cpu) const {
+        return CPU_ISSET(cpu, &m_orig_cpus);
+    }
+
+    /* Create a context while the calling thread runs on the given CPU */
+    local_timer_thread *create_on_cpu(int cpu) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        EXPECT_EQ(0, sched_setaffinity(0, sizeof(cpus), &cpus));
+        return new local_timer_thread(GetParam());
+    }
+
+    cpu_set_t m_orig_cpus;
+};
+
+/*
+ * All threads share CPU 0, so the contexts created on it are spread between
+ * the threads of the pool.
+ */
+UCS_TEST_P(test_async_thread_pool, spread_shared_cpu, "ASYNC_THREADS=4",
+           "ASYNC_THREAD_AFFINITY=0")
+{
+    static const unsigned NUM_CONTEXTS = 4;
+    local_timer_thread *lt[NUM_CONTEXTS];
+    std::set<pthread_t> threads;
+
+    if (!cpu_allowed(0)) {
+        UCS_TEST_SKIP_R("cpu 0 is not allowed");
+    }
+
+    for (unsigned i = 0; i < NUM_CONTEXTS; ++i) {
+        lt[i] = create_on_cpu(0);
+    }
+
+    for (unsigned i = 0; i < NUM_CONTEXTS; ++i) {
+        suspend_and_poll(lt[i], COUNT);
+        EXPECT_GE(lt[i]->count(), 1);
+        threads.insert(lt[i]->thread());
+    }
+
+    EXPECT_EQ(NUM_CONTEXTS, threads.size());
+
+    for (unsigned i = 0; i < NUM_CONTEXTS; ++i) {
+        delete lt[i];
+    }
+}
+
+/*
+ * Every thread owns a single CPU: a context gets the thread which owns the CPU
+ * it was created on, and contexts created on the same CPU share the thread.
+ */
+UCS_TEST_P(test_async_thread_pool, cpu_locality, "ASYNC_THREADS=4",
+           "ASYNC_THREAD_AFFINITY=0-3")
+{
+    static const int NUM_CPUS = 4;
+    local_timer_thread *lt[NUM_CPUS][2];
+    std::set<pthread_t> threads;
+
+    for (int cpu = 0; cpu < NUM_CPUS; ++cpu) {
+        if (!cpu_allowed(cpu)) {
+            UCS_TEST_SKIP_R("cpus 0-3 are not allowed");
+        }
+    }
+
+    for (int cpu = 0; cpu < NUM_CPUS; ++cpu) {
+        lt[cpu][0] = create_on_cpu(cpu);
+        lt[cpu][1] = create_on_cpu(cpu);
+    }
+
+    for (int cpu = 0; cpu < NUM_CPUS; ++cpu) {
+        for (int i = 0; i < 2; ++i) {
+            suspend_and_poll(lt[cpu][i], COUNT);
+            EXPECT_GE(lt[cpu][i]->count(), 1);
+            /* The thread is bound to the CPU the context was created on */
+            EXPECT_EQ(cpu, lt[cpu][i]->cpu());
+        }
+        EXPECT_EQ(lt[cpu][0]->thread(), lt[cpu][1]->thread());
+        threads.insert(lt[cpu][0]->thread());
+    }
+
+    EXPECT_EQ(static_cast<size_t>(NUM_CPUS), threads.size());
+
+    for (int cpu = 0; cpu < NUM_CPUS; ++cpu) {
+        delete lt[cpu][0];
+        delete lt[cpu][1];
+    }
+}
+
 typedef test_async_mt<local_event> test_async_event_mt;
 typedef test_async_mt<local_timer> test_async_timer_mt;
 
@@ -635,6 +814,7 @@ UCS_TEST_P(test_async_timer_mt, multithread) {
 INSTANTIATE_TEST_CASE_P(signal, test_async, ::testing::Values(UCS_ASYNC_MODE_SIGNAL));
 INSTANTIATE_TEST_CASE_P(thread, test_async, ::testing::Values(UCS_ASYNC_MODE_THREAD));
 INSTANTIATE_TEST_CASE_P(poll,   test_async, ::testing::Values(UCS_ASYNC_MODE_POLL));
+INSTANTIATE_TEST_CASE_P(thread, test_async_thread_pool, ::testing::Values(UCS_ASYNC_MODE_THREAD));
 INSTANTIATE_TEST_CASE_P(signal, test_async_event_mt, ::testing::Values(UCS_ASYNC_MODE_SIGNAL));
 INSTANTIATE_TEST_CASE_P(thread, test_async_event_mt, ::testing::Values(UCS_ASYNC_MODE_THREAD));
 INSTANTIATE_TEST_CASE_P(poll,   test_async_event_mt, ::testing::Values(UCS_ASYNC_MODE_POLL));
@@ -11,6 +11,7 @@ extern "C" {
 }
 
 #include <fstream>
+#include <vector>
 #include <set>
 
 
@@ -19,17 +20,23 @@ extern "C" {
 class scoped_profile {
 public:
     scoped_profile(ucs::test_base& test, const std::string &file_name,
-                   const char *mode) : m_test(test), m_file_name(file_name)
+                   const char *mode, const char *stream = "n",
+                   const char *log_size = "4m") :
+                   m_test(test), m_file_name(file_name)
 {
         ucs_profile_global_cleanup();
         m_test.push_config();
         m_test.modify_config("PROFILE_MODE", mode);
         m_test.modify_config("PROFILE_FILE", m_file_name.c_str());
+        m_test.modify_config("PROFILE_STREAM", stream);
+        m_test.modify_config("PROFILE_LOG_SIZE", log_size);
         ucs_profile_global_init();
     }
 
-    std::string read() {
-        ucs_profile_dump();
+    std::string read(bool dump = true) {
+        if (dump) {
+            ucs_profile_dump();
+        }
         std::ifstream f(m_file_name.c_str());
         return std::string(std::istreambuf_iterator<char>(f),
                            std::istreambuf_iterator<char>());
@@ -52,9 +59,15 @@ public:
     static const int   MIN_LINE;
     static const int   MAX_LINE;
 
+    static const int   NUM_LOCATIONS = 12;
+
     void test_header(ucs_profile_header_t *hdr, unsigned exp_mode);
     void test_locations(ucs_profile_location_t *locations, unsigned num_locations,
                         uint64_t exp_count);
+    void test_thread(ucs_profile_location_t *locations,
+                     ucs_profile_thread_header_t *thread_hdr, int iters);
+
+    static void *profile_thread_func(void *arg);
 };
 
 const char* test_profile::UCS_PROFILE_FILENAME = "test.prof";
@@ -85,6 +98,16 @@ UCS_PROFILE_FUNC(int, profile_test_func2, (a, b), int a, int b)
 
 const int test_profile::MAX_LINE = __LINE__;
 
+void *test_profile::profile_thread_func(void *arg)
+{
+    int iters = *(int*)arg;
+    for (int i = 0; i < iters; ++i) {
+        profile_test_func1();
+        profile_test_func2(1, 2);
+    }
+    return NULL;
+}
+
 void test_profile::test_header(ucs_profile_header_t *hdr, unsigned exp_mode)
 {
     EXPECT_EQ(std::string(ucs_get_host_name()), std::string(hdr->hostname));
@@ -125,12 +148,46 @@ UCS_TEST_F(test_profile, accum) {
     ucs_profile_header_t *hdr = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
     test_header(hdr, UCS_BIT(UCS_PROFILE_MODE_ACCUM));
 
-    EXPECT_EQ(12u, hdr->num_locations);
+    EXPECT_EQ((unsigned)NUM_LOCATIONS, hdr->num_locations);
     test_locations(reinterpret_cast<ucs_profile_location_t*>(hdr + 1),
                    hdr->num_locations,
                    1);
 
     EXPECT_EQ(0u, hdr->num_records);
+    EXPECT_EQ(1u, hdr->num_segments);
+}
+
+void test_profile::test_thread(ucs_profile_location_t *locations,
+                               ucs_profile_thread_header_t *thread_hdr,
+                               int iters)
+{
+    EXPECT_EQ(NUM_LOCATIONS * iters, (int)thread_hdr->num_records);
+
+    ucs_profile_record_t *records =
+                    reinterpret_cast<ucs_profile_record_t*>(thread_hdr + 1);
+    uint64_t prev_ts = records[0].timestamp;
+    int nesting      = 0;
+    EXPECT_GE(prev_ts, thread_hdr->start_time);
+    for (uint64_t i = 0; i < thread_hdr->num_records; ++i) {
+        ucs_profile_record_t *rec = &records[i];
+        EXPECT_GE(rec->location, 0u);
+        EXPECT_LT(rec->location, (unsigned)NUM_LOCATIONS);
+        EXPECT_GE(rec->timestamp, prev_ts);
+        prev_ts = rec->timestamp;
+        ucs_profile_location_t *loc = &locations[rec->location];
+        if ((loc->type == UCS_PROFILE_TYPE_REQUEST_NEW) ||
+            (loc->type == UCS_PROFILE_TYPE_REQUEST_EVENT) ||
+            (loc->type == UCS_PROFILE_TYPE_REQUEST_FREE))
+        {
+            EXPECT_EQ((uintptr_t)&test_request, rec->param64);
+        } else if (loc->type == UCS_PROFILE_TYPE_SCOPE_BEGIN) {
+            ++nesting;
+        } else if (loc->type == UCS_PROFILE_TYPE_SCOPE_END) {
+            --nesting;
+            EXPECT_GE(nesting, 0);
+        }
+    }
+    EXPECT_EQ(0, nesting);
 }
 
 UCS_TEST_F(test_profile, log) {
@@ -145,28 +202,136 @@ UCS_TEST_F(test_profile, log) {
     ucs_profile_header_t *hdr = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
     test_header(hdr, UCS_BIT(UCS_PROFILE_MODE_LOG));
 
-    EXPECT_EQ(12u, hdr->num_locations);
+    EXPECT_EQ((unsigned)NUM_LOCATIONS, hdr->num_locations);
     ucs_profile_location_t *locations = reinterpret_cast<ucs_profile_location_t*>(hdr + 1);
     test_locations(locations, hdr->num_locations, 0);
 
-    EXPECT_EQ(12 * ITER, (int)hdr->num_records);
-    ucs_profile_record_t *records = reinterpret_cast<ucs_profile_record_t*>(locations +
-                                                                            hdr->num_locations);
-    uint64_t prev_ts = records[0].timestamp;
-    for (uint64_t i = 0; i < hdr->num_records; ++i) {
-        ucs_profile_record_t *rec = &records[i];
-        EXPECT_GE(rec->location, 0u);
-        EXPECT_LT(rec->location, 12u);
-        EXPECT_GE(rec->timestamp, prev_ts);
-        prev_ts = rec->timestamp;
-        ucs_profile_location_t *loc = &locations[rec->location];
-        if ((loc->type == UCS_PROFILE_TYPE_REQUEST_NEW) ||
-            (loc->type == UCS_PROFILE_TYPE_REQUEST_EVENT) ||
-            (loc->type == UCS_PROFILE_TYPE_REQUEST_FREE))
-        {
-            EXPECT_EQ((uintptr_t)&test_request, rec->param64);
+    EXPECT_EQ(NUM_LOCATIONS * ITER, (int)hdr->num_records);
+    ASSERT_EQ(1u, hdr->num_segments);
+    ucs_profile_thread_header_t *thread_hdr =
+                    reinterpret_cast<ucs_profile_thread_header_t*>(&data[0] +
+                                                                   hdr->segments_offset);
+    EXPECT_EQ(ucs_get_tid(), (pid_t)thread_hdr->tid);
+    test_thread(locations, thread_hdr, ITER);
+}
+
+UCS_TEST_F(test_profile, log_mt) {
+    static const int ITER        = 5;
+    static const int NUM_THREADS = 4;
+    scoped_profile p(*this, UCS_PROFILE_FILENAME, "accum,log");
+    std::vector<pthread_t> threads(NUM_THREADS);
+    int iters = ITER;
+
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_create(&threads[i], NULL, profile_thread_func, &iters);
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    std::string data = p.read();
+    ucs_profile_header_t *hdr = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
+    test_header(hdr, UCS_BIT(UCS_PROFILE_MODE_ACCUM) |
+                     UCS_BIT(UCS_PROFILE_MODE_LOG));
+
+    /* accumulated counts are summed over all threads */
+    EXPECT_EQ((unsigned)NUM_LOCATIONS, hdr->num_locations);
+    ucs_profile_location_t *locations = reinterpret_cast<ucs_profile_location_t*>(hdr + 1);
+    test_locations(locations, hdr->num_locations, NUM_THREADS * ITER);
+
+    /* every thread has its own section with a complete timeline */
+    EXPECT_EQ(NUM_LOCATIONS * ITER * NUM_THREADS, (int)hdr->num_records);
+    ASSERT_EQ((unsigned)NUM_THREADS, hdr->num_segments);
+    std::set<uint32_t> tids;
+    ucs_profile_thread_header_t *thread_hdr =
+                    reinterpret_cast<ucs_profile_thread_header_t*>(&data[0] +
+                                                                   hdr->segments_offset);
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        tids.insert(thread_hdr->tid);
+        test_thread(locations, thread_hdr, ITER);
+        thread_hdr = reinterpret_cast<ucs_profile_thread_header_t*>(
+                        reinterpret_cast<ucs_profile_record_t*>(thread_hdr + 1) +
+                        thread_hdr->num_records);
+    }
+    EXPECT_EQ((size_t)NUM_THREADS, tids.size());
+    EXPECT_EQ(data.size(), (size_t)((char*)thread_hdr - &data[0]));
+}
+
+UCS_TEST_F(test_profile, log_stream) {
+    static const int ITER = 1000;
+    /* log buffer of 64 records, split to segments of 16 records */
+    scoped_profile p(*this, UCS_PROFILE_FILENAME, "log", "y", "1536");
+    for (int i = 0; i < ITER; ++i) {
+        profile_test_func1();
+        profile_test_func2(1, 2);
+    }
+
+    std::string data = p.read();
+    ucs_profile_header_t *hdr = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
+    test_header(hdr, UCS_BIT(UCS_PROFILE_MODE_LOG));
+
+    /* records are either written or dropped, never overwritten */
+    EXPECT_EQ((uint64_t)NUM_LOCATIONS * ITER, hdr->num_records + hdr->num_dropped);
+    EXPECT_GT(hdr->num_segments, 1u);
+    EXPECT_GT(hdr->overhead, 0u);
+    EXPECT_GE(hdr->overhead, hdr->num_records * hdr->record_cost);
+
+    /* locations are written after the segments */
+    EXPECT_EQ((unsigned)NUM_LOCATIONS, hdr->num_locations);
+    ucs_profile_location_t *locations =
+                    reinterpret_cast<ucs_profile_location_t*>(&data[0] +
+                                                              hdr->locations_offset);
+    test_locations(locations, hdr->num_locations, 0);
+    EXPECT_EQ(data.size(), hdr->locations_offset +
+                           (sizeof(*locations) * hdr->num_locations));
+
+    uint64_t num_records = 0;
+    uint64_t prev_ts     = 0;
+    char *ptr            = &data[0] + hdr->segments_offset;
+    for (unsigned i = 0; i < hdr->num_segments; ++i) {
+        ucs_profile_thread_header_t *seg_hdr =
+                        reinterpret_cast<ucs_profile_thread_header_t*>(ptr);
+        ucs_profile_record_t *records =
+                        reinterpret_cast<ucs_profile_record_t*>(seg_hdr + 1);
+        EXPECT_EQ(ucs_get_tid(), (pid_t)seg_hdr->tid);
+        for (uint64_t j = 0; j < seg_hdr->num_records; ++j) {
+            EXPECT_LT(records[j].location, (unsigned)NUM_LOCATIONS);
+            EXPECT_GE(records[j].timestamp, prev_ts);
+            prev_ts = records[j].timestamp;
         }
+        num_records += seg_hdr->num_records;
+        ptr          = reinterpret_cast<char*>(records + seg_hdr->num_records);
     }
+    EXPECT_EQ(hdr->num_records, num_records);
+    EXPECT_EQ(&data[0] + hdr->locations_offset, ptr);
+}
+
+UCS_TEST_F(test_profile, log_stream_running) {
+    static const int ITER = 100;
+    scoped_profile p(*this, UCS_PROFILE_FILENAME, "log", "y", "1536");
+    for (int i = 0; i < ITER; ++i) {
+        profile_test_func1();
+        profile_test_func2(1, 2);
+    }
+
+    /* the writer thread keeps the file parseable without a dump */
+    ucs_time_t deadline = ucs_get_time() +
+                          ucs_time_from_sec(5.0 * ucs::test_time_multiplier());
+    std::string data;
+    ucs_profile_header_t *hdr;
+    do {
+        usleep(10000);
+        data = p.read(false);
+        hdr  = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
+    } while (((data.size() < sizeof(*hdr)) || (hdr->num_segments == 0)) &&
+             (ucs_get_time() < deadline));
+
+    ASSERT_GE(data.size(), sizeof(*hdr));
+    test_header(hdr, UCS_BIT(UCS_PROFILE_MODE_LOG));
+    EXPECT_GT(hdr->num_segments, 0u);
+    EXPECT_EQ((unsigned)NUM_LOCATIONS, hdr->num_locations);
+    EXPECT_EQ(data.size(), hdr->locations_offset +
+                           (sizeof(ucs_profile_location_t) * hdr->num_locations));
 }
 
 #endif
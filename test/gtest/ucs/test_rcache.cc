@@ -9,7 +9,9 @@ extern "C" {
 #include <ucs/arch/atomic.h>
 #include <ucs/sys/rcache.h>
 #include <ucs/sys/sys.h>
+#include <ucs/time/time.h>
 }
+#include <vector>
 
 
 class test_rcache : public ucs::test {
@@ -24,8 +26,7 @@ protected:
     test_rcache() : m_reg_count(0), m_ptr(NULL) {
     }
 
-    virtual void init() {
-        ucs::test::init();
+    virtual ucs_rcache_params_t rcache_params() {
         static const ucs_rcache_ops_t ops = {
             mem_reg_cb,
             mem_dereg_cb,
@@ -36,10 +37,19 @@ protected:
             UCS_PGT_ADDR_ALIGN,
             1000,
             &ops,
-            reinterpret_cast<void*>(this)
+            reinterpret_cast<void*>(this),
+            SIZE_MAX,
+            SIZE_MAX
         };
+        return params;
+    }
+
+    virtual void init() {
+        ucs::test::init();
+        ucs_rcache_params_t params = rcache_params();
         UCS_TEST_CREATE_HANDLE(ucs_rcache_t*, m_rcache, ucs_rcache_destroy,
-                               ucs_rcache_create, &params, "test" UCS_STATS_ARG(NULL));
+                               ucs_rcache_create, &params, "test"
+                               UCS_STATS_ARG(ucs_stats_get_root()));
     }
 
     virtual void cleanup() {
@@ -500,3 +510,152 @@ UCS_MT_TEST_F(test_rcache_no_register, register_failure, 10) {
 
     free(ptr);
 }
+
+class test_rcache_lru : public test_rcache {
+protected:
+    static const size_t MAX_REGIONS = 16;
+    static const size_t MAX_PAGES   = 64;
+
+    virtual ucs_rcache_params_t rcache_params() {
+        ucs_rcache_params_t params = test_rcache::rcache_params();
+        params.max_regions = MAX_REGIONS;
+        params.max_size    = MAX_PAGES * ucs_get_page_size();
+        return params;
+    }
+
+    /*
+     * Get and release buffers of buf_pages pages, separated by a guard page so
+     * regions would not be merged, 10 times more than the cache can hold.
+     */
+    void cycle_buffers(size_t buf_pages, size_t max_regions) {
+        const size_t page_size = ucs_get_page_size();
+        const size_t stride    = (buf_pages + 1) * page_size;
+        const size_t num_bufs  = 10 * max_regions;
+        const int    rounds    = 5;
+        char *mem;
+        region *r;
+
+        mem = (char*)alloc_pages(num_bufs * stride, PROT_READ|PROT_WRITE);
+
+        for (int round = 0; round < rounds; ++round) {
+            ucs_time_t start_time = ucs_get_time();
+            for (size_t i = 0; i < num_bufs; ++i) {
+                r = get(mem + (i * stride), buf_pages * page_size);
+                put(r);
+                ASSERT_LE(m_reg_count, max_regions);
+                ASSERT_LE(m_rcache.get()->total_size, MAX_PAGES * page_size);
+            }
+            UCS_TEST_MESSAGE << "round " << round << ": "
+                             << ucs_time_to_nsec(ucs_get_time() - start_time) /
+                                num_bufs
+                             << " nsec per get+put";
+        }
+
+        /* The most recently used buffers are still cached */
+        uint32_t reg_id = next_id;
+        for (size_t i = num_bufs - max_regions; i < num_bufs; ++i) {
+            r = get(mem + (i * stride), buf_pages * page_size);
+            put(r);
+        }
+        EXPECT_EQ(reg_id, next_id);
+
+        munmap(mem, num_bufs * stride);
+    }
+};
+
+const size_t test_rcache_lru::MAX_REGIONS;
+const size_t test_rcache_lru::MAX_PAGES;
+
+UCS_TEST_F(test_rcache_lru, evict_by_count) {
+    cycle_buffers(1, MAX_REGIONS);
+}
+
+UCS_TEST_F(test_rcache_lru, evict_by_size) {
+    cycle_buffers(MAX_PAGES / 8, 8);
+}
+
+UCS_TEST_F(test_rcache_lru, evict_inuse) {
+    const size_t page_size = ucs_get_page_size();
+    const size_t num_bufs  = 2 * MAX_REGIONS;
+    std::vector<region*> regions;
+    char *mem;
+
+    mem = (char*)alloc_pages(2 * (num_bufs + 1) * page_size,
+                             PROT_READ|PROT_WRITE);
+
+    /* Regions which are in use are never evicted, even beyond the limit */
+    for (size_t i = 0; i < num_bufs; ++i) {
+        regions.push_back(get(mem + (2 * i * page_size), page_size));
+    }
+    EXPECT_EQ(num_bufs, m_reg_count);
+
+    for (size_t i = 0; i < num_bufs; ++i) {
+        put(regions[i]);
+    }
+
+    /* The next registration evicts unused regions to get back to the limit */
+    put(get(mem + (2 * num_bufs * page_size), page_size));
+    EXPECT_LE(m_reg_count, MAX_REGIONS);
+
+    munmap(mem, 2 * (num_bufs + 1) * page_size);
+}
+
+UCS_TEST_F(test_rcache_lru, evict_reused) {
+    const size_t page_size = ucs_get_page_size();
+    const size_t num_bufs  = MAX_REGIONS + 1;
+    std::vector<uint32_t> ids;
+    char *mem;
+    region *r;
+
+    mem = (char*)alloc_pages(2 * num_bufs * page_size, PROT_READ|PROT_WRITE);
+
+    /* Fill the cache */
+    for (size_t i = 0; i < MAX_REGIONS; ++i) {
+        r = get(mem + (2 * i * page_size), page_size);
+        ids.push_back(r->id);
+        put(r);
+    }
+    EXPECT_EQ(MAX_REGIONS, m_reg_count);
+
+    /* Use the oldest region again, and keep the next one in use */
+    put(get(mem, page_size));
+    region *inuse = get(mem + (2 * page_size), page_size);
+
+    /* The new region evicts the oldest region which was not used again */
+    put(get(mem + (2 * MAX_REGIONS * page_size), page_size));
+    EXPECT_EQ(MAX_REGIONS, m_reg_count);
+
+    uint32_t reg_id = next_id;
+    r = get(mem, page_size);
+    EXPECT_EQ(ids[0], r->id);
+    put(r);
+    EXPECT_EQ(inuse->id, ids[1]);
+    put(inuse);
+    EXPECT_EQ(reg_id, next_id);
+
+    /* The third region was evicted, so it's registered again */
+    r = get(mem + (4 * page_size), page_size);
+    EXPECT_NE(ids[2], r->id);
+    put(r);
+
+    munmap(mem, 2 * num_bufs * page_size);
+}
+
+UCS_MT_TEST_F(test_rcache_lru, mt_cycle, 6) {
+    const size_t page_size = ucs_get_page_size();
+    const size_t num_bufs  = 10 * MAX_REGIONS;
+
+    char *mem = (char*)shared_malloc(2 * num_bufs * page_size);
+
+    for (int round = 0; round < 10; ++round) {
+        for (size_t i = 0; i < num_bufs; ++i) {
+            put(get(mem + (2 * i * page_size), page_size));
+        }
+    }
+
+    /* Every thread holds at most one region beyond the limit */
+    barrier();
+    EXPECT_LE(m_reg_count, MAX_REGIONS + num_threads());
+
+    shared_free(mem);
+}
@@ -7,6 +7,7 @@
 #include <common/test.h>
 extern "C" {
 #include <ucs/sys/sys.h>
+#include <ucs/config/parser.h>
 #include <ucs/type/spinlock.h>
 #include <ucs/time/time.h>
 }
@@ -104,3 +105,37 @@ UCS_TEST_F(test_sys, memory) {
     UCS_TEST_MESSAGE << "Physical memory size: " << ucs::size_value(phys_size);
     EXPECT_GT(phys_size, 1ul * 1024 * 1024);
 }
+
+UCS_TEST_F(test_sys, parse_cpu_list) {
+    ucs_cpu_set_t cpu_set;
+    ucs_status_t status;
+
+    status = ucs_parse_cpu_list("0-3,8,10-11\n", &cpu_set);
+    ASSERT_UCS_OK(status);
+    for (int cpu = 0; cpu < 16; ++cpu) {
+        bool expected = (cpu <= 3) || (cpu == 8) || (cpu == 10) || (cpu == 11);
+        EXPECT_EQ(expected, (bool)ucs_cpu_is_set(cpu, &cpu_set)) << "cpu " << cpu;
+    }
+
+    status = ucs_parse_cpu_list("", &cpu_set);
+    ASSERT_UCS_OK(status);
+    EXPECT_FALSE(ucs_cpu_is_set(0, &cpu_set));
+
+    EXPECT_NE(UCS_OK, ucs_parse_cpu_list("3-1", &cpu_set));
+    EXPECT_NE(UCS_OK, ucs_parse_cpu_list("1,x", &cpu_set));
+}
+
+UCS_TEST_F(test_sys, sprintf_cpu_set) {
+    ucs_cpu_set_t cpu_set;
+    char buf[256];
+
+    UCS_CPU_ZERO(&cpu_set);
+    for (int cpu = UCS_CPU_SETSIZE - 4; cpu < UCS_CPU_SETSIZE; ++cpu) {
+        UCS_CPU_SET(cpu, &cpu_set);
+    }
+    UCS_CPU_SET(1, &cpu_set);
+
+    ucs_config_sprintf_cpu_set(buf, sizeof(buf), &cpu_set, NULL);
+    EXPECT_EQ("1," + ucs::to_string(UCS_CPU_SETSIZE - 4) + "-" +
+              ucs::to_string(UCS_CPU_SETSIZE - 1), std::string(buf));
+}
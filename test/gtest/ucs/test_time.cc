@@ -11,6 +11,7 @@ extern "C" {
 }
 
 #include <time.h>
+#include <vector>
 
 class test_time : public ucs::test {
 };
@@ -144,4 +145,125 @@ UCS_TEST_F(test_time, timerq) {
     }
 }
 
+UCS_TEST_F(test_time, timerq_wheel) {
+    static const unsigned NUM_TIMERS = 500;
 
+    ucs_timer_queue_t timerq;
+    std::vector<ucs_time_t> intervals, expirations;
+    std::vector<unsigned> expected, counters;
+    ucs_time_t current_time;
+    ucs_timer_t *timer;
+    ucs_status_t status;
+
+    status = ucs_timerq_init(&timerq);
+    ASSERT_UCS_OK(status);
+
+    /* Intervals of different magnitudes, to place timers on all levels */
+    for (unsigned i = 0; i < NUM_TIMERS; ++i) {
+        intervals.push_back((ucs_time_t)(ucs::rand() % 1000 + 1) <<
+                            (ucs::rand() % 40));
+        status = ucs_timerq_add(&timerq, i, intervals[i]);
+        ASSERT_UCS_OK(status);
+    }
+    EXPECT_EQ(NUM_TIMERS, (unsigned)ucs_timerq_size(&timerq));
+
+    /* Compare with the expected behavior: a timer fires when the time passes
+     * its expiration, and is scheduled again to an interval from now */
+    expirations.resize(NUM_TIMERS, 0);
+    expected.resize(NUM_TIMERS, 0);
+    counters.resize(NUM_TIMERS, 0);
+    current_time = ucs::rand();
+    for (unsigned count = 0; count < 5000; ++count) {
+        current_time += (ucs_time_t)(ucs::rand() % 1000 + 1) <<
+                        (ucs::rand() % 30);
+
+        for (unsigned i = 0; i < NUM_TIMERS; ++i) {
+            if (current_time >= expirations[i]) {
+                expirations[i] = current_time + intervals[i];
+                ++expected[i];
+            }
+        }
+
+        ucs_timerq_for_each_expired(timer, &timerq, current_time, {
+            ++counters[timer->id];
+        })
+    }
+
+    for (unsigned i = 0; i < NUM_TIMERS; ++i) {
+        EXPECT_EQ(expected[i], counters[i]) << "timer " << i << " interval " <<
+                                               intervals[i];
+        status = ucs_timerq_remove(&timerq, i);
+        ASSERT_UCS_OK(status);
+    }
+
+    EXPECT_TRUE(ucs_timerq_is_empty(&timerq));
+    EXPECT_EQ(UCS_TIME_INFINITY, ucs_timerq_min_interval(&timerq));
+    ucs_timerq_cleanup(&timerq);
+}
+
+UCS_TEST_F(test_time, timerq_zero_interval) {
+    ucs_timer_queue_t timerq;
+    ucs_status_t status;
+
+    status = ucs_timerq_init(&timerq);
+    ASSERT_UCS_OK(status);
+
+    wrap_errors();
+    status = ucs_timerq_add(&timerq, 1, 0);
+    restore_errors();
+    EXPECT_EQ(UCS_ERR_INVALID_PARAM, status);
+    EXPECT_TRUE(ucs_timerq_is_empty(&timerq));
+
+    ucs_timerq_cleanup(&timerq);
+}
+
+UCS_TEST_F(test_time, timerq_dispatch_perf) {
+    static const unsigned NUM_SWEEPS = 10000;
+
+    ucs_timer_queue_t timerq;
+    ucs_time_t current_time;
+    ucs_timer_t *timer;
+    ucs_status_t status;
+    double time_per_sweep[2];
+    unsigned num_timers[2] = {10, 100000};
+
+    if (ucs::test_time_multiplier() > 1) {
+        UCS_TEST_SKIP;
+    }
+
+    /* A few short timers, and many long ones which don't expire */
+    for (unsigned n = 0; n < 2; ++n) {
+        status = ucs_timerq_init(&timerq);
+        ASSERT_UCS_OK(status);
+
+        current_time = ucs_get_time();
+        for (unsigned i = 0; i < num_timers[n]; ++i) {
+            status = ucs_timerq_add(&timerq, i, (i < 10) ?
+                                    ucs_time_from_usec(10) :
+                                    ucs_time_from_sec(1000 + i));
+            ASSERT_UCS_OK(status);
+        }
+
+        /* Fire all timers for the first time */
+        ucs_timerq_for_each_expired(timer, &timerq, current_time, {})
+
+        ucs_time_t start_time = ucs_get_time();
+        for (unsigned count = 0; count < NUM_SWEEPS; ++count) {
+            current_time += ucs_time_from_usec(10);
+            ucs_timerq_for_each_expired(timer, &timerq, current_time, {})
+        }
+        time_per_sweep[n] = ucs_time_to_nsec(ucs_get_time() - start_time) /
+                            NUM_SWEEPS;
+
+        for (unsigned i = 0; i < num_timers[n]; ++i) {
+            ucs_timerq_remove(&timerq, i);
+        }
+        ucs_timerq_cleanup(&timerq);
+
+        UCS_TEST_MESSAGE << num_timers[n] << " timers: " << time_per_sweep[n]
+                         << " nsec per dispatch";
+    }
+
+    /* Dispatch does not scan the timers which did not expire */
+    EXPECT_LT(time_per_sweep[1], time_per_sweep[0] * 20 + 1000);
+}
@@ -7,11 +7,58 @@
 #include <common/test.h>
 extern "C" {
 #include <ucs/type/cpu_set.h>
+#include <ucs/type/epoch.h>
 }
 
 #include <time.h>
 
 class test_type : public ucs::test {
+protected:
+    static void *epoch_alloc(size_t size) {
+        void *ptr;
+        return posix_memalign(&ptr, UCS_SYS_CACHE_LINE_SIZE, size) ? NULL : ptr;
+    }
+
+    static void *epoch_sync_func(void *arg) {
+        test_type *self = reinterpret_cast<test_type*>(arg);
+        ucs_epoch_synchronize(&self->m_epoch);
+        self->m_synchronized = true;
+        return NULL;
+    }
+
+    /* check that synchronize waits until the reader leaves the section */
+    void test_epoch_section(ucs_epoch_reader_t *reader) {
+        pthread_t thread;
+        int section;
+
+        section = ucs_epoch_enter(&m_epoch, reader);
+        ASSERT_TRUE(section);
+        m_synchronized = false;
+        pthread_create(&thread, NULL, epoch_sync_func, this);
+        usleep(100000);
+        EXPECT_FALSE(m_synchronized);
+
+        ucs_epoch_leave(&m_epoch, reader, section);
+        pthread_join(thread, NULL);
+        EXPECT_TRUE(m_synchronized);
+    }
+
+    void epoch_init() {
+        memset(&m_epoch, 0, sizeof(m_epoch));
+        pthread_mutex_init(&m_epoch.lock, NULL);
+        pthread_mutex_init(&m_epoch.sync_lock, NULL);
+        m_epoch.current = 1;
+        m_epoch.alloc   = epoch_alloc;
+    }
+
+    void epoch_cleanup() {
+        ucs_epoch_cleanup(&m_epoch);
+        pthread_mutex_destroy(&m_epoch.sync_lock);
+        pthread_mutex_destroy(&m_epoch.lock);
+    }
+
+    ucs_epoch_t   m_epoch;
+    volatile bool m_synchronized;
 };
 
 UCS_TEST_F(test_type, cpu_set) {
@@ -39,3 +86,60 @@ UCS_TEST_F(test_type, cpu_set) {
     EXPECT_EQ(0, ucs_cpu_set_find_lcs(&cpu_mask));
 }
 
+UCS_TEST_F(test_type, epoch) {
+    ucs_epoch_thread_t thread;
+    int section;
+
+    epoch_init();
+
+    memset(&thread, 0, sizeof(thread));
+    ucs_epoch_thread_register(&m_epoch, &thread);
+    ucs_epoch_reader_t *reader = ucs_epoch_thread_reader(&thread);
+    ASSERT_TRUE(reader != NULL);
+
+    test_epoch_section(reader);
+    test_epoch_section(NULL);
+
+    /* nested section is not left */
+    section = ucs_epoch_enter(&m_epoch, reader);
+    ASSERT_TRUE(section);
+    EXPECT_FALSE(ucs_epoch_enter(&m_epoch, reader));
+    ucs_epoch_leave(&m_epoch, reader, section);
+    ucs_epoch_synchronize(&m_epoch);
+
+    epoch_cleanup();
+    free(reader); /* first record of the chunk */
+}
+
+UCS_TEST_F(test_type, epoch_unregistered_readers) {
+    int old_section, new_section;
+    pthread_t thread;
+
+    epoch_init();
+
+    /* a reader without a record which enters after the writer started waiting
+     * does not delay it */
+    old_section = ucs_epoch_enter(&m_epoch, NULL);
+    m_synchronized = false;
+    pthread_create(&thread, NULL, epoch_sync_func, this);
+    usleep(100000);
+    EXPECT_FALSE(m_synchronized);
+
+    new_section = ucs_epoch_enter(&m_epoch, NULL);
+    EXPECT_NE(old_section, new_section);
+    ucs_epoch_leave(&m_epoch, NULL, old_section);
+    pthread_join(thread, NULL);
+    EXPECT_TRUE(m_synchronized);
+
+    /* the next writer waits for it */
+    m_synchronized = false;
+    pthread_create(&thread, NULL, epoch_sync_func, this);
+    usleep(100000);
+    EXPECT_FALSE(m_synchronized);
+
+    ucs_epoch_leave(&m_epoch, NULL, new_section);
+    pthread_join(thread, NULL);
+    EXPECT_TRUE(m_synchronized);
+
+    epoch_cleanup();
+}
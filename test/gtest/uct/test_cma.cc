@@ -0,0 +1,136 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2001-2017.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+extern "C" {
+#include <uct/api/uct.h>
+#include <uct/sm/cma/cma_iface.h>
+}
+#include <common/test.h>
+#include "uct_test.h"
+
+class test_uct_cma : public uct_test {
+public:
+    static const size_t LENGTH = 8 * UCS_MBYTE;
+
+    struct pending_send {
+        uct_pending_req_t uct;
+        test_uct_cma      *test;
+        volatile int      done;
+    };
+
+    test_uct_cma() : m_completed(0) {
+        m_comp.func  = completion_cb;
+        m_comp.count = 1;
+    }
+
+    virtual void init() {
+        uct_test::init();
+
+        m_sender = uct_test::create_entity(0);
+        m_entities.push_back(m_sender);
+
+        m_receiver = uct_test::create_entity(0);
+        m_entities.push_back(m_receiver);
+
+        m_sender->connect(0, *m_receiver, 0);
+    }
+
+    static void completion_cb(uct_completion_t *self, ucs_status_t status) {
+        test_uct_cma *test = ucs_container_of(self, test_uct_cma, m_comp);
+        EXPECT_UCS_OK(status);
+        test->m_completed = 1;
+    }
+
+    static ucs_status_t pending_cb(uct_pending_req_t *self) {
+        pending_send *req = ucs_container_of(self, pending_send, uct);
+        ucs_status_t status;
+
+        status = req->test->put_small();
+        if (status == UCS_OK) {
+            req->done = 1;
+        }
+        return status;
+    }
+
+protected:
+    uct_cma_iface_t *sender_iface() {
+        return ucs_derived_of(m_sender->iface(), uct_cma_iface_t);
+    }
+
+    /* start a copy which is done by the helper threads */
+    void put_async(const mapped_buffer &sendbuf, const mapped_buffer &recvbuf) {
+        ucs_status_t status;
+
+        status = uct_ep_put_zcopy(m_sender->ep(0), sendbuf.iov(), 1,
+                                  recvbuf.addr(), recvbuf.rkey(), &m_comp);
+        ASSERT_UCS_OK_OR_INPROGRESS(status);
+        if (status == UCS_OK) {
+            UCS_TEST_SKIP_R("the operation was completed in place");
+        }
+    }
+
+    ucs_status_t put_small() {
+        return uct_ep_put_zcopy(m_sender->ep(0), m_small_sendbuf->iov(), 1,
+                                m_small_recvbuf->addr(),
+                                m_small_recvbuf->rkey(), NULL);
+    }
+
+    entity           *m_sender, *m_receiver;
+    uct_completion_t m_comp;
+    volatile int     m_completed;
+    mapped_buffer    *m_small_sendbuf, *m_small_recvbuf;
+};
+
+UCS_TEST_P(test_uct_cma, fence_pending) {
+    mapped_buffer sendbuf(LENGTH, 1, *m_sender);
+    mapped_buffer recvbuf(LENGTH, 0, *m_receiver);
+    mapped_buffer small_sendbuf(64, 2, *m_sender);
+    mapped_buffer small_recvbuf(64, 0, *m_receiver);
+    pending_send req;
+
+    m_small_sendbuf = &small_sendbuf;
+    m_small_recvbuf = &small_recvbuf;
+
+    put_async(sendbuf, recvbuf);
+
+    /* the fence does not wait, the next operation waits for the copy instead */
+    EXPECT_UCS_OK(uct_ep_fence(m_sender->ep(0), 0));
+    EXPECT_EQ(UCS_ERR_NO_RESOURCE, put_small());
+
+    req.uct.func = pending_cb;
+    req.test     = this;
+    req.done     = 0;
+    ASSERT_UCS_OK(uct_ep_pending_add(m_sender->ep(0), &req.uct));
+
+    wait_for_flag(&req.done);
+    EXPECT_TRUE(m_completed);
+    EXPECT_TRUE(req.done);
+    recvbuf.pattern_check(1);
+    small_recvbuf.pattern_check(2);
+}
+
+UCS_TEST_P(test_uct_cma, destroy_outstanding) {
+    mapped_buffer sendbuf(LENGTH, 1, *m_sender);
+    mapped_buffer recvbuf(LENGTH, 0, *m_receiver);
+    ucs_time_t deadline;
+
+    put_async(sendbuf, recvbuf);
+
+    /* the endpoint is destroyed without waiting for the copy, which is then
+     * completed without invoking the user completion */
+    m_sender->destroy_ep(0);
+
+    deadline = ucs_get_time() + ucs_time_from_sec(DEFAULT_TIMEOUT_SEC);
+    while ((sender_iface()->outstanding > 0) && (ucs_get_time() < deadline)) {
+        progress();
+    }
+
+    EXPECT_EQ(0u, sender_iface()->outstanding);
+    EXPECT_FALSE(m_completed);
+    recvbuf.pattern_check(1);
+}
+
+_UCT_INSTANTIATE_TEST_CASE(test_uct_cma, cma)
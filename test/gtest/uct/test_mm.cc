@@ -6,7 +6,12 @@
 
 extern "C" {
 #include <uct/api/uct.h>
+#include <uct/sm/mm/mm_ep.h>
 #include <ucs/time/time.h>
+#ifndef UCT_MD_DISABLE_NUMA
+#include <numaif.h>
+#include <numa.h>
+#endif
 }
 #include "uct_p2p_test.h"
 #include <common/test.h>
@@ -15,17 +20,22 @@ extern "C" {
 class test_uct_mm : public uct_test {
 public:
 
-    void initialize() {
+    void init() {
         if (GetParam()->dev_name == "posix") {
             set_config("USE_SHM_OPEN=no");
         }
         uct_test::init();
+    }
 
-        m_e1 = uct_test::create_entity(0);
-        m_entities.push_back(m_e1);
+    entity* create_mm_entity() {
+        entity *e = uct_test::create_entity(0);
+        m_entities.push_back(e);
+        return e;
+    }
 
-        m_e2 = uct_test::create_entity(0);
-        m_entities.push_back(m_e2);
+    void initialize() {
+        m_e1 = create_mm_entity();
+        m_e2 = create_mm_entity();
 
         m_e1->connect(0, *m_e2, 0);
         m_e2->connect(0, *m_e1, 0);
@@ -99,4 +109,437 @@ UCS_TEST_P(test_uct_mm, open_for_posix) {
     }
 }
 
+class test_uct_mm_fifo_batch : public test_uct_mm {
+public:
+    static ucs_status_t am_seq_handler(void *arg, void *data, size_t length,
+                                       unsigned flags) {
+        std::vector<uint64_t> *recvd = (std::vector<uint64_t>*)arg;
+        recvd->push_back(*(uint64_t*)data);
+        return UCS_OK;
+    }
+
+    /* the receiver's tail, as the sender sees it */
+    uint64_t sender_tail() {
+        return ucs_derived_of(m_e1->ep(0), uct_mm_ep_t)->remote_fifo_ctl->tail;
+    }
+};
+
+UCS_TEST_P(test_uct_mm_fifo_batch, poll_batch, "FIFO_SIZE=64",
+           "FIFO_MAX_POLL=6", "FIFO_RELEASE_FACTOR=0.25")
+{
+    const unsigned max_poll    = 6;
+    const unsigned release     = 16; /* FIFO_SIZE * FIFO_RELEASE_FACTOR */
+    const unsigned num_sends   = 40;
+    std::vector<uint64_t> recvd;
+    unsigned prev_recvd;
+    uint64_t tail;
+
+    initialize();
+    check_caps(UCT_IFACE_FLAG_AM_SHORT | UCT_IFACE_FLAG_AM_CB_SYNC);
+    uct_iface_set_am_handler(m_e2->iface(), 0, am_seq_handler, &recvd,
+                             UCT_AM_CB_FLAG_SYNC);
+
+    /* send a burst which fits the FIFO, before the receiver polls it */
+    for (uint64_t seq = 0; seq < num_sends; ++seq) {
+        ASSERT_UCS_OK(uct_ep_am_short(m_e1->ep(0), 0, seq, NULL, 0));
+    }
+    EXPECT_EQ(0ul, sender_tail());
+
+    /* the progress is enabled after the connection is signaled */
+    ucs_time_t deadline = ucs_get_time() +
+                          ucs_time_from_sec(DEFAULT_TIMEOUT_SEC) *
+                          ucs::test_time_multiplier();
+    while (recvd.empty() && (ucs_get_time() < deadline)) {
+        m_e2->progress();
+    }
+
+    ASSERT_EQ(max_poll, recvd.size());
+    EXPECT_EQ(0ul, sender_tail());
+
+    /* every progress call reads a full batch, until the FIFO is drained, and
+     * publishes the tail when the read index crosses a release boundary */
+    tail = 0;
+    while (recvd.size() < num_sends) {
+        prev_recvd = recvd.size();
+        m_e2->progress();
+        ASSERT_EQ(std::min(prev_recvd + max_poll, num_sends), recvd.size());
+        if ((prev_recvd / release) != (recvd.size() / release)) {
+            tail = recvd.size();
+        }
+        EXPECT_EQ(tail, sender_tail());
+    }
+
+    for (unsigned i = 0; i < num_sends; ++i) {
+        EXPECT_EQ(i, recvd[i]);
+    }
+
+    /* the batch which read elements 30..35 crossed the boundary at 32 */
+    EXPECT_EQ(36ul, sender_tail());
+
+    uct_iface_set_am_handler(m_e2->iface(), 0, NULL, NULL, UCT_AM_CB_FLAG_SYNC);
+}
+
+class test_uct_mm_wakeup : public test_uct_mm {
+public:
+    struct pending_send {
+        uct_pending_req_t uct;
+        uct_ep_h          ep;
+    };
+
+    static ucs_status_t am_count_handler(void *arg, void *data, size_t length,
+                                         unsigned flags) {
+        ++(*(volatile unsigned*)arg);
+        return UCS_OK;
+    }
+
+    static ucs_status_t pending_cb(uct_pending_req_t *self) {
+        pending_send *req = ucs_container_of(self, pending_send, uct);
+        return uct_ep_am_short(req->ep, 0, 0, NULL, 0);
+    }
+
+    void wait_for_recv(volatile unsigned *num_recvd, unsigned value,
+                       entity *e) {
+        ucs_time_t deadline = ucs_get_time() +
+                              ucs_time_from_sec(DEFAULT_TIMEOUT_SEC) *
+                              ucs::test_time_multiplier();
+        while ((*num_recvd != value) && (ucs_get_time() < deadline)) {
+            e->progress();
+        }
+    }
+};
+
+UCS_TEST_P(test_uct_mm_wakeup, arm_pending) {
+    ucs::handle<uct_wakeup_h> wakeup_handle;
+    volatile unsigned num_recvd;
+    unsigned num_sent;
+    pending_send req;
+
+    initialize();
+    check_caps(UCT_IFACE_FLAG_AM_SHORT | UCT_IFACE_FLAG_PENDING |
+               UCT_IFACE_FLAG_WAKEUP);
+
+    num_recvd = 0;
+    uct_iface_set_am_handler(m_e2->iface(), 0, am_count_handler,
+                             (void*)&num_recvd, UCT_AM_CB_FLAG_SYNC);
+    UCS_TEST_CREATE_HANDLE(uct_wakeup_h, wakeup_handle, uct_wakeup_close,
+                           uct_wakeup_open, m_e1->iface(), UCT_WAKEUP_RX_AM);
+
+    /* fill the remote FIFO, and queue a pending send */
+    num_sent = 0;
+    while (uct_ep_am_short(m_e1->ep(0), 0, 0, NULL, 0) == UCS_OK) {
+        ++num_sent;
+    }
+
+    req.uct.func = pending_cb;
+    req.ep       = m_e1->ep(0);
+    ASSERT_UCS_OK(uct_ep_pending_add(m_e1->ep(0), &req.uct));
+
+    /* the pending send can't progress, so the sender can sleep */
+    EXPECT_UCS_OK(uct_wakeup_efd_arm(wakeup_handle));
+
+    /* once the receiver releases the FIFO, the pending send can progress */
+    wait_for_recv(&num_recvd, num_sent, m_e2);
+    ASSERT_EQ(num_sent, num_recvd);
+    EXPECT_EQ(UCS_ERR_BUSY, uct_wakeup_efd_arm(wakeup_handle));
+
+    m_e1->progress();
+    wait_for_recv(&num_recvd, num_sent + 1, m_e2);
+    EXPECT_EQ(num_sent + 1, num_recvd);
+    EXPECT_UCS_OK(uct_wakeup_efd_arm(wakeup_handle));
+}
+
+
+class test_uct_mm_fifo_lanes : public test_uct_mm {
+public:
+    static const unsigned NUM_SENDERS = 4;
+
+    void init() {
+        test_uct_mm::init();
+        m_receiver = create_mm_entity();
+        m_received = 0;
+    }
+
+    static ucs_status_t am_handler(void *arg, void *data, size_t length,
+                                   unsigned flags) {
+        test_uct_mm_fifo_lanes *self = reinterpret_cast<test_uct_mm_fifo_lanes*>(arg);
+        uint64_t hdr = *(uint64_t*)data;
+        unsigned sender = hdr >> 32;
+
+        /* messages of every sender arrive in order */
+        EXPECT_EQ(self->m_seq.at(sender), (hdr & UCS_MASK(32)));
+        ++self->m_seq.at(sender);
+        ++self->m_received;
+        return UCS_OK;
+    }
+
+    entity* add_sender() {
+        entity *sender = create_mm_entity();
+        sender->connect(0, *m_receiver, 0);
+        m_seq.push_back(0);
+        return sender;
+    }
+
+    int fifo_lane(entity *sender) {
+        return ucs_derived_of(sender->ep(0), uct_mm_ep_t)->fifo_lane;
+    }
+
+    void send(entity *sender, unsigned sender_index, unsigned count) {
+        uint64_t first_seq = m_seq.at(sender_index);
+        uint64_t payload   = 0;
+        unsigned expected  = m_received + count;
+        ucs_status_t status;
+
+        for (unsigned seq = 0; seq < count; ++seq) {
+            uint64_t hdr = ((uint64_t)sender_index << 32) | (first_seq + seq);
+            do {
+                status = uct_ep_am_short(sender->ep(0), 0, hdr, &payload,
+                                         sizeof(payload));
+                sender->progress();
+                m_receiver->progress();
+            } while (status == UCS_ERR_NO_RESOURCE);
+            ASSERT_UCS_OK(status);
+        }
+
+        while (m_received < expected) {
+            m_receiver->progress();
+        }
+    }
+
+protected:
+    entity                *m_receiver;
+    std::vector<uint64_t> m_seq;
+    unsigned              m_received;
+};
+
+UCS_TEST_P(test_uct_mm_fifo_lanes, many2one, "FIFO_LANES=2")
+{
+    const unsigned num_sends = 1000 / ucs::test_time_multiplier();
+    std::vector<entity*> senders;
+    unsigned num_lanes = 0;
+
+    check_caps(UCT_IFACE_FLAG_AM_SHORT | UCT_IFACE_FLAG_AM_CB_SYNC);
+    uct_iface_set_am_handler(m_receiver->iface(), 0, am_handler, this,
+                             UCT_AM_CB_FLAG_SYNC);
+
+    for (unsigned i = 0; i < NUM_SENDERS; ++i) {
+        senders.push_back(add_sender());
+        num_lanes += (fifo_lane(senders.back()) >= 0);
+    }
+
+    /* first senders take the lanes, the rest use the shared FIFO */
+    EXPECT_EQ(2u, num_lanes);
+
+    for (unsigned i = 0; i < num_sends; ++i) {
+        unsigned sender_index = ucs::rand() % NUM_SENDERS;
+        send(senders[sender_index], sender_index, 1 + ucs::rand() % 100);
+    }
+
+    /* a released lane is reused after the receiver drains it */
+    ASSERT_GE(fifo_lane(senders[0]), 0);
+    senders[0]->destroy_ep(0);
+    m_receiver->progress();
+
+    entity *sender = add_sender();
+    EXPECT_GE(fifo_lane(sender), 0);
+    send(sender, NUM_SENDERS, num_sends);
+
+    uct_iface_set_am_handler(m_receiver->iface(), 0, NULL, NULL,
+                             UCT_AM_CB_FLAG_SYNC);
+}
+
+UCS_TEST_P(test_uct_mm_fifo_lanes, remote_lanes, "FIFO_LANES=1")
+{
+    const unsigned num_sends = 1000 / ucs::test_time_multiplier();
+    std::vector<entity*> senders;
+    unsigned num_lanes = 0;
+
+    check_caps(UCT_IFACE_FLAG_AM_SHORT | UCT_IFACE_FLAG_AM_CB_SYNC);
+    uct_iface_set_am_handler(m_receiver->iface(), 0, am_handler, this,
+                             UCT_AM_CB_FLAG_SYNC);
+
+    /* the senders claim the lanes of the receiver, not their own */
+    modify_config("FIFO_LANES", "4");
+    for (unsigned i = 0; i < NUM_SENDERS; ++i) {
+        senders.push_back(add_sender());
+        num_lanes += (fifo_lane(senders.back()) >= 0);
+    }
+    EXPECT_EQ(1u, num_lanes);
+
+    for (unsigned i = 0; i < num_sends; ++i) {
+        unsigned sender_index = ucs::rand() % NUM_SENDERS;
+        send(senders[sender_index], sender_index, 1 + ucs::rand() % 100);
+    }
+
+    uct_iface_set_am_handler(m_receiver->iface(), 0, NULL, NULL,
+                             UCT_AM_CB_FLAG_SYNC);
+}
+
+class test_uct_mm_remote_segs : public test_uct_mm {
+public:
+    static const unsigned NUM_EPS = 4;
+
+    void init() {
+        test_uct_mm::init();
+        m_sender   = create_mm_entity();
+        m_receiver = create_mm_entity();
+        m_received = 0;
+    }
+
+    static ucs_status_t am_handler(void *arg, void *data, size_t length,
+                                   unsigned flags) {
+        test_uct_mm_remote_segs *self = reinterpret_cast<test_uct_mm_remote_segs*>(arg);
+
+        EXPECT_EQ(sizeof(uint64_t), length);
+        EXPECT_EQ(self->m_received, *(uint64_t*)data);
+        ++self->m_received;
+        return UCS_OK;
+    }
+
+    static size_t pack_cb(void *dest, void *arg) {
+        *(uint64_t*)dest = *(uint64_t*)arg;
+        return sizeof(uint64_t);
+    }
+
+    uct_mm_iface_t *sender_iface() {
+        return ucs_derived_of(m_sender->iface(), uct_mm_iface_t);
+    }
+
+    uct_mm_remote_peer_t *peer(unsigned index) {
+        return ucs_derived_of(m_sender->ep(index), uct_mm_ep_t)->peer;
+    }
+
+    void send_bcopy(unsigned index, unsigned count) {
+        unsigned expected = m_received + count;
+        ssize_t packed_len;
+
+        for (uint64_t seq = m_received; seq < expected; ++seq) {
+            do {
+                packed_len = uct_ep_am_bcopy(m_sender->ep(index), 0, pack_cb,
+                                             &seq);
+                progress();
+            } while (packed_len == UCS_ERR_NO_RESOURCE);
+            ASSERT_EQ((ssize_t)sizeof(seq), packed_len);
+            while (m_received <= seq) {
+                progress();
+            }
+        }
+    }
+
+protected:
+    entity   *m_sender, *m_receiver;
+    uint64_t m_received;
+};
+
+UCS_TEST_P(test_uct_mm_remote_segs, shared_by_eps)
+{
+    const unsigned num_sends = 1000 / ucs::test_time_multiplier();
+    uct_mm_iface_t *iface;
+    size_t num_segs;
+
+    check_caps(UCT_IFACE_FLAG_AM_BCOPY | UCT_IFACE_FLAG_AM_CB_SYNC);
+    uct_iface_set_am_handler(m_receiver->iface(), 0, am_handler, this,
+                             UCT_AM_CB_FLAG_SYNC);
+
+    for (unsigned i = 0; i < NUM_EPS; ++i) {
+        m_sender->connect_to_iface(i, *m_receiver);
+    }
+
+    /* all the eps use the same attached peer, which has the receiver's
+     * descriptor chunks attached in advance */
+    iface = sender_iface();
+    EXPECT_EQ(1u, kh_size(&iface->remote_peers));
+    EXPECT_EQ((unsigned)NUM_EPS, peer(0)->refcount);
+    num_segs = kh_size(&iface->remote_segs);
+    EXPECT_GT(num_segs, 0ul);
+
+    for (unsigned i = 0; i < num_sends; ++i) {
+        unsigned index = ucs::rand() % NUM_EPS;
+        EXPECT_EQ(peer(0), peer(index));
+        send_bcopy(index, 1 + ucs::rand() % 10);
+    }
+
+    /* no segment is attached per ep */
+    EXPECT_EQ(num_segs, kh_size(&iface->remote_segs));
+
+    /* the peer is detached with its last ep */
+    for (unsigned i = 1; i < NUM_EPS; ++i) {
+        m_sender->destroy_ep(i);
+    }
+    EXPECT_EQ(1u, kh_size(&iface->remote_peers));
+    EXPECT_EQ(1u, peer(0)->refcount);
+
+    m_sender->destroy_ep(0);
+    EXPECT_EQ(0u, kh_size(&iface->remote_peers));
+    EXPECT_EQ(0u, kh_size(&iface->remote_segs));
+
+    uct_iface_set_am_handler(m_receiver->iface(), 0, NULL, NULL,
+                             UCT_AM_CB_FLAG_SYNC);
+}
+
+class test_uct_mm_numa : public test_uct_mm {
+public:
+    void init() {
+        test_uct_mm::init();
+        m_e = create_mm_entity();
+    }
+
+protected:
+#ifndef UCT_MD_DISABLE_NUMA
+    /* restores the default memory policy when leaving the scope, also if the
+     * test fails in it */
+    class mempolicy_restore {
+    public:
+        ~mempolicy_restore() {
+            set_mempolicy(MPOL_DEFAULT, NULL, 0);
+        }
+    };
+#endif
+
+    entity *m_e;
+};
+
+UCS_TEST_P(test_uct_mm_numa, default_policy, "NUMA_POLICY=default")
+{
+    EXPECT_EQ(0ul, m_e->iface_attr().numa_node_mask);
+}
+
+UCS_TEST_P(test_uct_mm_numa, bind_node, "NUMA_POLICY=bind", "NUMA_NODE=0")
+{
+    uct_mm_iface_t *iface = ucs_derived_of(m_e->iface(), uct_mm_iface_t);
+
+    if (iface->numa_node < 0) {
+        UCS_TEST_SKIP_R("NUMA is not available");
+    }
+
+    /* the receive FIFO and descriptors are placed on the configured node */
+    EXPECT_EQ(0, iface->numa_node);
+    EXPECT_EQ(1ul, m_e->iface_attr().numa_node_mask);
+}
+
+#ifndef UCT_MD_DISABLE_NUMA
+UCS_TEST_P(test_uct_mm_numa, process_bind, "NUMA_POLICY=bind", "NUMA_NODE=0")
+{
+    unsigned long nodemask = 1;
+    entity *e;
+
+    if (numa_available() < 0) {
+        UCS_TEST_SKIP_R("NUMA is not available");
+    }
+
+    /* the bind policy of the process is kept */
+    ASSERT_EQ(0, set_mempolicy(MPOL_BIND, &nodemask, sizeof(nodemask) * 8 + 1));
+    {
+        mempolicy_restore restore;
+        e = create_mm_entity();
+    }
+
+    EXPECT_EQ(0ul, e->iface_attr().numa_node_mask);
+}
+#endif
+
 _UCT_INSTANTIATE_TEST_CASE(test_uct_mm, mm)
+_UCT_INSTANTIATE_TEST_CASE(test_uct_mm_fifo_batch, mm)
+_UCT_INSTANTIATE_TEST_CASE(test_uct_mm_wakeup, mm)
+_UCT_INSTANTIATE_TEST_CASE(test_uct_mm_fifo_lanes, mm)
+_UCT_INSTANTIATE_TEST_CASE(test_uct_mm_remote_segs, mm)
+_UCT_INSTANTIATE_TEST_CASE(test_uct_mm_numa, mm)
@@ -0,0 +1,125 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2001-2017.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+extern "C" {
+#include <uct/api/uct.h>
+#include <uct/tcp/tcp.h>
+#include <ucs/time/time.h>
+}
+#include <common/test.h>
+#include "uct_test.h"
+
+class test_uct_tcp : public uct_test {
+public:
+    struct comp_status {
+        uct_completion_t      uct;
+        volatile ucs_status_t status;
+    };
+
+    virtual void init() {
+        uct_test::init();
+
+        m_sender = uct_test::create_entity(0);
+        m_entities.push_back(m_sender);
+
+        m_receiver = uct_test::create_entity(0);
+        m_entities.push_back(m_receiver);
+
+        m_sender->connect(0, *m_receiver, 0);
+    }
+
+    static void completion_cb(uct_completion_t *self, ucs_status_t status) {
+        comp_status *comp = ucs_container_of(self, comp_status, uct);
+        comp->status = status;
+    }
+
+    static void unpack_cb(void *arg, const void *data, size_t length) {
+    }
+
+    static size_t pack_cb(void *dest, void *arg) {
+        size_t length = *(size_t*)arg;
+        memset(dest, 0, length);
+        return length;
+    }
+
+protected:
+    entity *m_sender, *m_receiver;
+};
+
+UCS_TEST_P(test_uct_tcp, rma_connection_failure) {
+    mapped_buffer recvbuf(64, 1, *m_receiver);
+    uct_tcp_key_t bad_key;
+    comp_status comp;
+    ucs_status_t status;
+    ucs_time_t deadline;
+    uint64_t value = 0;
+
+    /* the target rejects a request to an unknown region by closing the RMA
+     * connection, so the reply never arrives */
+    bad_key    = *(const uct_tcp_key_t*)recvbuf.rkey();
+    bad_key.id = 0;
+
+    comp.uct.func  = completion_cb;
+    comp.uct.count = 1;
+    comp.status    = UCS_INPROGRESS;
+
+    wrap_errors();
+    status = uct_ep_get_bcopy(m_sender->ep(0), unpack_cb, NULL,
+                              recvbuf.length(), recvbuf.addr(),
+                              (uct_rkey_t)&bad_key, &comp.uct);
+    EXPECT_EQ(UCS_INPROGRESS, status);
+
+    deadline = ucs_get_time() + ucs_time_from_sec(DEFAULT_TIMEOUT_SEC);
+    while ((comp.status == UCS_INPROGRESS) && (ucs_get_time() < deadline)) {
+        progress();
+    }
+    restore_errors();
+
+    /* the request is failed, and the endpoint does not start new RMA
+     * operations on the broken connection */
+    EXPECT_NE(UCS_INPROGRESS, comp.status);
+    EXPECT_NE(UCS_OK, comp.status);
+
+    status = uct_ep_put_short(m_sender->ep(0), &value, sizeof(value),
+                              recvbuf.addr(), recvbuf.rkey());
+    EXPECT_EQ(UCS_ERR_IO_ERROR, status);
+
+    status = uct_ep_flush(m_sender->ep(0), 0, NULL);
+    EXPECT_EQ(UCS_ERR_IO_ERROR, status);
+}
+
+UCS_TEST_P(test_uct_tcp, tx_failure) {
+    size_t length = m_sender->iface_attr().cap.am.max_bcopy;
+    ucs_time_t deadline;
+    ucs_status_t status;
+    ssize_t ret;
+
+    /* fill the socket buffers, until a part of a message is kept in the send
+     * buffer of the endpoint */
+    do {
+        ret = uct_ep_am_bcopy(m_sender->ep(0), 0, pack_cb, &length);
+    } while (ret >= 0);
+    ASSERT_EQ(UCS_ERR_NO_RESOURCE, ret);
+
+    /* the receiver closes the connection without reading the data */
+    m_entities.remove(m_receiver);
+
+    wrap_errors();
+    deadline = ucs_get_time() + ucs_time_from_sec(DEFAULT_TIMEOUT_SEC);
+    do {
+        m_sender->progress();
+        status = uct_ep_flush(m_sender->ep(0), 0, NULL);
+    } while ((status == UCS_ERR_NO_RESOURCE) && (ucs_get_time() < deadline));
+    restore_errors();
+
+    /* the buffered data could not be sent, so neither flush nor the following
+     * sends report success */
+    EXPECT_EQ(UCS_ERR_IO_ERROR, status);
+    EXPECT_EQ(UCS_ERR_IO_ERROR, uct_ep_am_short(m_sender->ep(0), 0, 0, NULL, 0));
+    EXPECT_EQ(UCS_ERR_IO_ERROR, uct_ep_flush(m_sender->ep(0), 0, NULL));
+}
+
+_UCT_INSTANTIATE_TEST_CASE(test_uct_tcp, tcp)
@@ -91,6 +91,9 @@ UCS_TEST_P(test_uct_wakeup, am)
     /* make sure the file descriptor IS signaled ONCE */
     ASSERT_EQ(1, poll(&wakeup_fd, 1, 1000*ucs::test_time_multiplier()));
     do {
+        /* transports which report unprocessed messages as events can be armed
+         * only after the message is processed */
+        progress();
         status = uct_wakeup_efd_arm(wakeup_handle);
     } while (UCS_ERR_BUSY == status);
     ASSERT_EQ(UCS_OK, status);
@@ -119,3 +122,64 @@ UCS_TEST_P(test_uct_wakeup, am)
 }
 
 UCT_INSTANTIATE_NO_SELF_TEST_CASE(test_uct_wakeup);
+
+
+class test_uct_wakeup_tx : public test_uct_wakeup {
+public:
+    test_uct_wakeup_tx() : m_completed(0) {
+        m_comp.func  = completion_cb;
+        m_comp.count = 1;
+    }
+
+    static void completion_cb(uct_completion_t *self, ucs_status_t status) {
+        test_uct_wakeup_tx *test = ucs_container_of(self, test_uct_wakeup_tx,
+                                                    m_comp);
+        EXPECT_UCS_OK(status);
+        test->m_completed = 1;
+    }
+
+protected:
+    uct_completion_t m_comp;
+    volatile int     m_completed;
+};
+
+UCS_TEST_P(test_uct_wakeup_tx, put_zcopy)
+{
+    static const size_t length = 8 * UCS_MBYTE;
+    ucs::handle<uct_wakeup_h> wakeup_handle;
+    struct pollfd wakeup_fd;
+    ucs_status_t status;
+
+    initialize();
+    check_caps(UCT_IFACE_FLAG_WAKEUP | UCT_IFACE_FLAG_PUT_ZCOPY);
+
+    mapped_buffer sendbuf(length, 1, *m_e1);
+    mapped_buffer recvbuf(length, 0, *m_e2);
+
+    UCS_TEST_CREATE_HANDLE(uct_wakeup_h, wakeup_handle, uct_wakeup_close,
+                           uct_wakeup_open, m_e1->iface(), UCT_WAKEUP_TX_COMPLETION);
+
+    ASSERT_EQ(UCS_OK, uct_wakeup_efd_get(wakeup_handle, &wakeup_fd.fd));
+    wakeup_fd.events = POLLIN;
+
+    status = uct_ep_put_zcopy(m_e1->ep(0), sendbuf.iov(), 1, recvbuf.addr(),
+                              recvbuf.rkey(), &m_comp);
+    ASSERT_UCS_OK_OR_INPROGRESS(status);
+    if (status == UCS_OK) {
+        UCS_TEST_SKIP_R("the operation was completed in place");
+    }
+
+    /* the fd is signaled by the completion, unless it was already done */
+    status = uct_wakeup_efd_arm(wakeup_handle);
+    if (status == UCS_OK) {
+        ASSERT_EQ(1, poll(&wakeup_fd, 1, 10000*ucs::test_time_multiplier()));
+    } else {
+        ASSERT_EQ(UCS_ERR_BUSY, status);
+    }
+
+    wait_for_flag(&m_completed);
+    EXPECT_TRUE(m_completed);
+    recvbuf.pattern_check(1);
+}
+
+_UCT_INSTANTIATE_TEST_CASE(test_uct_wakeup_tx, cma)
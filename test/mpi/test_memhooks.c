@@ -9,9 +9,13 @@
 #include <ucs/sys/preprocessor.h>
 #include <ucm/api/ucm.h>
 #include <sys/mman.h>
+#include <sys/time.h>
+#include <pthread.h>
 #include <malloc.h>
 #include <dlfcn.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 #define CHKERR_JUMP(cond, msg, label) \
@@ -40,6 +44,8 @@ void* flag_no_install_init(const char *path);
 int malloc_hooks_run(void *dl);
 int ext_event_run(void *dl);
 void *ext_event_init(const char *path);
+int malloc_scale_run(void *dl);
+int mmap_scale_run(void *dl);
 
 typedef struct memtest_type {
     const char *name;
@@ -51,11 +57,14 @@ memtest_type_t tests[] = {
     {"malloc_hooks",    open_dyn_lib,         malloc_hooks_run},
     {"external_events", ext_event_init,       ext_event_run},
     {"flag_no_install", flag_no_install_init, ext_event_run},
+    {"malloc_scale",    open_dyn_lib,         malloc_scale_run},
+    {"mmap_scale",      open_dyn_lib,         mmap_scale_run},
     {NULL}
 };
 
 static volatile size_t total_mapped = 0;
 static volatile size_t total_unmapped = 0;
+static int max_threads = 8;
 
 static void usage() {
     printf("Usage: test_memhooks [options]\n");
@@ -65,6 +74,10 @@ static void usage() {
     printf("                 malloc_hooks     : General UCM test.\n");
     printf("                 external_events  : Test of ucm_set_external_event() API.\n");
     printf("                 flag_no_install  : Test of UCM_EVENT_FLAG_NO_INSTALL flag.\n");
+    printf("                 malloc_scale     : Multi-threaded malloc/free benchmark.\n");
+    printf("                 mmap_scale       : Multi-threaded mmap/munmap benchmark.\n");
+    printf("  -n <count> Maximal number of threads for benchmarks (%d)\n",
+           max_threads);
     printf("\n");
 }
 
@@ -269,6 +282,113 @@ fail:
     return  -1;
 }
 
+static double get_time()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void *malloc_scale_thread(void *arg)
+{
+    static const int num_iters = 200000;
+    static const int num_ptrs  = 64;
+    void *ptrs[num_ptrs];
+    unsigned seed = (uintptr_t)arg;
+    int i, j;
+
+    memset(ptrs, 0, sizeof(ptrs));
+    for (i = 0; i < num_iters; ++i) {
+        j = rand_r(&seed) % num_ptrs;
+        free(ptrs[j]);
+        ptrs[j] = malloc(16 + (rand_r(&seed) % 4096));
+        *(char*)ptrs[j] = 0;
+    }
+    for (j = 0; j < num_ptrs; ++j) {
+        free(ptrs[j]);
+    }
+    return (void*)(uintptr_t)num_iters;
+}
+
+static void *mmap_scale_thread(void *arg)
+{
+    static const int num_iters = 100000;
+    size_t length = 4096 * (1 + ((uintptr_t)arg % 4));
+    void *ptr;
+    int i;
+
+    for (i = 0; i < num_iters; ++i) {
+        ptr = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+                   -1, 0);
+        if (ptr != MAP_FAILED) {
+            munmap(ptr, length);
+        }
+    }
+    return (void*)(uintptr_t)num_iters;
+}
+
+static void scale_event_callback(ucm_event_type_t event_type, ucm_event_t *event,
+                                 void *arg)
+{
+}
+
+static int scale_run(void *dl, void* (*thread_func)(void*), const char *op_name)
+{
+    ucs_status_t (*set_handler)(int events, int priority,
+                                ucm_event_callback_t cb, void *arg);
+    pthread_t threads[max_threads];
+    double start, elapsed;
+    ucs_status_t status;
+    size_t total_ops;
+    void *thread_ops;
+    int num_threads;
+    int i;
+
+    DL_FIND_FUNC(dl, "ucm_set_event_handler", set_handler, goto fail);
+
+    /* Setting an event handler installs the hooks. It does not touch shared
+     * data, so the benchmark measures only the hooks. */
+    status = set_handler(UCM_EVENT_VM_MAPPED | UCM_EVENT_VM_UNMAPPED, 0,
+                         scale_event_callback, NULL);
+    CHKERR_JUMP(status != UCS_OK, "Failed to set event handler", fail);
+
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        total_ops = 0;
+        start     = get_time();
+        for (i = 0; i < num_threads; ++i) {
+            pthread_create(&threads[i], NULL, thread_func,
+                           (void*)(uintptr_t)(i + 1));
+        }
+        for (i = 0; i < num_threads; ++i) {
+            pthread_join(threads[i], &thread_ops);
+            total_ops += (uintptr_t)thread_ops;
+        }
+        elapsed = get_time() - start;
+
+        printf("threads: %3d  %s: %8.2f Mops/s  per thread: %6.2f Mops/s\n",
+               num_threads, op_name, total_ops / elapsed * 1e-6,
+               total_ops / elapsed * 1e-6 / num_threads);
+    }
+
+    dlclose(dl);
+    return 0;
+
+fail:
+    dlclose(dl);
+    return -1;
+}
+
+int malloc_scale_run(void *dl)
+{
+    return scale_run(dl, malloc_scale_thread, "malloc+free");
+}
+
+int mmap_scale_run(void *dl)
+{
+    return scale_run(dl, mmap_scale_thread, "mmap+munmap");
+}
+
 int ext_event_run(void *dl)
 {
     void *ptr_direct_mmap;
@@ -315,7 +435,7 @@ int main(int argc, char **argv)
     int ret;
     int c;
 
-    while ((c = getopt(argc, argv, "t:h")) != -1) {
+    while ((c = getopt(argc, argv, "t:n:h")) != -1) {
         switch (c) {
         case 't':
             for (test = tests; test->name != NULL; ++test) {
@@ -328,6 +448,9 @@ int main(int argc, char **argv)
                 return -1;
             }
             break;
+        case 'n':
+            max_threads = atoi(optarg);
+            break;
         case 'h':
         default:
             usage();